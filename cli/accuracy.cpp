@@ -0,0 +1,313 @@
+#include "cli.hpp"
+#include "def_psi0.hpp"
+#include "def_v.hpp"
+#include "special.hpp"
+#include <cstdio>
+#include <functional>
+
+// Accuracy versus cost: demo configurations with a closed-form evolution are run over a range of dx/dt values,
+// reporting the L² error against the exact Ψ (at the last iteration), norm and energy drift and the wall time of each run
+// Runs of the same case that no other run beats in both error and time are marked as Pareto-optimal
+
+namespace {
+
+    constexpr double AccuracyHslash = 1.0;
+    constexpr double AccuracyMass = 1.0;
+    constexpr double DefaultSpaceSteps[] = { 0.05, 0.02, 0.01 };
+    constexpr double DefaultTimeSteps[] = { 1.0e-2, 5.0e-3, 1.0e-3 };
+
+    // Free Gaussian packet
+    constexpr double FreePacketCenter = -5.0;
+    constexpr double FreePacketWavenumber = 5.0;
+    constexpr double FreePacketWidth = 1.0;
+
+    // Harmonic oscillator eigenstate and coherent state, both over a whole period
+    constexpr double OscillatorFrequency = 2.0;
+    constexpr int OscillatorEigenstate = 1;
+    constexpr double CoherentStateCenter = 2.0;
+
+    // Infinite well eigenstate over a whole period (the well being the grid itself, whose ends are kept at zero)
+    constexpr double WellWidth = 1.0;
+    constexpr int WellEigenstate = 2;
+
+    struct AccuracyOptions {
+        std::vector<double> space_steps;
+        std::vector<double> time_steps;
+        std::string case_filter;
+        std::string output_path;
+    };
+
+    struct AccuracyCase {
+        const char *name;
+        double x_0;
+        double x_f;
+        double t_f;
+        // Fills the sources (and anything else that depends on dx), starting from demo sources
+        std::function<bool(const double dx, nlohmann::json &settings, std::string &out_error)> configure;
+        std::function<Num(const double x, const double t)> exact_psi;
+    };
+
+    struct AccuracyResult {
+        long n;
+        long step_count;
+        double time_ms;
+        double l2_error;
+        double norm_drift;
+        double energy_drift;
+        bool pareto;
+    };
+
+    inline bool ConfigureSources(nlohmann::json &settings, std::string psi0_src, std::string v_src, const std::vector<std::pair<const char*, double>> &psi0_globals, const std::vector<std::pair<const char*, double>> &v_globals, std::string &out_error) {
+        for(const auto &[name, val]: psi0_globals) {
+            if(!OverrideSourceGlobal(psi0_src, name, val, out_error)) {
+                return false;
+            }
+        }
+        for(const auto &[name, val]: v_globals) {
+            if(!OverrideSourceGlobal(v_src, name, val, out_error)) {
+                return false;
+            }
+        }
+        settings["psi0_src"] = psi0_src;
+        settings["v_src"] = v_src;
+        return true;
+    }
+
+    inline double OscillatorEnergy(const int n) {
+        return AccuracyHslash * OscillatorFrequency * (n + 0.5);
+    }
+
+    inline double WellEnergy(const int n) {
+        return pow(n * M_PI * AccuracyHslash / WellWidth, 2) / (2 * AccuracyMass);
+    }
+
+    const AccuracyCase AccuracyCases[] = {
+        // The packet spreads as a(t) = a * |1 + 2iħt/(ma²)| while moving at ħk/m
+        { "free_gaussian", -20.0, 20.0, 1.0, [](const double dx, nlohmann::json &settings, std::string &out_error) {
+            (void)dx;
+            return ConfigureSources(settings, def_psi0::GaussianPacketPsi0, def_v::NoneV, { { "k", FreePacketWavenumber }, { "xc", FreePacketCenter }, { "s", FreePacketWidth } }, {}, out_error);
+        }, [](const double x, const double t) {
+            const auto a2 = pow(FreePacketWidth, 2);
+            const auto spread = 1.0 + I * (2 * AccuracyHslash * t / (AccuracyMass * a2));
+            const auto rel_x = x - FreePacketCenter;
+            const auto exponent = (-pow(rel_x, 2) / a2 + I * FreePacketWavenumber * rel_x - I * (AccuracyHslash * pow(FreePacketWavenumber, 2) * t / (2 * AccuracyMass))) / spread;
+            return pow(2.0 / (M_PI * a2), 0.25) / std::sqrt(spread) * std::exp(exponent);
+        } },
+        // Stationary: only the phase e^(-iEt/ħ) changes
+        { "oscillator_eigenstate", -8.0, 8.0, 2 * M_PI / OscillatorFrequency, [](const double dx, nlohmann::json &settings, std::string &out_error) {
+            (void)dx;
+            return ConfigureSources(settings, def_psi0::HarmonicOscillatorPsi0, def_v::HarmonicOscillatorV, { { "omega", OscillatorFrequency }, { "n", OscillatorEigenstate } }, { { "omega", OscillatorFrequency } }, out_error);
+        }, [](const double x, const double t) {
+            const auto scale = sqrt(AccuracyMass * OscillatorFrequency / AccuracyHslash);
+            return sqrt(scale) * special::HermiteFunction(OscillatorEigenstate, scale * x) * std::exp(-I * (OscillatorEnergy(OscillatorEigenstate) * t / AccuracyHslash));
+        } },
+        // The displaced ground state keeps its shape while its center follows the classical orbit
+        { "oscillator_coherent", -8.0, 8.0, 2 * M_PI / OscillatorFrequency, [](const double dx, nlohmann::json &settings, std::string &out_error) {
+            (void)dx;
+            const auto width = sqrt(2 * AccuracyHslash / (AccuracyMass * OscillatorFrequency));
+            return ConfigureSources(settings, def_psi0::GaussianPacketPsi0, def_v::HarmonicOscillatorV, { { "k", 0.0 }, { "xc", CoherentStateCenter }, { "s", width } }, { { "omega", OscillatorFrequency } }, out_error);
+        }, [](const double x, const double t) {
+            const auto mw = AccuracyMass * OscillatorFrequency;
+            const auto x_c = CoherentStateCenter * cos(OscillatorFrequency * t);
+            const auto p_c = -mw * CoherentStateCenter * sin(OscillatorFrequency * t);
+            const auto exponent = -(mw / (2 * AccuracyHslash)) * pow(x - x_c, 2) + I * ((p_c * x - 0.5 * x_c * p_c) / AccuracyHslash) - I * (0.5 * OscillatorFrequency * t);
+            return pow(mw / (M_PI * AccuracyHslash), 0.25) * std::exp(exponent);
+        } },
+        { "well_eigenstate", 0.0, WellWidth, 2 * M_PI * AccuracyHslash / WellEnergy(WellEigenstate), [](const double dx, nlohmann::json &settings, std::string &out_error) {
+            // The last grid point must be the well's end
+            const auto interval_count = std::max(2.0, std::round(WellWidth / dx));
+            settings["dx"] = WellWidth / interval_count;
+            settings["x_f"] = WellWidth + 0.5 * WellWidth / interval_count;
+            return ConfigureSources(settings, def_psi0::InfiniteWellPsi0, def_v::NoneV, { { "n", WellEigenstate }, { "u", WellWidth } }, {}, out_error);
+        }, [](const double x, const double t) {
+            if((x <= 0) || (x >= WellWidth)) {
+                return Num(0.0);
+            }
+            return sqrt(2 / WellWidth) * sin(WellEigenstate * M_PI * x / WellWidth) * std::exp(-I * (WellEnergy(WellEigenstate) * t / AccuracyHslash));
+        } }
+    };
+
+    bool ParseDoubleList(const std::string &list, std::vector<double> &out_vals) {
+        size_t start = 0;
+        while(true) {
+            const auto end = list.find(',', start);
+            double val;
+            if(!ParseDouble(list.substr(start, end - start).c_str(), val) || (val <= 0)) {
+                return false;
+            }
+            out_vals.push_back(val);
+            if(end == std::string::npos) {
+                return true;
+            }
+            start = end + 1;
+        }
+    }
+
+    bool ParseAccuracyOptions(const int argc, char **argv, AccuracyOptions &out_opts, std::string &out_error) {
+        out_opts = {};
+
+        for(int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if(i + 1 >= argc) {
+                out_error = "missing value for '" + arg + "'";
+                return false;
+            }
+            const char *val = argv[++i];
+
+            if((arg == "--dx") || (arg == "--dt")) {
+                auto &vals = (arg == "--dx") ? out_opts.space_steps : out_opts.time_steps;
+                if(!ParseDoubleList(val, vals)) {
+                    out_error = "invalid value for '" + arg + "' (expected positive values separated by commas): " + val;
+                    return false;
+                }
+            }
+            else if(arg == "--case") {
+                out_opts.case_filter = val;
+            }
+            else if(arg == "--output") {
+                out_opts.output_path = val;
+            }
+            else {
+                out_error = "unknown option '" + arg + "'";
+                return false;
+            }
+        }
+
+        if(out_opts.space_steps.empty()) {
+            out_opts.space_steps.assign(std::begin(DefaultSpaceSteps), std::end(DefaultSpaceSteps));
+        }
+        if(out_opts.time_steps.empty()) {
+            out_opts.time_steps.assign(std::begin(DefaultTimeSteps), std::end(DefaultTimeSteps));
+        }
+        return true;
+    }
+
+    bool RunAccuracyCase(const AccuracyCase &acc_case, const double dx, const double dt, AccuracyResult &out_result, std::string &out_error) {
+        out_result = {};
+
+        nlohmann::json settings = {
+            { "t_0", 0.0 },
+            { "x_0", acc_case.x_0 },
+            { "x_f", acc_case.x_f },
+            { "dt", dt },
+            { "dx", dx },
+            { "hslash", AccuracyHslash },
+            { "m", AccuracyMass }
+        };
+        if(!acc_case.configure(dx, settings, out_error)) {
+            return false;
+        }
+
+        QuantumSimulator sim(DefaultHslash, DefaultMass, DefaultTimeStart, DefaultTimeStep, DefaultSpaceStart, DefaultSpaceEnd, DefaultSpaceStep);
+        sim.UpdateHistoryEnabled(false);
+        if(!ApplySettings(sim, settings, out_error) || !EvaluateSources(sim, true, out_error)) {
+            return false;
+        }
+
+        // The first iteration is t_0 itself
+        out_result.step_count = std::max(1L, std::lround(acc_case.t_f / dt));
+        const auto start_time = GetCurrentTimeMs();
+        double norm_0 = 0.0;
+        double energy_0 = 0.0;
+        for(long i = 0; i <= out_result.step_count; i++) {
+            if(!sim.ComputeNextIteration()) {
+                out_error = GetIterationError(sim);
+                return false;
+            }
+            if(i == 0) {
+                norm_0 = sim.GetCurrentPsiNorm();
+                energy_0 = sim.GetCurrentEnergyEstimateValue();
+            }
+        }
+        out_result.time_ms = GetCurrentTimeMs() - start_time;
+
+        const auto t = sim.DiscreteT(sim.GetIteration() - 1);
+        const auto &x_vec = sim.GetXDiscreteVector();
+        const auto &psi_vec = sim.GetCurrentPsiDiscreteVector();
+        double err_sum = 0.0;
+        for(long i = 0; i < x_vec.size(); i++) {
+            err_sum += NormSquared(psi_vec(i) - acc_case.exact_psi(x_vec(i), t));
+        }
+        out_result.n = sim.GetDimensions();
+        out_result.l2_error = sqrt(err_sum * sim.GetSpaceStep());
+        out_result.norm_drift = sim.GetCurrentPsiNorm() - norm_0;
+        out_result.energy_drift = (sim.GetCurrentEnergyEstimateValue() - energy_0) / std::abs(energy_0);
+        return true;
+    }
+
+}
+
+void PrintAccuracyUsage() {
+    fprintf(stderr, "Accuracy options:\n");
+    fprintf(stderr, "  --dx <v1>,<v2>...            Space steps (default: 0.05,0.02,0.01)\n");
+    fprintf(stderr, "  --dt <v1>,<v2>...            Time steps (default: 0.01,0.005,0.001)\n");
+    fprintf(stderr, "  --case <text>                Only run the cases whose name contains the text\n");
+    fprintf(stderr, "                               (free_gaussian, oscillator_eigenstate, oscillator_coherent, well_eigenstate)\n");
+    fprintf(stderr, "  --output <path>              Write the CSV results there instead of stdout\n");
+}
+
+int RunAccuracy(const int argc, char **argv) {
+    AccuracyOptions opts;
+    std::string error;
+    if(!ParseAccuracyOptions(argc, argv, opts, error)) {
+        fprintf(stderr, "Error: %s\n\n", error.c_str());
+        PrintAccuracyUsage();
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if(!opts.output_path.empty()) {
+        out = fopen(opts.output_path.c_str(), "w");
+        if(out == nullptr) {
+            fprintf(stderr, "Error: unable to open '%s'\n", opts.output_path.c_str());
+            return 1;
+        }
+    }
+    fprintf(out, "case,dx,dt,points,steps,time_ms,ms_per_step,l2_error,norm_drift,rel_energy_drift,pareto\n");
+
+    // Runs are timed one at a time, since concurrent runs would compete for memory bandwidth
+    for(const auto &acc_case: AccuracyCases) {
+        if(std::string(acc_case.name).find(opts.case_filter) == std::string::npos) {
+            continue;
+        }
+
+        std::vector<AccuracyResult> results;
+        std::vector<std::pair<double, double>> steps;
+        for(const auto dx: opts.space_steps) {
+            for(const auto dt: opts.time_steps) {
+                AccuracyResult result;
+                if(!RunAccuracyCase(acc_case, dx, dt, result, error)) {
+                    fprintf(stderr, "Error: %s (dx=%g, dt=%g) failed: %s\n", acc_case.name, dx, dt, error.c_str());
+                    if(out != stdout) {
+                        fclose(out);
+                    }
+                    return 1;
+                }
+                fprintf(stderr, "%-22s dx=%-8g dt=%-8g %9.1f ms  L2 error %.3e\n", acc_case.name, dx, dt, result.time_ms, result.l2_error);
+                results.push_back(result);
+                steps.push_back({ dx, dt });
+            }
+        }
+
+        for(auto &result: results) {
+            result.pareto = true;
+            for(const auto &other_result: results) {
+                const auto dominated = (other_result.time_ms <= result.time_ms) && (other_result.l2_error <= result.l2_error) && ((other_result.time_ms < result.time_ms) || (other_result.l2_error < result.l2_error));
+                if(dominated) {
+                    result.pareto = false;
+                    break;
+                }
+            }
+        }
+        for(size_t i = 0; i < results.size(); i++) {
+            const auto &result = results[i];
+            fprintf(out, "%s,%.9g,%.9g,%ld,%ld,%.3f,%.6f,%.9g,%.9g,%.9g,%d\n", acc_case.name, steps[i].first, steps[i].second, result.n, result.step_count, result.time_ms, result.time_ms / result.step_count, result.l2_error, result.norm_drift, result.energy_drift, result.pareto ? 1 : 0);
+        }
+        fflush(out);
+    }
+
+    if(out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,299 @@
+#include "cli.hpp"
+#include "special.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+
+// Microbenchmarks of the simulation hot paths across grid sizes, meant to catch regressions and compare propagation engines
+// Each case reports the time per grid point, heap allocations per call and the memory bandwidth achieved, estimated from the traffic each case needs at least
+
+namespace {
+
+    // Only counted in the calling thread, which is the one running every case
+    thread_local long g_AllocationCount = 0;
+
+}
+
+// Heap allocations are counted by wrapping glibc's allocator (Eigen and operator new both end up there), elsewhere they are not available
+// Since that wraps every allocation of the whole binary, it is only done in the dedicated build ("make bench" builds it with QUANTIZE_BENCH_ALLOCATIONS=1)
+#ifndef QUANTIZE_BENCH_ALLOCATIONS
+#define QUANTIZE_BENCH_ALLOCATIONS 0
+#endif
+
+#if QUANTIZE_BENCH_ALLOCATIONS && defined(__GLIBC__)
+#define _BENCH_COUNT_ALLOCATIONS 1
+
+extern "C" {
+
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+
+    void *malloc(size_t size) noexcept {
+        g_AllocationCount++;
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size) noexcept {
+        g_AllocationCount++;
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size) noexcept {
+        g_AllocationCount++;
+        return __libc_realloc(ptr, size);
+    }
+
+}
+#else
+#define _BENCH_COUNT_ALLOCATIONS 0
+#endif
+
+// Access to the internal steps of an iteration (see q_sim.hpp)
+struct SimulationBenchmarkAccess {
+    static void RefactorizePropagator(QuantumSimulator &sim) {
+        sim.cn_factor_rows = 0;
+        sim.UpdatePropagatorFactorization();
+    }
+
+    static void UpdateVariableRecords(QuantumSimulator &sim) {
+        sim.UpdateVariableRecords();
+    }
+};
+
+namespace {
+
+    constexpr double DefaultMinCaseTime = 200.0;
+    constexpr long MinRepetitionCount = 3;
+    constexpr long DefaultGridSizes[] = { 100, 1000, 10000, 100000, 1000000 };
+    constexpr int HermiteOrder = 16;
+
+    constexpr double BenchSpaceStart = -10.0;
+    constexpr double BenchSpaceEnd = 10.0;
+    constexpr double BenchTimeStep = 1.0e-4;
+    constexpr const char *BenchPsi0Source = "function psi0(x) {\n    return gauss(x, 0, 2, 1);\n}";
+    constexpr const char *BenchVSource = "function V(x, t) {\n    return 0.5 * x * x;\n}";
+
+    struct BenchOptions {
+        std::vector<long> sizes;
+        double min_time;
+        std::string filter;
+        std::string output_path;
+    };
+
+    // Everything a case might need for a given grid size, already past the first iterations
+    struct BenchState {
+        QuantumSimulator sim;
+        CVector psi_vec;
+        CVector out_cvec;
+        Vector out_vec;
+
+        BenchState() : sim(DefaultHslash, DefaultMass, DefaultTimeStart, BenchTimeStep, BenchSpaceStart, BenchSpaceEnd, DefaultSpaceStep) {}
+    };
+
+    struct BenchCase {
+        const char *name;
+        // Least memory traffic per grid point (bytes) each call needs, for the bandwidth estimate
+        double bytes_per_point;
+        std::function<void(BenchState&)> fn;
+    };
+
+    // Eigen results are kept around so that the compiler cannot drop the calls
+    const BenchCase BenchCases[] = {
+        // Reads V, writes both factor vectors
+        { "propagator_factorization", 8 + 2 * 16, [](BenchState &state) {
+            SimulationBenchmarkAccess::RefactorizePropagator(state.sim);
+        } },
+        // Propagation (forward substitution, then back substitution fused with the Ψ update), |Ψ|² and the records below
+        { "compute_next_iteration", 48 + 80 + 24 + 96, [](BenchState &state) {
+            state.sim.ComputeNextIteration();
+        } },
+        // Autocorrelation, the |Ψ|² pass (with x) and the Ψ pass (with V, writing the current)
+        { "update_variable_records", 48 + 16 + 32, [](BenchState &state) {
+            SimulationBenchmarkAccess::UpdateVariableRecords(state.sim);
+        } },
+        // Ψ read and |Ψ|² write
+        { "norm_squared_vector", 16 + 8, [](BenchState &state) {
+            NormSquaredVector(state.psi_vec, state.out_vec);
+        } },
+        { "vector_derivative", 16 + 16 + 16, [](BenchState &state) {
+            state.out_cvec = VectorDerivative(state.psi_vec, state.sim.GetSpaceStep());
+        } },
+        { "vector_dderivative", 16 + 16 + 16, [](BenchState &state) {
+            state.out_cvec = VectorDDerivative(state.psi_vec, state.sim.GetSpaceStep());
+        } },
+        // One pass per order, reading x and both previous orders and writing the next one
+        { "hermite_function_grid", HermiteOrder * 32, [](BenchState &state) {
+            special::HermiteFunctionGrid(HermiteOrder, state.sim.GetXDiscreteVector(), state.out_vec);
+        } }
+    };
+
+    bool ParseBenchOptions(const int argc, char **argv, BenchOptions &out_opts, std::string &out_error) {
+        out_opts = {};
+        out_opts.min_time = DefaultMinCaseTime;
+
+        for(int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if(i + 1 >= argc) {
+                out_error = "missing value for '" + arg + "'";
+                return false;
+            }
+            const char *val = argv[++i];
+
+            if(arg == "--sizes") {
+                const std::string sizes = val;
+                size_t start = 0;
+                while(true) {
+                    const auto end = sizes.find(',', start);
+                    long size;
+                    if(!ParseLong(sizes.substr(start, end - start).c_str(), size) || (size < 3)) {
+                        out_error = "invalid grid sizes (at least 3 points each): " + sizes;
+                        return false;
+                    }
+                    out_opts.sizes.push_back(size);
+                    if(end == std::string::npos) {
+                        break;
+                    }
+                    start = end + 1;
+                }
+            }
+            else if(arg == "--min-time") {
+                if(!ParseDouble(val, out_opts.min_time) || (out_opts.min_time < 0)) {
+                    out_error = std::string("invalid value for '--min-time': ") + val;
+                    return false;
+                }
+            }
+            else if(arg == "--filter") {
+                out_opts.filter = val;
+            }
+            else if(arg == "--output") {
+                out_opts.output_path = val;
+            }
+            else {
+                out_error = "unknown option '" + arg + "'";
+                return false;
+            }
+        }
+
+        if(out_opts.sizes.empty()) {
+            out_opts.sizes.assign(std::begin(DefaultGridSizes), std::end(DefaultGridSizes));
+        }
+        return true;
+    }
+
+    bool PrepareBenchState(BenchState &state, const long size, std::string &out_error) {
+        auto &sim = state.sim;
+        sim.UpdateHistoryEnabled(false);
+        sim.UpdateAll(DefaultHslash, DefaultMass, DefaultTimeStart, BenchTimeStep, BenchSpaceStart, BenchSpaceEnd, (BenchSpaceEnd - BenchSpaceStart) / (size - 1));
+        sim.UpdatePsi0Source(BenchPsi0Source);
+        sim.UpdateVSource(BenchVSource);
+        if(!EvaluateSources(sim, true, out_error)) {
+            return false;
+        }
+
+        // Past the first iteration (sampling) and the first propagation (factorization)
+        for(int i = 0; i < 2; i++) {
+            if(!sim.ComputeNextIteration()) {
+                out_error = GetIterationError(sim);
+                return false;
+            }
+        }
+        state.psi_vec = sim.GetCurrentPsiDiscreteVector();
+        return true;
+    }
+
+    nlohmann::json RunBenchCase(const BenchCase &bench_case, BenchState &state, const double min_time) {
+        const auto n = state.sim.GetDimensions();
+
+        // Warm-up call, for caches and lazily grown buffers
+        bench_case.fn(state);
+
+        long rep_count = 0;
+        g_AllocationCount = 0;
+        const auto start_time = GetCurrentTimeMs();
+        double elapsed_time;
+        do {
+            bench_case.fn(state);
+            rep_count++;
+            elapsed_time = GetCurrentTimeMs() - start_time;
+        } while((rep_count < MinRepetitionCount) || (elapsed_time < min_time));
+        const auto alloc_count = g_AllocationCount;
+
+        const auto call_time_ns = elapsed_time * 1.0e6 / rep_count;
+        nlohmann::json result = {
+            { "name", bench_case.name },
+            { "points", n },
+            { "repetitions", rep_count },
+            { "ns_per_call", call_time_ns },
+            { "ns_per_point", call_time_ns / n },
+            { "bandwidth_gb_s", bench_case.bytes_per_point * n / call_time_ns }
+        };
+        #if _BENCH_COUNT_ALLOCATIONS
+        result["allocations_per_call"] = (double)alloc_count / rep_count;
+        #else
+        (void)alloc_count;
+        result["allocations_per_call"] = nullptr;
+        #endif
+
+        fprintf(stderr, "%-26s %9ld points %12.3f ns/point %8.2f allocs/call %8.2f GB/s\n", bench_case.name, n, call_time_ns / n, _BENCH_COUNT_ALLOCATIONS ? ((double)alloc_count / rep_count) : NAN, bench_case.bytes_per_point * n / call_time_ns);
+        return result;
+    }
+
+}
+
+void PrintBenchUsage() {
+    fprintf(stderr, "Benchmark options:\n");
+    fprintf(stderr, "  --sizes <n1>,<n2>...         Grid sizes (default: 100 to 1000000, by powers of 10)\n");
+    fprintf(stderr, "  --min-time <ms>              Least time spent per case and size (default: %g)\n", DefaultMinCaseTime);
+    fprintf(stderr, "  --filter <text>              Only run the cases whose name contains the text\n");
+    fprintf(stderr, "  --output <path>              Write the JSON results there instead of stdout\n");
+}
+
+int RunBench(const int argc, char **argv) {
+    BenchOptions opts;
+    std::string error;
+    if(!ParseBenchOptions(argc, argv, opts, error)) {
+        fprintf(stderr, "Error: %s\n\n", error.c_str());
+        PrintBenchUsage();
+        return 1;
+    }
+
+    nlohmann::json results = nlohmann::json::array();
+    for(const auto size: opts.sizes) {
+        BenchState state;
+        if(!PrepareBenchState(state, size, error)) {
+            fprintf(stderr, "Error: unable to prepare a %ld point grid: %s\n", size, error.c_str());
+            return 1;
+        }
+
+        for(const auto &bench_case: BenchCases) {
+            if(std::string(bench_case.name).find(opts.filter) == std::string::npos) {
+                continue;
+            }
+            results.push_back(RunBenchCase(bench_case, state, opts.min_time));
+        }
+    }
+
+    const nlohmann::json report = {
+        #ifdef __VERSION__
+        { "compiler", __VERSION__ },
+        #endif
+        { "min_time_ms", opts.min_time },
+        { "allocations_counted", (bool)_BENCH_COUNT_ALLOCATIONS },
+        { "results", results }
+    };
+    const auto report_str = report.dump(4);
+    if(opts.output_path.empty()) {
+        printf("%s\n", report_str.c_str());
+    }
+    else {
+        std::ofstream out(opts.output_path);
+        out << report_str << std::endl;
+        if(!out) {
+            fprintf(stderr, "Error: unable to write '%s'\n", opts.output_path.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
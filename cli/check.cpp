@@ -0,0 +1,254 @@
+#include "cli.hpp"
+#include "def_psi0.hpp"
+#include "def_v.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+// Consistency checks of what the golden outputs do not cover (state reused across settings changes, quantities derived by other modes...),
+// each one being an independent small run which reports why it failed
+
+namespace {
+
+    struct Check {
+        const char *name;
+        bool (*fn)(std::string &out_error);
+    };
+
+    bool PrepareSimulator(QuantumSimulator &sim, const char *psi0_src, const char *v_src, std::string &out_error) {
+        sim.UpdateHistoryEnabled(false);
+        sim.UpdatePsi0Source(psi0_src);
+        sim.UpdateVSource(v_src);
+        return EvaluateSources(sim, true, out_error);
+    }
+
+    bool RunIterations(QuantumSimulator &sim, const long count, std::string &out_error) {
+        for(long i = 0; i < count; i++) {
+            if(!sim.ComputeNextIteration()) {
+                out_error = GetIterationError(sim);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // r = iħ²dt/(4dx²m) stays the same when scaling both dt and m, but the propagator does not, thus nothing cached for the previous run must be reused
+    bool CheckTimeStepMassScaling(std::string &out_error) {
+        constexpr long StepCount = 50;
+        constexpr double Scale = 2.0;
+
+        QuantumSimulator sim(DefaultHslash, DefaultMass, DefaultTimeStart, DefaultTimeStep, DefaultSpaceStart, DefaultSpaceEnd, DefaultSpaceStep);
+        if(!PrepareSimulator(sim, def_psi0::GaussianPacketPsi0, def_v::StepV, out_error) || !RunIterations(sim, StepCount, out_error)) {
+            return false;
+        }
+        sim.Reset();
+        sim.UpdateTimeStep(DefaultTimeStep * Scale);
+        sim.UpdateMass(DefaultMass * Scale);
+        if(!EvaluateSources(sim, true, out_error) || !RunIterations(sim, StepCount, out_error)) {
+            return false;
+        }
+
+        QuantumSimulator fresh_sim(DefaultHslash, DefaultMass * Scale, DefaultTimeStart, DefaultTimeStep * Scale, DefaultSpaceStart, DefaultSpaceEnd, DefaultSpaceStep);
+        if(!PrepareSimulator(fresh_sim, def_psi0::GaussianPacketPsi0, def_v::StepV, out_error) || !RunIterations(fresh_sim, StepCount, out_error)) {
+            return false;
+        }
+
+        // Both runs go through the very same computations
+        const auto diff = (sim.GetCurrentPsiDiscreteVector() - fresh_sim.GetCurrentPsiDiscreteVector()).cwiseAbs().maxCoeff();
+        if(diff != 0.0) {
+            char diff_str[128];
+            snprintf(diff_str, sizeof(diff_str), "Ψ differs from a fresh simulator's by up to %.3e", diff);
+            out_error = diff_str;
+            return false;
+        }
+        return true;
+    }
+
+    // Editing V only resamples what changed: moving one barrier while narrowing another one (by less than the gaps between probed samples)
+    // must give the very same potential and propagation as a fresh simulator
+    bool CheckVEditSeparatedFeatures(std::string &out_error) {
+        constexpr long StepCount = 20;
+        constexpr double SpaceStep = 4.0e-4;
+        constexpr const char *BarriersV = "a = 0.0;\nw = 0.1;\nb = 2.0;\nv = 0.1;\nfunction V(x, t) {\n    if(((x > a) && (x < a + w)) || ((x > b) && (x < b + v))) {\n        return 50;\n    }\n    return 0;\n}";
+        constexpr const char *EditedBarriersV = "a = 0.2;\nw = 0.1;\nb = 2.0;\nv = 0.098;\nfunction V(x, t) {\n    if(((x > a) && (x < a + w)) || ((x > b) && (x < b + v))) {\n        return 50;\n    }\n    return 0;\n}";
+
+        QuantumSimulator sim(DefaultHslash, DefaultMass, DefaultTimeStart, DefaultTimeStep, DefaultSpaceStart, DefaultSpaceEnd, SpaceStep);
+        // Per-sample evaluation, as with sources which cannot be compiled
+        sim.UpdateGridEvaluationEnabled(false);
+        if(!PrepareSimulator(sim, def_psi0::GaussianPacketPsi0, BarriersV, out_error) || !RunIterations(sim, StepCount, out_error)) {
+            return false;
+        }
+        sim.Reset();
+        sim.UpdateVSource(EditedBarriersV);
+        if(!EvaluateSources(sim, true, out_error) || !RunIterations(sim, StepCount, out_error)) {
+            return false;
+        }
+
+        QuantumSimulator fresh_sim(DefaultHslash, DefaultMass, DefaultTimeStart, DefaultTimeStep, DefaultSpaceStart, DefaultSpaceEnd, SpaceStep);
+        if(!PrepareSimulator(fresh_sim, def_psi0::GaussianPacketPsi0, EditedBarriersV, out_error) || !RunIterations(fresh_sim, StepCount, out_error)) {
+            return false;
+        }
+
+        const auto v_diff_count = (sim.GetCurrentVDiscreteVector().array() != fresh_sim.GetCurrentVDiscreteVector().array()).count();
+        const auto psi_diff = (sim.GetCurrentPsiDiscreteVector() - fresh_sim.GetCurrentPsiDiscreteVector()).cwiseAbs().maxCoeff();
+        if((v_diff_count > 0) || (psi_diff != 0.0)) {
+            char diff_str[160];
+            snprintf(diff_str, sizeof(diff_str), "%ld V samples differ from a fresh simulator's, Ψ by up to %.3e", (long)v_diff_count, psi_diff);
+            out_error = diff_str;
+            return false;
+        }
+        return true;
+    }
+
+    // Reads a CSV without quoted fields into rows of named values
+    bool LoadCsv(const std::string &path, std::vector<std::map<std::string, std::string>> &out_rows, std::string &out_error) {
+        std::ifstream file(path);
+        if(!file) {
+            out_error = "unable to open '" + path + "'";
+            return false;
+        }
+
+        const auto split = [](const std::string &line) {
+            std::vector<std::string> items;
+            std::stringstream line_stream(line);
+            std::string item;
+            while(std::getline(line_stream, item, ',')) {
+                items.push_back(item);
+            }
+            return items;
+        };
+
+        std::string line;
+        std::getline(file, line);
+        const auto header = split(line);
+        out_rows.clear();
+        while(std::getline(file, line)) {
+            const auto items = split(line);
+            auto &row = out_rows.emplace_back();
+            for(size_t i = 0; i < std::min(header.size(), items.size()); i++) {
+                row[header[i]] = items[i];
+            }
+        }
+        return true;
+    }
+
+    // A packet coming from the left onto a step (whose edge lies between the separators) for a few step heights, run until it left the separators' region:
+    // what was reflected and what was transmitted must add up to the whole packet
+    bool CheckSweepStepReflectionTransmission(std::string &out_error) {
+        constexpr double Tolerance = 1.0e-2;
+
+        QuantumSimulator sim(DefaultHslash, DefaultMass, DefaultTimeStart, DefaultTimeStep, DefaultSpaceStart, DefaultSpaceEnd, DefaultSpaceStep);
+        sim.UpdatePsi0Source(def_psi0::GaussianPacketPsi0);
+        sim.UpdateVSource(def_v::StepV);
+
+        const auto tmp_dir = std::filesystem::temp_directory_path();
+        const auto settings_path = (tmp_dir / "quantize-check-step.json").string();
+        const auto output_path = (tmp_dir / "quantize-check-step.csv").string();
+        {
+            std::ofstream settings_file(settings_path);
+            settings_file << sim.GenerateSettings().dump();
+            if(!settings_file) {
+                out_error = "unable to write '" + settings_path + "'";
+                return false;
+            }
+        }
+
+        const char *sweep_args[] = {
+            "sweep", settings_path.c_str(),
+            "--param", "psi0.k=20",
+            "--param", "V.si=1",
+            "--param", "V.sf=10",
+            "--param", "V.V0=0,200,300,600",
+            "--left-separator", "0.9",
+            "--right-separator", "1.1",
+            "--steps", "80",
+            "--output", output_path.c_str()
+        };
+        const auto sweep_rc = RunSweep(std::size(sweep_args), const_cast<char**>(sweep_args));
+        std::vector<std::map<std::string, std::string>> rows;
+        const auto load_ok = (sweep_rc == 0) && LoadCsv(output_path, rows, out_error);
+        std::filesystem::remove(settings_path);
+        std::filesystem::remove(output_path);
+        if(sweep_rc != 0) {
+            out_error = "the sweep failed";
+            return false;
+        }
+        if(!load_ok) {
+            return false;
+        }
+        if(rows.size() != 4) {
+            out_error = "expected 4 sweep runs, got " + std::to_string(rows.size());
+            return false;
+        }
+
+        for(const auto &row: rows) {
+            double reflection;
+            double transmission;
+            if(!row.count("reflection") || !row.count("transmission") || !ParseDouble(row.at("reflection").c_str(), reflection) || !ParseDouble(row.at("transmission").c_str(), transmission)) {
+                out_error = "invalid sweep output row";
+                return false;
+            }
+            if(std::abs(reflection + transmission - 1.0) > Tolerance) {
+                char diff_str[128];
+                snprintf(diff_str, sizeof(diff_str), "V0=%s: R + T = %.6f (R = %.6f, T = %.6f)", row.at("V.V0").c_str(), reflection + transmission, reflection, transmission);
+                out_error = diff_str;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr Check Checks[] = {
+        { "time_step_mass_scaling", &CheckTimeStepMassScaling },
+        { "v_edit_separated_features", &CheckVEditSeparatedFeatures },
+        { "sweep_step_reflection_transmission", &CheckSweepStepReflectionTransmission }
+    };
+
+}
+
+void PrintCheckUsage() {
+    fprintf(stderr, "Check options:\n");
+    fprintf(stderr, "  --filter <text>              Only run the checks whose name contains the text\n");
+}
+
+int RunCheck(const int argc, char **argv) {
+    std::string filter;
+    for(int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if((arg == "--filter") && (i + 1 < argc)) {
+            filter = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Error: unknown option '%s'\n\n", arg.c_str());
+            PrintCheckUsage();
+            return 1;
+        }
+    }
+
+    size_t check_count = 0;
+    size_t failed_count = 0;
+    for(const auto &check: Checks) {
+        if(std::string(check.name).find(filter) == std::string::npos) {
+            continue;
+        }
+        check_count++;
+
+        std::string error;
+        if(check.fn(error)) {
+            printf("ok   %s\n", check.name);
+        }
+        else {
+            printf("FAIL %s: %s\n", check.name, error.c_str());
+            failed_count++;
+        }
+    }
+
+    if(check_count == 0) {
+        fprintf(stderr, "Error: no check matches '%s'\n", filter.c_str());
+        return 1;
+    }
+    fprintf(stderr, "%zu/%zu checks passed\n", check_count - failed_count, check_count);
+    return (failed_count > 0) ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "q_sim.hpp"
+
+// Helpers shared by the CLI modes (see main.cpp)
+
+bool ParseLong(const char *str, long &out_val);
+bool ParseDouble(const char *str, double &out_val);
+
+bool LoadSettingsFile(const std::string &path, nlohmann::json &out_settings, std::string &out_error);
+// Like UpdateFromSettings, but also reporting mistyped items instead of throwing
+bool ApplySettings(QuantumSimulator &sim, const nlohmann::json &settings, std::string &out_error);
+// Evaluates the sources the simulator will sample from (psi0 is not needed when resuming, since Ψ is restored)
+bool EvaluateSources(QuantumSimulator &sim, const bool need_psi0, std::string &out_error);
+// Replaces the value of the global's top-level assignment (an unindented "[var|let|const] <name> = ...;" line, like in every demo source)
+bool OverrideSourceGlobal(std::string &src, const std::string &name, const double val, std::string &out_error);
+// Why ComputeNextIteration failed, which can only be due to one of the sources
+std::string GetIterationError(QuantumSimulator &sim);
+
+// Sweep mode (see sweep.cpp), with argv[0] being the mode name
+void PrintSweepUsage();
+int RunSweep(const int argc, char **argv);
+
+// Benchmark mode (see bench.cpp)
+void PrintBenchUsage();
+int RunBench(const int argc, char **argv);
+
+// Accuracy mode (see accuracy.cpp)
+void PrintAccuracyUsage();
+int RunAccuracy(const int argc, char **argv);
+
+// Golden-output regression mode (see golden.cpp)
+void PrintGoldenUsage();
+int RunGolden(const int argc, char **argv);
+
+// Consistency checks mode (see check.cpp)
+void PrintCheckUsage();
+int RunCheck(const int argc, char **argv);
@@ -0,0 +1,78 @@
+#include "cli.hpp"
+#include <fstream>
+#include <regex>
+
+bool ParseLong(const char *str, long &out_val) {
+    char *end;
+    out_val = strtol(str, &end, 10);
+    return (*str != '\0') && (*end == '\0') && (out_val >= 0);
+}
+
+bool ParseDouble(const char *str, double &out_val) {
+    char *end;
+    out_val = strtod(str, &end);
+    return (*str != '\0') && (*end == '\0');
+}
+
+bool LoadSettingsFile(const std::string &path, nlohmann::json &out_settings, std::string &out_error) {
+    std::ifstream file(path);
+    if(!file) {
+        out_error = "unable to open '" + path + "'";
+        return false;
+    }
+
+    try {
+        out_settings = nlohmann::json::parse(file);
+    }
+    catch(std::exception &e) {
+        out_error = std::string("invalid JSON: ") + e.what();
+        return false;
+    }
+    if(!out_settings.is_object()) {
+        out_error = "settings must be a JSON object";
+        return false;
+    }
+    return true;
+}
+
+bool ApplySettings(QuantumSimulator &sim, const nlohmann::json &settings, std::string &out_error) {
+    try {
+        return sim.UpdateFromSettings(settings, out_error);
+    }
+    catch(std::exception &e) {
+        out_error = std::string("invalid settings: ") + e.what();
+        return false;
+    }
+}
+
+bool EvaluateSources(QuantumSimulator &sim, const bool need_psi0, std::string &out_error) {
+    // Same as the web UI: sources are not needed while sampling from tables
+    if(need_psi0 && !sim.HasPsi0Table() && !sim.EvaluatePsi0Source()) {
+        out_error = "psi0 source error: " + sim.GetPsi0SourceError();
+        return false;
+    }
+    if(!sim.HasVTable() && !sim.EvaluateVSource()) {
+        out_error = "V source error: " + sim.GetVSourceError();
+        return false;
+    }
+    return true;
+}
+
+std::string GetIterationError(QuantumSimulator &sim) {
+    const auto psi0_failed = !sim.IsPsi0SourceOk();
+    return std::string(psi0_failed ? "psi0" : "V") + " source failed at iteration " + std::to_string(sim.GetIteration()) + ": " + (psi0_failed ? sim.GetPsi0SourceError() : sim.GetVSourceError());
+}
+
+bool OverrideSourceGlobal(std::string &src, const std::string &name, const double val, std::string &out_error) {
+    const std::regex assign_regex("(^|\\n)((?:(?:var|let|const)[ \\t]+)?" + name + "[ \\t]*=)(?!=)[^;\\n]*;");
+    std::smatch match;
+    if(!std::regex_search(src, match, assign_regex)) {
+        out_error = "no top-level assignment of '" + name + "' in the source";
+        return false;
+    }
+
+    char val_str[32];
+    snprintf(val_str, sizeof(val_str), "%.17g", val);
+    src = match.prefix().str() + match[1].str() + match[2].str() + " " + val_str + ";" + match.suffix().str();
+    return true;
+}
@@ -0,0 +1,385 @@
+#include "cli.hpp"
+#include "def_psi0.hpp"
+#include "def_v.hpp"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+// Golden-output regression checks: every Ψ0 × V demo combination is run for a fixed amount of iterations with the default settings,
+// and every record (sampled at a fixed stride) and the final Ψ are compared against stored golden files within tolerances
+// Both source evaluation engines (whole-grid and single-sample) can also be compared against each other, without golden files
+
+namespace {
+
+    constexpr long DefaultGoldenStepCount = 200;
+    constexpr long GoldenRecordStride = 10;
+    constexpr int GoldenFormatVersion = 1;
+    constexpr double DefaultRelativeTolerance = 1.0e-8;
+    constexpr double DefaultAbsoluteTolerance = 1.0e-10;
+
+    enum class GoldenEngine {
+        Grid,
+        Sample
+    };
+
+    constexpr const char *GoldenEngineNames[] = { "grid", "sample" };
+
+    struct GoldenOptions {
+        std::string dir;
+        bool update;
+        GoldenEngine engine;
+        bool compare_engines;
+        GoldenEngine compare_engine;
+        long step_count;
+        std::string filter;
+        double rel_tolerance;
+        double abs_tolerance;
+    };
+
+    struct GoldenOutput {
+        long step_count;
+        long dimensions;
+        // Per record column, at every GoldenRecordStride iterations (and the last one)
+        std::vector<std::vector<double>> records;
+        std::vector<double> psi_re;
+        std::vector<double> psi_im;
+    };
+
+    bool ParseGoldenEngine(const std::string &name, GoldenEngine &out_engine) {
+        for(size_t i = 0; i < std::size(GoldenEngineNames); i++) {
+            if(name == GoldenEngineNames[i]) {
+                out_engine = static_cast<GoldenEngine>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline const char *GetGoldenEngineName(const GoldenEngine engine) {
+        return GoldenEngineNames[static_cast<size_t>(engine)];
+    }
+
+    // "Dirac delta (position eigenstate)" -> "dirac_delta_position_eigenstate"
+    std::string MakeSlug(const char *name) {
+        std::string slug;
+        for(const char *c = name; *c != '\0'; c++) {
+            if(isalnum(static_cast<unsigned char>(*c))) {
+                slug += static_cast<char>(tolower(static_cast<unsigned char>(*c)));
+            }
+            else if(!slug.empty() && (slug.back() != '_')) {
+                slug += '_';
+            }
+        }
+        while(!slug.empty() && (slug.back() == '_')) {
+            slug.pop_back();
+        }
+        return slug;
+    }
+
+    inline std::string GetCaseName(const size_t psi0_idx, const size_t v_idx) {
+        return MakeSlug(Psi0DemoSourceNames[psi0_idx]) + "__" + MakeSlug(VDemoSourceNames[v_idx]);
+    }
+
+    bool ParseGoldenOptions(const int argc, char **argv, GoldenOptions &out_opts, std::string &out_error) {
+        out_opts = {};
+        out_opts.step_count = DefaultGoldenStepCount;
+        out_opts.rel_tolerance = DefaultRelativeTolerance;
+        out_opts.abs_tolerance = DefaultAbsoluteTolerance;
+
+        for(int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if(arg == "--update") {
+                out_opts.update = true;
+                continue;
+            }
+
+            if(i + 1 >= argc) {
+                out_error = "missing value for '" + arg + "'";
+                return false;
+            }
+            const char *val = argv[++i];
+
+            if(arg == "--dir") {
+                out_opts.dir = val;
+            }
+            else if((arg == "--engine") || (arg == "--compare")) {
+                auto &engine = (arg == "--engine") ? out_opts.engine : out_opts.compare_engine;
+                if(!ParseGoldenEngine(val, engine)) {
+                    out_error = "invalid value for '" + arg + "' (expected grid or sample): " + val;
+                    return false;
+                }
+                if(arg == "--compare") {
+                    out_opts.compare_engines = true;
+                }
+            }
+            else if(arg == "--steps") {
+                if(!ParseLong(val, out_opts.step_count) || (out_opts.step_count < 1)) {
+                    out_error = std::string("invalid value for '--steps': ") + val;
+                    return false;
+                }
+            }
+            else if(arg == "--filter") {
+                out_opts.filter = val;
+            }
+            else if((arg == "--rtol") || (arg == "--atol")) {
+                auto &tolerance = (arg == "--rtol") ? out_opts.rel_tolerance : out_opts.abs_tolerance;
+                if(!ParseDouble(val, tolerance) || (tolerance < 0)) {
+                    out_error = "invalid value for '" + arg + "': " + val;
+                    return false;
+                }
+            }
+            else {
+                out_error = "unknown option '" + arg + "'";
+                return false;
+            }
+        }
+
+        if(out_opts.compare_engines) {
+            if(out_opts.update) {
+                out_error = "--update cannot be combined with --compare";
+                return false;
+            }
+        }
+        else if(out_opts.dir.empty()) {
+            out_error = "the golden files directory (--dir) is needed unless comparing engines";
+            return false;
+        }
+        return true;
+    }
+
+    bool RunGoldenCase(const size_t psi0_idx, const size_t v_idx, const GoldenEngine engine, const long step_count, GoldenOutput &out_output, std::string &out_error) {
+        QuantumSimulator sim(DefaultHslash, DefaultMass, DefaultTimeStart, DefaultTimeStep, DefaultSpaceStart, DefaultSpaceEnd, DefaultSpaceStep);
+        sim.UpdateHistoryEnabled(false);
+        sim.UpdateGridEvaluationEnabled(engine == GoldenEngine::Grid);
+        sim.UpdatePsi0Source(Psi0DemoSources[psi0_idx]);
+        sim.UpdateVSource(VDemoSources[v_idx]);
+        if(!EvaluateSources(sim, true, out_error)) {
+            return false;
+        }
+
+        out_output = {};
+        out_output.step_count = step_count;
+        out_output.records.resize(RecordColumnCount);
+        const auto columns = sim.GetAllRecordColumns();
+        for(long i = 0; i < step_count; i++) {
+            if(!sim.ComputeNextIteration()) {
+                out_error = GetIterationError(sim);
+                return false;
+            }
+            if(((i % GoldenRecordStride) == 0) || (i == (step_count - 1))) {
+                for(size_t j = 0; j < RecordColumnCount; j++) {
+                    out_output.records[j].push_back(columns[j]->Back());
+                }
+            }
+        }
+
+        const auto &psi_vec = sim.GetCurrentPsiDiscreteVector();
+        out_output.dimensions = sim.GetDimensions();
+        for(long i = 0; i < psi_vec.size(); i++) {
+            out_output.psi_re.push_back(psi_vec(i).real());
+            out_output.psi_im.push_back(psi_vec(i).imag());
+        }
+        return true;
+    }
+
+    nlohmann::json GoldenOutputToJson(const size_t psi0_idx, const size_t v_idx, const GoldenOutput &output) {
+        nlohmann::json records = nlohmann::json::object();
+        for(size_t j = 0; j < RecordColumnCount; j++) {
+            records[RecordColumnNames[j]] = output.records[j];
+        }
+        return {
+            { "format_version", GoldenFormatVersion },
+            { "psi0", Psi0DemoSourceNames[psi0_idx] },
+            { "v", VDemoSourceNames[v_idx] },
+            { "steps", output.step_count },
+            { "record_stride", GoldenRecordStride },
+            { "dimensions", output.dimensions },
+            { "records", records },
+            { "psi_re", output.psi_re },
+            { "psi_im", output.psi_im }
+        };
+    }
+
+    bool LoadGoldenOutput(const std::string &path, GoldenOutput &out_output, std::string &out_error) {
+        nlohmann::json golden;
+        if(!LoadSettingsFile(path, golden, out_error)) {
+            return false;
+        }
+
+        try {
+            if(golden.at("format_version").get<int>() != GoldenFormatVersion) {
+                out_error = "unsupported golden file version";
+                return false;
+            }
+            if(golden.at("record_stride").get<long>() != GoldenRecordStride) {
+                out_error = "golden file recorded with another record stride";
+                return false;
+            }
+            out_output = {};
+            out_output.step_count = golden.at("steps").get<long>();
+            out_output.dimensions = golden.at("dimensions").get<long>();
+            const auto &records = golden.at("records");
+            for(size_t j = 0; j < RecordColumnCount; j++) {
+                out_output.records.push_back(records.at(RecordColumnNames[j]).get<std::vector<double>>());
+            }
+            out_output.psi_re = golden.at("psi_re").get<std::vector<double>>();
+            out_output.psi_im = golden.at("psi_im").get<std::vector<double>>();
+        }
+        catch(std::exception &e) {
+            out_error = std::string("invalid golden file: ") + e.what();
+            return false;
+        }
+        return true;
+    }
+
+    // Reports every quantity out of tolerance, with the iteration (or Ψ index) of its largest difference
+    size_t CompareGoldenOutputs(const GoldenOutput &output, const GoldenOutput &expected, const double rel_tolerance, const double abs_tolerance, std::vector<std::string> &out_diffs) {
+        const auto compare = [&](const char *name, const std::vector<double> &vals, const std::vector<double> &expected_vals, const bool is_record) {
+            if(vals.size() != expected_vals.size()) {
+                out_diffs.push_back(std::string(name) + ": " + std::to_string(vals.size()) + " values, expected " + std::to_string(expected_vals.size()));
+                return;
+            }
+
+            size_t worst_idx = 0;
+            double worst_excess = 0.0;
+            double worst_diff = 0.0;
+            for(size_t i = 0; i < vals.size(); i++) {
+                // NaN is expected to stay NaN (like undefined uncertainties)
+                if(std::isnan(vals[i]) && std::isnan(expected_vals[i])) {
+                    continue;
+                }
+                const auto diff = std::abs(vals[i] - expected_vals[i]);
+                const auto excess = std::isnan(diff) ? INFINITY : (diff - (abs_tolerance + rel_tolerance * std::abs(expected_vals[i])));
+                if(excess > worst_excess) {
+                    worst_idx = i;
+                    worst_excess = excess;
+                    worst_diff = diff;
+                }
+            }
+            if(worst_excess > 0.0) {
+                char diff_str[256];
+                if(is_record) {
+                    const auto ti = std::min(static_cast<long>(worst_idx) * GoldenRecordStride, expected.step_count - 1);
+                    snprintf(diff_str, sizeof(diff_str), "%s: %.17g at ti=%ld, expected %.17g (difference %.3e)", name, vals[worst_idx], ti, expected_vals[worst_idx], worst_diff);
+                }
+                else {
+                    snprintf(diff_str, sizeof(diff_str), "%s: %.17g at xi=%zu, expected %.17g (difference %.3e)", name, vals[worst_idx], worst_idx, expected_vals[worst_idx], worst_diff);
+                }
+                out_diffs.push_back(diff_str);
+            }
+        };
+
+        if(output.dimensions != expected.dimensions) {
+            out_diffs.push_back("dimensions: " + std::to_string(output.dimensions) + ", expected " + std::to_string(expected.dimensions));
+            return out_diffs.size();
+        }
+        for(size_t j = 0; j < RecordColumnCount; j++) {
+            compare(RecordColumnNames[j], output.records[j], expected.records[j], true);
+        }
+        compare("psi_re", output.psi_re, expected.psi_re, false);
+        compare("psi_im", output.psi_im, expected.psi_im, false);
+        return out_diffs.size();
+    }
+
+}
+
+void PrintGoldenUsage() {
+    fprintf(stderr, "Golden options:\n");
+    fprintf(stderr, "  --dir <path>                 Golden files directory, checked against unless comparing engines\n");
+    fprintf(stderr, "  --update                     Write the golden files instead of checking them\n");
+    fprintf(stderr, "  --engine <grid|sample>       Source evaluation engine (default: grid)\n");
+    fprintf(stderr, "  --compare <grid|sample>      Compare against runs with this other engine instead of golden files\n");
+    fprintf(stderr, "  --steps <n>                  Iterations per combination, when updating or comparing (default: %ld)\n", DefaultGoldenStepCount);
+    fprintf(stderr, "  --filter <text>              Only run the combinations whose name contains the text (<psi0>__<V>)\n");
+    fprintf(stderr, "  --rtol <v>                   Relative tolerance (default: %g)\n", DefaultRelativeTolerance);
+    fprintf(stderr, "  --atol <v>                   Absolute tolerance (default: %g)\n", DefaultAbsoluteTolerance);
+}
+
+int RunGolden(const int argc, char **argv) {
+    GoldenOptions opts;
+    std::string error;
+    if(!ParseGoldenOptions(argc, argv, opts, error)) {
+        fprintf(stderr, "Error: %s\n\n", error.c_str());
+        PrintGoldenUsage();
+        return 1;
+    }
+
+    if(opts.update) {
+        std::error_code ec;
+        std::filesystem::create_directories(opts.dir, ec);
+        if(ec) {
+            fprintf(stderr, "Error: unable to create '%s': %s\n", opts.dir.c_str(), ec.message().c_str());
+            return 1;
+        }
+    }
+
+    const auto start_time = GetCurrentTimeMs();
+    size_t case_count = 0;
+    size_t failed_count = 0;
+    for(size_t psi0_idx = 0; psi0_idx < Psi0DemoSourceCount; psi0_idx++) {
+        for(size_t v_idx = 0; v_idx < VDemoSourceCount; v_idx++) {
+            const auto case_name = GetCaseName(psi0_idx, v_idx);
+            if(case_name.find(opts.filter) == std::string::npos) {
+                continue;
+            }
+            case_count++;
+            const auto golden_path = (std::filesystem::path(opts.dir) / (case_name + ".json")).string();
+
+            // Golden runs take as many iterations as were recorded
+            GoldenOutput expected;
+            auto step_count = opts.step_count;
+            if(!opts.update && !opts.compare_engines) {
+                if(!LoadGoldenOutput(golden_path, expected, error)) {
+                    printf("FAIL %s: unable to load '%s': %s\n", case_name.c_str(), golden_path.c_str(), error.c_str());
+                    failed_count++;
+                    continue;
+                }
+                step_count = expected.step_count;
+            }
+
+            GoldenOutput output;
+            if(!RunGoldenCase(psi0_idx, v_idx, opts.engine, step_count, output, error)) {
+                printf("FAIL %s: %s run failed: %s\n", case_name.c_str(), GetGoldenEngineName(opts.engine), error.c_str());
+                failed_count++;
+                continue;
+            }
+
+            if(opts.update) {
+                std::ofstream out(golden_path);
+                out << GoldenOutputToJson(psi0_idx, v_idx, output).dump(1) << std::endl;
+                if(!out) {
+                    fprintf(stderr, "Error: unable to write '%s'\n", golden_path.c_str());
+                    return 1;
+                }
+                printf("UPDATED %s\n", case_name.c_str());
+                continue;
+            }
+
+            if(opts.compare_engines && !RunGoldenCase(psi0_idx, v_idx, opts.compare_engine, step_count, expected, error)) {
+                printf("FAIL %s: %s run failed: %s\n", case_name.c_str(), GetGoldenEngineName(opts.compare_engine), error.c_str());
+                failed_count++;
+                continue;
+            }
+
+            std::vector<std::string> diffs;
+            if(CompareGoldenOutputs(output, expected, opts.rel_tolerance, opts.abs_tolerance, diffs) > 0) {
+                printf("FAIL %s\n", case_name.c_str());
+                for(const auto &diff: diffs) {
+                    printf("    %s\n", diff.c_str());
+                }
+                failed_count++;
+            }
+            else {
+                printf("ok   %s\n", case_name.c_str());
+            }
+        }
+    }
+
+    if(case_count == 0) {
+        fprintf(stderr, "Error: no combination matches '%s'\n", opts.filter.c_str());
+        return 1;
+    }
+    fprintf(stderr, "%zu/%zu combinations %s in %.1f ms\n", case_count - failed_count, case_count, opts.update ? "updated" : "passed", GetCurrentTimeMs() - start_time);
+    return (failed_count > 0) ? 1 : 0;
+}
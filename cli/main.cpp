@@ -0,0 +1,260 @@
+#include "cli.hpp"
+#include "trace.hpp"
+#include <cstdio>
+
+// Headless simulation runner for native builds: loads settings as saved from the web UI (or resumes a checkpoint),
+// runs the given amount of iterations and writes the results out (see export.hpp and checkpoint.hpp)
+// Other modes are selected by the first argument (see cli.hpp)
+
+namespace {
+
+    constexpr long DefaultStepCount = 1000;
+    constexpr long DefaultProgressInterval = 10000;
+
+    struct Options {
+        std::string settings_path;
+        std::string resume_path;
+        long step_count;
+        std::string export_dir;
+        long snapshot_interval;
+        std::string checkpoint_path;
+        long auto_checkpoint_interval;
+        bool has_left_sep;
+        double left_sep;
+        bool has_right_sep;
+        double right_sep;
+        long progress_interval;
+        std::string trace_path;
+    };
+
+    void PrintUsage(const char *argv0) {
+        fprintf(stderr, "Usage: %s [<settings.json>] [options]\n", argv0);
+        fprintf(stderr, "       %s sweep <settings.json> --param <spec> [options]\n", argv0);
+        fprintf(stderr, "       %s bench [options]\n", argv0);
+        fprintf(stderr, "       %s accuracy [options]\n", argv0);
+        fprintf(stderr, "       %s golden [options]\n", argv0);
+        fprintf(stderr, "       %s check [options]\n", argv0);
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "  --steps <n>                  Iterations to run (default: %ld)\n", DefaultStepCount);
+        fprintf(stderr, "  --resume <checkpoint>        Resume from a checkpoint instead of starting from the settings\n");
+        fprintf(stderr, "  --export <dir>               Stream records into the directory\n");
+        fprintf(stderr, "  --snapshot-interval <n>      Also export Psi every n iterations (needs --export)\n");
+        fprintf(stderr, "  --checkpoint <path>          Save a checkpoint once done\n");
+        fprintf(stderr, "  --auto-checkpoint <n>        Also save it every n iterations (needs --checkpoint)\n");
+        fprintf(stderr, "  --left-separator <x>         Left region separator\n");
+        fprintf(stderr, "  --right-separator <x>        Right region separator\n");
+        fprintf(stderr, "  --progress <n>               Print progress every n iterations, 0 to disable (default: %ld)\n", DefaultProgressInterval);
+        fprintf(stderr, "  --trace <path>               Record a Chrome trace (last %zu events) and save it there once done\n", trace::EventCapacity);
+        fprintf(stderr, "\n");
+        PrintSweepUsage();
+        fprintf(stderr, "\n");
+        PrintBenchUsage();
+        fprintf(stderr, "\n");
+        PrintAccuracyUsage();
+        fprintf(stderr, "\n");
+        PrintGoldenUsage();
+        fprintf(stderr, "\n");
+        PrintCheckUsage();
+    }
+
+    bool ParseOptions(const int argc, char **argv, Options &out_opts, std::string &out_error) {
+        out_opts = {};
+        out_opts.step_count = DefaultStepCount;
+        out_opts.progress_interval = DefaultProgressInterval;
+
+        for(int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if(arg.rfind("--", 0) != 0) {
+                if(!out_opts.settings_path.empty()) {
+                    out_error = "only one settings file can be given";
+                    return false;
+                }
+                out_opts.settings_path = arg;
+                continue;
+            }
+
+            if(i + 1 >= argc) {
+                out_error = "missing value for '" + arg + "'";
+                return false;
+            }
+            const char *val = argv[++i];
+
+            #define _LONG_OPTION(name, field) \
+                if(arg == name) { \
+                    if(!ParseLong(val, out_opts.field)) { \
+                        out_error = std::string("invalid value for '") + name + "': " + val; \
+                        return false; \
+                    } \
+                    continue; \
+                }
+
+            #define _DOUBLE_OPTION(name, field) \
+                if(arg == name) { \
+                    if(!ParseDouble(val, out_opts.field)) { \
+                        out_error = std::string("invalid value for '") + name + "': " + val; \
+                        return false; \
+                    } \
+                    out_opts.has_##field = true; \
+                    continue; \
+                }
+
+            #define _STRING_OPTION(name, field) \
+                if(arg == name) { \
+                    out_opts.field = val; \
+                    continue; \
+                }
+
+            _LONG_OPTION("--steps", step_count);
+            _STRING_OPTION("--resume", resume_path);
+            _STRING_OPTION("--export", export_dir);
+            _LONG_OPTION("--snapshot-interval", snapshot_interval);
+            _STRING_OPTION("--checkpoint", checkpoint_path);
+            _LONG_OPTION("--auto-checkpoint", auto_checkpoint_interval);
+            _DOUBLE_OPTION("--left-separator", left_sep);
+            _DOUBLE_OPTION("--right-separator", right_sep);
+            _LONG_OPTION("--progress", progress_interval);
+            _STRING_OPTION("--trace", trace_path);
+
+            out_error = "unknown option '" + arg + "'";
+            return false;
+        }
+
+        if(out_opts.settings_path.empty() == out_opts.resume_path.empty()) {
+            out_error = "either a settings file or a checkpoint to resume must be given";
+            return false;
+        }
+        if((out_opts.snapshot_interval > 0) && out_opts.export_dir.empty()) {
+            out_error = "--snapshot-interval needs --export";
+            return false;
+        }
+        if((out_opts.auto_checkpoint_interval > 0) && out_opts.checkpoint_path.empty()) {
+            out_error = "--auto-checkpoint needs --checkpoint";
+            return false;
+        }
+        return true;
+    }
+
+    void PrintState(QuantumSimulator &sim) {
+        const auto ti = sim.GetIteration() - 1;
+        printf("ti=%ld t=%.6g norm=%.9f x=%.6g p=%.6g E=%.9g left=%.6f mid=%.6f right=%.6f\n", ti, sim.DiscreteT(ti), sim.GetCurrentPsiNorm(), sim.GetCurrentXEstimateValue(), sim.GetCurrentPEstimateValue(), sim.GetCurrentEnergyEstimateValue(), sim.GetCurrentLeftRegionProbability(), sim.GetCurrentMiddleRegionProbability(), sim.GetCurrentRightRegionProbability());
+        fflush(stdout);
+    }
+
+}
+
+int main(int argc, char **argv) {
+    if((argc > 1) && (std::string(argv[1]) == "sweep")) {
+        return RunSweep(argc - 1, argv + 1);
+    }
+    if((argc > 1) && (std::string(argv[1]) == "bench")) {
+        return RunBench(argc - 1, argv + 1);
+    }
+    if((argc > 1) && (std::string(argv[1]) == "accuracy")) {
+        return RunAccuracy(argc - 1, argv + 1);
+    }
+    if((argc > 1) && (std::string(argv[1]) == "golden")) {
+        return RunGolden(argc - 1, argv + 1);
+    }
+    if((argc > 1) && (std::string(argv[1]) == "check")) {
+        return RunCheck(argc - 1, argv + 1);
+    }
+
+    Options opts;
+    std::string error;
+    if(!ParseOptions(argc, argv, opts, error)) {
+        fprintf(stderr, "Error: %s\n\n", error.c_str());
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    QuantumSimulator sim(DefaultHslash, DefaultMass, DefaultTimeStart, DefaultTimeStep, DefaultSpaceStart, DefaultSpaceEnd, DefaultSpaceStep);
+    if(!opts.resume_path.empty()) {
+        if(!sim.LoadCheckpoint(opts.resume_path, error)) {
+            fprintf(stderr, "Error: unable to load checkpoint: %s\n", error.c_str());
+            return 1;
+        }
+    }
+    else {
+        nlohmann::json settings;
+        if(!LoadSettingsFile(opts.settings_path, settings, error) || !ApplySettings(sim, settings, error)) {
+            fprintf(stderr, "Error: unable to load settings: %s\n", error.c_str());
+            return 1;
+        }
+    }
+    sim.UpdateHistoryEnabled(false);
+
+    if(opts.has_left_sep) {
+        sim.UpdateLeftRegionSeparator(opts.left_sep);
+    }
+    if(opts.has_right_sep) {
+        sim.UpdateRightRegionSeparator(opts.right_sep);
+    }
+
+    // Resumed runs only need V (Ψ was restored)
+    if(!EvaluateSources(sim, sim.GetIteration() == 0, error)) {
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return 1;
+    }
+
+    const auto plan = PlanSimulation(sim.GetPlanInput());
+    fprintf(stderr, "Planned: %.2f MB (grid %.2f MB, records %.2f MB), about %.3f ms/iteration\n", plan.total_size / (1024.0 * 1024.0), plan.grid_size / (1024.0 * 1024.0), plan.record_size / (1024.0 * 1024.0), plan.step_time);
+
+    if(!opts.export_dir.empty() && !sim.StartExport(opts.export_dir, opts.snapshot_interval, error)) {
+        fprintf(stderr, "Error: unable to start export: %s\n", error.c_str());
+        return 1;
+    }
+    sim.UpdateAutoCheckpoint(opts.checkpoint_path, opts.auto_checkpoint_interval);
+
+    if(!opts.trace_path.empty()) {
+        trace::SetEnabled(true);
+    }
+
+    const auto start_time = GetCurrentTimeMs();
+    for(long i = 0; i < opts.step_count; i++) {
+        if(!sim.ComputeNextIteration()) {
+            fprintf(stderr, "Error: %s\n", GetIterationError(sim).c_str());
+            return 1;
+        }
+        if((opts.progress_interval > 0) && (((i + 1) % opts.progress_interval) == 0)) {
+            PrintState(sim);
+        }
+        if(!sim.GetAutoCheckpointError().empty()) {
+            fprintf(stderr, "Warning: auto-checkpoint failed: %s\n", sim.GetAutoCheckpointError().c_str());
+            sim.UpdateAutoCheckpoint(opts.checkpoint_path, opts.auto_checkpoint_interval);
+        }
+    }
+    const auto elapsed_time = GetCurrentTimeMs() - start_time;
+
+    const auto exporter = sim.GetExporter();
+    if(exporter != nullptr) {
+        // Wait for the pending writes first, since they might fail too
+        exporter->Stop();
+        const auto export_error = exporter->GetError();
+        const auto skipped_snapshot_count = exporter->GetSkippedSnapshotCount();
+        sim.StopExport();
+        if(!export_error.empty()) {
+            fprintf(stderr, "Error: export failed: %s\n", export_error.c_str());
+            return 1;
+        }
+        if(skipped_snapshot_count > 0) {
+            fprintf(stderr, "Warning: %zu snapshots were skipped, since writing them fell over %zu MB behind\n", skipped_snapshot_count, ExportMaxPendingSize / (1024 * 1024));
+        }
+    }
+    if(!opts.checkpoint_path.empty() && !sim.SaveCheckpoint(opts.checkpoint_path, error)) {
+        fprintf(stderr, "Error: unable to save checkpoint: %s\n", error.c_str());
+        return 1;
+    }
+
+    if(!opts.trace_path.empty() && !trace::SaveJson(opts.trace_path, error)) {
+        fprintf(stderr, "Error: unable to save trace: %s\n", error.c_str());
+        return 1;
+    }
+
+    const auto progress_printed = (opts.progress_interval > 0) && (opts.step_count > 0) && ((opts.step_count % opts.progress_interval) == 0);
+    if((sim.GetIteration() > 0) && !progress_printed) {
+        PrintState(sim);
+    }
+    fprintf(stderr, "%ld iterations (%ld points) in %.1f ms (%.3f ms/iteration)\n", opts.step_count, sim.GetDimensions(), elapsed_time, (opts.step_count > 0) ? (elapsed_time / opts.step_count) : 0.0);
+    return 0;
+}
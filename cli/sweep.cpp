@@ -0,0 +1,432 @@
+#include "cli.hpp"
+#include "thread_pool.hpp"
+#include <cstdio>
+#include <cstring>
+#include <regex>
+
+// Parameter sweeps: every combination of the given parameter values is run as an independent simulation (from the same base settings),
+// spread over a pool of threads, with a summary row written per run
+// Parameters are either settings items (t_0, x_0, x_f, dt, dx, hslash, m), the region separators, or globals of the sources (as "psi0.<name>" or "V.<name>"),
+// the latter replacing the value of the global's top-level assignment
+
+namespace {
+
+    constexpr long DefaultSweepStepCount = 1000;
+
+    constexpr const char *SettingsParameterNames[] = { "t_0", "x_0", "x_f", "dt", "dx", "hslash", "m" };
+    constexpr const char *LeftSeparatorParameterName = "left_separator";
+    constexpr const char *RightSeparatorParameterName = "right_separator";
+    constexpr const char *Psi0ParameterPrefix = "psi0.";
+    constexpr const char *VParameterPrefix = "V.";
+
+    struct SweepParameter {
+        std::string name;
+        std::vector<double> values;
+    };
+
+    struct SweepOptions {
+        std::string settings_path;
+        std::vector<SweepParameter> params;
+        long step_count;
+        long thread_count;
+        std::string output_path;
+        double left_sep;
+        double right_sep;
+    };
+
+    struct RunSummary {
+        bool ok;
+        std::string error;
+        double norm_drift;
+        double energy_0;
+        double energy_f;
+        double left_prob;
+        double mid_prob;
+        double right_prob;
+        double reflection;
+        double transmission;
+        double time_ms;
+    };
+
+    inline bool IsSettingsParameter(const std::string &name) {
+        for(const auto param_name: SettingsParameterNames) {
+            if(name == param_name) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline bool IsSourceGlobalParameter(const std::string &name, std::string &out_global, bool &out_is_v) {
+        for(const auto prefix: { Psi0ParameterPrefix, VParameterPrefix }) {
+            if(name.rfind(prefix, 0) == 0) {
+                out_global = name.substr(strlen(prefix));
+                out_is_v = prefix == VParameterPrefix;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Either "name=start:end:count" (evenly spaced, both ends included) or "name=v1,v2,..."
+    bool ParseSweepParameter(const std::string &spec, SweepParameter &out_param, std::string &out_error) {
+        const auto eq_pos = spec.find('=');
+        if((eq_pos == std::string::npos) || (eq_pos == 0)) {
+            out_error = "expected <name>=<values> in '" + spec + "'";
+            return false;
+        }
+        out_param.name = spec.substr(0, eq_pos);
+        out_param.values.clear();
+
+        std::string global;
+        bool is_v;
+        if(IsSourceGlobalParameter(out_param.name, global, is_v)) {
+            static const std::regex identifier_regex("[A-Za-z_$][A-Za-z0-9_$]*");
+            if(!std::regex_match(global, identifier_regex)) {
+                out_error = "invalid source global name '" + global + "'";
+                return false;
+            }
+        }
+        else if(!IsSettingsParameter(out_param.name) && (out_param.name != LeftSeparatorParameterName) && (out_param.name != RightSeparatorParameterName)) {
+            out_error = "unknown parameter '" + out_param.name + "'";
+            return false;
+        }
+
+        const auto values = spec.substr(eq_pos + 1);
+        std::vector<std::string> items;
+        const auto is_range = values.find(':') != std::string::npos;
+        const auto sep = is_range ? ':' : ',';
+        size_t start = 0;
+        while(true) {
+            const auto end = values.find(sep, start);
+            items.push_back(values.substr(start, end - start));
+            if(end == std::string::npos) {
+                break;
+            }
+            start = end + 1;
+        }
+
+        if(is_range) {
+            double range_start;
+            double range_end;
+            long count;
+            if((items.size() != 3) || !ParseDouble(items[0].c_str(), range_start) || !ParseDouble(items[1].c_str(), range_end) || !ParseLong(items[2].c_str(), count) || (count == 0)) {
+                out_error = "invalid range for '" + out_param.name + "' (expected <start>:<end>:<count>)";
+                return false;
+            }
+            for(long i = 0; i < count; i++) {
+                out_param.values.push_back((count == 1) ? range_start : (range_start + (range_end - range_start) * i / (count - 1)));
+            }
+        }
+        else {
+            for(const auto &item: items) {
+                double val;
+                if(!ParseDouble(item.c_str(), val)) {
+                    out_error = "invalid value '" + item + "' for '" + out_param.name + "'";
+                    return false;
+                }
+                out_param.values.push_back(val);
+            }
+        }
+        return true;
+    }
+
+    bool ParseSweepOptions(const int argc, char **argv, SweepOptions &out_opts, std::string &out_error) {
+        out_opts = {};
+        out_opts.step_count = DefaultSweepStepCount;
+        out_opts.left_sep = DefaultLeftRegionSeparator;
+        out_opts.right_sep = DefaultRightRegionSeparator;
+
+        for(int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if(arg.rfind("--", 0) != 0) {
+                if(!out_opts.settings_path.empty()) {
+                    out_error = "only one settings file can be given";
+                    return false;
+                }
+                out_opts.settings_path = arg;
+                continue;
+            }
+
+            if(i + 1 >= argc) {
+                out_error = "missing value for '" + arg + "'";
+                return false;
+            }
+            const char *val = argv[++i];
+
+            if(arg == "--param") {
+                SweepParameter param;
+                if(!ParseSweepParameter(val, param, out_error)) {
+                    return false;
+                }
+                for(const auto &other_param: out_opts.params) {
+                    if(other_param.name == param.name) {
+                        out_error = "parameter '" + param.name + "' was given more than once";
+                        return false;
+                    }
+                }
+                out_opts.params.push_back(std::move(param));
+                continue;
+            }
+
+            #define _LONG_OPTION(name, field) \
+                if(arg == name) { \
+                    if(!ParseLong(val, out_opts.field)) { \
+                        out_error = std::string("invalid value for '") + name + "': " + val; \
+                        return false; \
+                    } \
+                    continue; \
+                }
+
+            #define _DOUBLE_OPTION(name, field) \
+                if(arg == name) { \
+                    if(!ParseDouble(val, out_opts.field)) { \
+                        out_error = std::string("invalid value for '") + name + "': " + val; \
+                        return false; \
+                    } \
+                    continue; \
+                }
+
+            #define _STRING_OPTION(name, field) \
+                if(arg == name) { \
+                    out_opts.field = val; \
+                    continue; \
+                }
+
+            _LONG_OPTION("--steps", step_count);
+            _LONG_OPTION("--threads", thread_count);
+            _STRING_OPTION("--output", output_path);
+            _DOUBLE_OPTION("--left-separator", left_sep);
+            _DOUBLE_OPTION("--right-separator", right_sep);
+
+            out_error = "unknown option '" + arg + "'";
+            return false;
+        }
+
+        if(out_opts.settings_path.empty()) {
+            out_error = "a base settings file must be given";
+            return false;
+        }
+        if(out_opts.params.empty()) {
+            out_error = "at least one parameter must be given";
+            return false;
+        }
+        if(out_opts.step_count == 0) {
+            out_error = "--steps must be positive";
+            return false;
+        }
+        return true;
+    }
+
+    bool GenerateRunSettings(const nlohmann::json &base_settings, const std::vector<SweepParameter> &params, const std::vector<double> &values, nlohmann::json &out_settings, std::string &out_error) {
+        out_settings = base_settings;
+        for(size_t i = 0; i < params.size(); i++) {
+            std::string global;
+            bool is_v;
+            if(IsSourceGlobalParameter(params[i].name, global, is_v)) {
+                const auto src_key = is_v ? "v_src" : "psi0_src";
+                if(!out_settings.contains(src_key) || !out_settings[src_key].is_string()) {
+                    out_error = std::string("the base settings have no ") + src_key;
+                    return false;
+                }
+                auto src = out_settings[src_key].get<std::string>();
+                if(!OverrideSourceGlobal(src, global, values[i], out_error)) {
+                    out_error = params[i].name + ": " + out_error;
+                    return false;
+                }
+                out_settings[src_key] = src;
+            }
+            else if(IsSettingsParameter(params[i].name)) {
+                out_settings[params[i].name] = values[i];
+            }
+        }
+        return true;
+    }
+
+    void RunSimulation(const nlohmann::json &settings, const SweepOptions &opts, const std::vector<double> &values, RunSummary &out_summary) {
+        out_summary = {};
+        const auto start_time = GetCurrentTimeMs();
+
+        QuantumSimulator sim(DefaultHslash, DefaultMass, DefaultTimeStart, DefaultTimeStep, DefaultSpaceStart, DefaultSpaceEnd, DefaultSpaceStep);
+        sim.UpdateHistoryEnabled(false);
+        if(!ApplySettings(sim, settings, out_summary.error) || !EvaluateSources(sim, true, out_summary.error)) {
+            return;
+        }
+
+        auto left_sep = opts.left_sep;
+        auto right_sep = opts.right_sep;
+        for(size_t i = 0; i < opts.params.size(); i++) {
+            if(opts.params[i].name == LeftSeparatorParameterName) {
+                left_sep = values[i];
+            }
+            else if(opts.params[i].name == RightSeparatorParameterName) {
+                right_sep = values[i];
+            }
+        }
+        sim.UpdateLeftRegionSeparator(left_sep);
+        sim.UpdateRightRegionSeparator(right_sep);
+
+        double norm_0 = 0.0;
+        double left_prob_0 = 0.0;
+        for(long i = 0; i < opts.step_count; i++) {
+            if(!sim.ComputeNextIteration()) {
+                out_summary.error = GetIterationError(sim);
+                return;
+            }
+            if(i == 0) {
+                norm_0 = sim.GetCurrentPsiNorm();
+                left_prob_0 = sim.GetCurrentLeftRegionProbability();
+                out_summary.energy_0 = sim.GetCurrentEnergyEstimateValue();
+            }
+        }
+
+        out_summary.ok = true;
+        out_summary.norm_drift = sim.GetCurrentPsiNorm() - norm_0;
+        out_summary.energy_f = sim.GetCurrentEnergyEstimateValue();
+        out_summary.left_prob = sim.GetCurrentLeftRegionProbability();
+        out_summary.mid_prob = sim.GetCurrentMiddleRegionProbability();
+        out_summary.right_prob = sim.GetCurrentRightRegionProbability();
+        // Whatever was on the left minus what went through the left separator (just the final left probability for packets coming from the left)
+        out_summary.reflection = left_prob_0 - sim.GetCurrentLeftSeparatorFlux();
+        out_summary.transmission = sim.GetCurrentRightSeparatorFlux();
+        out_summary.time_ms = GetCurrentTimeMs() - start_time;
+    }
+
+    std::string EscapeCsv(const std::string &str) {
+        if(str.find_first_of(",\"\n") == std::string::npos) {
+            return str;
+        }
+
+        std::string escaped = "\"";
+        for(const auto ch: str) {
+            if(ch == '"') {
+                escaped += '"';
+            }
+            escaped += ch;
+        }
+        return escaped + "\"";
+    }
+
+    void WriteSummaryHeader(FILE *out, const std::vector<SweepParameter> &params) {
+        fprintf(out, "run");
+        for(const auto &param: params) {
+            fprintf(out, ",%s", EscapeCsv(param.name).c_str());
+        }
+        fprintf(out, ",status,left_prob,mid_prob,right_prob,reflection,transmission,norm_drift,energy_0,energy_f,energy_drift,rel_energy_drift,time_ms\n");
+    }
+
+    void WriteSummaryRow(FILE *out, const size_t run_idx, const std::vector<double> &values, const RunSummary &summary) {
+        fprintf(out, "%zu", run_idx);
+        for(const auto val: values) {
+            fprintf(out, ",%.17g", val);
+        }
+
+        if(summary.ok) {
+            const auto energy_drift = summary.energy_f - summary.energy_0;
+            const auto rel_energy_drift = (summary.energy_0 != 0.0) ? (energy_drift / std::abs(summary.energy_0)) : NAN;
+            fprintf(out, ",ok,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.12g,%.12g,%.9g,%.9g,%.1f\n", summary.left_prob, summary.mid_prob, summary.right_prob, summary.reflection, summary.transmission, summary.norm_drift, summary.energy_0, summary.energy_f, energy_drift, rel_energy_drift, summary.time_ms);
+        }
+        else {
+            fprintf(out, ",%s,,,,,,,,,,,\n", EscapeCsv("error: " + summary.error).c_str());
+        }
+    }
+
+}
+
+void PrintSweepUsage() {
+    fprintf(stderr, "Sweep options:\n");
+    fprintf(stderr, "  --param <name>=<a>:<b>:<n>   Sweep n evenly spaced values from a to b (both included)\n");
+    fprintf(stderr, "  --param <name>=<v1>,<v2>...  Sweep the given values\n");
+    fprintf(stderr, "                               Names: t_0, x_0, x_f, dt, dx, hslash, m, %s, %s,\n", LeftSeparatorParameterName, RightSeparatorParameterName);
+    fprintf(stderr, "                               or source globals as psi0.<name> / V.<name>\n");
+    fprintf(stderr, "  --steps <n>                  Iterations per run (default: %ld)\n", DefaultSweepStepCount);
+    fprintf(stderr, "  --threads <n>                Runs in parallel, 0 for one per hardware thread (default: 0)\n");
+    fprintf(stderr, "  --output <path>              Write the CSV summary there instead of stdout\n");
+    fprintf(stderr, "  --left-separator <x>         Left region separator (unless swept)\n");
+    fprintf(stderr, "  --right-separator <x>        Right region separator (unless swept)\n");
+}
+
+int RunSweep(const int argc, char **argv) {
+    SweepOptions opts;
+    std::string error;
+    if(!ParseSweepOptions(argc, argv, opts, error)) {
+        fprintf(stderr, "Error: %s\n\n", error.c_str());
+        PrintSweepUsage();
+        return 1;
+    }
+
+    nlohmann::json base_settings;
+    if(!LoadSettingsFile(opts.settings_path, base_settings, error)) {
+        fprintf(stderr, "Error: unable to load settings: %s\n", error.c_str());
+        return 1;
+    }
+
+    // Cartesian product of every parameter's values, the last parameter varying the fastest
+    size_t run_count = 1;
+    for(const auto &param: opts.params) {
+        run_count *= param.values.size();
+    }
+    std::vector<std::vector<double>> run_values(run_count);
+    std::vector<nlohmann::json> run_settings(run_count);
+    for(size_t i = 0; i < run_count; i++) {
+        auto rem = i;
+        run_values[i].resize(opts.params.size());
+        for(size_t j = opts.params.size(); j-- > 0;) {
+            run_values[i][j] = opts.params[j].values[rem % opts.params[j].values.size()];
+            rem /= opts.params[j].values.size();
+        }
+
+        // Settings mistakes are the same for every run, thus better reported before starting
+        if(!GenerateRunSettings(base_settings, opts.params, run_values[i], run_settings[i], error)) {
+            fprintf(stderr, "Error: %s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    FILE *out = stdout;
+    if(!opts.output_path.empty()) {
+        out = fopen(opts.output_path.c_str(), "w");
+        if(out == nullptr) {
+            fprintf(stderr, "Error: unable to open '%s'\n", opts.output_path.c_str());
+            return 1;
+        }
+    }
+
+    // Runs are independent, thus spread over the pool one at a time (so that uneven run costs are still balanced)
+    const auto hw_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    const auto thread_count = std::min((size_t)((opts.thread_count > 0) ? opts.thread_count : hw_thread_count), run_count);
+    ThreadPool pool(thread_count - 1);
+    fprintf(stderr, "%zu runs of %ld iterations on %zu threads\n", run_count, opts.step_count, pool.GetThreadCount());
+
+    std::vector<RunSummary> summaries(run_count);
+    std::mutex progress_lock;
+    size_t done_count = 0;
+    size_t failed_count = 0;
+    const auto start_time = GetCurrentTimeMs();
+    pool.ParallelFor(run_count, [&](const size_t idx, const size_t thread_idx) {
+        (void)thread_idx;
+        RunSimulation(run_settings[idx], opts, run_values[idx], summaries[idx]);
+
+        std::scoped_lock lk(progress_lock);
+        done_count++;
+        if(!summaries[idx].ok) {
+            failed_count++;
+            fprintf(stderr, "[%zu/%zu] run %zu failed: %s\n", done_count, run_count, idx, summaries[idx].error.c_str());
+        }
+        else {
+            fprintf(stderr, "[%zu/%zu] run %zu done in %.1f ms\n", done_count, run_count, idx, summaries[idx].time_ms);
+        }
+    });
+    const auto elapsed_time = GetCurrentTimeMs() - start_time;
+
+    WriteSummaryHeader(out, opts.params);
+    for(size_t i = 0; i < run_count; i++) {
+        WriteSummaryRow(out, i, run_values[i], summaries[i]);
+    }
+    if(out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "%zu runs (%zu failed) in %.1f ms (%.3f runs/s)\n", run_count, failed_count, elapsed_time, run_count * 1000.0 / elapsed_time);
+    return (failed_count > 0) ? 1 : 0;
+}
@@ -3,10 +3,12 @@
 #include <complex>
 #include <string>
 
-#ifndef __EMSCRIPTEN__
-#error "This should be compiled as JS!"
-#endif
+// The simulation core is platform-neutral: the web build adds the UI and JS source evaluation on top, while native builds run it headless
+#ifdef __EMSCRIPTEN__
 #include <emscripten.h>
+#else
+#include <chrono>
+#endif
 
 #include <Eigen/Dense>
 
@@ -21,6 +23,25 @@ using JsResult = int;
 
 #define JS_RC_SUCCEEDED(expr) ((expr) == 0)
 
+// Milliseconds since an arbitrary point, only meant for measuring intervals
+inline double GetCurrentTimeMs() {
+    #ifdef __EMSCRIPTEN__
+    return emscripten_get_now();
+    #else
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    #endif
+}
+
+inline uint64_t HashFnv1a(const uint8_t *data, const size_t data_size) {
+    // FNV-1a, 64-bit
+    uint64_t hash = 0xcbf29ce484222325;
+    for(size_t i = 0; i < data_size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
 inline double NormSquared(const Num num) {
     return pow(num.real(), 2) + pow(num.imag(), 2);
 }
@@ -37,11 +58,17 @@ inline CVector ConjugatedCVector(const CVector &vec) {
     return new_vec;
 }
 
-inline Vector NormSquaredVector(const CVector &vec) {
-    Vector new_vec = Vector::Zero(vec.size());
-    for(long i = 0; i < new_vec.size(); i++) {
-        new_vec(i) = NormSquared(vec(i));
+// Into an existing vector, which is not reallocated while its size stays the same
+inline void NormSquaredVector(const CVector &vec, Vector &out_vec) {
+    out_vec.resize(vec.size());
+    for(long i = 0; i < out_vec.size(); i++) {
+        out_vec(i) = NormSquared(vec(i));
     }
+}
+
+inline Vector NormSquaredVector(const CVector &vec) {
+    Vector new_vec;
+    NormSquaredVector(vec, new_vec);
     return new_vec;
 }
 
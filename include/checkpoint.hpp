@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Checkpoint files: CheckpointHeader followed by sections (CheckpointSectionHeader and its payload), every one with its own checksum (FNV-1a)
+// Sections with unknown tags are skipped when reading, so that newer sections can be added without breaking older checkpoints
+
+constexpr char CheckpointMagic[4] = { 'Q', 'C', 'H', 'K' };
+// Bumped on every change to the contents of the sections (older checkpoints are then refused instead of misread)
+constexpr uint32_t CheckpointVersion = 2;
+
+enum class CheckpointSectionTag : uint32_t {
+    Settings = 1,
+    State = 2,
+    Records = 3,
+    Spectrum = 4
+};
+
+struct CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t section_count;
+    uint32_t reserved;
+};
+static_assert(sizeof(CheckpointHeader) == 16);
+
+struct CheckpointSectionHeader {
+    CheckpointSectionTag tag;
+    uint32_t reserved;
+    uint64_t size;
+    uint64_t hash;
+};
+static_assert(sizeof(CheckpointSectionHeader) == 24);
+
+class CheckpointWriter {
+    private:
+        std::vector<uint8_t> data;
+
+        inline void WriteBytes(const void *bytes, const size_t size) {
+            const auto bytes_ptr = static_cast<const uint8_t*>(bytes);
+            this->data.insert(this->data.end(), bytes_ptr, bytes_ptr + size);
+        }
+
+    public:
+        template<typename T>
+        inline void Write(const T &val) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            this->WriteBytes(&val, sizeof(T));
+        }
+
+        inline void WriteArray(const double *vals, const size_t count) {
+            this->Write<uint64_t>(count);
+            this->WriteBytes(vals, count * sizeof(double));
+        }
+
+        inline void WriteString(const std::string &str) {
+            this->Write<uint64_t>(str.length());
+            this->WriteBytes(str.data(), str.length());
+        }
+
+        inline const std::vector<uint8_t> &GetData() const {
+            return this->data;
+        }
+};
+
+class CheckpointReader {
+    private:
+        const uint8_t *cur;
+        const uint8_t *end;
+        bool ok;
+
+        inline bool ReadBytes(void *out_bytes, const size_t size) {
+            if(!this->ok || (static_cast<size_t>(this->end - this->cur) < size)) {
+                this->ok = false;
+                return false;
+            }
+            memcpy(out_bytes, this->cur, size);
+            this->cur += size;
+            return true;
+        }
+
+    public:
+        CheckpointReader(const std::vector<uint8_t> &data) : cur(data.data()), end(data.data() + data.size()), ok(true) {}
+
+        template<typename T>
+        inline bool Read(T &out_val) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            return this->ReadBytes(&out_val, sizeof(T));
+        }
+
+        inline bool ReadArray(std::vector<double> &out_vals) {
+            uint64_t count;
+            if(!this->Read(count) || (count > static_cast<size_t>(this->end - this->cur) / sizeof(double))) {
+                this->ok = false;
+                return false;
+            }
+            out_vals.resize(count);
+            return this->ReadBytes(out_vals.data(), count * sizeof(double));
+        }
+
+        inline bool ReadString(std::string &out_str) {
+            uint64_t length;
+            if(!this->Read(length) || (length > static_cast<size_t>(this->end - this->cur))) {
+                this->ok = false;
+                return false;
+            }
+            out_str.assign(reinterpret_cast<const char*>(this->cur), length);
+            this->cur += length;
+            return true;
+        }
+
+        inline bool IsOk() const {
+            return this->ok;
+        }
+};
+
+using CheckpointSections = std::map<CheckpointSectionTag, std::vector<uint8_t>>;
+
+// Written into a temporary file first, so that an interrupted write never corrupts a previous checkpoint
+bool WriteCheckpointFile(const std::string &path, const CheckpointSections &sections, std::string &out_error);
+bool ReadCheckpointFile(const std::string &path, CheckpointSections &out_sections, std::string &out_error);
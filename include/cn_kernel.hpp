@@ -0,0 +1,166 @@
+#pragma once
+#include <complex>
+
+// Crank-Nicolson propagation and derivative-based observable kernels, specialized at compile time on the scalar type and the boundary condition,
+// so that each combination is a branch-free inner loop with its constants hoisted (boundary rows are peeled off the loops instead)
+// The simulator picks its instantiation once per grid/settings change (see SelectPropagationKernels), never per element
+// Stencils are fixed to 3 points, since the propagator solve relies on Q being tridiagonal
+
+namespace kernel {
+
+    enum class Boundary {
+        // Ψ vanishes past the grid ends (identity boundary rows)
+        Dirichlet
+    };
+
+    template<typename Real>
+    using Complex = std::complex<Real>;
+
+    // Q has -r/2 off the diagonal and 1/2 (1 + r(2 + dx² 2mV/ħ²)) on it, where r = iħ²dt / (4dx²m)
+    template<typename Real>
+    struct PropagatorCoefficients {
+        Complex<Real> r;
+        Complex<Real> off_diag;
+        Real dx2;
+        Real v_factor;
+
+        inline Complex<Real> Diagonal(const Real v) const {
+            return Real(0.5) * (Real(1.0) + this->r * (Real(2.0) + this->dx2 * (v * this->v_factor)));
+        }
+    };
+
+    template<typename Real>
+    inline Complex<Real> ComputePropagatorR(const Real hslash, const Real m, const Real dt, const Real dx) {
+        return Complex<Real>(0, 1) * ((hslash * hslash * dt) / (4 * dx * dx * m));
+    }
+
+    template<typename Real>
+    inline PropagatorCoefficients<Real> MakePropagatorCoefficients(const Complex<Real> r, const Real hslash, const Real m, const Real dx) {
+        return { r, Real(0.5) * (-r), dx * dx, (2 * m) / (hslash * hslash) };
+    }
+
+    // LU factorization (Thomas algorithm) of Q from the given row onwards, where the previous rows are already factorized
+    template<typename Real, Boundary B>
+    void FactorizePropagator(const PropagatorCoefficients<Real> &coeffs, const Real *v, const long n, const long first_row, Complex<Real> *out_lower, Complex<Real> *out_diag) {
+        static_assert(B == Boundary::Dirichlet);
+
+        const auto last = n - 1;
+        const auto off = coeffs.off_diag;
+        long xi = first_row;
+        if(xi == 0) {
+            out_lower[0] = 0;
+            out_diag[0] = 1;
+            xi++;
+        }
+        // The first boundary row has no upper off-diagonal term
+        if((xi == 1) && (xi < last)) {
+            out_lower[1] = off;
+            out_diag[1] = coeffs.Diagonal(v[1]);
+            xi++;
+        }
+        for(; xi < last; xi++) {
+            const auto lower = off / out_diag[xi - 1];
+            out_lower[xi] = lower;
+            out_diag[xi] = coeffs.Diagonal(v[xi]) - lower * off;
+        }
+        if(xi == last) {
+            out_lower[last] = 0;
+            out_diag[last] = 1;
+        }
+    }
+
+    // Ψ ← Q⁻¹Ψ - Ψ, with forward and back substitution through the factorization (the scratch buffer holds n values)
+    template<typename Real, Boundary B>
+    void SolvePropagator(const Complex<Real> off_diag, const Complex<Real> *lower, const Complex<Real> *diag, const long n, Complex<Real> *psi, Complex<Real> *scratch) {
+        static_assert(B == Boundary::Dirichlet);
+
+        const auto last = n - 1;
+        scratch[0] = psi[0];
+        for(long xi = 1; xi < n; xi++) {
+            scratch[xi] = psi[xi] - lower[xi] * scratch[xi - 1];
+        }
+
+        // The last boundary row has no lower off-diagonal term, and Ψ is only needed once its row is solved
+        scratch[last] /= diag[last];
+        psi[last] = scratch[last] - psi[last];
+        for(long xi = last - 1; xi > 0; xi--) {
+            scratch[xi] = (scratch[xi] - off_diag * scratch[xi + 1]) / diag[xi];
+            psi[xi] = scratch[xi] - psi[xi];
+        }
+        if(last > 0) {
+            scratch[0] /= diag[0];
+            psi[0] = scratch[0] - psi[0];
+        }
+    }
+
+    // Finite-difference terms of <p>, <p²> and <H> (not yet normalized), where p uses a forward difference
+    template<typename Real>
+    struct DerivativeObservableSums {
+        Real p;
+        Real p2;
+        Real energy;
+    };
+
+    // Also computes the probability current j at every point
+    template<typename Real, Boundary B>
+    DerivativeObservableSums<Real> ComputeDerivativeObservables(const Complex<Real> *psi, const Real *v, const long n, const Real dx, const Real hslash, const Real m, Real *out_current) {
+        static_assert(B == Boundary::Dirichlet);
+
+        const auto p_factor = -Complex<Real>(0, 1) * hslash;
+        const auto p2_factor = -(hslash * hslash);
+        const auto dx2 = dx * dx;
+        const auto kinetic_factor = Real(1.0) / (Real(2.0) * m);
+        const auto current_factor = hslash / m;
+        const auto two_dx = 2 * dx;
+
+        DerivativeObservableSums<Real> sums = {};
+        const auto accumulate = [&](const long i, const Complex<Real> prev, const Complex<Real> next) {
+            const auto cur = psi[i];
+            const auto cj_cur = std::conj(cur);
+            const auto p_psi = p_factor * ((next - cur) / dx);
+            const auto p2_psi = p2_factor * ((next - Real(2.0) * cur + prev) / dx2);
+            const Complex<Real> hm_psi = kinetic_factor * p2_psi + v[i] * cur;
+            // Need to explicitly keep only the real parts, even though p and H are observable operators thus the results will be real anyway
+            sums.p += (cj_cur * p_psi * dx).real();
+            sums.p2 += (cj_cur * p2_psi * dx).real();
+            sums.energy += (cj_cur * hm_psi * dx).real();
+        };
+
+        // Ψ vanishes at the boundaries, so does j
+        const auto last = n - 1;
+        accumulate(0, 0, (n > 1) ? psi[1] : 0);
+        out_current[0] = 0;
+        for(long i = 1; i < last; i++) {
+            accumulate(i, psi[i - 1], psi[i + 1]);
+            const auto dpsi = (psi[i + 1] - psi[i - 1]) / two_dx;
+            out_current[i] = current_factor * (std::conj(psi[i]) * dpsi).imag();
+        }
+        if(last > 0) {
+            accumulate(last, psi[last - 1], 0);
+            out_current[last] = 0;
+        }
+        return sums;
+    }
+
+    template<typename Real>
+    struct PropagationKernels {
+        void (*factorize)(const PropagatorCoefficients<Real>&, const Real*, const long, const long, Complex<Real>*, Complex<Real>*);
+        void (*solve)(const Complex<Real>, const Complex<Real>*, const Complex<Real>*, const long, Complex<Real>*, Complex<Real>*);
+        DerivativeObservableSums<Real> (*derivative_observables)(const Complex<Real>*, const Real*, const long, const Real, const Real, const Real, Real*);
+    };
+
+    template<typename Real, Boundary B>
+    constexpr PropagationKernels<Real> MakePropagationKernels() {
+        return { &FactorizePropagator<Real, B>, &SolvePropagator<Real, B>, &ComputeDerivativeObservables<Real, B> };
+    }
+
+    template<typename Real>
+    inline PropagationKernels<Real> SelectPropagationKernels(const Boundary boundary) {
+        switch(boundary) {
+            case Boundary::Dirichlet:
+            default:
+                return MakePropagationKernels<Real, Boundary::Dirichlet>();
+        }
+    }
+
+}
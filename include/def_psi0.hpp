@@ -48,7 +48,8 @@ namespace def_psi0 {
         "n = 1; // Eigenstate |n>\n"
         "\n"
         "function psi0(x) {\n"
-        "    return (1/math.sqrt((2**n)*math.factorial(n))) * math.nthRoot(((m*omega)/(math.PI*hslash)), 4) * math.exp(- ((m*omega)/(2*hslash)) * x**2) * hermite(n, math.sqrt((m*omega)/hslash) * x);\n"
+        "    // hermite_fn(n, x) is the normalized Hermite function, which avoids overflowing with big n values\n"
+        "    return math.nthRoot((m*omega)/hslash, 4) * hermite_fn(n, math.sqrt((m*omega)/hslash) * x);\n"
         "}";
 
     constexpr const char DiracDeltaPsi0[] =
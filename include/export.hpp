@@ -0,0 +1,78 @@
+#pragma once
+#include "base.hpp"
+#include "json.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Streams records and periodic Ψ snapshots into a directory while the simulation runs:
+// - header.json: simulation settings (as in GenerateSettings) plus the layout described here
+// - records/chunk_NNNNNN.npy: float64 array of shape (column count, rows) (thus columnar), every RecordExportChunkRows iterations (the last chunk may be shorter)
+// - psi/iter_NNNNNNNNNN.npy: complex128 array with Ψ at that iteration
+// Files are written with a temporary name and renamed once complete, so that partial results can be read while the run continues
+// Writes happen in a background thread (or synchronously in builds without thread support), with at most ExportMaxPendingSize bytes pending:
+// beyond that, snapshots are skipped (and counted), while record chunks wait for room since they cannot be recovered
+
+constexpr size_t RecordExportChunkRows = 4096;
+constexpr uint32_t ExportFormatVersion = 1;
+constexpr size_t ExportMaxPendingSize = 256 * 1024 * 1024;
+
+class SimulationExporter {
+    private:
+        struct WriteJob {
+            std::string path;
+            // NPY dtype descriptor, "<f8" or "<c16"
+            std::string descr;
+            std::vector<size_t> shape;
+            std::vector<double> data;
+        };
+
+        std::string dir;
+        size_t column_count;
+        std::vector<double> chunk;
+        size_t chunk_rows;
+        size_t chunk_idx;
+        std::deque<WriteJob> jobs;
+        size_t pending_size;
+        std::mutex jobs_lock;
+        std::condition_variable jobs_cv;
+        std::condition_variable room_cv;
+        std::thread writer_thread;
+        bool stopping;
+        size_t skipped_snapshot_count;
+        std::string error;
+
+        // Returns false if the job was skipped (only if can_skip, when over the pending limit)
+        bool Enqueue(WriteJob &&job, const bool can_skip);
+        void FlushChunk();
+        bool WriteJobFile(const WriteJob &job);
+        void WriterMain();
+
+    public:
+        SimulationExporter() : column_count(0), chunk_rows(0), chunk_idx(0), pending_size(0), stopping(false), skipped_snapshot_count(0) {}
+        SimulationExporter(const SimulationExporter&) = delete;
+        SimulationExporter &operator=(const SimulationExporter&) = delete;
+
+        ~SimulationExporter() {
+            this->Stop();
+        }
+
+        bool Start(const std::string &dir, const nlohmann::json &header, const size_t column_count, std::string &out_error);
+        // Waits for every pending write
+        void Stop();
+
+        // vals must contain column_count values
+        void PushRow(const double *vals);
+        void PushSnapshot(const long ti, const CVector &psi_vec);
+
+        std::string GetError();
+
+        inline size_t GetSkippedSnapshotCount() const {
+            return this->skipped_snapshot_count;
+        }
+
+        inline const std::string &GetDirectory() const {
+            return this->dir;
+        }
+};
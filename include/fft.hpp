@@ -0,0 +1,38 @@
+#pragma once
+#include "base.hpp"
+#include <memory>
+#include <vector>
+
+// Discrete Fourier transform of any size: X_k = Σ x_j e^(-2πi jk/n)
+// - Power-of-two sizes use an iterative radix-2 transform
+// - Other sizes use Bluestein's algorithm (a convolution through a power-of-two transform of at least 2n - 1)
+// Plans precompute everything depending on the size only, thus transforms do not allocate once the scratch buffer is sized
+
+class FftPlan {
+    private:
+        size_t n;
+        // Size of the underlying radix-2 transform
+        size_t m;
+        std::vector<Num> twiddles;
+        std::vector<uint32_t> bit_reversal;
+        // Bluestein: e^(-iπ j²/n) and the transform of its (zero-padded, wrapped) conjugate
+        std::vector<Num> chirp;
+        std::vector<Num> chirp_fft;
+
+        void Radix2(Num *data, const bool inverse) const;
+
+    public:
+        FftPlan(const size_t n);
+
+        // in and out may be the same buffer; scratch is only resized the first time (concurrent transforms need different scratch buffers)
+        void Forward(const Num *in, Num *out, std::vector<Num> &scratch) const;
+        void Inverse(const Num *in, Num *out, std::vector<Num> &scratch) const;
+
+        inline size_t GetSize() const {
+            return this->n;
+        }
+};
+
+// Plans are cached per size (grids rarely change, so only a few are kept) and shared between threads, since they are immutable once built
+// Evicted plans stay alive while anyone still holds them
+std::shared_ptr<const FftPlan> GetFftPlan(const size_t n);
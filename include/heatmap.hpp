@@ -0,0 +1,64 @@
+#pragma once
+#include "base.hpp"
+#include <GLES3/gl3.h>
+#include <vector>
+
+// |Ψ|² space-time heatmap, kept in a ring-buffered texture: every stored iteration only uploads its own row (glTexSubImage2D),
+// so that the cost per iteration stays constant however long the run gets
+// Rows are downsampled (keeping the maximum of every bin, so that narrow peaks are never lost) to at most HeatmapMaxWidth columns
+
+constexpr int HeatmapMaxWidth = 1024;
+constexpr int HeatmapRowCount = 1024;
+
+class SpaceTimeHeatmap {
+    private:
+        GLuint texture;
+        int width;
+        long n;
+        long stride;
+        int next_row;
+        int row_count;
+        long last_ti;
+        // Values over scale * saturation are drawn with the last colormap color
+        double scale;
+        double saturation;
+        // Raw (downsampled) rows are kept, so that the texture can be rebuilt when the saturation changes
+        std::vector<float> rows;
+        std::vector<long> row_tis;
+        std::vector<uint32_t> colormap;
+        std::vector<uint32_t> pixels;
+
+        void ColorizeRow(const int row, uint32_t *out_pixels);
+        void UploadRows(const int row_start, const int row_end);
+
+    public:
+        SpaceTimeHeatmap() : texture(0), stride(1), saturation(1.0) {
+            this->Clear();
+        }
+
+        void Clear();
+
+        // Iterations must be pushed in order (going back in time is treated as a new run)
+        void Push(const long ti, const Vector &psisq_vec);
+        // Draws the stored rows in the current plot (x in space, y in iterations)
+        void Plot(const char *label, const double x_0, const double x_f);
+
+        inline void UpdateStride(const long stride) {
+            if(stride != this->stride) {
+                this->stride = stride;
+                this->Clear();
+            }
+        }
+        inline long GetStride() {
+            return this->stride;
+        }
+
+        void UpdateSaturation(const double saturation);
+        inline double GetSaturation() {
+            return this->saturation;
+        }
+
+        inline double GetScale() {
+            return this->scale;
+        }
+};
@@ -0,0 +1,94 @@
+#pragma once
+#include "base.hpp"
+#include <array>
+#include <vector>
+
+// Per-frame timing breakdown, so that slow runs can be told apart as source (JS) bound, solver bound or render bound
+// Phase times of the most recent frames are kept in a ring, from which rolling percentiles and per-frame plots are computed
+
+enum class PerfPhase {
+    Psi0Sampling,
+    VSampling,
+    Propagation,
+    Observables,
+    PlotSubmission,
+    Render,
+    // Frame time not spent in any of the above (source evaluation, non-plot UI...)
+    Other,
+
+    Count
+};
+
+constexpr size_t PerfPhaseCount = static_cast<size_t>(PerfPhase::Count);
+
+constexpr const char *PerfPhaseNames[PerfPhaseCount] = {
+    "Ψ0 sampling",
+    "V sampling",
+    "Propagation",
+    "Observables",
+    "Plot submission",
+    "GL render",
+    "Other"
+};
+
+constexpr size_t DefaultPerfFrameCapacity = 240;
+
+struct PerfStats {
+    double p50;
+    double p95;
+    double max;
+};
+
+class PerfMonitor {
+    private:
+        // Ring of frames, each one being PerfPhaseCount phase times (ms)
+        std::vector<double> frame_times;
+        size_t capacity;
+        size_t next_frame;
+        size_t frame_count;
+        std::array<double, PerfPhaseCount> cur_frame;
+
+    public:
+        PerfMonitor(const size_t capacity);
+
+        inline void AddPhaseTime(const PerfPhase phase, const double time_ms) {
+            this->cur_frame[static_cast<size_t>(phase)] += time_ms;
+        }
+
+        // Closes the current frame, where the time not accounted to any phase goes to PerfPhase::Other
+        void EndFrame(const double frame_time_ms);
+
+        inline size_t GetFrameCount() const {
+            return this->frame_count;
+        }
+
+        // Oldest frame first
+        inline double GetPhaseTime(const size_t frame_idx, const PerfPhase phase) const {
+            const auto ring_idx = (this->next_frame + this->capacity - this->frame_count + frame_idx) % this->capacity;
+            return this->frame_times[ring_idx * PerfPhaseCount + static_cast<size_t>(phase)];
+        }
+
+        double GetFrameTime(const size_t frame_idx) const;
+
+        PerfStats ComputePhaseStats(const PerfPhase phase) const;
+        PerfStats ComputeFrameStats() const;
+
+        void Clear();
+};
+
+// Accounts the time spent in its scope to the given phase
+class ScopedPerfTimer {
+    private:
+        PerfMonitor &monitor;
+        PerfPhase phase;
+        double start_time;
+
+    public:
+        ScopedPerfTimer(PerfMonitor &monitor, const PerfPhase phase) : monitor(monitor), phase(phase), start_time(GetCurrentTimeMs()) {}
+        ScopedPerfTimer(const ScopedPerfTimer&) = delete;
+        ScopedPerfTimer &operator=(const ScopedPerfTimer&) = delete;
+
+        ~ScopedPerfTimer() {
+            this->monitor.AddPhaseTime(this->phase, GetCurrentTimeMs() - this->start_time);
+        }
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+
+// Predicts the memory and time per iteration a simulation needs before it runs, so that only runs which would not fit are refused:
+// - Memory is mostly linear in the grid size (Ψ, V, the propagator factorization, FFT plans...) on top of bounded parts (records, Ψ history, spectrum)
+// - Time per iteration is linear in the grid size too (n log n for FFTs), where default costs are scaled by the propagation cost measured on this machine
+
+struct SimulationPlanInput {
+    long dimensions;
+    size_t record_column_count;
+    // Whether V is resampled every iteration, and how (a compiled whole-grid module, otherwise one JS call per sample)
+    bool v_time_dependent;
+    bool v_compiled;
+    // Either for spectral momentum estimates or momentum plots
+    bool uses_fft;
+    bool history_enabled;
+    size_t history_budget;
+    // Propagation time measured on this machine (ms per grid point), 0 if not measured yet
+    double measured_propagation_cost;
+    // Whatever the caller keeps besides the simulator itself (plots, textures...)
+    size_t extra_bytes_per_point;
+    size_t extra_fixed_bytes;
+
+    bool operator==(const SimulationPlanInput&) const = default;
+};
+
+struct SimulationPlan {
+    size_t grid_size;
+    size_t record_size;
+    size_t history_size;
+    size_t extra_size;
+    size_t total_size;
+    // Predicted time per iteration (ms)
+    double step_time;
+};
+
+SimulationPlan PlanSimulation(const SimulationPlanInput &input);
@@ -0,0 +1,91 @@
+#pragma once
+#include "base.hpp"
+#include <algorithm>
+#include <vector>
+
+// History of Ψ over a whole run, compressed so that past frames can be reconstructed later on (for instance, timeline scrubbing):
+// - Ψ components are quantized with a step of 2*tolerance (thus every reconstructed component is within tolerance of the original one)
+// - Frames are grouped in segments starting with a keyframe, followed by (closed-loop) deltas against the previous frame, all of them stored as zigzag varints
+//   (consecutive frames barely differ, so most deltas take a single byte per component)
+// - Once the encoded frames are over the memory budget, every other frame is dropped and the frame stride is doubled (quantized values are re-encoded exactly)
+// - If not even PsiHistoryMinFrameCount frames fit in the budget (huge grids), the history is left empty instead (dropping would double the stride on every push)
+
+constexpr size_t PsiHistoryKeyframeInterval = 32;
+constexpr size_t PsiHistoryMinFrameCount = 4;
+constexpr size_t DefaultPsiHistoryMemoryBudget = 32 * 1024 * 1024;
+constexpr double DefaultPsiHistoryTolerance = 1.0e-4;
+
+class PsiHistory {
+    private:
+        struct Segment {
+            std::vector<uint8_t> data;
+            size_t frame_count;
+        };
+
+        size_t memory_budget;
+        double tolerance;
+        long first_ti;
+        long stride;
+        long n;
+        size_t frame_count;
+        bool over_budget;
+        std::vector<Segment> segments;
+        // Quantized components (interleaved real/imaginary parts) of the last frame, which deltas are computed against
+        std::vector<int64_t> last_q;
+        // Quantized components of the frame being pushed, kept so that pushing does not allocate every time
+        std::vector<int64_t> push_q;
+
+        void EncodeFrame(const std::vector<int64_t> &q);
+        void DecodeFrame(const Segment &segment, size_t &offset, const bool is_keyframe, std::vector<int64_t> &q) const;
+        void DropOddFrames();
+        size_t GetEncodedSize() const;
+
+    public:
+        PsiHistory() : memory_budget(DefaultPsiHistoryMemoryBudget), tolerance(DefaultPsiHistoryTolerance) {
+            this->Clear();
+        }
+
+        // Clears the history, since already stored frames cannot be requantized
+        void Configure(const size_t memory_budget, const double tolerance);
+        void Clear();
+
+        // Only stored if ti is a multiple of the current stride (relative to the first pushed iteration)
+        void Push(const long ti, const CVector &psi_vec);
+        bool Reconstruct(const size_t frame_idx, CVector &out_psi_vec) const;
+
+        // Closest stored frame (at or before ti)
+        inline size_t FindFrame(const long ti) const {
+            if((this->frame_count == 0) || (ti <= this->first_ti)) {
+                return 0;
+            }
+            return std::min(this->frame_count - 1, static_cast<size_t>((ti - this->first_ti) / this->stride));
+        }
+
+        inline long GetFrameIteration(const size_t frame_idx) const {
+            return this->first_ti + static_cast<long>(frame_idx) * this->stride;
+        }
+
+        inline size_t GetFrameCount() const {
+            return this->frame_count;
+        }
+
+        inline long GetStride() const {
+            return this->stride;
+        }
+
+        inline size_t GetMemoryBudget() const {
+            return this->memory_budget;
+        }
+
+        inline double GetTolerance() const {
+            return this->tolerance;
+        }
+
+        // Whether frames are not being stored since too few of them fit in the budget (until cleared or the grid changes)
+        inline bool IsOverBudget() const {
+            return this->over_budget;
+        }
+
+        // Including the scratch frames, which are not counted against the budget
+        size_t GetMemorySize() const;
+};
@@ -1,6 +1,16 @@
 
 #pragma once
 #include "base.hpp"
+#include "table.hpp"
+#include "src_eval.hpp"
+#include "record.hpp"
+#include "psi_history.hpp"
+#include "fft.hpp"
+#include "spectrum.hpp"
+#include "export.hpp"
+#include "checkpoint.hpp"
+#include "cn_kernel.hpp"
+#include "planner.hpp"
 #include "json.hpp"
 
 constexpr size_t CodeStringLength = 10000;
@@ -16,6 +26,36 @@ constexpr double DefaultSpaceStep = 0.02;
 constexpr double DefaultLeftRegionSeparator = 0.0;
 constexpr double DefaultRightRegionSeparator = 0.0;
 
+// Weight of every new sample in the measured propagation cost (see planner.hpp)
+constexpr double PropagationCostSmoothing = 0.05;
+
+// Every record, in the order they are stored in checkpoints and exports
+constexpr const char *RecordColumnNames[] = { "ti", "norm", "x", "x2", "deltax", "p", "p2", "deltap", "deltaprod", "energy", "left_prob", "mid_prob", "right_prob", "left_current", "right_current", "left_flux", "right_flux", "autocorr_re", "autocorr_im" };
+constexpr size_t RecordColumnCount = std::size(RecordColumnNames);
+
+// Ψ0/V source prepared for whole-grid evaluation (see src_eval.hpp), used to sample the whole grid in a single call
+struct CompiledSource {
+    std::string src;
+    // Whether this very source was compiled, thus only needs to be installed again
+    bool compile_ok;
+    // Why the compiled module is not being used, if that is the case
+    std::string error;
+    bool active;
+    // Whether V references its t parameter (conservatively true if the source could not be parsed)
+    bool time_dependent;
+    // Last whole-grid evaluation time (ms), and how many samples were left to single-sample evaluation there
+    double eval_time;
+    long js_sample_count;
+};
+
+// Time (ms) spent in each phase of an iteration
+struct IterationTimings {
+    double psi0_sampling;
+    double v_sampling;
+    double propagation;
+    double observables;
+};
+
 class QuantumSimulator {
     private:
         double t_0;
@@ -30,53 +70,83 @@ class QuantumSimulator {
         CodeString psi0_src;
         bool psi0_src_eval;
         bool psi0_src_ok;
+        std::string psi0_src_error;
         CodeString v_src;
         bool v_src_eval;
         bool v_src_ok;
+        std::string v_src_error;
+        std::unique_ptr<src::Evaluator> evaluator;
+        SampleTableRef psi0_table;
+        InterpolationKind psi0_table_interp;
+        SampleTableRef v_table;
+        InterpolationKind v_table_interp;
+        CompiledSource psi0_compiled;
+        CompiledSource v_compiled;
         long n;
         long cur_ti;
         CVector psi_vec;
+        // Kept for the autocorrelation
+        CVector psi0_vec;
         Vector psisq_vec;
         Vector x_vec;
+        Vector current_vec;
         Vector cur_v_vec;
-        std::vector<double> rec_ti;
-        std::vector<double> rec_norm;
-        std::vector<double> rec_x_est;
-        std::vector<double> rec_x2_est;
-        std::vector<double> rec_deltax;
-        std::vector<double> rec_p_est;
-        std::vector<double> rec_p2_est;
-        std::vector<double> rec_deltap;
-        std::vector<double> rec_deltaprod;
-        std::vector<double> rec_energy_est;
-        std::vector<double> rec_left_prob;
-        std::vector<double> rec_mid_prob;
-        std::vector<double> rec_right_prob;
+        double v_vec_x_0;
+        double v_vec_dx;
+        double v_vec_t;
+        CVector cn_lower;
+        CVector cn_diag;
+        // Q only depends on these besides V (see UpdatePropagatorFactorization)
+        Num cn_r;
+        double cn_dt;
+        long cn_factor_rows;
+        CVector cn_scratch;
+        kernel::PropagationKernels<double> kernels;
+        RecordColumn rec_ti;
+        RecordColumn rec_norm;
+        RecordColumn rec_x_est;
+        RecordColumn rec_x2_est;
+        RecordColumn rec_deltax;
+        RecordColumn rec_p_est;
+        RecordColumn rec_p2_est;
+        RecordColumn rec_deltap;
+        RecordColumn rec_deltaprod;
+        RecordColumn rec_energy_est;
+        RecordColumn rec_left_prob;
+        RecordColumn rec_mid_prob;
+        RecordColumn rec_right_prob;
+        // Probability current at each separator, and its time integral (positive towards increasing x)
+        RecordColumn rec_left_current;
+        RecordColumn rec_right_current;
+        RecordColumn rec_left_flux;
+        RecordColumn rec_right_flux;
+        // C(t) = <Ψ(0)|Ψ(t)>
+        RecordColumn rec_autocorr_re;
+        RecordColumn rec_autocorr_im;
+        EnergySpectrum energy_spectrum;
+        PsiHistory psi_history;
+        bool history_enabled;
+        // Whole-grid source evaluation, otherwise every sample is evaluated on its own (see src_eval.hpp)
+        bool grid_evaluation_enabled;
+        bool spectral_momentum;
+        CVector phi_vec;
+        std::shared_ptr<const FftPlan> fft_plan;
+        std::vector<Num> fft_scratch;
+        std::unique_ptr<SimulationExporter> exporter;
+        long export_snapshot_interval;
+        std::string auto_checkpoint_path;
+        long auto_checkpoint_interval;
+        std::string auto_checkpoint_error;
+        IterationTimings last_timings;
+        // Moving average of the propagation time per grid point (ms), kept across runs for the planner
+        double propagation_point_cost;
 
         inline void UpdateSpaceDimensions() {
             this->n = (long)((x_f - x_0) / dx) + 1;
         }
 
-        inline CMatrix CreateEvolutionMatrix() {
-            CMatrix q_mat = CMatrix::Zero(this->n, this->n);
-
-            const auto hslash2 = pow(this->hslash, 2);
-            const auto dx2 = pow(this->dx, 2);
-            
-            const auto r = I * ((hslash2 * this->dt) / (4 * dx2 * this->m));
-
-            q_mat(0, 0) = 1.0;
-            q_mat(this->n - 1, this->n - 1) = 1.0;
-
-            for(long xi = 1; xi < (this->n - 1); xi++) {
-                const auto v_i = this->cur_v_vec(xi) * ((2*m) / hslash2);
-                q_mat(xi, xi) = 0.5 * (1.0 + r * (2.0 + dx2 * v_i));
-                q_mat(xi, xi - 1) = 0.5 * (-r);
-                q_mat(xi, xi + 1) = 0.5 * (-r);
-            }
-
-            return q_mat.inverse() - CMatrix::Identity(this->n, this->n);
-        }
+        void UpdatePropagatorFactorization();
+        void PropagatePsi();
 
         inline void CreateXDiscreteVector() {
             this->x_vec = Vector::Zero(this->n);
@@ -85,10 +155,29 @@ class QuantumSimulator {
             }
         }
 
+        inline src::EvaluationVariables GetEvaluationVariables() {
+            return { this->hslash, this->m, this->x_0, this->x_f, this->dx, this->t_0, this->dt };
+        }
+
+        void PrepareCompiledSource(CompiledSource &compiled, const char *src, const src::GridFunctionKind kind);
+        bool SamplePsi0();
+        bool SampleV(const long xi_start, const long xi_end, const double t);
+        bool UpdateChangedVSamples(const double t);
         bool CreateCurrentVDiscreteVector();
 
+        void ComputeMomentumTransform();
+        void ComputeSpectralMomentumEstimates(double &out_p_est, double &out_p2_est);
+        // Every record, in the order of RecordColumnNames (as a fixed array, since it is queried every frame too)
+        inline std::array<RecordColumn*, RecordColumnCount> GetRecordColumns() {
+            return { &this->rec_ti, &this->rec_norm, &this->rec_x_est, &this->rec_x2_est, &this->rec_deltax, &this->rec_p_est, &this->rec_p2_est, &this->rec_deltap, &this->rec_deltaprod, &this->rec_energy_est, &this->rec_left_prob, &this->rec_mid_prob, &this->rec_right_prob, &this->rec_left_current, &this->rec_right_current, &this->rec_left_flux, &this->rec_right_flux, &this->rec_autocorr_re, &this->rec_autocorr_im };
+        }
+
+        double InterpolateCurrent(const double x);
         void UpdateVariableRecords();
 
+        // Benchmarks (see cli/bench.cpp) time the internal steps of an iteration separately
+        friend struct SimulationBenchmarkAccess;
+
     public:
         inline double DiscreteT(const long ti) {
             return this->t_0 + ti * this->dt;
@@ -114,112 +203,260 @@ class QuantumSimulator {
             return this->psisq_vec;
         }
 
+        // j(x) = (ħ/m) Im(Ψ* dΨ/dx)
+        inline Vector &GetCurrentProbabilityCurrentDiscreteVector() {
+            return this->current_vec;
+        }
+
         inline std::vector<double> &GetIterationRecord() {
-            return this->rec_ti;
+            return this->rec_ti.GetRecent();
         }
 
+        // Only the recent records are kept raw (thus returned by the record getters)
         inline size_t GetRecordSize() {
-            return this->rec_ti.size();
+            return this->rec_ti.GetRecent().size();
+        }
+
+        inline size_t GetRecordCount() {
+            return this->rec_ti.GetCount();
+        }
+
+        size_t GetRecordMemorySize();
+
+        // Every record, in the order of RecordColumnNames
+        inline std::vector<const RecordColumn*> GetAllRecordColumns() {
+            const auto columns = this->GetRecordColumns();
+            return std::vector<const RecordColumn*>(columns.begin(), columns.end());
         }
 
         inline std::vector<double> &GetPsiNormRecord() {
+            return this->rec_norm.GetRecent();
+        }
+
+        inline const RecordColumn &GetPsiNormRecordColumn() {
             return this->rec_norm;
         }
 
         inline double GetCurrentPsiNorm() {
-            return this->rec_norm.back();
+            return this->rec_norm.Back();
         }
 
         inline std::vector<double> &GetXEstimateRecord() {
+            return this->rec_x_est.GetRecent();
+        }
+
+        inline const RecordColumn &GetXEstimateRecordColumn() {
             return this->rec_x_est;
         }
 
         inline double GetCurrentXEstimateValue() {
-            return this->rec_x_est.back();
+            return this->rec_x_est.Back();
         }
 
         inline std::vector<double> &GetXSquaredEstimateRecord() {
+            return this->rec_x2_est.GetRecent();
+        }
+
+        inline const RecordColumn &GetXSquaredEstimateRecordColumn() {
             return this->rec_x2_est;
         }
         
         inline double GetCurrentXSquaredEstimateValue() {
-            return this->rec_x2_est.back();
+            return this->rec_x2_est.Back();
         }
 
         inline std::vector<double> &GetDeltaXRecord() {
+            return this->rec_deltax.GetRecent();
+        }
+
+        inline const RecordColumn &GetDeltaXRecordColumn() {
             return this->rec_deltax;
         }
 
         inline double GetCurrentDeltaXValue() {
-            return this->rec_deltax.back();
+            return this->rec_deltax.Back();
         }
 
         inline std::vector<double> &GetPEstimateRecord() {
+            return this->rec_p_est.GetRecent();
+        }
+
+        inline const RecordColumn &GetPEstimateRecordColumn() {
             return this->rec_p_est;
         }
 
         inline double GetCurrentPEstimateValue() {
-            return this->rec_p_est.back();
+            return this->rec_p_est.Back();
         }
 
         inline std::vector<double> &GetPSquaredEstimateRecord() {
+            return this->rec_p2_est.GetRecent();
+        }
+
+        inline const RecordColumn &GetPSquaredEstimateRecordColumn() {
             return this->rec_p2_est;
         }
         
         inline double GetCurrentPSquaredEstimateValue() {
-            return this->rec_p2_est.back();
+            return this->rec_p2_est.Back();
         }
 
         inline std::vector<double> &GetDeltaPRecord() {
+            return this->rec_deltap.GetRecent();
+        }
+
+        inline const RecordColumn &GetDeltaPRecordColumn() {
             return this->rec_deltap;
         }
 
         inline double GetCurrentDeltaPValue() {
-            return this->rec_deltap.back();
+            return this->rec_deltap.Back();
         }
 
         inline std::vector<double> &GetDeltaProductRecord() {
+            return this->rec_deltaprod.GetRecent();
+        }
+
+        inline const RecordColumn &GetDeltaProductRecordColumn() {
             return this->rec_deltaprod;
         }
 
         inline double GetCurrentDeltaProductValue() {
-            return this->rec_deltaprod.back();
+            return this->rec_deltaprod.Back();
         }
 
         inline std::vector<double> &GetEnergyEstimateRecord() {
+            return this->rec_energy_est.GetRecent();
+        }
+
+        inline const RecordColumn &GetEnergyEstimateRecordColumn() {
             return this->rec_energy_est;
         }
 
         inline double GetCurrentEnergyEstimateValue() {
-            return this->rec_energy_est.back();
+            return this->rec_energy_est.Back();
         }
 
         inline std::vector<double> &GetLeftRegionProbabilityRecord() {
+            return this->rec_left_prob.GetRecent();
+        }
+
+        inline const RecordColumn &GetLeftRegionProbabilityRecordColumn() {
             return this->rec_left_prob;
         }
 
         inline double GetCurrentLeftRegionProbability() {
-            return this->rec_left_prob.back();
+            return this->rec_left_prob.Back();
         }
 
         inline std::vector<double> &GetMiddleRegionProbabilityRecord() {
+            return this->rec_mid_prob.GetRecent();
+        }
+
+        inline const RecordColumn &GetMiddleRegionProbabilityRecordColumn() {
             return this->rec_mid_prob;
         }
 
         inline double GetCurrentMiddleRegionProbability() {
-            return this->rec_mid_prob.back();
+            return this->rec_mid_prob.Back();
         }
 
         inline std::vector<double> &GetRightRegionProbabilityRecord() {
+            return this->rec_right_prob.GetRecent();
+        }
+
+        inline const RecordColumn &GetRightRegionProbabilityRecordColumn() {
             return this->rec_right_prob;
         }
 
         inline double GetCurrentRightRegionProbability() {
-            return this->rec_right_prob.back();
+            return this->rec_right_prob.Back();
+        }
+
+        // Compressed Ψ of past iterations (see psi_history.hpp)
+        inline PsiHistory &GetPsiHistory() {
+            return this->psi_history;
+        }
+
+        // Headless runs have no use for the history, and skip its (per-iteration) encoding cost
+        inline void UpdateHistoryEnabled(const bool enabled) {
+            this->history_enabled = enabled;
+            if(!enabled) {
+                this->psi_history.Clear();
+            }
+        }
+        inline bool IsHistoryEnabled() {
+            return this->history_enabled;
+        }
+
+        // Only meant to compare both evaluation paths, since single samples are far slower (applies from the next source preparation on)
+        inline void UpdateGridEvaluationEnabled(const bool enabled) {
+            this->grid_evaluation_enabled = enabled;
+        }
+        inline bool IsGridEvaluationEnabled() {
+            return this->grid_evaluation_enabled;
+        }
+
+        // Momentum space density |φ(p)|² (through a FFT of Ψ), with p sorted in increasing order
+        void ComputeMomentumDistribution(Vector &out_p_vec, Vector &out_phisq_vec);
+
+        // Whether <p> and <p²> records come from Ψ's spectrum (more accurate for oscillating Ψ) instead of finite differences
+        inline void UpdateSpectralMomentum(const bool spectral) {
+            this->spectral_momentum = spectral;
+        }
+        inline bool IsSpectralMomentum() {
+            return this->spectral_momentum;
+        }
+
+        inline const RecordColumn &GetLeftSeparatorCurrentRecordColumn() {
+            return this->rec_left_current;
+        }
+
+        inline const RecordColumn &GetRightSeparatorCurrentRecordColumn() {
+            return this->rec_right_current;
+        }
+
+        // Net probability that went (rightwards) through each separator so far (normalized by the Ψ norm), thus for a packet coming from the left:
+        // the reflection coefficient is R = P_left(0) - (left flux), and the transmission coefficient is the right flux
+        // (R is just -(left flux) when the packet starts between the separators)
+        inline const RecordColumn &GetLeftSeparatorFluxRecordColumn() {
+            return this->rec_left_flux;
+        }
+
+        inline double GetCurrentLeftSeparatorFlux() {
+            return this->rec_left_flux.Back();
+        }
+
+        inline const RecordColumn &GetRightSeparatorFluxRecordColumn() {
+            return this->rec_right_flux;
+        }
+
+        inline double GetCurrentRightSeparatorFlux() {
+            return this->rec_right_flux.Back();
+        }
+
+        inline const RecordColumn &GetAutocorrelationRealRecordColumn() {
+            return this->rec_autocorr_re;
+        }
+
+        inline const RecordColumn &GetAutocorrelationImaginaryRecordColumn() {
+            return this->rec_autocorr_im;
+        }
+
+        // Its samples are pushed every iteration, but the spectrum itself is only computed on Update
+        inline EnergySpectrum &GetEnergySpectrum() {
+            return this->energy_spectrum;
         }
 
         bool ComputeNextIteration();
 
+        // Resources the current settings need (see planner.hpp), to which the caller adds whatever it keeps besides the simulator
+        SimulationPlanInput GetPlanInput();
+
+        inline const IterationTimings &GetLastIterationTimings() {
+            return this->last_timings;
+        }
+
         inline void UpdateHslash(const double hslash) {
             this->hslash = hslash;
         }
@@ -293,6 +530,12 @@ class QuantumSimulator {
         inline bool IsPsi0SourceOk() {
             return this->psi0_src_ok;
         }
+        // Evaluates the source (along with the simulation variables) through the platform's evaluator, notifying the result
+        bool EvaluatePsi0Source();
+        // Only set by the evaluator when it knows why the source failed
+        inline const std::string &GetPsi0SourceError() {
+            return this->psi0_src_error;
+        }
 
         inline const char *GetVSource() {
             return this->v_src;
@@ -315,6 +558,53 @@ class QuantumSimulator {
         inline bool IsVSourceOk() {
             return this->v_src_ok;
         }
+        bool EvaluateVSource();
+        inline const std::string &GetVSourceError() {
+            return this->v_src_error;
+        }
+
+        bool LoadPsi0Table(const std::string &path, const InterpolationKind interp, std::string &out_error);
+        inline void ClearPsi0Table() {
+            this->psi0_table = {};
+        }
+        inline bool HasPsi0Table() {
+            return this->psi0_table != nullptr;
+        }
+        inline const SampleTable &GetPsi0Table() {
+            return *this->psi0_table;
+        }
+        inline void UpdatePsi0TableInterpolation(const InterpolationKind interp) {
+            this->psi0_table_interp = interp;
+        }
+        inline InterpolationKind GetPsi0TableInterpolation() {
+            return this->psi0_table_interp;
+        }
+
+        bool LoadVTable(const std::string &path, const InterpolationKind interp, std::string &out_error);
+        inline void ClearVTable() {
+            this->v_table = {};
+            this->cur_v_vec = {};
+        }
+        inline bool HasVTable() {
+            return this->v_table != nullptr;
+        }
+        inline const SampleTable &GetVTable() {
+            return *this->v_table;
+        }
+        inline void UpdateVTableInterpolation(const InterpolationKind interp) {
+            this->v_table_interp = interp;
+            this->cur_v_vec = {};
+        }
+        inline InterpolationKind GetVTableInterpolation() {
+            return this->v_table_interp;
+        }
+
+        inline const CompiledSource &GetCompiledPsi0Source() {
+            return this->psi0_compiled;
+        }
+        inline const CompiledSource &GetCompiledVSource() {
+            return this->v_compiled;
+        }
 
         inline void UpdateLeftRegionSeparator(const double xl) {
             this->left_region_sep = xl;
@@ -338,13 +628,35 @@ class QuantumSimulator {
             return this->cur_ti;
         }
 
+        // Streams records (and Ψ every snapshot_interval iterations, if non-zero) into the given directory, until stopped or reset (see export.hpp)
+        bool StartExport(const std::string &dir, const long snapshot_interval, std::string &out_error);
+        void StopExport();
+        inline SimulationExporter *GetExporter() {
+            return this->exporter.get();
+        }
+
+        // Full simulation state (settings, Ψ, V samples, propagator factorization and records), so that a run can be resumed without recomputing anything
+        bool SaveCheckpoint(const std::string &path, std::string &out_error);
+        // The simulation is reset if the checkpoint cannot be loaded
+        bool LoadCheckpoint(const std::string &path, std::string &out_error);
+
+        // Saves a checkpoint (overwriting the previous one) every interval iterations, disabled if zero
+        inline void UpdateAutoCheckpoint(const std::string &path, const long interval) {
+            this->auto_checkpoint_path = path;
+            this->auto_checkpoint_interval = interval;
+            this->auto_checkpoint_error.clear();
+        }
+        inline const std::string &GetAutoCheckpointError() {
+            return this->auto_checkpoint_error;
+        }
+
         void Reset();
 
         void UpdateAll(const double hslash, const double m, const double t_0, const double dt, const double x_0, const double x_f, const double dx);
-        bool UpdateFromSettings(const nlohmann::json &settings);
+        bool UpdateFromSettings(const nlohmann::json &settings, std::string &out_error);
         nlohmann::json GenerateSettings();
 
-        QuantumSimulator(const double hslash, const double m, const double t_0, const double dt, const double x_0, const double x_f, const double dx) {
+        QuantumSimulator(const double hslash, const double m, const double t_0, const double dt, const double x_0, const double x_f, const double dx) : evaluator(src::CreatePlatformEvaluator()), history_enabled(true), grid_evaluation_enabled(true), spectral_momentum(false), export_snapshot_interval(0), auto_checkpoint_interval(0), last_timings(), propagation_point_cost(0) {
             this->UpdateAll(hslash, m, t_0, dt, x_0, x_f, dx);
             this->Reset();
         }
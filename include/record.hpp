@@ -0,0 +1,99 @@
+#pragma once
+#include "checkpoint.hpp"
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Per-iteration record of a simulation variable, with bounded memory regardless of the simulation length:
+// - The most recent samples are kept raw (and contiguous, so that they can be plotted directly)
+// - Older samples are only kept as min/max/mean summaries of fixed-size blocks, at several levels of increasing block sizes
+//   (each level made of fixed-size chunks, where the finer levels only keep their most recent chunks)
+
+constexpr size_t RecordRecentCount = 4096;
+constexpr size_t RecordLevelCount = 5;
+// Level block sizes: 16, 256, 4096, 65536, 1048576 samples
+constexpr size_t RecordBlockFactor = 16;
+constexpr size_t RecordChunkBlockCount = 1024;
+// Applies to every level but the coarsest one
+constexpr size_t RecordMaxLevelChunkCount = 16;
+
+struct RecordSeries {
+    // Sample index at the center of every block
+    std::vector<double> idx;
+    std::vector<double> min;
+    std::vector<double> max;
+    std::vector<double> mean;
+    size_t block_size;
+
+    inline size_t GetSize() const {
+        return this->idx.size();
+    }
+};
+
+class RecordColumn {
+    private:
+        struct Chunk {
+            std::array<double, RecordChunkBlockCount> min;
+            std::array<double, RecordChunkBlockCount> max;
+            std::array<double, RecordChunkBlockCount> mean;
+            size_t count;
+        };
+
+        struct Level {
+            size_t block_size;
+            std::deque<Chunk> chunks;
+            // Index of the first block still kept (older ones were dropped along with their chunks)
+            size_t first_block;
+            size_t block_count;
+            // Block being currently accumulated
+            double acc_min;
+            double acc_max;
+            double acc_sum;
+            size_t acc_count;
+        };
+
+        std::vector<double> recent;
+        size_t recent_start;
+        size_t count;
+        std::array<Level, RecordLevelCount> levels;
+
+        void PushBlock(const size_t level_idx, const double min, const double max, const double sum, const size_t sample_count);
+
+    public:
+        RecordColumn();
+
+        void Push(const double val);
+        void Clear();
+
+        // Summarizes [start, end) sample indices with at most (about) max_blocks blocks, using the finest level that fits
+        void Query(const size_t start, const size_t end, const size_t max_blocks, RecordSeries &out_series) const;
+        // Same, but merging blocks into (at most) bucket_count equally sized buckets, typically one per plot pixel
+        void QueryBuckets(const size_t start, const size_t end, const size_t bucket_count, RecordSeries &out_series) const;
+
+        inline std::vector<double> &GetRecent() {
+            return this->recent;
+        }
+
+        inline size_t GetRecentStart() const {
+            return this->recent_start;
+        }
+
+        inline double Back() const {
+            return this->recent.back();
+        }
+
+        inline size_t GetCount() const {
+            return this->count;
+        }
+
+        size_t GetMemorySize() const;
+
+        // Upper bound of GetMemorySize() for runs shorter than a whole coarsest level chunk (over 10⁹ samples)
+        static constexpr size_t GetMaxMemorySize() {
+            return 2 * RecordRecentCount * sizeof(double) + ((RecordLevelCount - 1) * RecordMaxLevelChunkCount + 1) * sizeof(Chunk);
+        }
+
+        void Save(CheckpointWriter &writer) const;
+        bool Load(CheckpointReader &reader);
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include "base.hpp"
+
+// Special functions commonly needed for initial states and potentials
+// Every *Grid variant evaluates the function over the whole space grid in a single call
+
+namespace special {
+
+    // Gaussian wave packet centered at x0, with wavenumber k0 and width a (normalized)
+    void GaussianPacketGrid(const Vector &x_vec, const double x0, const double k0, const double a, CVector &out_vec);
+
+    // Discretized Dirac delta: val inside the closed [x0 - dx, x0 + dx] window, zero elsewhere
+    void DiracDeltaGrid(const Vector &x_vec, const double x0, const double val, const double dx, Vector &out_vec);
+
+    // H_n(x), physicists' Hermite polynomials
+    double HermitePolynomial(const int n, const double x);
+    void HermitePolynomialGrid(const int n, const Vector &x_vec, Vector &out_vec);
+
+    // Normalized Hermite functions: h_n(x) = (2^n * n! * sqrt(pi))^(-1/2) * H_n(x) * exp(-x²/2)
+    double HermiteFunction(const int n, const double x);
+    void HermiteFunctionGrid(const int n, const Vector &x_vec, Vector &out_vec);
+
+    // Ai(x), Airy function of the first kind
+    double AiryAi(const double x);
+    void AiryAiGrid(const Vector &x_vec, Vector &out_vec);
+
+    // L_n^alpha(x), generalized Laguerre polynomials
+    double LaguerrePolynomial(const int n, const double alpha, const double x);
+    void LaguerrePolynomialGrid(const int n, const double alpha, const Vector &x_vec, Vector &out_vec);
+
+    // sech((x - x0) / a)
+    void SechGrid(const Vector &x_vec, const double x0, const double a, Vector &out_vec);
+
+    // Bright soliton profile centered at x0, with wavenumber k0 and width a (normalized)
+    void SolitonGrid(const Vector &x_vec, const double x0, const double k0, const double a, CVector &out_vec);
+
+    // Smooth step from 0 to 1 centered at x0 with width w: (1 + tanh((x - x0) / w)) / 2
+    void SmoothStepGrid(const Vector &x_vec, const double x0, const double w, Vector &out_vec);
+
+    // Pöschl–Teller well: -V0 * sech²((x - x0) / a)
+    void PoschlTellerGrid(const Vector &x_vec, const double v0, const double x0, const double a, Vector &out_vec);
+
+    // Morse potential: D * (1 - exp(-a * (x - x0)))²
+    void MorseGrid(const Vector &x_vec, const double d, const double x0, const double a, Vector &out_vec);
+
+    // Optical lattice: V0 * cos²(pi * (x - x0) / d)
+    void CosineLatticeGrid(const Vector &x_vec, const double v0, const double x0, const double d, Vector &out_vec);
+
+    // Kronig–Penney lattice: barriers of height V0 and width b, repeated with period d starting at x0
+    void KronigPenneyGrid(const Vector &x_vec, const double v0, const double x0, const double d, const double b, Vector &out_vec);
+
+}
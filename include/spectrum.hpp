@@ -0,0 +1,68 @@
+#pragma once
+#include "base.hpp"
+#include "checkpoint.hpp"
+#include "record.hpp"
+#include <vector>
+
+// Energy spectrum from the autocorrelation C(t) = <Ψ(0)|Ψ(t)> = Σ |c_n|² e^(-iE_n t/ħ), thus (using C(-t) = C(t)*):
+// S(E) = (1/2πħ) ∫ w(t) C(t) e^(iEt/ħ) dt over [-T, T], with a Hann window w to reduce leakage, peaking at every E_n with area |c_n|²
+// Samples are kept at a stride which doubles (dropping every other sample) whenever AutocorrelationMaxSampleCount is reached,
+// thus the energy resolution keeps improving with the run length, while the highest resolvable energy (πħ / (stride dt), higher ones alias) halves
+
+constexpr size_t AutocorrelationMaxSampleCount = 65536;
+constexpr size_t SpectrumMaxPeakCount = 16;
+
+class EnergySpectrum {
+    private:
+        std::vector<Num> samples;
+        long first_ti;
+        long stride;
+        // Sample count when the spectrum was last computed
+        size_t computed_sample_count;
+        Vector energy_vec;
+        Vector intensity_vec;
+        std::vector<double> peak_energies;
+        std::vector<Num> fft_vec;
+        std::vector<Num> fft_scratch;
+
+    public:
+        EnergySpectrum() {
+            // Samples are decimated once reaching this count, thus pushing never reallocates them
+            this->samples.reserve(AutocorrelationMaxSampleCount);
+            this->Clear();
+        }
+
+        void Clear();
+        // Iterations must be pushed in order, every iteration
+        void Push(const long ti, const Num autocorr);
+
+        // Recomputes the spectrum only after the samples grew enough since the last time, returns whether it was recomputed
+        bool Update(const double hslash, const double dt);
+
+        // Min/max summaries of the spectrum within [e_min, e_max], in (at most) bucket_count buckets (with idx being their center energy)
+        void QueryBuckets(const double e_min, const double e_max, const size_t bucket_count, RecordSeries &out_series) const;
+
+        void Save(CheckpointWriter &writer) const;
+        bool Load(CheckpointReader &reader);
+
+        inline Vector &GetEnergyVector() {
+            return this->energy_vec;
+        }
+
+        inline Vector &GetIntensityVector() {
+            return this->intensity_vec;
+        }
+
+        // Energies of the highest local maxima (in increasing energy order)
+        inline const std::vector<double> &GetPeakEnergies() {
+            return this->peak_energies;
+        }
+
+        inline size_t GetSampleCount() {
+            return this->samples.size();
+        }
+
+        inline long GetStride() {
+            return this->stride;
+        }
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+// Parser for the supported subset of the Ψ0/V source language (plain JS + math.js), shared by the source compilers:
+// - Top level: global assignments ("k = 1;", optionally with var/let/const) and function declarations
+// - Functions: if/else, return, local declarations and assignments
+// - Expressions: numeric literals, identifiers, math.X / Math.X constants and calls, special functions, arithmetic/comparison/logical operators and ternaries
+// Anything outside of it is rejected, in which case sources keep being evaluated by the JS engine
+
+namespace src {
+
+    enum class ExprKind {
+        Number,
+        Identifier,
+        Unary,
+        Binary,
+        Logical,
+        Conditional,
+        Call
+    };
+
+    // Resolved by the parser, so that evaluating an operator does not involve its name
+    enum class Operator {
+        None,
+        // Unary
+        Negate,
+        Plus,
+        Not,
+        // Binary
+        Power,
+        Multiply,
+        Divide,
+        Remainder,
+        Add,
+        Subtract,
+        Less,
+        Greater,
+        LessEqual,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+        // Logical
+        And,
+        Or
+    };
+
+    struct Expr {
+        ExprKind kind;
+        Operator op;
+        double num;
+        // Identifier/callee name (dotted for members like "math.sqrt") or operator
+        std::string name;
+        std::vector<std::unique_ptr<Expr>> args;
+    };
+
+    using ExprRef = std::unique_ptr<Expr>;
+
+    enum class StmtKind {
+        Block,
+        If,
+        Return,
+        Declare,
+        Assign
+    };
+
+    struct Stmt {
+        StmtKind kind;
+        std::string name;
+        ExprRef expr;
+        std::unique_ptr<Stmt> then_stmt;
+        std::unique_ptr<Stmt> else_stmt;
+        std::vector<std::unique_ptr<Stmt>> body;
+    };
+
+    using StmtRef = std::unique_ptr<Stmt>;
+
+    struct Function {
+        std::string name;
+        std::vector<std::string> params;
+        StmtRef body;
+    };
+
+    struct GlobalAssignment {
+        std::string name;
+        ExprRef expr;
+    };
+
+    struct Program {
+        std::vector<GlobalAssignment> globals;
+        std::vector<Function> functions;
+
+        const Function *FindFunction(const std::string &name) const;
+    };
+
+    bool Parse(const char *src, Program &out_program, std::string &out_error);
+
+    // Whether the statement/expression references the given identifier (conservative, shadowing is not taken into account)
+    bool References(const Stmt &stmt, const std::string &name);
+    bool References(const Expr &expr, const std::string &name);
+
+}
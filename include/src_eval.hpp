@@ -0,0 +1,51 @@
+#pragma once
+#include "base.hpp"
+#include "src_wasm.hpp"
+#include <memory>
+
+// Runs the Ψ0/V sources for the simulator, independently of where they are actually evaluated:
+// - Web builds go through the JS engine (sources are plain JS + math.js), with compiled WebAssembly modules for whole-grid evaluation
+// - Native builds interpret the parsed sources directly (see src_interp.hpp), thus only the subset supported by the parser is available
+
+namespace src {
+
+    // Simulation values available as globals to every source
+    struct EvaluationVariables {
+        double hslash;
+        double m;
+        double x0;
+        double xf;
+        double dx;
+        double t0;
+        double dt;
+    };
+
+    class Evaluator {
+        public:
+            virtual ~Evaluator() {}
+
+            // Defines the simulation variables and then the source's globals and functions (sources share the same globals)
+            virtual bool Evaluate(const GridFunctionKind kind, const char *src, const EvaluationVariables &vars, std::string &out_error) = 0;
+
+            // Single samples, false if the function is not properly defined there (exceptions, invalid return types...)
+            virtual bool TryGetPsi0(const double x, Num &out_psi0) = 0;
+            virtual bool TryGetV(const double x, const double t, double &out_v) = 0;
+            // Why the last failed sample failed, if known
+            virtual std::string GetSampleError() {
+                return {};
+            }
+
+            // Prepares the whole-grid function for the (already evaluated) source, only needed whenever the source changes
+            virtual bool CompileGridFunction(const Program &program, const GridFunctionKind kind, std::string &out_error) = 0;
+            // Binds the prepared function to the current globals, thus must be done again whenever they might have changed
+            virtual bool InstallGridFunction(const GridFunctionKind kind, std::string &out_error) = 0;
+
+            // These return -1 on success, the index of the first sample to be evaluated with TryGet*, or -2 if the grid function failed
+            virtual long EvaluatePsi0Grid(const double *x_ptr, const long count, Num *out_ptr) = 0;
+            virtual long EvaluateVGrid(const double *x_ptr, const long count, const double t, double *out_ptr) = 0;
+    };
+
+    // JS engine in web builds, the native interpreter otherwise
+    std::unique_ptr<Evaluator> CreatePlatformEvaluator();
+
+}
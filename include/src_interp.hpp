@@ -0,0 +1,69 @@
+#pragma once
+#include "src_eval.hpp"
+#include <map>
+#include <optional>
+
+// Native source evaluation, interpreting the parsed sources (see src_ast.hpp) directly
+// Semantics follow the compiled modules (see src_wasm.cpp), except that nothing is left to a JS engine:
+// - math.js functions return complex values outside of their real domain (math.sqrt(-1) is i), like math.js itself
+// - Sources may call their own functions and the other source's ones, since JS evaluates both in the same global scope (their own ones take precedence)
+// Operators, identifiers and calls are resolved right after evaluating the sources, thus sampling never looks anything up by name
+// Anything the parser does not support (or a runtime error, like using an undefined global) makes the source fail
+
+namespace src {
+
+    enum class ValueKind {
+        Bool,
+        Real,
+        Complex
+    };
+
+    // Booleans are stored as 0/1 and reals with a zero imaginary part, so that conversions are trivial
+    struct Value {
+        ValueKind kind;
+        Num num;
+    };
+
+    using GlobalMap = std::map<std::string, Value>;
+
+    // Function bodies with everything resolved (see src_interp.cpp)
+    struct ResolvedFunction;
+
+    class NativeEvaluator : public Evaluator {
+        private:
+            Program psi0_program;
+            Program v_program;
+            const Function *psi0_fn;
+            const Function *v_fn;
+            // Shared by both sources, like JS globals
+            GlobalMap globals;
+            std::vector<std::unique_ptr<ResolvedFunction>> resolved_fns;
+            const ResolvedFunction *resolved_psi0_fn;
+            const ResolvedFunction *resolved_v_fn;
+            // Locals of the functions being called, unbound ones being empty (kept across samples to avoid allocating them every time)
+            std::vector<std::optional<Value>> locals_stack;
+            std::string sample_error;
+
+            void ResolveFunctions();
+
+        public:
+            NativeEvaluator();
+            ~NativeEvaluator() override;
+
+            bool Evaluate(const GridFunctionKind kind, const char *src, const EvaluationVariables &vars, std::string &out_error) override;
+
+            bool TryGetPsi0(const double x, Num &out_psi0) override;
+            bool TryGetV(const double x, const double t, double &out_v) override;
+            std::string GetSampleError() override {
+                return this->sample_error;
+            }
+
+            // Sources are interpreted as they are, thus there is nothing to compile
+            bool CompileGridFunction(const Program &program, const GridFunctionKind kind, std::string &out_error) override;
+            bool InstallGridFunction(const GridFunctionKind kind, std::string &out_error) override;
+
+            long EvaluatePsi0Grid(const double *x_ptr, const long count, Num *out_ptr) override;
+            long EvaluateVGrid(const double *x_ptr, const long count, const double t, double *out_ptr) override;
+    };
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "src_ast.hpp"
+#include <cstdint>
+
+// Compiles Ψ0/V source functions into small WebAssembly modules evaluating the whole grid in a single call,
+// working directly on the simulator's vectors in linear memory (thus no per-sample JS calls nor math.js boxing)
+
+namespace src {
+
+    enum class GridFunctionKind {
+        Psi0,
+        V
+    };
+
+    struct WasmMemoryImport {
+        bool shared;
+        uint32_t max_pages;
+    };
+
+    // The module imports:
+    // - "env"."memory": the main module's memory
+    // - "Math".X / "math".X: JS builtin and math.js functions
+    // - "op".X: JS operators without an exact wasm equivalent ("rem": a % b)
+    // - "window".X: global variables (as immutable f64 globals) and JS special functions, resolved at instantiation time
+    // It exports a "run" function:
+    // - Ψ0: run(x_ptr: i32, count: i32, out_ptr: i32) -> i32, writing complex values (interleaved real/imaginary parts)
+    // - V: run(x_ptr: i32, count: i32, t: f64, out_ptr: i32) -> i32, writing real values
+    // which returns -1 on success, or the index of the first sample the module cannot evaluate (math.js would return a complex value
+    // from a real function, the function ends without returning, V is not finite...) so that the caller can fall back to the JS engine
+    bool GenerateWasmGridModule(const Program &program, const GridFunctionKind kind, const WasmMemoryImport &mem_import, std::vector<uint8_t> &out_module, std::string &out_error);
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "base.hpp"
+#include <memory>
+
+// Tabulated samples of V or Ψ0 (typically produced by other solvers or measurements), loaded from:
+// - Binary files: SampleTableHeader followed by the x column, the real part column and (if complex) the imaginary part column, all as little-endian doubles
+// - CSV files: one "x,re" or "x,re,im" row per sample, lines starting with '#' (and non-numeric header lines) are ignored
+// In both cases x values must be strictly ascending
+
+constexpr char SampleTableMagic[4] = { 'Q', 'T', 'A', 'B' };
+constexpr uint32_t SampleTableVersion = 1;
+
+struct SampleTableHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t column_count;
+    uint32_t reserved;
+    uint64_t sample_count;
+    uint64_t reserved_2;
+};
+static_assert(sizeof(SampleTableHeader) == 32);
+
+enum class InterpolationKind {
+    Linear,
+    Cubic
+};
+
+constexpr const char *InterpolationKindNames[] = {
+    "linear",
+    "cubic"
+};
+
+bool ParseInterpolationKind(const std::string &name, InterpolationKind &out_kind);
+
+class SampleTable {
+    private:
+        std::string path;
+        uint64_t hash;
+        size_t count;
+        bool is_complex;
+        std::vector<double> owned_data;
+        const double *x_data;
+        const double *re_data;
+        const double *im_data;
+        void *map_addr;
+        size_t map_size;
+
+        bool LoadBinary(const uint8_t *data, const size_t data_size, const bool can_reference, std::string &out_error);
+        bool LoadCsv(const char *data, const size_t data_size, std::string &out_error);
+        void ResampleColumn(const double *y_data, const Vector &x_vec, const InterpolationKind interp, const bool zero_outside, Vector &out_vec) const;
+        void Unmap();
+
+    public:
+        SampleTable() : hash(0), count(0), is_complex(false), x_data(nullptr), re_data(nullptr), im_data(nullptr), map_addr(nullptr), map_size(0) {}
+        SampleTable(const SampleTable&) = delete;
+        SampleTable &operator=(const SampleTable&) = delete;
+
+        ~SampleTable() {
+            this->Unmap();
+        }
+
+        bool Load(const std::string &path, std::string &out_error);
+
+        // Values outside the tabulated x range are either the closest edge value or zero
+        void Resample(const Vector &x_vec, const InterpolationKind interp, const bool zero_outside, Vector &out_vec) const;
+        void Resample(const Vector &x_vec, const InterpolationKind interp, const bool zero_outside, CVector &out_vec) const;
+
+        inline const std::string &GetPath() const {
+            return this->path;
+        }
+
+        inline uint64_t GetHash() const {
+            return this->hash;
+        }
+
+        std::string GetHashString() const;
+
+        inline size_t GetSampleCount() const {
+            return this->count;
+        }
+
+        inline bool IsComplex() const {
+            return this->is_complex;
+        }
+};
+
+using SampleTableRef = std::shared_ptr<const SampleTable>;
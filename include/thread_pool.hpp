@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads are available natively, and in WASM only when built with pthreads
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define _THREAD_POOL_THREADED 1
+#else
+#define _THREAD_POOL_THREADED 0
+#endif
+
+// Fixed set of worker threads running parallel loops, where the calling thread also takes part
+// Iterations are handed out one at a time, so that uneven iteration costs are still balanced
+class ThreadPool {
+    public:
+        // Called with the iteration index, and the index of the thread running it (in [0, GetThreadCount()), 0 being the calling thread)
+        using LoopFunction = std::function<void(const size_t idx, const size_t thread_idx)>;
+
+    private:
+        std::vector<std::thread> workers;
+        std::mutex lock;
+        std::condition_variable start_cv;
+        std::condition_variable done_cv;
+        const LoopFunction *cur_fn;
+        size_t cur_count;
+        std::atomic_size_t next_idx;
+        size_t generation;
+        size_t busy_worker_count;
+        bool stopping;
+
+        void RunLoop(const size_t thread_idx);
+        void WorkerMain(const size_t thread_idx);
+
+    public:
+        // Zero workers means every loop runs in the calling thread
+        ThreadPool(const size_t worker_count);
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool &operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        // Not reentrant: fn must not call ParallelFor itself
+        void ParallelFor(const size_t count, const LoopFunction &fn);
+
+        inline size_t GetThreadCount() const {
+            return this->workers.size() + 1;
+        }
+};
+
+// Shared pool with a worker per extra hardware thread
+ThreadPool &GetThreadPool();
@@ -0,0 +1,66 @@
+#pragma once
+#include "base.hpp"
+#include <atomic>
+
+// Timeline tracing (frames, iterations and their phases, JS bridge calls), exported as Chrome trace event JSON (chrome://tracing, Perfetto)
+// Events go to a fixed-size ring, overwriting the oldest ones, and recording is disabled by default:
+// trace points then cost a single branch, and building with QUANTIZE_TRACING=0 removes them altogether
+
+#ifndef QUANTIZE_TRACING
+#define QUANTIZE_TRACING 1
+#endif
+
+namespace trace {
+
+    constexpr size_t EventCapacity = 1 << 16;
+
+    extern std::atomic_bool g_Enabled;
+
+    inline bool IsEnabled() {
+        return g_Enabled.load(std::memory_order_acquire);
+    }
+
+    // The ring is only allocated once first enabled
+    void SetEnabled(const bool enabled);
+    void Clear();
+    size_t GetEventCount();
+
+    // The name must outlive the trace (string literals, typically), since only its pointer is kept
+    void RecordEvent(const char *name, const double start_time_ms, const double end_time_ms);
+
+    bool SaveJson(const std::string &path, std::string &out_error);
+
+    class ScopedEvent {
+        private:
+            const char *name;
+            double start_time;
+
+        public:
+            ScopedEvent(const char *name) : name(name), start_time(IsEnabled() ? GetCurrentTimeMs() : -1.0) {}
+            ScopedEvent(const ScopedEvent&) = delete;
+            ScopedEvent &operator=(const ScopedEvent&) = delete;
+
+            ~ScopedEvent() {
+                if(this->start_time >= 0.0) {
+                    RecordEvent(this->name, this->start_time, GetCurrentTimeMs());
+                }
+            }
+    };
+
+}
+
+#if QUANTIZE_TRACING
+#define _TRACE_SCOPE(name) trace::ScopedEvent _trace_scope(name)
+#define _TRACE_EVENT(name, start_time_ms, end_time_ms) { \
+    if(trace::IsEnabled()) { \
+        trace::RecordEvent(name, start_time_ms, end_time_ms); \
+    } \
+}
+#else
+#define _TRACE_SCOPE(name)
+#define _TRACE_EVENT(name, start_time_ms, end_time_ms) { \
+    (void)(name); \
+    (void)(start_time_ms); \
+    (void)(end_time_ms); \
+}
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+#include "base.hpp"
+#include <vector>
+
+// Wigner quasi-probability distribution: W(x, p) = (1/πħ) ∫ Ψ*(x - y) Ψ(x + y) e^(-2ipy/ħ) dy
+// Every x sample (row) is a FFT over the lag y, thus rows are computed in parallel (see thread_pool.hpp)
+// Both directions can be downsampled: x samples are a subset of the grid, and fewer lags mean a coarser (but equally wide) p range
+
+constexpr size_t DefaultWignerRowCount = 256;
+constexpr size_t DefaultWignerMomentumCount = 256;
+
+class WignerDistribution {
+    private:
+        size_t row_count;
+        size_t momentum_count;
+        // momentum_count rows (decreasing p) of row_count values (increasing x), as heatmaps are drawn
+        std::vector<double> values;
+        double x_0;
+        double x_f;
+        double p_max;
+        double max_abs_value;
+        // Per thread, so that no allocations happen after the first computation
+        std::vector<std::vector<Num>> thread_buffers;
+        std::vector<std::vector<Num>> thread_scratches;
+
+    public:
+        WignerDistribution() : row_count(0), momentum_count(0), x_0(0), x_f(0), p_max(0), max_abs_value(0) {}
+
+        // momentum_count must be a power of two (the FFT size)
+        void Compute(const CVector &psi_vec, const double x_0, const double dx, const double hslash, const size_t row_count, const size_t momentum_count);
+
+        inline const double *GetValues() const {
+            return this->values.data();
+        }
+
+        inline size_t GetRowCount() const {
+            return this->row_count;
+        }
+
+        inline size_t GetMomentumCount() const {
+            return this->momentum_count;
+        }
+
+        inline double GetSpaceStart() const {
+            return this->x_0;
+        }
+
+        inline double GetSpaceEnd() const {
+            return this->x_f;
+        }
+
+        // p goes from -GetMomentumMax() to GetMomentumMax()
+        inline double GetMomentumMax() const {
+            return this->p_max;
+        }
+
+        inline double GetMaxAbsValue() const {
+            return this->max_abs_value;
+        }
+};
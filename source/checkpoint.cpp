@@ -0,0 +1,92 @@
+#include "checkpoint.hpp"
+#include "base.hpp"
+#include <cstdio>
+#include <fstream>
+
+bool WriteCheckpointFile(const std::string &path, const CheckpointSections &sections, std::string &out_error) {
+    const auto tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary);
+        if(!file) {
+            out_error = "unable to create checkpoint file '" + tmp_path + "'";
+            return false;
+        }
+
+        CheckpointHeader header = {};
+        memcpy(header.magic, CheckpointMagic, sizeof(header.magic));
+        header.version = CheckpointVersion;
+        header.section_count = sections.size();
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        for(const auto &[tag, data]: sections) {
+            CheckpointSectionHeader section_header = {};
+            section_header.tag = tag;
+            section_header.size = data.size();
+            section_header.hash = HashFnv1a(data.data(), data.size());
+            file.write(reinterpret_cast<const char*>(&section_header), sizeof(section_header));
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        }
+
+        if(!file) {
+            out_error = "unable to write checkpoint file '" + tmp_path + "'";
+            return false;
+        }
+    }
+
+    if(rename(tmp_path.c_str(), path.c_str()) != 0) {
+        out_error = "unable to move checkpoint file into '" + path + "'";
+        return false;
+    }
+    return true;
+}
+
+bool ReadCheckpointFile(const std::string &path, CheckpointSections &out_sections, std::string &out_error) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file) {
+        out_error = "unable to open checkpoint file '" + path + "'";
+        return false;
+    }
+
+    // Section sizes are checked against what is left in the file before allocating their payloads, in case they are corrupted
+    file.seekg(0, std::ios::end);
+    const auto file_size = static_cast<uint64_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+
+    CheckpointHeader header;
+    if(!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || (memcmp(header.magic, CheckpointMagic, sizeof(header.magic)) != 0)) {
+        out_error = "not a checkpoint file";
+        return false;
+    }
+    if(header.version != CheckpointVersion) {
+        out_error = "unsupported checkpoint version " + std::to_string(header.version);
+        return false;
+    }
+
+    out_sections.clear();
+    for(uint32_t i = 0; i < header.section_count; i++) {
+        CheckpointSectionHeader section_header;
+        if(!file.read(reinterpret_cast<char*>(&section_header), sizeof(section_header))) {
+            out_error = "checkpoint file is truncated";
+            return false;
+        }
+
+        if(section_header.size > (file_size - static_cast<uint64_t>(file.tellg()))) {
+            out_error = "truncated checkpoint section";
+            return false;
+        }
+
+        std::vector<uint8_t> data(section_header.size);
+        if(!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+            out_error = "checkpoint file is truncated";
+            return false;
+        }
+        if(HashFnv1a(data.data(), data.size()) != section_header.hash) {
+            out_error = "checkpoint section " + std::to_string(static_cast<uint32_t>(section_header.tag)) + " is corrupted (checksum mismatch)";
+            return false;
+        }
+
+        out_sections[section_header.tag] = std::move(data);
+    }
+
+    return true;
+}
@@ -0,0 +1,238 @@
+#include "export.hpp"
+#include <filesystem>
+#include <fstream>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define _EXPORT_THREADED 1
+#else
+#define _EXPORT_THREADED 0
+#endif
+
+namespace {
+
+    void BuildNpyHeader(const std::string &descr, const std::vector<size_t> &shape, std::string &out_header) {
+        std::string shape_str = "(";
+        for(const auto dim: shape) {
+            shape_str += std::to_string(dim) + ",";
+        }
+        if(shape.size() > 1) {
+            // Only 1-element tuples need the trailing comma
+            shape_str.pop_back();
+        }
+        shape_str += ")";
+
+        auto dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': " + shape_str + ", }";
+
+        // Magic (6) + version (2) + header length (2) + dict, padded with spaces and ended with a newline to a 64-byte multiple
+        constexpr size_t PreambleSize = 10;
+        const auto total_size = ((PreambleSize + dict.length() + 1 + 63) / 64) * 64;
+        dict.append(total_size - PreambleSize - dict.length() - 1, ' ');
+        dict += '\n';
+
+        const auto dict_len = static_cast<uint16_t>(dict.length());
+        out_header = "\x93NUMPY";
+        out_header += static_cast<char>(1);
+        out_header += static_cast<char>(0);
+        out_header += static_cast<char>(dict_len & 0xff);
+        out_header += static_cast<char>(dict_len >> 8);
+        out_header += dict;
+    }
+
+}
+
+bool SimulationExporter::Start(const std::string &dir, const nlohmann::json &header, const size_t column_count, std::string &out_error) {
+    this->Stop();
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir + "/records", ec);
+    if(!ec) {
+        std::filesystem::create_directories(dir + "/psi", ec);
+    }
+    if(ec) {
+        out_error = "unable to create export directory '" + dir + "': " + ec.message();
+        return false;
+    }
+
+    std::ofstream header_file(dir + "/header.json");
+    if(!header_file) {
+        out_error = "unable to write export header in '" + dir + "'";
+        return false;
+    }
+    header_file << header.dump(4);
+    header_file.close();
+
+    this->dir = dir;
+    this->column_count = column_count;
+    this->chunk.assign(column_count * RecordExportChunkRows, 0.0);
+    this->chunk_rows = 0;
+    this->chunk_idx = 0;
+    this->pending_size = 0;
+    this->stopping = false;
+    this->skipped_snapshot_count = 0;
+    this->error.clear();
+
+    #if _EXPORT_THREADED
+    this->writer_thread = std::thread(&SimulationExporter::WriterMain, this);
+    #endif
+    return true;
+}
+
+void SimulationExporter::Stop() {
+    if(this->dir.empty()) {
+        return;
+    }
+
+    this->FlushChunk();
+
+    #if _EXPORT_THREADED
+    {
+        std::scoped_lock lk(this->jobs_lock);
+        this->stopping = true;
+    }
+    this->jobs_cv.notify_all();
+    if(this->writer_thread.joinable()) {
+        this->writer_thread.join();
+    }
+    #endif
+
+    this->dir.clear();
+}
+
+void SimulationExporter::PushRow(const double *vals) {
+    if(this->dir.empty()) {
+        return;
+    }
+
+    // Columnar layout: every column is contiguous within the chunk
+    for(size_t i = 0; i < this->column_count; i++) {
+        this->chunk[i * RecordExportChunkRows + this->chunk_rows] = vals[i];
+    }
+    this->chunk_rows++;
+    if(this->chunk_rows == RecordExportChunkRows) {
+        this->FlushChunk();
+    }
+}
+
+void SimulationExporter::PushSnapshot(const long ti, const CVector &psi_vec) {
+    if(this->dir.empty()) {
+        return;
+    }
+
+    char name[64] = {};
+    snprintf(name, sizeof(name), "/psi/iter_%010ld.npy", ti);
+
+    WriteJob job = {};
+    job.path = this->dir + name;
+    job.descr = "<c16";
+    job.shape = { static_cast<size_t>(psi_vec.size()) };
+    const auto psi_data = reinterpret_cast<const double*>(psi_vec.data());
+    job.data.assign(psi_data, psi_data + 2 * psi_vec.size());
+    if(!this->Enqueue(std::move(job), true)) {
+        this->skipped_snapshot_count++;
+    }
+}
+
+void SimulationExporter::FlushChunk() {
+    if(this->chunk_rows == 0) {
+        return;
+    }
+
+    char name[64] = {};
+    snprintf(name, sizeof(name), "/records/chunk_%06zu.npy", this->chunk_idx);
+
+    WriteJob job = {};
+    job.path = this->dir + name;
+    job.descr = "<f8";
+    job.shape = { this->column_count, this->chunk_rows };
+    job.data.reserve(this->column_count * this->chunk_rows);
+    for(size_t i = 0; i < this->column_count; i++) {
+        const auto col = this->chunk.data() + i * RecordExportChunkRows;
+        job.data.insert(job.data.end(), col, col + this->chunk_rows);
+    }
+    this->Enqueue(std::move(job), false);
+
+    this->chunk_rows = 0;
+    this->chunk_idx++;
+}
+
+bool SimulationExporter::Enqueue(WriteJob &&job, const bool can_skip) {
+    #if _EXPORT_THREADED
+    const auto job_size = job.data.size() * sizeof(double);
+    {
+        std::unique_lock lk(this->jobs_lock);
+        // A single job is always accepted when nothing is pending, however large it is
+        const auto has_room = [&]() {
+            return (this->pending_size == 0) || ((this->pending_size + job_size) <= ExportMaxPendingSize);
+        };
+        if(!has_room()) {
+            if(can_skip) {
+                return false;
+            }
+            this->room_cv.wait(lk, has_room);
+        }
+        this->pending_size += job_size;
+        this->jobs.push_back(std::move(job));
+    }
+    this->jobs_cv.notify_one();
+    #else
+    this->WriteJobFile(job);
+    #endif
+    return true;
+}
+
+bool SimulationExporter::WriteJobFile(const WriteJob &job) {
+    std::string header;
+    BuildNpyHeader(job.descr, job.shape, header);
+
+    const auto tmp_path = job.path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary);
+        file.write(header.data(), header.size());
+        file.write(reinterpret_cast<const char*>(job.data.data()), job.data.size() * sizeof(double));
+        if(!file) {
+            std::scoped_lock lk(this->jobs_lock);
+            this->error = "unable to write '" + tmp_path + "'";
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, job.path, ec);
+    if(ec) {
+        std::scoped_lock lk(this->jobs_lock);
+        this->error = "unable to rename '" + tmp_path + "': " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+void SimulationExporter::WriterMain() {
+    while(true) {
+        WriteJob job;
+        {
+            std::unique_lock lk(this->jobs_lock);
+            this->jobs_cv.wait(lk, [&]() {
+                return this->stopping || !this->jobs.empty();
+            });
+            if(this->jobs.empty()) {
+                // Only reached when stopping, with every job already written
+                return;
+            }
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+
+        this->WriteJobFile(job);
+
+        {
+            std::scoped_lock lk(this->jobs_lock);
+            this->pending_size -= job.data.size() * sizeof(double);
+        }
+        this->room_cv.notify_all();
+    }
+}
+
+std::string SimulationExporter::GetError() {
+    std::scoped_lock lk(this->jobs_lock);
+    return this->error;
+}
@@ -0,0 +1,131 @@
+#include "fft.hpp"
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace {
+
+    constexpr size_t MaxCachedFftPlanCount = 4;
+
+    std::mutex g_FftPlansLock;
+    std::map<size_t, std::shared_ptr<const FftPlan>> g_FftPlans;
+
+}
+
+FftPlan::FftPlan(const size_t n) : n(n) {
+    const auto is_pow2 = (n & (n - 1)) == 0;
+    this->m = 1;
+    while(this->m < (is_pow2 ? n : (2 * n - 1))) {
+        this->m <<= 1;
+    }
+
+    this->twiddles.resize(this->m / 2);
+    for(size_t i = 0; i < this->twiddles.size(); i++) {
+        this->twiddles[i] = std::polar(1.0, -2.0 * M_PI * i / this->m);
+    }
+
+    size_t log_m = 0;
+    while((static_cast<size_t>(1) << log_m) < this->m) {
+        log_m++;
+    }
+    this->bit_reversal.resize(this->m);
+    for(size_t i = 0; i < this->m; i++) {
+        uint32_t rev = 0;
+        for(size_t b = 0; b < log_m; b++) {
+            rev |= ((i >> b) & 1) << (log_m - 1 - b);
+        }
+        this->bit_reversal[i] = rev;
+    }
+
+    if(!is_pow2) {
+        this->chirp.resize(n);
+        for(size_t j = 0; j < n; j++) {
+            // j² mod 2n keeps the angle accurate for large j
+            const auto j2 = (static_cast<unsigned long long>(j) * j) % (2 * n);
+            this->chirp[j] = std::polar(1.0, -M_PI * j2 / n);
+        }
+
+        this->chirp_fft.assign(this->m, 0.0);
+        this->chirp_fft[0] = std::conj(this->chirp[0]);
+        for(size_t j = 1; j < n; j++) {
+            this->chirp_fft[j] = std::conj(this->chirp[j]);
+            this->chirp_fft[this->m - j] = std::conj(this->chirp[j]);
+        }
+        this->Radix2(this->chirp_fft.data(), false);
+    }
+}
+
+void FftPlan::Radix2(Num *data, const bool inverse) const {
+    for(size_t i = 0; i < this->m; i++) {
+        const auto j = this->bit_reversal[i];
+        if(i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    for(size_t len = 2; len <= this->m; len <<= 1) {
+        const auto half = len / 2;
+        const auto tw_step = this->m / len;
+        for(size_t i = 0; i < this->m; i += len) {
+            for(size_t k = 0; k < half; k++) {
+                const auto tw = inverse ? std::conj(this->twiddles[k * tw_step]) : this->twiddles[k * tw_step];
+                const auto u = data[i + k];
+                const auto v = data[i + k + half] * tw;
+                data[i + k] = u + v;
+                data[i + k + half] = u - v;
+            }
+        }
+    }
+}
+
+void FftPlan::Forward(const Num *in, Num *out, std::vector<Num> &scratch) const {
+    if(this->chirp.empty()) {
+        if(in != out) {
+            std::copy(in, in + this->n, out);
+        }
+        this->Radix2(out, false);
+        return;
+    }
+
+    scratch.resize(this->m);
+    for(size_t j = 0; j < this->n; j++) {
+        scratch[j] = in[j] * this->chirp[j];
+    }
+    std::fill(scratch.begin() + this->n, scratch.end(), 0.0);
+
+    this->Radix2(scratch.data(), false);
+    for(size_t i = 0; i < this->m; i++) {
+        scratch[i] *= this->chirp_fft[i];
+    }
+    this->Radix2(scratch.data(), true);
+
+    const auto inv_m = 1.0 / this->m;
+    for(size_t k = 0; k < this->n; k++) {
+        out[k] = scratch[k] * this->chirp[k] * inv_m;
+    }
+}
+
+void FftPlan::Inverse(const Num *in, Num *out, std::vector<Num> &scratch) const {
+    // x_j = (1/n) conj(FFT(conj(X)))_j
+    for(size_t k = 0; k < this->n; k++) {
+        out[k] = std::conj(in[k]);
+    }
+    this->Forward(out, out, scratch);
+
+    const auto inv_n = 1.0 / this->n;
+    for(size_t j = 0; j < this->n; j++) {
+        out[j] = std::conj(out[j]) * inv_n;
+    }
+}
+
+std::shared_ptr<const FftPlan> GetFftPlan(const size_t n) {
+    std::scoped_lock lk(g_FftPlansLock);
+    auto it = g_FftPlans.find(n);
+    if(it == g_FftPlans.end()) {
+        if(g_FftPlans.size() >= MaxCachedFftPlanCount) {
+            g_FftPlans.clear();
+        }
+        it = g_FftPlans.emplace(n, std::make_shared<const FftPlan>(n)).first;
+    }
+    return it->second;
+}
@@ -0,0 +1,141 @@
+#include "heatmap.hpp"
+#include <implot.h>
+#include <algorithm>
+
+void SpaceTimeHeatmap::Clear() {
+    this->width = 0;
+    this->n = 0;
+    this->next_row = 0;
+    this->row_count = 0;
+    this->last_ti = -1;
+    this->scale = 0;
+    this->rows.clear();
+    this->row_tis.clear();
+}
+
+void SpaceTimeHeatmap::ColorizeRow(const int row, uint32_t *out_pixels) {
+    if(this->colormap.empty()) {
+        // Sampled once (and lazily, since an ImPlot context is needed)
+        constexpr size_t ColormapSize = 256;
+        for(size_t i = 0; i < ColormapSize; i++) {
+            const auto color = ImPlot::SampleColormap(static_cast<float>(i) / (ColormapSize - 1), ImPlotColormap_Viridis);
+            this->colormap.push_back(ImGui::ColorConvertFloat4ToU32(color));
+        }
+    }
+
+    const auto max_val = this->scale * this->saturation;
+    const auto row_vals = this->rows.data() + static_cast<size_t>(row) * this->width;
+    for(int i = 0; i < this->width; i++) {
+        const auto t = (max_val > 0) ? std::clamp(row_vals[i] / max_val, 0.0, 1.0) : 0.0;
+        out_pixels[i] = this->colormap[static_cast<size_t>(t * (this->colormap.size() - 1))];
+    }
+}
+
+void SpaceTimeHeatmap::UploadRows(const int row_start, const int row_end) {
+    const auto row_span = row_end - row_start;
+    this->pixels.resize(static_cast<size_t>(row_span) * this->width);
+    for(int row = row_start; row < row_end; row++) {
+        this->ColorizeRow(row, this->pixels.data() + static_cast<size_t>(row - row_start) * this->width);
+    }
+
+    GLint prev_texture = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &prev_texture);
+    glBindTexture(GL_TEXTURE_2D, this->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row_start, this->width, row_span, GL_RGBA, GL_UNSIGNED_BYTE, this->pixels.data());
+    glBindTexture(GL_TEXTURE_2D, prev_texture);
+}
+
+void SpaceTimeHeatmap::Push(const long ti, const Vector &psisq_vec) {
+    if(ti == this->last_ti) {
+        return;
+    }
+    if((ti < this->last_ti) || (psisq_vec.size() != this->n)) {
+        this->Clear();
+    }
+    this->last_ti = ti;
+    if((ti % this->stride) != 0) {
+        return;
+    }
+
+    if(this->width == 0) {
+        const auto width = static_cast<int>(std::min<long>(psisq_vec.size(), HeatmapMaxWidth));
+        if(width == 0) {
+            return;
+        }
+
+        this->n = psisq_vec.size();
+        this->rows.assign(static_cast<size_t>(width) * HeatmapRowCount, 0.0f);
+        this->row_tis.assign(HeatmapRowCount, 0);
+        // Initial peak as reference, so that decays/revivals are visible
+        this->scale = psisq_vec.maxCoeff();
+
+        GLint prev_texture = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &prev_texture);
+        if(this->texture == 0) {
+            glGenTextures(1, &this->texture);
+            glBindTexture(GL_TEXTURE_2D, this->texture);
+            // Linear filtering would blend rows across the ring seam
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        // (Re)allocated once per run, rows are only uploaded one at a time from here on
+        glBindTexture(GL_TEXTURE_2D, this->texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, HeatmapRowCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, prev_texture);
+        this->width = width;
+    }
+
+    auto row_vals = this->rows.data() + static_cast<size_t>(this->next_row) * this->width;
+    for(int i = 0; i < this->width; i++) {
+        const auto xi_start = (static_cast<long>(i) * this->n) / this->width;
+        const auto xi_end = std::max(xi_start + 1, (static_cast<long>(i + 1) * this->n) / this->width);
+        row_vals[i] = static_cast<float>(psisq_vec.segment(xi_start, xi_end - xi_start).maxCoeff());
+    }
+    this->row_tis.at(this->next_row) = ti;
+
+    this->UploadRows(this->next_row, this->next_row + 1);
+    this->next_row = (this->next_row + 1) % HeatmapRowCount;
+    this->row_count = std::min(this->row_count + 1, HeatmapRowCount);
+}
+
+void SpaceTimeHeatmap::Plot(const char *label, const double x_0, const double x_f) {
+    if(this->row_count == 0) {
+        return;
+    }
+
+    // Once the ring is full, the oldest row is the next one to be overwritten, thus the image is drawn in (up to) two pieces
+    const auto draw_rows = [&](const int row_start, const int row_end) {
+        if(row_start >= row_end) {
+            return;
+        }
+        const auto ti_start = static_cast<double>(this->row_tis.at(row_start));
+        const auto ti_end = static_cast<double>(this->row_tis.at(row_end - 1) + this->stride);
+        // The top-left texture coordinate goes to the top (thus latest) iteration
+        const ImVec2 uv0(0.0f, static_cast<float>(row_end) / HeatmapRowCount);
+        const ImVec2 uv1(1.0f, static_cast<float>(row_start) / HeatmapRowCount);
+        ImPlot::PlotImage(label, reinterpret_cast<ImTextureID>(static_cast<intptr_t>(this->texture)), ImPlotPoint(x_0, ti_start), ImPlotPoint(x_f, ti_end), uv0, uv1);
+    };
+
+    if(this->row_count < HeatmapRowCount) {
+        draw_rows(0, this->row_count);
+    }
+    else {
+        draw_rows(this->next_row, HeatmapRowCount);
+        draw_rows(0, this->next_row);
+    }
+}
+
+void SpaceTimeHeatmap::UpdateSaturation(const double saturation) {
+    if(saturation == this->saturation) {
+        return;
+    }
+
+    this->saturation = saturation;
+    if(this->row_count > 0) {
+        // Only when the user changes it, so a full upload is fine here
+        this->UploadRows(0, this->row_count);
+    }
+}
@@ -1,86 +1,189 @@
 #include "js_export.hpp"
+#include "special.hpp"
+
+// Scalar special functions for sources, implemented directly in JS so that sampling does not need to bounce back into C++ for every point
 
 EM_JS(double, gauss, (const double x, const double x0, const double k0, const double a), {
     return math.multiply(math.nthRoot(2.0 / (math.PI * a**2), 4), math.exp(math.complex(0, k0 * (x - x0))), math.exp(- (((x - x0)/a)**2)));
 });
 
-// Defined in main, where the quantum simulator is instantiated
+EM_JS(double, delta, (const double x, const double x0, const double val), {
+    // Use simulation's discretized space step value as allowed discrepancy to simulate a Dirac delta
+    if(Math.abs(x - x0) <= window.dx) {
+        return val;
+    }
+    else {
+        return 0;
+    }
+});
 
-extern "C" __attribute__((used)) double cpp_ApproximateDiracDelta(const double x, const double x0, const double val);
+EM_JS(double, hermite, (const int n, const double x), {
+    var h_km1 = 0.0;
+    var h_k = 1.0;
+    for(var k = 0; k < n; k++) {
+        var h_kp1 = 2.0 * x * h_k - 2.0 * k * h_km1;
+        h_km1 = h_k;
+        h_k = h_kp1;
+    }
+    return h_k;
+});
 
-EM_JS(double, delta, (const double x, const double x0, const double val), {
-    return Module.ccall("cpp_ApproximateDiracDelta", "number", ["number", "number", "number"], [x, x0, val]);
+EM_JS(double, hermite_fn, (const int n, const double x), {
+    var h_km1 = 0.0;
+    var h_k = Math.pow(Math.PI, -0.25) * Math.exp(-0.5 * x * x);
+    for(var k = 0; k < n; k++) {
+        var h_kp1 = Math.sqrt(2.0 / (k + 1)) * x * h_k - Math.sqrt(k / (k + 1)) * h_km1;
+        h_km1 = h_k;
+        h_k = h_kp1;
+    }
+    return h_k;
 });
 
-namespace {
+// Whole-grid special functions, where each JS call is a single native call over the entire array
 
-    using CoefficientList = std::vector<double>;
+#define _GRID_EXPORT(name, ...) extern "C" EMSCRIPTEN_KEEPALIVE void cpp_Special_##name(const double *x_arr, const int count, ##__VA_ARGS__)
 
-    void DerivatePolynomial(CoefficientList &poly) {
-        poly.erase(poly.begin());
-        for(int i = 0; i < poly.size(); i++) {
-            poly.at(i) *= (i + 1);
-        }
-    }
+#define _GRID_IN_VEC const Vector x_vec = Eigen::Map<const Vector>(x_arr, count)
 
-    void PolynomialTimesConstant(CoefficientList &poly, const double c) {
-        for(int i = 0; i < poly.size(); i++) {
-            poly.at(i) *= c;
-        }
-    }
-    
-    void PolynomialTimesX(CoefficientList &poly) {
-        poly.insert(poly.begin(), 0.0);
-    }
-    
-    void AddPolynomials(CoefficientList &base, CoefficientList &add) {
-        while(add.size() > base.size()) {
-            base.push_back(0.0);
-        }
+#define _GRID_OUT_REAL(vec) Eigen::Map<Vector>(out_arr, count) = vec
 
-        for(int i = 0; i < add.size(); i++) {
-            base.at(i) += add.at(i);
-        }
-    }
+#define _GRID_OUT_COMPLEX(vec) { \
+    Eigen::Map<Vector>(out_arr, count) = vec.real(); \
+    Eigen::Map<Vector>(out_arr + count, count) = vec.imag(); \
+}
 
-    double EvaluatePolynomial(const CoefficientList &poly, const double x) {
-        double val = 0.0;
-        for(int i = 0; i < poly.size(); i++) {
-            val += poly.at(i) * pow(x, i);
-        }
-        return val;
-    }
+_GRID_EXPORT(GaussianPacket, const double x0, const double k0, const double a, double *out_arr) {
+    _GRID_IN_VEC;
+    CVector out_vec;
+    special::GaussianPacketGrid(x_vec, x0, k0, a, out_vec);
+    _GRID_OUT_COMPLEX(out_vec);
+}
 
-    CoefficientList HermitePolynomial(const int n) {
-        if(n == 0) {
-            return { 1.0 };
-        }
-        else {
-            // H_{n} = 2*x*H_{n-1} - H_{n-1}'
+_GRID_EXPORT(DiracDelta, const double x0, const double val, const double dx, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::DiracDeltaGrid(x_vec, x0, val, dx, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
 
-            auto poly_nm1_a = HermitePolynomial(n - 1);
-            PolynomialTimesX(poly_nm1_a);
-            PolynomialTimesConstant(poly_nm1_a, 2.0);
+_GRID_EXPORT(HermitePolynomial, const int n, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::HermitePolynomialGrid(n, x_vec, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
 
-            auto poly_nm1_b = HermitePolynomial(n - 1);
-            DerivatePolynomial(poly_nm1_b);
-            PolynomialTimesConstant(poly_nm1_b, -1.0);
+_GRID_EXPORT(HermiteFunction, const int n, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::HermiteFunctionGrid(n, x_vec, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
 
-            AddPolynomials(poly_nm1_a, poly_nm1_b);
+_GRID_EXPORT(AiryAi, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::AiryAiGrid(x_vec, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
 
-            return poly_nm1_a;
-        }
-    }
+_GRID_EXPORT(LaguerrePolynomial, const int n, const double alpha, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::LaguerrePolynomialGrid(n, alpha, x_vec, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
 
+_GRID_EXPORT(Sech, const double x0, const double a, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::SechGrid(x_vec, x0, a, out_vec);
+    _GRID_OUT_REAL(out_vec);
 }
 
-extern "C" EMSCRIPTEN_KEEPALIVE double cpp_Hermite(const int n, const double x) {
-    const auto h = HermitePolynomial(n);
-    return EvaluatePolynomial(h, x);
+_GRID_EXPORT(Soliton, const double x0, const double k0, const double a, double *out_arr) {
+    _GRID_IN_VEC;
+    CVector out_vec;
+    special::SolitonGrid(x_vec, x0, k0, a, out_vec);
+    _GRID_OUT_COMPLEX(out_vec);
 }
 
-EM_JS(double, hermite, (const int n, const double x), {
-    return Module.ccall("cpp_Hermite", "number", ["number", "number"], [n, x]);
+_GRID_EXPORT(SmoothStep, const double x0, const double w, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::SmoothStepGrid(x_vec, x0, w, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
+
+_GRID_EXPORT(PoschlTeller, const double v0, const double x0, const double a, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::PoschlTellerGrid(x_vec, v0, x0, a, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
+
+_GRID_EXPORT(Morse, const double d, const double x0, const double a, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::MorseGrid(x_vec, d, x0, a, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
+
+_GRID_EXPORT(CosineLattice, const double v0, const double x0, const double d, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::CosineLatticeGrid(x_vec, v0, x0, d, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
+
+_GRID_EXPORT(KronigPenney, const double v0, const double x0, const double d, const double b, double *out_arr) {
+    _GRID_IN_VEC;
+    Vector out_vec;
+    special::KronigPenneyGrid(x_vec, v0, x0, d, b, out_vec);
+    _GRID_OUT_REAL(out_vec);
+}
+
+// Exposed to JS as the global 'special' object, every function takes an array of x values (plus parameters) and returns a Float64Array
+// (complex-valued functions return an object with 're' and 'im' Float64Arrays instead)
+
+EM_JS(void, InstallSpecialGridFunctions, (), {
+    function grid_call(name, xs, param_types, params, is_complex) {
+        var count = xs.length;
+        var out_count = is_complex ? (2 * count) : count;
+        var x_ptr = _malloc(count * 8);
+        var out_ptr = _malloc(out_count * 8);
+        try {
+            HEAPF64.set(xs, x_ptr / 8);
+            ccall("cpp_Special_" + name, null, ["number", "number"].concat(param_types, ["number"]), [x_ptr, count].concat(params, [out_ptr]));
+            var out = HEAPF64.slice(out_ptr / 8, out_ptr / 8 + out_count);
+            if(is_complex) {
+                return { re: out.subarray(0, count), im: out.subarray(count) };
+            }
+            else {
+                return out;
+            }
+        }
+        finally {
+            _free(x_ptr);
+            _free(out_ptr);
+        }
+    }
+
+    window.special = {
+        gauss: (xs, x0, k0, a) => grid_call("GaussianPacket", xs, ["number", "number", "number"], [x0, k0, a], true),
+        delta: (xs, x0, val) => grid_call("DiracDelta", xs, ["number", "number", "number"], [x0, val, window.dx], false),
+        hermite: (xs, n) => grid_call("HermitePolynomial", xs, ["number"], [n], false),
+        hermite_fn: (xs, n) => grid_call("HermiteFunction", xs, ["number"], [n], false),
+        airy: (xs) => grid_call("AiryAi", xs, [], [], false),
+        laguerre: (xs, n, alpha) => grid_call("LaguerrePolynomial", xs, ["number", "number"], [n, alpha], false),
+        sech: (xs, x0, a) => grid_call("Sech", xs, ["number", "number"], [x0, a], false),
+        soliton: (xs, x0, k0, a) => grid_call("Soliton", xs, ["number", "number", "number"], [x0, k0, a], true),
+        smooth_step: (xs, x0, w) => grid_call("SmoothStep", xs, ["number", "number"], [x0, w], false),
+        poschl_teller: (xs, v0, x0, a) => grid_call("PoschlTeller", xs, ["number", "number", "number"], [v0, x0, a], false),
+        morse: (xs, d, x0, a) => grid_call("Morse", xs, ["number", "number", "number"], [d, x0, a], false),
+        cos_lattice: (xs, v0, x0, d) => grid_call("CosineLattice", xs, ["number", "number", "number"], [v0, x0, d], false),
+        kronig_penney: (xs, v0, x0, d, b) => grid_call("KronigPenney", xs, ["number", "number", "number", "number"], [v0, x0, d, b], false)
+    };
 });
 
 void InitializeJsExports() {
@@ -88,4 +191,7 @@ void InitializeJsExports() {
     gauss(0, 0, 0, 0);
     delta(0, 0, 0);
     hermite(0, 0);
+    hermite_fn(0, 0);
+
+    InstallSpecialGridFunctions();
 }
@@ -7,7 +7,13 @@
 #include <imgui_impl_opengl3.h>
 #include <implot.h>
 
+#include <emscripten/heap.h>
+
 #include "q_sim.hpp"
+#include "perf.hpp"
+#include "trace.hpp"
+#include "heatmap.hpp"
+#include "wigner.hpp"
 #include "js_export.hpp"
 #include "def_psi0.hpp"
 #include "def_v.hpp"
@@ -37,16 +43,6 @@ EM_JS(void, ShowInformation, (const char *info), {
     alert(UTF8ToString(info));
 });
 
-EM_JS(int, TryEvaluate, (const char *src), {
-    try {
-        window.eval(UTF8ToString(src));
-        return 0;
-    }
-    catch(e) {
-        return 1;
-    }
-});
-
 EM_JS(const char*, GetMathJsVersion, (), {
     return stringToNewUTF8(math.version);
 });
@@ -92,17 +88,117 @@ EM_JS(void, LoadSimulationSettings, (), {
     }
 });
 
+EM_JS(void, DownloadCheckpointFile, (const char *path), {
+    var data = FS.readFile(UTF8ToString(path));
+    var url = URL.createObjectURL(new Blob([data], { type: "application/octet-stream" }));
+    var pom = document.createElement("a");
+    pom.setAttribute("href", url);
+    pom.setAttribute("download", "quantize_checkpoint.qchk");
+
+    if(document.createEvent) {
+        var event = document.createEvent("MouseEvents");
+        event.initEvent("click", true, true);
+        pom.dispatchEvent(event);
+    }
+    else {
+        pom.click();
+    }
+    setTimeout(() => URL.revokeObjectURL(url), 0);
+});
+
+EM_JS(void, DownloadTraceFile, (const char *path), {
+    var data = FS.readFile(UTF8ToString(path));
+    var url = URL.createObjectURL(new Blob([data], { type: "application/json" }));
+    var pom = document.createElement("a");
+    pom.setAttribute("href", url);
+    pom.setAttribute("download", "quantize_trace.json");
+
+    if(document.createEvent) {
+        var event = document.createEvent("MouseEvents");
+        event.initEvent("click", true, true);
+        pom.dispatchEvent(event);
+    }
+    else {
+        pom.click();
+    }
+    setTimeout(() => URL.revokeObjectURL(url), 0);
+});
+
+EM_JS(void, LoadCheckpointFile, (const char *path), {
+    var input = document.createElement("input");
+    input.type = "file";
+    input.id = "file-selector";
+    input.accept = ".qchk";
+    var path_str = UTF8ToString(path);
+    input.addEventListener('change', (event) => {
+        var file = event.target.files[0];
+
+        var reader = new FileReader();
+        reader.addEventListener("load", () => {
+            FS.writeFile(path_str, new Uint8Array(reader.result));
+            Module.ccall("cpp_LoadCheckpoint", null, ["string"], [path_str]);
+        }, false);
+        reader.readAsArrayBuffer(file);
+    });
+
+    if(document.createEvent) {
+        var event = document.createEvent("MouseEvents");
+        event.initEvent("click", true, true);
+        input.dispatchEvent(event);
+    }
+    else {
+        input.click();
+    }
+});
+
+EM_JS(void, LoadSampleTableFile, (const int is_v), {
+    var input = document.createElement("input");
+    input.type = "file";
+    input.id = "file-selector";
+    input.accept = ".csv,.txt,.dat,.bin,.qtab";
+    input.addEventListener('change', (event) => {
+        var file = event.target.files[0];
+
+        var reader = new FileReader();
+        reader.addEventListener("load", () => {
+            // Tables are placed in the virtual filesystem, so that settings can reference them by path
+            try {
+                FS.mkdir("/tables");
+            }
+            catch(e) {}
+            var path = "/tables/" + file.name;
+            FS.writeFile(path, new Uint8Array(reader.result));
+            Module.ccall("cpp_LoadSampleTable", null, ["number", "string"], [is_v, path]);
+        }, false);
+        reader.readAsArrayBuffer(file);
+    });
+
+    if(document.createEvent) {
+        var event = document.createEvent("MouseEvents");
+        event.initEvent("click", true, true);
+        input.dispatchEvent(event);
+    }
+    else {
+        input.click();
+    }
+});
+
 namespace {
 
-    // Hard-limit max discretized space dimensions and time iterations, we want to avoid the simulation choking on memory and/or performance as much as possible
-    // Note that these are quite arbitrary limits though
+    // Runs are only refused when they are predicted not to fit in the heap (see planner.hpp), which grows as needed up to its maximum size (or is fixed in builds with threads, see the Makefile)
+    // Time iterations are not limited, since records have bounded memory (see record.hpp)
 
-    constexpr long MaxSupportedDimensions = 400;
-    constexpr long MaxSupportedIterations = 5000;
+    constexpr size_t MiB = 1024 * 1024;
+    // Kept for everything besides the simulation (fonts, ImGui/ImPlot state, the JS runtime's own allocations)
+    constexpr size_t ReservedHeapSize = 64 * MiB;
+    // Plot vertices (several lines over the whole grid, every frame) and the momentum/history vectors plotted
+    constexpr size_t PlotBytesPerPoint = 512;
 
     constexpr auto SourceGlobalsNoticeText = "NOTE: Simulation variables available: hslash, m, x0, xf, dx, t0, dt";
-    constexpr auto SourceFunctionsNoticeText = "NOTE: Special functions available: gauss, delta, hermite (see source demos for usage)";
+    constexpr auto SourceFunctionsNoticeText = "NOTE: Special functions available: gauss, delta, hermite, hermite_fn (see source demos for usage)";
+    constexpr auto SourceGridFunctionsNoticeText = "NOTE: Whole-grid special functions are available in the 'special' object (gauss, delta, hermite, hermite_fn, airy, laguerre, sech, soliton, smooth_step, poschl_teller, morse, cos_lattice, kronig_penney), taking an array of x values first and returning an array";
     constexpr auto SourceLibrariesNoticeText = "NOTE: math.js libraries are used here, check their online docs for more extended usage";
+    constexpr auto SourceCompilationNoticeText = "NOTE: Sources using only plain functions (if/else, local variables, arithmetic), math.X/Math.X calls and gauss/delta/hermite/hermite_fn are compiled to WebAssembly for faster evaluation, otherwise they are evaluated by the JS engine";
     constexpr auto SourceEvaluationNoticeText = "NOTE: Ψ0 and V sources are globally evaluated (in this order), thus variables defined in Ψ0 source will be overriden by variables in V source with the same name!";
 
     constexpr auto ClearColor = ImVec4(0.14, 0.14, 0.4, 1.0);
@@ -114,10 +210,14 @@ namespace {
     bool g_DisplayControlWindow = true;
     bool g_DisplaySourceWindow = true;
     bool g_DisplaySpacePlotWindow = true;
+    bool g_DisplaySpaceTimePlotWindow = false;
+    bool g_DisplayPhaseSpacePlotWindow = false;
     bool g_DisplaySpaceOpsPlotWindow = false;
     bool g_DisplayMomentumOpsPlotWindow = false;
     bool g_DisplayUncertaintyPlotWindow = false;
     bool g_DisplayEnergyPlotWindow = false;
+    bool g_DisplaySpectrumPlotWindow = false;
+    bool g_DisplayPerformanceWindow = false;
     bool g_DisplayAboutWindow = false;
 
     double g_EditHslash = DefaultHslash;
@@ -130,7 +230,33 @@ namespace {
     double g_EditLeftRegionSeparator = DefaultLeftRegionSeparator;
     double g_EditRightRegionSeparator = DefaultRightRegionSeparator;
 
+    SpaceTimeHeatmap g_SpaceTimeHeatmap;
+    // Reused every frame (no reallocations while the grid does not change)
+    Vector g_MomentumPVector;
+    Vector g_MomentumDensityVector;
+    int g_EditHeatmapStride = 1;
+    float g_EditHeatmapSaturation = 1.0f;
+
+    constexpr const char *WignerMomentumCountNames[] = { "64", "128", "256", "512", "1024" };
+    constexpr size_t WignerMomentumCounts[] = { 64, 128, 256, 512, 1024 };
+
+    WignerDistribution g_Wigner;
+    int g_EditWignerRowCount = DefaultWignerRowCount;
+    int g_EditWignerMomentumCountIdx = 2;
+    int g_EditWignerInterval = 1;
+    // Iteration of the last computed distribution
+    long g_WignerIteration = -1;
+
+    // Whether to fit the spectrum plot around its peaks (once they are found)
+    bool g_SpectrumFitPeaks = true;
+
     bool g_Running = false;
+    // Otherwise, Ψ is reconstructed from the history at the timeline iteration
+    bool g_HistoryLive = true;
+    long g_HistoryIteration = 0;
+    long g_HistoryLoadedIteration = -1;
+    CVector g_HistoryPsi;
+    Vector g_HistoryPsiSquareNorm;
     bool g_AutoStart = false;
     CodeString g_EditPsi0Source = {};
     CodeString g_EditVSource = {};
@@ -145,24 +271,78 @@ namespace {
     int g_Width;
     int g_Height;
 
-    void EvaluateJsSimulationVariables() {
-        #define _EVAL_JS_SIM_VARIABLE(name, val) { \
-            const auto js_src = std::string(#name) + " = " + std::to_string(val) + ";"; \
-            TryEvaluate(js_src.c_str()); \
+    RecordSeries g_PlotRecordSeries;
+
+    PerfMonitor g_PerfMonitor(DefaultPerfFrameCapacity);
+    // Phase-major, as stacked bar groups expect
+    std::vector<double> g_PerfPlotValues;
+
+    ImPlotPoint GetRecordSeriesPoint(int idx, void *user_data) {
+        // Every bucket is drawn as a min-max segment, so that spikes are never lost
+        const auto series = reinterpret_cast<const RecordSeries*>(user_data);
+        const auto bucket = idx / 2;
+        return ImPlotPoint(series->idx.at(bucket), (idx % 2) ? series->max.at(bucket) : series->min.at(bucket));
+    }
+
+    void PlotRecord(const char *label, const RecordColumn &record) {
+        // Only about one bucket per horizontal pixel of the visible range is plotted, regardless of the record length
+        const auto limits = ImPlot::GetPlotLimits();
+        const auto start = static_cast<size_t>(std::max(0.0, std::floor(limits.X.Min)));
+        const auto end = static_cast<size_t>(std::max(0.0, std::ceil(limits.X.Max) + 1));
+        const auto bucket_count = static_cast<size_t>(std::max(1.0f, ImPlot::GetPlotSize().x));
+        record.QueryBuckets(start, end, bucket_count, g_PlotRecordSeries);
+        ImPlot::PlotLineG(label, GetRecordSeriesPoint, &g_PlotRecordSeries, 2 * g_PlotRecordSeries.GetSize());
+    }
+
+    void PlotSpectrum(const char *label, const EnergySpectrum &spectrum) {
+        // Same as records, since the spectrum may have way more points than visible pixels
+        const auto limits = ImPlot::GetPlotLimits();
+        const auto bucket_count = static_cast<size_t>(std::max(1.0f, ImPlot::GetPlotSize().x));
+        spectrum.QueryBuckets(limits.X.Min, limits.X.Max, bucket_count, g_PlotRecordSeries);
+        ImPlot::PlotLineG(label, GetRecordSeriesPoint, &g_PlotRecordSeries, 2 * g_PlotRecordSeries.GetSize());
+    }
+
+    inline size_t GetSimulationMemoryBudget() {
+        // Heaps configured below the reserve just have no room for simulations
+        const auto heap_max = emscripten_get_heap_max();
+        return (heap_max > ReservedHeapSize) ? (heap_max - ReservedHeapSize) : 0;
+    }
+
+    // Shown and checked every frame, thus only planned again once its input changes
+    SimulationPlanInput g_PlanInput = {};
+    SimulationPlan g_Plan = {};
+    bool g_PlanValid = false;
+
+    const SimulationPlan &PlanCurrentSimulation() {
+        auto input = g_QuantumSimulator.GetPlanInput();
+        input.uses_fft = input.uses_fft || g_DisplayMomentumOpsPlotWindow;
+        input.extra_bytes_per_point = PlotBytesPerPoint;
+        // Heatmap rows and their pixels, and the Wigner distribution
+        input.extra_fixed_bytes = HeatmapRowCount * HeatmapMaxWidth * (sizeof(float) + sizeof(uint32_t)) + g_EditWignerRowCount * WignerMomentumCounts[g_EditWignerMomentumCountIdx] * sizeof(double);
+        if(!g_PlanValid || (input != g_PlanInput)) {
+            g_PlanInput = input;
+            g_Plan = PlanSimulation(input);
+            g_PlanValid = true;
         }
+        return g_Plan;
+    }
 
-        _EVAL_JS_SIM_VARIABLE(hslash, g_QuantumSimulator.GetHslash());
-        _EVAL_JS_SIM_VARIABLE(m, g_QuantumSimulator.GetMass());
-        _EVAL_JS_SIM_VARIABLE(x0, g_QuantumSimulator.GetSpaceStart());
-        _EVAL_JS_SIM_VARIABLE(xf, g_QuantumSimulator.GetSpaceEnd());
-        _EVAL_JS_SIM_VARIABLE(dx, g_QuantumSimulator.GetSpaceStep());
-        _EVAL_JS_SIM_VARIABLE(t0, g_QuantumSimulator.GetTimeStart());
-        _EVAL_JS_SIM_VARIABLE(dt, g_QuantumSimulator.GetTimeStep());
+    bool ComputeNextSimulationIteration() {
+        const auto iteration_ok = g_QuantumSimulator.ComputeNextIteration();
+        const auto &timings = g_QuantumSimulator.GetLastIterationTimings();
+        g_PerfMonitor.AddPhaseTime(PerfPhase::Psi0Sampling, timings.psi0_sampling);
+        g_PerfMonitor.AddPhaseTime(PerfPhase::VSampling, timings.v_sampling);
+        g_PerfMonitor.AddPhaseTime(PerfPhase::Propagation, timings.propagation);
+        g_PerfMonitor.AddPhaseTime(PerfPhase::Observables, timings.observables);
+        return iteration_ok;
     }
 
     void ResetSimulation() {
         g_QuantumSimulator.Reset();
         g_Running = g_AutoStart;
+        g_HistoryLive = true;
+        g_HistoryLoadedIteration = -1;
+        g_SpectrumFitPeaks = true;
     }
 
     void ResetSimulationToDefault() {
@@ -187,27 +367,69 @@ namespace {
         SaveSettingsJson(settings_json.c_str());
     }
 
+    // Checkpoints go through the virtual filesystem
+    constexpr const char CheckpointPath[] = "/checkpoint.qchk";
+
+    void SaveSimulationCheckpoint() {
+        std::string checkpoint_error;
+        if(g_QuantumSimulator.SaveCheckpoint(CheckpointPath, checkpoint_error)) {
+            DownloadCheckpointFile(CheckpointPath);
+        }
+        else {
+            std::string error_msg = "Unable to save checkpoint:\n\n";
+            error_msg += checkpoint_error;
+            ShowError(error_msg.c_str());
+        }
+    }
+
+    #if QUANTIZE_TRACING
+
+    constexpr const char TracePath[] = "/trace.json";
+
+    void SaveTrace() {
+        std::string trace_error;
+        if(trace::SaveJson(TracePath, trace_error)) {
+            DownloadTraceFile(TracePath);
+        }
+        else {
+            std::string error_msg = "Unable to save trace:\n\n";
+            error_msg += trace_error;
+            ShowError(error_msg.c_str());
+        }
+    }
+
+    #endif
+
+    void SyncEditValues() {
+        g_EditHslash = g_QuantumSimulator.GetHslash();
+        g_EditMass = g_QuantumSimulator.GetMass();
+        g_EditTimeStart = g_QuantumSimulator.GetTimeStart();
+        g_EditTimeStep = g_QuantumSimulator.GetTimeStep();
+        g_EditSpaceStart = g_QuantumSimulator.GetSpaceStart();
+        g_EditSpaceStep = g_QuantumSimulator.GetSpaceStep();
+        g_EditSpaceEnd = g_QuantumSimulator.GetSpaceEnd();
+        strcpy(g_EditPsi0Source, g_QuantumSimulator.GetPsi0Source());
+        strcpy(g_EditVSource, g_QuantumSimulator.GetVSource());
+        g_EditLeftRegionSeparator = g_QuantumSimulator.GetLeftRegionSeparator();
+        g_EditRightRegionSeparator = g_QuantumSimulator.GetRightRegionSeparator();
+    }
+
 }
 
 extern "C" EMSCRIPTEN_KEEPALIVE void cpp_LoadSettings(const char *settings_json) {
     try {
         const auto settings = nlohmann::json::parse(settings_json);
-        if(g_QuantumSimulator.UpdateFromSettings(settings)) {
-            g_EditHslash = g_QuantumSimulator.GetHslash();
-            g_EditMass = g_QuantumSimulator.GetMass();
-            g_EditTimeStart = g_QuantumSimulator.GetTimeStart();
-            g_EditTimeStep = g_QuantumSimulator.GetTimeStep();
-            g_EditSpaceStart = g_QuantumSimulator.GetSpaceStart();
-            g_EditSpaceStep = g_QuantumSimulator.GetSpaceStep();
-            g_EditSpaceEnd = g_QuantumSimulator.GetSpaceEnd();
-            strcpy(g_EditPsi0Source, g_QuantumSimulator.GetPsi0Source());
-            strcpy(g_EditVSource, g_QuantumSimulator.GetVSource());
+        std::string settings_error;
+        if(g_QuantumSimulator.UpdateFromSettings(settings, settings_error)) {
+            SyncEditValues();
             ResetSimulation();
 
             ShowInformation("Successfully loaded settings!");
         }
         else {
-            ShowError("Invalid settings JSON!\nSome fields are missing (expected fields: t_0, x_0, x_f, dt, dx, hslash, m, psi0_src, v_src)");
+            std::string error_msg = "Invalid settings JSON!\n";
+            error_msg += settings_error;
+            ShowError(error_msg.c_str());
         }
     }
     catch(std::exception &e) {
@@ -218,13 +440,35 @@ extern "C" EMSCRIPTEN_KEEPALIVE void cpp_LoadSettings(const char *settings_json)
     }
 }
 
-extern "C" EMSCRIPTEN_KEEPALIVE double cpp_ApproximateDiracDelta(const double x, const double x0, const double val) {
-    // Use simulation's discretized space step value as allowed discrepancy to simulate a Dirac delta
-    if(abs(x - x0) <= g_QuantumSimulator.GetSpaceStep()) {
-        return val;
+extern "C" EMSCRIPTEN_KEEPALIVE void cpp_LoadCheckpoint(const char *path) {
+    std::string checkpoint_error;
+    const auto load_ok = g_QuantumSimulator.LoadCheckpoint(path, checkpoint_error);
+    // Settings are loaded even if the rest of the checkpoint is not
+    SyncEditValues();
+    if(load_ok) {
+        // Resumed as saved, thus not reset (but paused)
+        g_Running = false;
+        g_HistoryLive = true;
+        g_HistoryLoadedIteration = -1;
+        ShowInformation("Successfully loaded checkpoint!");
     }
     else {
-        return 0.0;
+        std::string error_msg = "Unable to load checkpoint:\n\n";
+        error_msg += checkpoint_error;
+        ShowError(error_msg.c_str());
+    }
+}
+
+extern "C" EMSCRIPTEN_KEEPALIVE void cpp_LoadSampleTable(const int is_v, const char *path) {
+    std::string table_error;
+    const auto load_ok = is_v ? g_QuantumSimulator.LoadVTable(path, g_QuantumSimulator.GetVTableInterpolation(), table_error) : g_QuantumSimulator.LoadPsi0Table(path, g_QuantumSimulator.GetPsi0TableInterpolation(), table_error);
+    if(load_ok) {
+        ResetSimulation();
+    }
+    else {
+        std::string error_msg = "Unable to load table:\n\n";
+        error_msg += table_error;
+        ShowError(error_msg.c_str());
     }
 }
 
@@ -236,6 +480,9 @@ namespace {
     }
 
     void MainLoop() {
+        _TRACE_SCOPE("Frame");
+        const auto frame_start_time = GetCurrentTimeMs();
+
         const auto cur_width = GetCanvasWidth();
         const auto cur_height = GetCanvasHeight();
         if((cur_width != g_Width) || (cur_height != g_Height)) {
@@ -278,6 +525,20 @@ namespace {
                     ImGui::SetTooltip("Save current simulation settings (control and Ψ0/V sources) as JSON");
                 }
 
+                if(ImGui::MenuItem("Load checkpoint")) {
+                    LoadCheckpointFile(CheckpointPath);
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Resume a simulation from a previously saved checkpoint");
+                }
+
+                if(ImGui::MenuItem("Save checkpoint", nullptr, false, g_QuantumSimulator.GetIteration() > 0)) {
+                    SaveSimulationCheckpoint();
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Save the full simulation state (settings, Ψ, V, records) so that it can be resumed later");
+                }
+
                 ImGui::EndMenu();
             }
             if(ImGui::IsItemHovered()) {
@@ -290,6 +551,16 @@ namespace {
                     ImGui::SetTooltip("Plot evolution of potential and probability density");
                 }
 
+                ImGui::MenuItem("Space-time", nullptr, &g_DisplaySpaceTimePlotWindow);
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Plot probability density over space and time as a heatmap");
+                }
+
+                ImGui::MenuItem("Phase space", nullptr, &g_DisplayPhaseSpacePlotWindow);
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Plot the Wigner quasi-probability distribution of Ψ");
+                }
+
                 ImGui::MenuItem("Space operators", nullptr, &g_DisplaySpaceOpsPlotWindow);
                 if(ImGui::IsItemHovered()) {
                     ImGui::SetTooltip("Plot evolution of position operators");
@@ -310,12 +581,22 @@ namespace {
                     ImGui::SetTooltip("Plot energy evolution");
                 }
 
+                ImGui::MenuItem("Spectrum", nullptr, &g_DisplaySpectrumPlotWindow);
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Plot the autocorrelation and the energy spectrum computed from it");
+                }
+
                 ImGui::EndMenu();
             }
             if(ImGui::IsItemHovered()) {
                 ImGui::SetTooltip("Space and value/operator evolution plots");
             }
 
+            ImGui::MenuItem("Performance", nullptr, &g_DisplayPerformanceWindow);
+            if(ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Per-phase frame timings (sources, solver, rendering)");
+            }
+
             ImGui::MenuItem("About", nullptr, &g_DisplayAboutWindow);
             if(ImGui::IsItemHovered()) {
                 ImGui::SetTooltip("Information about this project");
@@ -352,6 +633,13 @@ namespace {
 
             ImGui::TextWrapped("Space discretized, dimensions: %ld", g_QuantumSimulator.GetDimensions());
             ImGui::TextWrapped("Time discretized, current iteration: %ld", g_QuantumSimulator.GetIteration());
+            ImGui::TextWrapped("Records: %zu iterations (%.2f MB)", g_QuantumSimulator.GetRecordCount(), g_QuantumSimulator.GetRecordMemorySize() / (1024.0 * 1024.0));
+
+            const auto plan = PlanCurrentSimulation();
+            ImGui::TextWrapped("Predicted: %.2f MB (of %.0f MB available), %.3f ms per iteration", (double)plan.total_size / MiB, (double)GetSimulationMemoryBudget() / MiB, plan.step_time);
+            if(ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Grid: %.2f MB, records: %.2f MB, Ψ history: %.2f MB, plots: %.2f MB\nIteration times are calibrated with the propagation times measured so far", (double)plan.grid_size / MiB, (double)plan.record_size / MiB, (double)plan.history_size / MiB, (double)plan.extra_size / MiB);
+            }
 
             ImGui::Separator();
 
@@ -513,6 +801,40 @@ namespace {
                     ImGui::SetTooltip("V source code examples (click to apply)");
                 }
 
+                if(ImGui::BeginMenu("Tables")) {
+                    #define _TABLE_MENU(name, is_v, has_fn, clear_fn, get_interp_fn, update_interp_fn) { \
+                        if(ImGui::MenuItem("Load " name " table")) { \
+                            LoadSampleTableFile(is_v); \
+                        } \
+                        if(ImGui::IsItemHovered()) { \
+                            ImGui::SetTooltip("Sample " name " from a binary or CSV table file instead of its source code"); \
+                        } \
+                        if(ImGui::MenuItem("Use " name " source", nullptr, false, g_QuantumSimulator.has_fn())) { \
+                            g_QuantumSimulator.clear_fn(); \
+                            _SIM_RESET; \
+                        } \
+                        if(ImGui::BeginMenu(name " table interpolation")) { \
+                            for(size_t i = 0; i < std::size(InterpolationKindNames); i++) { \
+                                const auto interp = static_cast<InterpolationKind>(i); \
+                                if(ImGui::MenuItem(InterpolationKindNames[i], nullptr, g_QuantumSimulator.get_interp_fn() == interp)) { \
+                                    g_QuantumSimulator.update_interp_fn(interp); \
+                                    _SIM_RESET; \
+                                } \
+                            } \
+                            ImGui::EndMenu(); \
+                        } \
+                    }
+
+                    _TABLE_MENU("Ψ0", 0, HasPsi0Table, ClearPsi0Table, GetPsi0TableInterpolation, UpdatePsi0TableInterpolation);
+                    ImGui::Separator();
+                    _TABLE_MENU("V", 1, HasVTable, ClearVTable, GetVTableInterpolation, UpdateVTableInterpolation);
+
+                    ImGui::EndMenu();
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Tabulated Ψ0 and V samples (from other solvers, measurements...)");
+                }
+
                 ImGui::EndMenuBar();
             }
 
@@ -521,14 +843,41 @@ namespace {
                     _DO_WITH_TEXT_COLOR(NoteColor, {
                         ImGui::TextWrapped(SourceGlobalsNoticeText);
                         ImGui::TextWrapped(SourceFunctionsNoticeText);
+                        ImGui::TextWrapped(SourceGridFunctionsNoticeText);
                         ImGui::TextWrapped(SourceLibrariesNoticeText);
+                        ImGui::TextWrapped(SourceCompilationNoticeText);
                         ImGui::TextWrapped(SourceEvaluationNoticeText);
                     });
 
                     ImGui::EndTabItem();
                 }
                 
+                #define _TABLE_NOTE(name, has_fn, get_fn, get_interp_fn) \
+                    if(g_QuantumSimulator.has_fn()) { \
+                        const auto &table = g_QuantumSimulator.get_fn(); \
+                        _DO_WITH_TEXT_COLOR(NoteColor, { \
+                            ImGui::TextWrapped("NOTE: " name " is sampled from table '%s' (%zu samples, %s interpolation, hash %s), the source below is ignored", table.GetPath().c_str(), table.GetSampleCount(), InterpolationKindNames[static_cast<size_t>(g_QuantumSimulator.get_interp_fn())], table.GetHashString().c_str()); \
+                        }); \
+                    }
+
+                #define _COMPILED_NOTE(name, has_table_fn, get_compiled_fn) \
+                    if(!g_QuantumSimulator.has_table_fn()) { \
+                        const auto &compiled = g_QuantumSimulator.get_compiled_fn(); \
+                        if(compiled.active) { \
+                            _DO_WITH_TEXT_COLOR(NoteColor, { \
+                                ImGui::TextWrapped("NOTE: " name " is evaluated by a compiled WebAssembly module (last evaluation: %.3f ms, %ld samples left to JS)", compiled.eval_time, compiled.js_sample_count); \
+                            }); \
+                        } \
+                        else if(!compiled.src.empty()) { \
+                            _DO_WITH_TEXT_COLOR(NoteColor, { \
+                                ImGui::TextWrapped("NOTE: " name " is evaluated by the JS engine (last evaluation: %.3f ms), since it could not be compiled: %s", compiled.eval_time, compiled.error.c_str()); \
+                            }); \
+                        } \
+                    }
+
                 if(ImGui::BeginTabItem("Ψ0 source")) {
+                    _TABLE_NOTE("Ψ0", HasPsi0Table, GetPsi0Table, GetPsi0TableInterpolation);
+                    _COMPILED_NOTE("Ψ0", HasPsi0Table, GetCompiledPsi0Source);
                     ImGui::InputTextMultiline("##Psi0Src", g_EditPsi0Source, sizeof(g_EditPsi0Source), ImGui::GetContentRegionAvail(), ImGuiInputTextFlags_AllowTabInput);
                     if(!g_QuantumSimulator.ComparePsi0Source(g_EditPsi0Source)) {
                         g_QuantumSimulator.UpdatePsi0Source(g_EditPsi0Source);
@@ -540,6 +889,8 @@ namespace {
                 }
 
                 if(ImGui::BeginTabItem("V source")) {
+                    _TABLE_NOTE("V", HasVTable, GetVTable, GetVTableInterpolation);
+                    _COMPILED_NOTE("V", HasVTable, GetCompiledVSource);
                     ImGui::InputTextMultiline("##VSrc", g_EditVSource, sizeof(g_EditVSource), ImGui::GetContentRegionAvail(), ImGuiInputTextFlags_AllowTabInput);
                     if(!g_QuantumSimulator.CompareVSource(g_EditVSource)) {
                         g_QuantumSimulator.UpdateVSource(g_EditVSource);
@@ -556,19 +907,27 @@ namespace {
             ImGui::End();
         }
 
-        if(!g_QuantumSimulator.IsPsi0SourceEvaluated() || psi0_src_changed) {
-            EvaluateJsSimulationVariables();
-            const auto psi0_rc = TryEvaluate(g_EditPsi0Source);
-            g_QuantumSimulator.NotifyPsi0SourceEvaluated(JS_RC_SUCCEEDED(psi0_rc));
+        // Sources are not needed (thus not evaluated) while sampling from tables
+
+        if(g_QuantumSimulator.HasPsi0Table()) {
+            if(!g_QuantumSimulator.IsPsi0SourceEvaluated()) {
+                g_QuantumSimulator.NotifyPsi0SourceEvaluated(true);
+            }
+        }
+        else if(!g_QuantumSimulator.IsPsi0SourceEvaluated() || psi0_src_changed) {
+            g_QuantumSimulator.EvaluatePsi0Source();
         }
         if(!g_QuantumSimulator.IsPsi0SourceOk()) {
             _PUSH_ERROR_FMT("Ψ0 source error");
         }
 
-        if(!g_QuantumSimulator.IsVSourceEvaluated() || v_src_changed) {
-            EvaluateJsSimulationVariables();
-            const auto v_rc = TryEvaluate(g_EditVSource);
-            g_QuantumSimulator.NotifyVSourceEvaluated(JS_RC_SUCCEEDED(v_rc));
+        if(g_QuantumSimulator.HasVTable()) {
+            if(!g_QuantumSimulator.IsVSourceEvaluated()) {
+                g_QuantumSimulator.NotifyVSourceEvaluated(true);
+            }
+        }
+        else if(!g_QuantumSimulator.IsVSourceEvaluated() || v_src_changed) {
+            g_QuantumSimulator.EvaluateVSource();
         }
         if(!g_QuantumSimulator.IsVSourceOk()) {
             _PUSH_ERROR_FMT("V source error");
@@ -587,8 +946,10 @@ namespace {
         if(g_QuantumSimulator.GetSpaceStep() <= 0) {
             _PUSH_ERROR_FMT("space step must be strictly positive");
         }
-        if(g_QuantumSimulator.GetDimensions() > MaxSupportedDimensions) {
-            _PUSH_ERROR_FMT("too many discretization dimensions (%ld > limit=%ld), too small space step and/or too big space start/end interval", g_QuantumSimulator.GetDimensions(), MaxSupportedDimensions);
+        const auto plan = PlanCurrentSimulation();
+        const auto memory_budget = GetSimulationMemoryBudget();
+        if(plan.total_size > memory_budget) {
+            _PUSH_ERROR_FMT("too many discretization dimensions (%ld), predicted to need %.0f MB out of %.0f MB available: too small space step and/or too big space start/end interval", g_QuantumSimulator.GetDimensions(), (double)plan.total_size / MiB, (double)memory_budget / MiB);
         }
         if(g_QuantumSimulator.GetTimeStep() <= 0) {
             _PUSH_ERROR_FMT("time step must be strictly positive");
@@ -596,7 +957,7 @@ namespace {
 
         if(error_list.empty()) {
             if(g_QuantumSimulator.GetIteration() == 0) {
-                if(!g_QuantumSimulator.ComputeNextIteration()) {
+                if(!ComputeNextSimulationIteration()) {
                     if(!g_QuantumSimulator.IsPsi0SourceOk()) {
                         _PUSH_ERROR_FMT("error in initial Ψ0 invocation");
                     }
@@ -606,8 +967,8 @@ namespace {
                 }
             }
             else {
-                if(was_reset || (g_Running && (g_QuantumSimulator.GetIteration() < MaxSupportedIterations))) {
-                    if(!g_QuantumSimulator.ComputeNextIteration()) {
+                if(was_reset || g_Running) {
+                    if(!ComputeNextSimulationIteration()) {
                         if(!g_QuantumSimulator.IsPsi0SourceOk()) {
                             _PUSH_ERROR_FMT("error in psi0 invocation");
                         }
@@ -619,6 +980,7 @@ namespace {
             }
         }
 
+        const auto plot_start_time = GetCurrentTimeMs();
         const auto sim_initialized = error_list.empty() && (g_QuantumSimulator.GetIteration() > 0);
 
         if(!error_list.empty()) {
@@ -638,7 +1000,7 @@ namespace {
         }
 
         if(g_DisplaySpacePlotWindow) {
-            ImGui::SetNextWindowSize(ImVec2(800, 430), ImGuiCond_Once);
+            ImGui::SetNextWindowSize(ImVec2(800, 860), ImGuiCond_Once);
             ImGui::Begin("Space plot", &g_DisplaySpacePlotWindow);
 
             if(sim_initialized) {
@@ -650,11 +1012,50 @@ namespace {
                 
                 ImGui::TextWrapped("Ψ norm: %f", g_QuantumSimulator.GetCurrentPsiNorm());
 
+                const auto &history = g_QuantumSimulator.GetPsiHistory();
+                const Vector *psisq_vec = &g_QuantumSimulator.GetCurrentPsiSquareNormDiscreteVector();
+                if(history.GetFrameCount() > 1) {
+                    if(ImGui::Checkbox("Live", &g_HistoryLive) && !g_HistoryLive) {
+                        g_HistoryIteration = history.GetFrameIteration(history.GetFrameCount() - 1);
+                    }
+                    if(ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("Show the current Ψ, otherwise past Ψ values can be viewed in the timeline");
+                    }
+
+                    if(!g_HistoryLive) {
+                        ImGui::SameLine();
+                        auto frame_idx = static_cast<int>(history.FindFrame(g_HistoryIteration));
+                        if(ImGui::SliderInt("Timeline", &frame_idx, 0, static_cast<int>(history.GetFrameCount()) - 1, "")) {
+                            g_HistoryIteration = history.GetFrameIteration(frame_idx);
+                        }
+                        if(ImGui::IsItemHovered()) {
+                            ImGui::SetTooltip("Every %ld iterations are kept (compressed, with error below %g) within %.2f MB", history.GetStride(), history.GetTolerance(), history.GetMemorySize() / (1024.0 * 1024.0));
+                        }
+
+                        const auto frame_ti = history.GetFrameIteration(frame_idx);
+                        if((g_HistoryLoadedIteration != frame_ti) || (g_HistoryPsiSquareNorm.size() != g_QuantumSimulator.GetDimensions())) {
+                            if(history.Reconstruct(frame_idx, g_HistoryPsi)) {
+                                g_HistoryPsiSquareNorm = NormSquaredVector(g_HistoryPsi);
+                                g_HistoryLoadedIteration = frame_ti;
+                            }
+                        }
+                        if(g_HistoryPsiSquareNorm.size() == g_QuantumSimulator.GetDimensions()) {
+                            ImGui::TextWrapped("Iteration %ld, t = %f", frame_ti, g_QuantumSimulator.DiscreteT(frame_ti));
+                            psisq_vec = &g_HistoryPsiSquareNorm;
+                        }
+                    }
+                }
+                else if(history.IsOverBudget()) {
+                    _DO_WITH_TEXT_COLOR(NoteColor, {
+                        ImGui::TextWrapped("NOTE: past Ψ values are not kept, since the grid is too large for the %.2f MB history budget", history.GetMemoryBudget() / (1024.0 * 1024.0));
+                    });
+                }
+
                 if(ImPlot::BeginPlot("Space evolution")) {
                     ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_None);
-                    ImPlot::SetupAxesLimits(g_QuantumSimulator.GetSpaceStart(), g_QuantumSimulator.GetSpaceEnd(), 0, g_QuantumSimulator.GetCurrentPsiSquareNormDiscreteVector().maxCoeff());
+                    ImPlot::SetupAxesLimits(g_QuantumSimulator.GetSpaceStart(), g_QuantumSimulator.GetSpaceEnd(), 0, psisq_vec->maxCoeff());
 
-                    ImPlot::PlotLine("|Ψ|²", g_QuantumSimulator.GetXDiscreteVector().data(), g_QuantumSimulator.GetCurrentPsiSquareNormDiscreteVector().data(), g_QuantumSimulator.GetDimensions());
+                    ImPlot::PlotLine("|Ψ|²", g_QuantumSimulator.GetXDiscreteVector().data(), psisq_vec->data(), g_QuantumSimulator.GetDimensions());
                     ImPlot::PlotLine("V", g_QuantumSimulator.GetXDiscreteVector().data(), g_QuantumSimulator.GetCurrentVDiscreteVector().data(), g_QuantumSimulator.GetDimensions());
 
                     ImPlot::EndPlot();
@@ -664,9 +1065,71 @@ namespace {
                     ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
                     ImPlot::SetupAxesLimits(0, g_QuantumSimulator.GetIteration(), 0, 0);
 
-                    ImPlot::PlotLine("Pl", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetLeftRegionProbabilityRecord().data(), g_QuantumSimulator.GetRecordSize());
-                    ImPlot::PlotLine("P0", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetMiddleRegionProbabilityRecord().data(), g_QuantumSimulator.GetRecordSize());
-                    ImPlot::PlotLine("Pr", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetRightRegionProbabilityRecord().data(), g_QuantumSimulator.GetRecordSize());
+                    PlotRecord("Pl", g_QuantumSimulator.GetLeftRegionProbabilityRecordColumn());
+                    PlotRecord("P0", g_QuantumSimulator.GetMiddleRegionProbabilityRecordColumn());
+                    PlotRecord("Pr", g_QuantumSimulator.GetRightRegionProbabilityRecordColumn());
+
+                    ImPlot::EndPlot();
+                }
+
+                ImGui::TextWrapped("Flux through xl: %f, through xr: %f", g_QuantumSimulator.GetCurrentLeftSeparatorFlux(), g_QuantumSimulator.GetCurrentRightSeparatorFlux());
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Net probability that went through each separator so far (positive towards xf): for a packet coming from the left, the reflection coefficient is R = P_left(0) - (xl flux), i.e. the final left probability, and the xr flux is the transmission coefficient");
+                }
+
+                if(ImPlot::BeginPlot("Probability current")) {
+                    ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+                    ImPlot::SetupAxisLimits(ImAxis_X1, g_QuantumSimulator.GetSpaceStart(), g_QuantumSimulator.GetSpaceEnd());
+
+                    ImPlot::PlotLine("j", g_QuantumSimulator.GetXDiscreteVector().data(), g_QuantumSimulator.GetCurrentProbabilityCurrentDiscreteVector().data(), g_QuantumSimulator.GetDimensions());
+
+                    ImPlot::EndPlot();
+                }
+
+                if(ImPlot::BeginPlot("Separator fluxes")) {
+                    ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+                    ImPlot::SetupAxesLimits(0, g_QuantumSimulator.GetIteration(), 0, 0);
+
+                    PlotRecord("Φl", g_QuantumSimulator.GetLeftSeparatorFluxRecordColumn());
+                    PlotRecord("Φr", g_QuantumSimulator.GetRightSeparatorFluxRecordColumn());
+
+                    ImPlot::EndPlot();
+                }
+            }
+
+            ImGui::End();
+        }
+
+        if(sim_initialized) {
+            // Fed even while hidden, so that the heatmap covers the run whenever it is opened
+            g_SpaceTimeHeatmap.Push(g_QuantumSimulator.GetIteration() - 1, g_QuantumSimulator.GetCurrentPsiSquareNormDiscreteVector());
+        }
+
+        if(g_DisplaySpaceTimePlotWindow) {
+            ImGui::SetNextWindowSize(ImVec2(800, 500), ImGuiCond_Once);
+            ImGui::Begin("Space-time plot", &g_DisplaySpaceTimePlotWindow);
+
+            if(sim_initialized) {
+                if(ImGui::InputInt("Iterations per row", &g_EditHeatmapStride)) {
+                    g_EditHeatmapStride = std::max(g_EditHeatmapStride, 1);
+                    g_SpaceTimeHeatmap.UpdateStride(g_EditHeatmapStride);
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Only the latest %d rows are kept, changing this clears the heatmap", HeatmapRowCount);
+                }
+
+                if(ImGui::SliderFloat("Saturation", &g_EditHeatmapSaturation, 0.01f, 1.0f, "%.2f", ImGuiSliderFlags_Logarithmic)) {
+                    g_SpaceTimeHeatmap.UpdateSaturation(g_EditHeatmapSaturation);
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Fraction of the initial |Ψ|² peak drawn with the brightest color (lower values highlight faint regions)");
+                }
+
+                if(ImPlot::BeginPlot("|Ψ|² space-time evolution", ImVec2(-1, -1))) {
+                    ImPlot::SetupAxes("x", "iteration", ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+                    ImPlot::SetupAxisLimits(ImAxis_X1, g_QuantumSimulator.GetSpaceStart(), g_QuantumSimulator.GetSpaceEnd());
+
+                    g_SpaceTimeHeatmap.Plot("|Ψ|²", g_QuantumSimulator.GetSpaceStart(), g_QuantumSimulator.GetSpaceEnd());
 
                     ImPlot::EndPlot();
                 }
@@ -675,6 +1138,59 @@ namespace {
             ImGui::End();
         }
 
+        if(g_DisplayPhaseSpacePlotWindow) {
+            ImGui::SetNextWindowSize(ImVec2(800, 600), ImGuiCond_Once);
+            ImGui::Begin("Phase space plot", &g_DisplayPhaseSpacePlotWindow);
+
+            if(sim_initialized) {
+                auto params_changed = false;
+                if(ImGui::InputInt("x samples", &g_EditWignerRowCount)) {
+                    g_EditWignerRowCount = std::clamp(g_EditWignerRowCount, 2, static_cast<int>(g_QuantumSimulator.GetDimensions()));
+                    params_changed = true;
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Amount of x points where the distribution is computed (at most the space dimensions)");
+                }
+
+                if(ImGui::Combo("p samples", &g_EditWignerMomentumCountIdx, WignerMomentumCountNames, std::size(WignerMomentumCountNames))) {
+                    params_changed = true;
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Amount of p points (FFT size), the p range is the same but its resolution increases");
+                }
+
+                if(ImGui::InputInt("Update interval", &g_EditWignerInterval)) {
+                    g_EditWignerInterval = std::max(g_EditWignerInterval, 1);
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Only recompute the distribution every this many iterations (it is computed in parallel, but still costly for big grids)");
+                }
+
+                // Only computed while visible
+                const auto cur_ti = g_QuantumSimulator.GetIteration() - 1;
+                if(params_changed || (g_WignerIteration < 0) || (cur_ti < g_WignerIteration) || ((cur_ti - g_WignerIteration) >= g_EditWignerInterval)) {
+                    g_Wigner.Compute(g_QuantumSimulator.GetCurrentPsiDiscreteVector(), g_QuantumSimulator.GetSpaceStart(), g_QuantumSimulator.GetSpaceStep(), g_QuantumSimulator.GetHslash(), g_EditWignerRowCount, WignerMomentumCounts[g_EditWignerMomentumCountIdx]);
+                    g_WignerIteration = cur_ti;
+                }
+
+                const auto scale = std::max(g_Wigner.GetMaxAbsValue(), 1.0e-12);
+                ImPlot::PushColormap(ImPlotColormap_RdBu);
+                if(ImPlot::BeginPlot("Wigner distribution", ImVec2(-80, -1))) {
+                    ImPlot::SetupAxes("x", "p", ImPlotAxisFlags_None, ImPlotAxisFlags_None);
+                    ImPlot::SetupAxesLimits(g_Wigner.GetSpaceStart(), g_Wigner.GetSpaceEnd(), -g_Wigner.GetMomentumMax(), g_Wigner.GetMomentumMax());
+
+                    ImPlot::PlotHeatmap("W", g_Wigner.GetValues(), g_Wigner.GetMomentumCount(), g_Wigner.GetRowCount(), -scale, scale, nullptr, ImPlotPoint(g_Wigner.GetSpaceStart(), -g_Wigner.GetMomentumMax()), ImPlotPoint(g_Wigner.GetSpaceEnd(), g_Wigner.GetMomentumMax()));
+
+                    ImPlot::EndPlot();
+                }
+                ImGui::SameLine();
+                ImPlot::ColormapScale("W", -scale, scale, ImVec2(60, -1));
+                ImPlot::PopColormap();
+            }
+
+            ImGui::End();
+        }
+
         if(g_DisplaySpaceOpsPlotWindow) {
             ImGui::SetNextWindowSize(ImVec2(800, 435), ImGuiCond_Once);
             ImGui::Begin("Space operator plot", &g_DisplaySpaceOpsPlotWindow);
@@ -699,9 +1215,9 @@ namespace {
                     ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
                     ImPlot::SetupAxesLimits(0, g_QuantumSimulator.GetIteration(), 0, 0);
 
-                    ImPlot::PlotLine("x", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetXEstimateRecord().data(), g_QuantumSimulator.GetRecordSize());
-                    ImPlot::PlotLine("x²", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetXSquaredEstimateRecord().data(), g_QuantumSimulator.GetRecordSize());
-                    ImPlot::PlotLine("Δx", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetDeltaXRecord().data(), g_QuantumSimulator.GetRecordSize());
+                    PlotRecord("x", g_QuantumSimulator.GetXEstimateRecordColumn());
+                    PlotRecord("x²", g_QuantumSimulator.GetXSquaredEstimateRecordColumn());
+                    PlotRecord("Δx", g_QuantumSimulator.GetDeltaXRecordColumn());
 
                     ImPlot::EndPlot();
                 }
@@ -711,7 +1227,7 @@ namespace {
         }
 
         if(g_DisplayMomentumOpsPlotWindow) {
-            ImGui::SetNextWindowSize(ImVec2(800, 435), ImGuiCond_Once);
+            ImGui::SetNextWindowSize(ImVec2(800, 700), ImGuiCond_Once);
             ImGui::Begin("Momentum operator plot", &g_DisplayMomentumOpsPlotWindow);
 
             if(sim_initialized) {
@@ -730,13 +1246,32 @@ namespace {
                     ImGui::SetTooltip("Momentum uncertainty");
                 }
 
+                auto spectral_momentum = g_QuantumSimulator.IsSpectralMomentum();
+                if(ImGui::Checkbox("Spectral estimates", &spectral_momentum)) {
+                    g_QuantumSimulator.UpdateSpectralMomentum(spectral_momentum);
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Compute p and p² from Ψ's Fourier transform instead of finite differences (more accurate for quickly oscillating Ψ), from now on");
+                }
+
+                // Only computed while visible
+                g_QuantumSimulator.ComputeMomentumDistribution(g_MomentumPVector, g_MomentumDensityVector);
+                if(ImPlot::BeginPlot("Momentum space")) {
+                    ImPlot::SetupAxes("p", nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+                    ImPlot::SetupAxisLimits(ImAxis_X1, g_MomentumPVector(0), g_MomentumPVector(g_MomentumPVector.size() - 1));
+
+                    ImPlot::PlotLine("|φ(p)|²", g_MomentumPVector.data(), g_MomentumDensityVector.data(), g_MomentumPVector.size());
+
+                    ImPlot::EndPlot();
+                }
+
                 if(ImPlot::BeginPlot("Momentum operator evolution")) {
                     ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
                     ImPlot::SetupAxesLimits(0, g_QuantumSimulator.GetIteration(), 0, 0);
 
-                    ImPlot::PlotLine("p", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetPEstimateRecord().data(), g_QuantumSimulator.GetRecordSize());
-                    ImPlot::PlotLine("p²", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetPSquaredEstimateRecord().data(), g_QuantumSimulator.GetRecordSize());
-                    ImPlot::PlotLine("Δp", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetDeltaPRecord().data(), g_QuantumSimulator.GetRecordSize());
+                    PlotRecord("p", g_QuantumSimulator.GetPEstimateRecordColumn());
+                    PlotRecord("p²", g_QuantumSimulator.GetPSquaredEstimateRecordColumn());
+                    PlotRecord("Δp", g_QuantumSimulator.GetDeltaPRecordColumn());
 
                     ImPlot::EndPlot();
                 }
@@ -764,7 +1299,7 @@ namespace {
                     ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
                     ImPlot::SetupAxesLimits(0, g_QuantumSimulator.GetIteration(), 0, 0);
 
-                    ImPlot::PlotLine("ΔxΔp", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetDeltaProductRecord().data(), g_QuantumSimulator.GetRecordSize());
+                    PlotRecord("ΔxΔp", g_QuantumSimulator.GetDeltaProductRecordColumn());
 
                     ImPlot::EndPlot();
                 }
@@ -787,7 +1322,65 @@ namespace {
                     ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
                     ImPlot::SetupAxesLimits(0, g_QuantumSimulator.GetIteration(), 0, 0);
 
-                    ImPlot::PlotLine("E", g_QuantumSimulator.GetIterationRecord().data(), g_QuantumSimulator.GetEnergyEstimateRecord().data(), g_QuantumSimulator.GetRecordSize());
+                    PlotRecord("E", g_QuantumSimulator.GetEnergyEstimateRecordColumn());
+
+                    ImPlot::EndPlot();
+                }
+            }
+
+            ImGui::End();
+        }
+
+        if(g_DisplaySpectrumPlotWindow) {
+            ImGui::SetNextWindowSize(ImVec2(800, 700), ImGuiCond_Once);
+            ImGui::Begin("Spectrum plot", &g_DisplaySpectrumPlotWindow);
+
+            if(sim_initialized) {
+                auto &spectrum = g_QuantumSimulator.GetEnergySpectrum();
+                // Only recomputed (while visible) once enough new samples are available
+                spectrum.Update(g_QuantumSimulator.GetHslash(), g_QuantumSimulator.GetTimeStep());
+
+                _DO_WITH_TEXT_COLOR(NoteColor, {
+                    ImGui::TextWrapped("NOTE: peaks are at the energies of the eigenstates present in Ψ0, their resolution improves as the simulation runs");
+                });
+
+                std::string peaks_str;
+                for(const auto energy: spectrum.GetPeakEnergies()) {
+                    char energy_str[32] = {};
+                    snprintf(energy_str, sizeof(energy_str), "%s%.4f", peaks_str.empty() ? "" : ", ", energy);
+                    peaks_str += energy_str;
+                }
+                ImGui::TextWrapped("Peak energies: %s", peaks_str.empty() ? "-" : peaks_str.c_str());
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Resolution: %f (%zu samples, every %ld iterations)", (2 * M_PI * g_QuantumSimulator.GetHslash()) / (spectrum.GetSampleCount() * spectrum.GetStride() * g_QuantumSimulator.GetTimeStep()), spectrum.GetSampleCount(), spectrum.GetStride());
+                }
+
+                if(ImGui::Button("Fit peaks")) {
+                    g_SpectrumFitPeaks = true;
+                }
+
+                if(ImPlot::BeginPlot("Energy spectrum")) {
+                    ImPlot::SetupAxes("E", nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+                    if(g_SpectrumFitPeaks && !spectrum.GetPeakEnergies().empty()) {
+                        // The whole energy range is usually way wider than the relevant one
+                        const auto e_min = spectrum.GetPeakEnergies().front();
+                        const auto e_max = spectrum.GetPeakEnergies().back();
+                        const auto margin = std::max(1.0, 0.25 * (e_max - e_min));
+                        ImPlot::SetupAxisLimits(ImAxis_X1, e_min - margin, e_max + margin, ImPlotCond_Always);
+                        g_SpectrumFitPeaks = false;
+                    }
+
+                    PlotSpectrum("S(E)", spectrum);
+
+                    ImPlot::EndPlot();
+                }
+
+                if(ImPlot::BeginPlot("Autocorrelation")) {
+                    ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+                    ImPlot::SetupAxesLimits(0, g_QuantumSimulator.GetIteration(), 0, 0);
+
+                    PlotRecord("Re C", g_QuantumSimulator.GetAutocorrelationRealRecordColumn());
+                    PlotRecord("Im C", g_QuantumSimulator.GetAutocorrelationImaginaryRecordColumn());
 
                     ImPlot::EndPlot();
                 }
@@ -811,6 +1404,24 @@ namespace {
 
             ImGui::TextWrapped("C++20 (%ld), clang v" __clang_version__, __cplusplus);
 
+            // Depends on the build variant the page loaded (see the Makefile)
+            #ifdef __wasm_simd128__
+            constexpr bool BuildHasSimd = true;
+            #else
+            constexpr bool BuildHasSimd = false;
+            #endif
+            #ifdef __EMSCRIPTEN_PTHREADS__
+            constexpr bool BuildHasThreads = true;
+            #else
+            constexpr bool BuildHasThreads = false;
+            #endif
+            #ifdef NDEBUG
+            constexpr const char BuildType[] = "release";
+            #else
+            constexpr const char BuildType[] = "debug";
+            #endif
+            ImGui::TextWrapped("%s build, SIMD128: %s, threads: %s", BuildType, BuildHasSimd ? "yes" : "no", BuildHasThreads ? "yes" : "no");
+
             ImGui::Separator();
 
             const auto em_ver = (char*)emscripten_get_compiler_setting("EMSCRIPTEN_VERSION");
@@ -867,17 +1478,122 @@ namespace {
             ImGui::End();
         }
 
-        ImGui::Render();
+        if(g_DisplayPerformanceWindow) {
+            ImGui::SetNextWindowSize(ImVec2(700, 600), ImGuiCond_Once);
+            ImGui::Begin("Performance", &g_DisplayPerformanceWindow);
 
-        glfwMakeContextCurrent(g_Window);
-        int display_w, display_h;
-        glfwGetFramebufferSize(g_Window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
-        glClearColor(ClearColor.x, ClearColor.y, ClearColor.z, ClearColor.w);
-        glClear(GL_COLOR_BUFFER_BIT);
+            const auto frame_count = g_PerfMonitor.GetFrameCount();
+            const auto frame_stats = g_PerfMonitor.ComputeFrameStats();
+            ImGui::TextWrapped("Main loop time (last %zu frames): p50 %.2f ms, p95 %.2f ms, max %.2f ms", frame_count, frame_stats.p50, frame_stats.p95, frame_stats.max);
 
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        glfwMakeContextCurrent(g_Window);
+            std::array<PerfStats, PerfPhaseCount> phase_stats;
+            for(size_t i = 0; i < PerfPhaseCount; i++) {
+                phase_stats[i] = g_PerfMonitor.ComputePhaseStats(static_cast<PerfPhase>(i));
+            }
+
+            // Typical (median) time of each group of phases, to tell where a slow run is bound
+            const auto source_time = phase_stats[static_cast<size_t>(PerfPhase::Psi0Sampling)].p50 + phase_stats[static_cast<size_t>(PerfPhase::VSampling)].p50;
+            const auto solver_time = phase_stats[static_cast<size_t>(PerfPhase::Propagation)].p50 + phase_stats[static_cast<size_t>(PerfPhase::Observables)].p50;
+            const auto render_time = phase_stats[static_cast<size_t>(PerfPhase::PlotSubmission)].p50 + phase_stats[static_cast<size_t>(PerfPhase::Render)].p50;
+            const auto bound_time = std::max({ source_time, solver_time, render_time });
+            if(bound_time > 0) {
+                const auto bound_name = (bound_time == source_time) ? "Ψ0/V sampling (source evaluation)" : ((bound_time == solver_time) ? "the solver" : "rendering");
+                ImGui::TextWrapped("Most time goes to %s (%.2f ms per frame)", bound_name, bound_time);
+            }
+
+            if(ImGui::CollapsingHeader("Trace")) {
+                #if QUANTIZE_TRACING
+                auto trace_enabled = trace::IsEnabled();
+                if(ImGui::Checkbox("Record trace", &trace_enabled)) {
+                    trace::SetEnabled(trace_enabled);
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Record frames, iterations (and their phases) and JS calls, keeping the last %zu events", trace::EventCapacity);
+                }
+
+                ImGui::SameLine();
+                if(ImGui::Button("Clear")) {
+                    trace::Clear();
+                }
+                ImGui::SameLine();
+                if(ImGui::Button("Download")) {
+                    SaveTrace();
+                }
+                if(ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Download as Chrome trace JSON (open in chrome://tracing or ui.perfetto.dev)");
+                }
+
+                ImGui::TextWrapped("Recorded events: %zu", trace::GetEventCount());
+                #else
+                ImGui::TextWrapped("Tracing is not available in this build");
+                #endif
+            }
+
+            if(ImGui::CollapsingHeader("Phase statistics", ImGuiTreeNodeFlags_DefaultOpen)) {
+                if(ImGui::BeginTable("Phase statistics table", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                    ImGui::TableSetupColumn("Phase");
+                    ImGui::TableSetupColumn("p50 (ms)");
+                    ImGui::TableSetupColumn("p95 (ms)");
+                    ImGui::TableSetupColumn("max (ms)");
+                    ImGui::TableHeadersRow();
+
+                    for(size_t i = 0; i < PerfPhaseCount; i++) {
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%s", PerfPhaseNames[i]);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", phase_stats[i].p50);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", phase_stats[i].p95);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", phase_stats[i].max);
+                    }
+
+                    ImGui::EndTable();
+                }
+            }
+
+            if(ImGui::CollapsingHeader("Per-frame breakdown", ImGuiTreeNodeFlags_DefaultOpen) && (frame_count > 0)) {
+                g_PerfPlotValues.resize(PerfPhaseCount * frame_count);
+                for(size_t i = 0; i < PerfPhaseCount; i++) {
+                    for(size_t j = 0; j < frame_count; j++) {
+                        g_PerfPlotValues[i * frame_count + j] = g_PerfMonitor.GetPhaseTime(j, static_cast<PerfPhase>(i));
+                    }
+                }
+
+                if(ImPlot::BeginPlot("Frame phases", ImVec2(-1, -1))) {
+                    ImPlot::SetupAxes("Frame", "Time (ms)", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+
+                    ImPlot::PlotBarGroups(PerfPhaseNames, g_PerfPlotValues.data(), static_cast<int>(PerfPhaseCount), static_cast<int>(frame_count), 1.0, 0, ImPlotBarGroupsFlags_Stacked);
+
+                    ImPlot::EndPlot();
+                }
+            }
+
+            ImGui::End();
+        }
+
+        const auto plot_end_time = GetCurrentTimeMs();
+        g_PerfMonitor.AddPhaseTime(PerfPhase::PlotSubmission, plot_end_time - plot_start_time);
+        _TRACE_EVENT("Plot submission", plot_start_time, plot_end_time);
+
+        {
+            _TRACE_SCOPE("Render");
+            ScopedPerfTimer render_timer(g_PerfMonitor, PerfPhase::Render);
+            ImGui::Render();
+
+            glfwMakeContextCurrent(g_Window);
+            int display_w, display_h;
+            glfwGetFramebufferSize(g_Window, &display_w, &display_h);
+            glViewport(0, 0, display_w, display_h);
+            glClearColor(ClearColor.x, ClearColor.y, ClearColor.z, ClearColor.w);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            glfwMakeContextCurrent(g_Window);
+        }
+
+        g_PerfMonitor.EndFrame(GetCurrentTimeMs() - frame_start_time);
     }
 
     int InitializeGlfw() {
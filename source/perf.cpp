@@ -0,0 +1,70 @@
+#include "perf.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    PerfStats ComputeStats(std::vector<double> &samples) {
+        if(samples.empty()) {
+            return {};
+        }
+
+        // Nearest-rank percentiles
+        const auto percentile = [&](const double p) {
+            const auto rank = std::min(samples.size() - 1, static_cast<size_t>(std::ceil(p * samples.size())) - 1);
+            std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+            return samples[rank];
+        };
+        const auto p50 = percentile(0.5);
+        const auto p95 = percentile(0.95);
+        return { p50, p95, *std::max_element(samples.begin(), samples.end()) };
+    }
+
+}
+
+PerfMonitor::PerfMonitor(const size_t capacity) : frame_times(capacity * PerfPhaseCount, 0.0), capacity(capacity), next_frame(0), frame_count(0), cur_frame({}) {}
+
+void PerfMonitor::EndFrame(const double frame_time_ms) {
+    double phase_sum = 0.0;
+    for(size_t i = 0; i < PerfPhaseCount; i++) {
+        if(i != static_cast<size_t>(PerfPhase::Other)) {
+            phase_sum += this->cur_frame[i];
+        }
+    }
+    this->cur_frame[static_cast<size_t>(PerfPhase::Other)] += std::max(0.0, frame_time_ms - phase_sum);
+
+    std::copy(this->cur_frame.begin(), this->cur_frame.end(), this->frame_times.begin() + this->next_frame * PerfPhaseCount);
+    this->next_frame = (this->next_frame + 1) % this->capacity;
+    this->frame_count = std::min(this->frame_count + 1, this->capacity);
+    this->cur_frame = {};
+}
+
+double PerfMonitor::GetFrameTime(const size_t frame_idx) const {
+    double frame_time = 0.0;
+    for(size_t i = 0; i < PerfPhaseCount; i++) {
+        frame_time += this->GetPhaseTime(frame_idx, static_cast<PerfPhase>(i));
+    }
+    return frame_time;
+}
+
+PerfStats PerfMonitor::ComputePhaseStats(const PerfPhase phase) const {
+    std::vector<double> samples(this->frame_count);
+    for(size_t i = 0; i < this->frame_count; i++) {
+        samples[i] = this->GetPhaseTime(i, phase);
+    }
+    return ComputeStats(samples);
+}
+
+PerfStats PerfMonitor::ComputeFrameStats() const {
+    std::vector<double> samples(this->frame_count);
+    for(size_t i = 0; i < this->frame_count; i++) {
+        samples[i] = this->GetFrameTime(i);
+    }
+    return ComputeStats(samples);
+}
+
+void PerfMonitor::Clear() {
+    this->next_frame = 0;
+    this->frame_count = 0;
+    this->cur_frame = {};
+}
@@ -0,0 +1,54 @@
+#include "planner.hpp"
+#include "base.hpp"
+#include "record.hpp"
+#include "spectrum.hpp"
+#include <cmath>
+
+namespace {
+
+    // Ψ, Ψ0, both factorization vectors and the solve scratch, then |Ψ|², x, j, V and the whole-grid V evaluation output
+    constexpr size_t SimulatorBytesPerPoint = 5 * sizeof(Num) + 5 * sizeof(double);
+    // Bluestein plans (see fft.hpp) work on power-of-two transforms of up to 4n points, with twiddles, the chirp transform and scratch buffers
+    constexpr size_t FftBytesPerPoint = 4 * (sizeof(Num) / 2 + sizeof(uint32_t) + 2 * sizeof(Num)) + 2 * sizeof(Num);
+    // Quantized components of the last frame and of the one being pushed
+    constexpr size_t HistoryBytesPerPoint = 2 * 2 * sizeof(int64_t);
+    // Samples, plus the transform (zero-padded to twice the samples) and its scratch
+    constexpr size_t SpectrumSize = (1 + 2 * 2) * AutocorrelationMaxSampleCount * sizeof(Num);
+
+    // Default costs (ms per grid point), in the order of what optimized WASM builds take
+    constexpr double DefaultPropagationCost = 5.0e-5;
+    constexpr double DefaultObservablesCost = 3.0e-5;
+    constexpr double DefaultCompiledVCost = 2.0e-5;
+    constexpr double DefaultJsVCost = 1.0e-3;
+    // Multiplied by log2(n)
+    constexpr double DefaultFftCost = 2.0e-5;
+
+}
+
+SimulationPlan PlanSimulation(const SimulationPlanInput &input) {
+    const auto n = static_cast<size_t>(std::max(input.dimensions, 0L));
+
+    SimulationPlan plan = {};
+    plan.grid_size = n * SimulatorBytesPerPoint;
+    if(input.uses_fft) {
+        plan.grid_size += n * FftBytesPerPoint;
+    }
+    plan.record_size = input.record_column_count * RecordColumn::GetMaxMemorySize() + SpectrumSize;
+    if(input.history_enabled) {
+        plan.history_size = input.history_budget + n * HistoryBytesPerPoint;
+    }
+    plan.extra_size = n * input.extra_bytes_per_point + input.extra_fixed_bytes;
+    plan.total_size = plan.grid_size + plan.record_size + plan.history_size + plan.extra_size;
+
+    // Everything is assumed to scale like propagation does between this machine and the defaults
+    const auto cost_scale = (input.measured_propagation_cost > 0) ? (input.measured_propagation_cost / DefaultPropagationCost) : 1.0;
+    auto point_cost = DefaultPropagationCost + DefaultObservablesCost;
+    if(input.v_time_dependent) {
+        point_cost += input.v_compiled ? DefaultCompiledVCost : DefaultJsVCost;
+    }
+    if(input.uses_fft && (n > 1)) {
+        point_cost += DefaultFftCost * std::log2(static_cast<double>(n));
+    }
+    plan.step_time = cost_scale * point_cost * n;
+    return plan;
+}
@@ -0,0 +1,173 @@
+#include "psi_history.hpp"
+#include <cmath>
+
+namespace {
+
+    inline void WriteVarint(std::vector<uint8_t> &data, const int64_t val) {
+        // Zigzag, so that small negative values are small too
+        auto zz = (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63);
+        while(zz >= 0x80) {
+            data.push_back(static_cast<uint8_t>(zz | 0x80));
+            zz >>= 7;
+        }
+        data.push_back(static_cast<uint8_t>(zz));
+    }
+
+    inline int64_t ReadVarint(const std::vector<uint8_t> &data, size_t &offset) {
+        uint64_t zz = 0;
+        int shift = 0;
+        while(true) {
+            const auto byte = data[offset++];
+            zz |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) {
+                break;
+            }
+            shift += 7;
+        }
+        return static_cast<int64_t>(zz >> 1) ^ -static_cast<int64_t>(zz & 1);
+    }
+
+}
+
+void PsiHistory::Configure(const size_t memory_budget, const double tolerance) {
+    this->memory_budget = memory_budget;
+    this->tolerance = tolerance;
+    this->Clear();
+}
+
+void PsiHistory::Clear() {
+    this->first_ti = -1;
+    this->stride = 1;
+    this->n = 0;
+    this->frame_count = 0;
+    this->over_budget = false;
+    this->segments.clear();
+    this->last_q.clear();
+}
+
+void PsiHistory::EncodeFrame(const std::vector<int64_t> &q) {
+    if(this->segments.empty() || (this->segments.back().frame_count == PsiHistoryKeyframeInterval)) {
+        if(!this->segments.empty()) {
+            this->segments.back().data.shrink_to_fit();
+        }
+        this->segments.emplace_back();
+        this->segments.back().frame_count = 0;
+    }
+
+    auto &segment = this->segments.back();
+    if(segment.frame_count == 0) {
+        for(const auto val: q) {
+            WriteVarint(segment.data, val);
+        }
+    }
+    else {
+        for(size_t i = 0; i < q.size(); i++) {
+            WriteVarint(segment.data, q[i] - this->last_q[i]);
+        }
+    }
+    segment.frame_count++;
+    this->last_q = q;
+    this->frame_count++;
+}
+
+void PsiHistory::DecodeFrame(const Segment &segment, size_t &offset, const bool is_keyframe, std::vector<int64_t> &q) const {
+    if(is_keyframe) {
+        for(auto &val: q) {
+            val = ReadVarint(segment.data, offset);
+        }
+    }
+    else {
+        for(auto &val: q) {
+            val += ReadVarint(segment.data, offset);
+        }
+    }
+}
+
+void PsiHistory::DropOddFrames() {
+    auto old_segments = std::move(this->segments);
+    this->segments = {};
+    this->frame_count = 0;
+
+    std::vector<int64_t> q(2 * this->n);
+    size_t frame_idx = 0;
+    for(auto &segment: old_segments) {
+        size_t offset = 0;
+        for(size_t i = 0; i < segment.frame_count; i++) {
+            this->DecodeFrame(segment, offset, i == 0, q);
+            if((frame_idx % 2) == 0) {
+                this->EncodeFrame(q);
+            }
+            frame_idx++;
+        }
+        // Release memory as soon as possible, the budget might be tight (assigning {} would keep the capacity)
+        segment.data.clear();
+        segment.data.shrink_to_fit();
+    }
+    this->stride *= 2;
+}
+
+void PsiHistory::Push(const long ti, const CVector &psi_vec) {
+    if((this->first_ti < 0) || (psi_vec.size() != this->n) || (ti < this->first_ti)) {
+        this->Clear();
+        this->first_ti = ti;
+        this->n = psi_vec.size();
+    }
+    if(this->over_budget || (((ti - this->first_ti) % this->stride) != 0)) {
+        return;
+    }
+
+    const auto step = 2 * this->tolerance;
+    const auto psi_data = reinterpret_cast<const double*>(psi_vec.data());
+    // Resizing is a no-op while the grid stays the same
+    this->push_q.resize(2 * this->n);
+    for(size_t i = 0; i < this->push_q.size(); i++) {
+        this->push_q[i] = std::llround(psi_data[i] / step);
+    }
+    this->EncodeFrame(this->push_q);
+
+    while(this->GetEncodedSize() > this->memory_budget) {
+        if(this->frame_count <= PsiHistoryMinFrameCount) {
+            this->frame_count = 0;
+            this->over_budget = true;
+            this->segments.clear();
+            this->last_q.clear();
+            this->last_q.shrink_to_fit();
+            this->push_q.clear();
+            this->push_q.shrink_to_fit();
+            return;
+        }
+        this->DropOddFrames();
+    }
+}
+
+bool PsiHistory::Reconstruct(const size_t frame_idx, CVector &out_psi_vec) const {
+    if(frame_idx >= this->frame_count) {
+        return false;
+    }
+
+    const auto &segment = this->segments.at(frame_idx / PsiHistoryKeyframeInterval);
+    std::vector<int64_t> q(2 * this->n);
+    size_t offset = 0;
+    for(size_t i = 0; i <= (frame_idx % PsiHistoryKeyframeInterval); i++) {
+        this->DecodeFrame(segment, offset, i == 0, q);
+    }
+
+    const auto step = 2 * this->tolerance;
+    out_psi_vec.resize(this->n);
+    for(long xi = 0; xi < this->n; xi++) {
+        out_psi_vec(xi) = Num(q[2 * xi] * step, q[2 * xi + 1] * step);
+    }
+    return true;
+}
+
+size_t PsiHistory::GetEncodedSize() const {
+    size_t size = 0;
+    for(const auto &segment: this->segments) {
+        size += segment.data.capacity();
+    }
+    return size;
+}
+
+size_t PsiHistory::GetMemorySize() const {
+    return this->GetEncodedSize() + (this->last_q.capacity() + this->push_q.capacity()) * sizeof(int64_t);
+}
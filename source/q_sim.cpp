@@ -1,80 +1,148 @@
 #include "q_sim.hpp"
 #include "def_psi0.hpp"
 #include "def_v.hpp"
-
-// Due to limitations in C++/JS bindings (in the return types), 3 functions are needed:
-// - *_Test to test if the function is properly defined (no exceptions arise and proper return type) for the given position/time
-// - *_Real and *_Imaginary to return a complex result in parts (with V the return value is real and this separation is thankfully not needed)
-
-EM_JS(JsResult, sim_Psi0_Test, (const double x), {
-    try {
-        var psi0_val = psi0(x);
-        math.complex(psi0_val);
-        return 0;
+#include "trace.hpp"
+
+void QuantumSimulator::PrepareCompiledSource(CompiledSource &compiled, const char *src, const src::GridFunctionKind kind) {
+    compiled.eval_time = 0;
+    compiled.js_sample_count = 0;
+
+    if(compiled.src != src) {
+        compiled.src = src;
+        compiled.compile_ok = false;
+        compiled.error.clear();
+        compiled.time_dependent = true;
+
+        src::Program program;
+        if(!src::Parse(src, program, compiled.error)) {
+            compiled.active = false;
+            return;
+        }
+        if(kind == src::GridFunctionKind::V) {
+            const auto v_fn = program.FindFunction("V");
+            if(v_fn != nullptr) {
+                compiled.time_dependent = (v_fn->params.size() > 1) && src::References(*v_fn->body, v_fn->params.at(1));
+            }
+        }
+        if(!this->evaluator->CompileGridFunction(program, kind, compiled.error)) {
+            compiled.active = false;
+            return;
+        }
+        compiled.compile_ok = true;
     }
-    catch {
-        return 1;
+    else if(!compiled.compile_ok) {
+        // Already failed to compile this very source
+        compiled.active = false;
+        return;
     }
-});
-
-EM_JS(double, sim_Psi0_Real, (const double x), {
-    return math.complex(psi0(x)).re;
-});
 
-EM_JS(double, sim_Psi0_Imaginary, (const double x), {
-    return math.complex(psi0(x)).im;
-});
-
-EM_JS(JsResult, sim_V_Test, (const double x, const double t), {
-    try {
-        var v_val = V(x, t);
-        if(Number.isFinite(v_val)) {
-            return 0;
-        }
-        else {
-            return 2;
-        }
+    if(!this->grid_evaluation_enabled) {
+        compiled.active = false;
+        compiled.error = "whole-grid evaluation is disabled";
+        return;
     }
-    catch {
-        return 1;
+    compiled.active = this->evaluator->InstallGridFunction(kind, compiled.error);
+    if(compiled.active) {
+        compiled.error.clear();
     }
-});
+}
 
-EM_JS(double, sim_V, (const double x, const double t), {
-    return V(x, t);
-});
+bool QuantumSimulator::EvaluatePsi0Source() {
+    const auto eval_ok = this->evaluator->Evaluate(src::GridFunctionKind::Psi0, this->psi0_src, this->GetEvaluationVariables(), this->psi0_src_error);
+    if(eval_ok) {
+        this->psi0_src_error.clear();
+    }
+    this->NotifyPsi0SourceEvaluated(eval_ok);
+    return eval_ok;
+}
 
-namespace {
+bool QuantumSimulator::EvaluateVSource() {
+    const auto eval_ok = this->evaluator->Evaluate(src::GridFunctionKind::V, this->v_src, this->GetEvaluationVariables(), this->v_src_error);
+    if(eval_ok) {
+        this->v_src_error.clear();
+    }
+    this->NotifyVSourceEvaluated(eval_ok);
+    return eval_ok;
+}
 
-    bool sim_Psi0_tryGet(const double x, Num &out_psi0) {
-        if(JS_RC_SUCCEEDED(sim_Psi0_Test(x))) {
-            out_psi0 = Num(sim_Psi0_Real(x), sim_Psi0_Imaginary(x));
-            return true;
-        }
-        else {
-            return false;
+bool QuantumSimulator::SamplePsi0() {
+    const auto start_time = GetCurrentTimeMs();
+    long xi = 0;
+    if(this->psi0_compiled.active) {
+        while(xi < this->n) {
+            const auto rc = this->evaluator->EvaluatePsi0Grid(this->x_vec.data() + xi, this->n - xi, this->psi_vec.data() + xi);
+            if(rc == -1) {
+                xi = this->n;
+            }
+            else if(rc < 0) {
+                this->psi0_compiled.active = false;
+                this->psi0_compiled.error = "the compiled module failed at runtime";
+                break;
+            }
+            else {
+                // Leave the samples the grid function cannot handle to single-sample evaluation, and resume right after them
+                xi += rc;
+                Num cur_psi0;
+                if(!this->evaluator->TryGetPsi0(this->x_vec(xi), cur_psi0)) {
+                    this->psi0_src_ok = false;
+                    this->psi0_src_error = this->evaluator->GetSampleError();
+                    return false;
+                }
+                this->psi_vec(xi) = cur_psi0;
+                this->psi0_compiled.js_sample_count++;
+                xi++;
+            }
         }
     }
 
-    bool sim_V_TryGet(const double x, const double t, double &out_v) {
-        if(JS_RC_SUCCEEDED(sim_V_Test(x, t))) {
-            out_v = sim_V(x, t);
-            return true;
-        }
-        else {
+    Num cur_psi0;
+    for(; xi < this->n; xi++) {
+        if(!this->evaluator->TryGetPsi0(this->x_vec(xi), cur_psi0)) {
+            this->psi0_src_ok = false;
+            this->psi0_src_error = this->evaluator->GetSampleError();
             return false;
         }
+        this->psi_vec(xi) = cur_psi0;
     }
 
+    this->psi0_compiled.eval_time = GetCurrentTimeMs() - start_time;
+    return true;
 }
 
-bool QuantumSimulator::CreateCurrentVDiscreteVector() {
-    this->cur_v_vec = Vector::Zero(this->n);
+bool QuantumSimulator::SampleV(const long xi_start, const long xi_end, const double t) {
+    long xi = xi_start;
+    if(this->v_compiled.active) {
+        while(xi < xi_end) {
+            const auto rc = this->evaluator->EvaluateVGrid(this->x_vec.data() + xi, xi_end - xi, t, this->cur_v_vec.data() + xi);
+            if(rc == -1) {
+                xi = xi_end;
+            }
+            else if(rc < 0) {
+                this->v_compiled.active = false;
+                this->v_compiled.error = "the compiled module failed at runtime";
+                break;
+            }
+            else {
+                // Same as with Ψ0
+                xi += rc;
+                double cur_v;
+                if(!this->evaluator->TryGetV(this->x_vec(xi), t, cur_v)) {
+                    this->v_src_ok = false;
+                    this->v_src_error = this->evaluator->GetSampleError();
+                    return false;
+                }
+                this->cur_v_vec(xi) = cur_v;
+                this->v_compiled.js_sample_count++;
+                xi++;
+            }
+        }
+    }
 
     double cur_v;
-    for(long xi = 0; xi < this->n; xi++) {
-        if(!sim_V_TryGet(this->DiscreteX(xi), this->DiscreteT(this->cur_ti), cur_v)) {
+    for(; xi < xi_end; xi++) {
+        if(!this->evaluator->TryGetV(this->x_vec(xi), t, cur_v)) {
             this->v_src_ok = false;
+            this->v_src_error = this->evaluator->GetSampleError();
             return false;
         }
 
@@ -84,143 +152,565 @@ bool QuantumSimulator::CreateCurrentVDiscreteVector() {
     return true;
 }
 
-void QuantumSimulator::UpdateVariableRecords() {
-    this->rec_ti.push_back((double)this->cur_ti);
-
-    // Approximate integrals as finite sums with dx === our discretized space unit (works fine and it's straightforward to implement)
-    
-    double psi_norm = 0;
-    double left_prob = 0;
-    double mid_prob = 0;
-    double right_prob = 0;
-    for(long i = 0; i < this->n; i++) {
-        const auto cur_norm_contrib = this->psisq_vec(i) * this->dx;
+bool QuantumSimulator::UpdateChangedVSamples(const double t) {
+    // Any sample may have changed (edits between sparse probes would go unnoticed), thus resample the whole grid and compare every sample,
+    // where only the factorization is partially reused
+    const Vector prev_v_vec = this->cur_v_vec;
+    if(!this->SampleV(0, this->n, t)) {
+        return false;
+    }
+    long first_changed = this->n;
+    for(long xi = 0; xi < this->n; xi++) {
+        if(this->cur_v_vec(xi) != prev_v_vec(xi)) {
+            first_changed = xi;
+            break;
+        }
+    }
 
-        psi_norm += cur_norm_contrib;
+    // Factors before the first changed row are still valid
+    this->cn_factor_rows = std::min(this->cn_factor_rows, first_changed);
+    return true;
+}
 
-        if(this->DiscreteX(i) <= this->left_region_sep) {
-            left_prob += cur_norm_contrib;
+bool QuantumSimulator::CreateCurrentVDiscreteVector() {
+    const auto same_grid = (this->cur_v_vec.size() == this->n) && (this->v_vec_x_0 == this->x_0) && (this->v_vec_dx == this->dx);
+
+    if(this->v_table != nullptr) {
+        // Tabulated potentials are time-independent, only resample them when the grid changes
+        if(!same_grid) {
+            this->v_table->Resample(this->x_vec, this->v_table_interp, false, this->cur_v_vec);
+            this->v_vec_x_0 = this->x_0;
+            this->v_vec_dx = this->dx;
+            this->cn_factor_rows = 0;
         }
-        else if(this->DiscreteX(i) >= this->right_region_sep) {
-            right_prob += cur_norm_contrib;
+        return true;
+    }
+
+    const auto t = this->DiscreteT(this->cur_ti);
+    if((this->cur_ti > 0) && !this->v_compiled.time_dependent) {
+        // Neither the samples nor the propagator factorization need to be updated
+        return true;
+    }
+
+    const auto start_time = GetCurrentTimeMs();
+    this->v_compiled.js_sample_count = 0;
+
+    if((this->cur_ti == 0) && same_grid && (this->v_vec_t == t)) {
+        // Typically after editing V: compare with the previous samples, and refactorize only from where the potential changed
+        if(!this->UpdateChangedVSamples(t)) {
+            return false;
         }
-        else {
-            mid_prob += cur_norm_contrib;
+    }
+    else {
+        this->cur_v_vec = Vector::Zero(this->n);
+        if(!this->SampleV(0, this->n, t)) {
+            return false;
         }
+        this->cn_factor_rows = 0;
     }
-    left_prob /= psi_norm;
-    mid_prob /= psi_norm;
-    right_prob /= psi_norm;
-    this->rec_norm.push_back(psi_norm);
-    this->rec_left_prob.push_back(left_prob);
-    this->rec_mid_prob.push_back(mid_prob);
-    this->rec_right_prob.push_back(right_prob);
-    
-    double x_est = 0;
-    for(long i = 0; i < this->n; i++) {
-        x_est += this->x_vec(i) * this->psisq_vec(i) * this->dx;
+
+    this->v_vec_x_0 = this->x_0;
+    this->v_vec_dx = this->dx;
+    this->v_vec_t = t;
+    this->v_compiled.eval_time = GetCurrentTimeMs() - start_time;
+    return true;
+}
+
+void QuantumSimulator::UpdatePropagatorFactorization() {
+    // Crank-Nicolson: the next Ψ is Q⁻¹Ψ - Ψ, where Q is tridiagonal, thus its LU factorization (Thomas algorithm) is cached
+    // and only refactorized from the first row whose V sample changed
+    // Besides r, the V term of the diagonal is i·dt·V/2, so dt must match too (r stays the same when scaling both dt and m, for instance)
+    const auto r = kernel::ComputePropagatorR(this->hslash, this->m, this->dt, this->dx);
+    if((this->cn_diag.size() != this->n) || (this->cn_r != r) || (this->cn_dt != this->dt)) {
+        this->cn_lower = CVector::Zero(this->n);
+        this->cn_diag = CVector::Zero(this->n);
+        this->cn_r = r;
+        this->cn_dt = this->dt;
+        this->cn_factor_rows = 0;
     }
-    x_est /= psi_norm;
-    this->rec_x_est.push_back(x_est);
 
-    double x2_est = 0;
-    for(long i = 0; i < this->n; i++) {
-        x2_est += pow(this->x_vec(i), 2) * this->psisq_vec(i) * this->dx;
+    if(this->cn_factor_rows < this->n) {
+        const auto coeffs = kernel::MakePropagatorCoefficients(this->cn_r, this->hslash, this->m, this->dx);
+        this->kernels.factorize(coeffs, this->cur_v_vec.data(), this->n, this->cn_factor_rows, this->cn_lower.data(), this->cn_diag.data());
     }
-    x2_est /= psi_norm;
-    this->rec_x2_est.push_back(x2_est);
+    this->cn_factor_rows = this->n;
+}
 
-    const auto deltax = sqrt(x2_est - pow(x_est, 2));
-    this->rec_deltax.push_back(deltax);
+void QuantumSimulator::PropagatePsi() {
+    this->UpdatePropagatorFactorization();
 
-    double p_est = 0;
-    const CVector p_psi_vec = -I * this->hslash * VectorDerivative(this->psi_vec, this->dx);
-    const CVector cj_psi_vec = ConjugatedCVector(this->psi_vec);
-    for(long i = 0; i < this->n; i++) {
-        // Need to explicitly keep only the real part, even though p is an observable operator thus the result will be real anyway
-        p_est += (cj_psi_vec(i) * p_psi_vec(i) * this->dx).real();
+    // Resizing is a no-op while the grid stays the same
+    this->cn_scratch.resize(this->n);
+    const auto coeffs = kernel::MakePropagatorCoefficients(this->cn_r, this->hslash, this->m, this->dx);
+    this->kernels.solve(coeffs.off_diag, this->cn_lower.data(), this->cn_diag.data(), this->n, this->psi_vec.data(), this->cn_scratch.data());
+}
+
+void QuantumSimulator::ComputeMomentumTransform() {
+    // Resizing is a no-op while the grid stays the same, and the plan is only looked up again (which takes the cache lock) when it changes
+    this->phi_vec.resize(this->n);
+    if((this->fft_plan == nullptr) || (this->fft_plan->GetSize() != static_cast<size_t>(this->n))) {
+        this->fft_plan = GetFftPlan(this->n);
+    }
+    this->fft_plan->Forward(this->psi_vec.data(), this->phi_vec.data(), this->fft_scratch);
+}
+
+void QuantumSimulator::ComputeSpectralMomentumEstimates(double &out_p_est, double &out_p2_est) {
+    this->ComputeMomentumTransform();
+
+    // Bin k has p = 2πħk / (n dx), where bins from the middle onwards are negative momenta (k - n)
+    const auto dp = (2 * M_PI * this->hslash) / (this->n * this->dx);
+    double phi_norm = 0;
+    double p_sum = 0;
+    double p2_sum = 0;
+    for(long k = 0; k < this->n; k++) {
+        const auto p = ((k < (this->n + 1) / 2) ? k : (k - this->n)) * dp;
+        const auto phisq = std::norm(this->phi_vec(k));
+        phi_norm += phisq;
+        p_sum += p * phisq;
+        p2_sum += p * p * phisq;
     }
-    p_est /= psi_norm;
-    this->rec_p_est.push_back(p_est);
+    out_p_est = p_sum / phi_norm;
+    out_p2_est = p2_sum / phi_norm;
+}
 
-    double p2_est = 0;
-    const CVector p2_psi_vec = - pow(this->hslash, 2) * VectorDDerivative(this->psi_vec, this->dx);
+void QuantumSimulator::ComputeMomentumDistribution(Vector &out_p_vec, Vector &out_phisq_vec) {
+    this->ComputeMomentumTransform();
+
+    // Same normalization as Ψ (Parseval): |φ(p)|² = |FFT(Ψ)|² dx² / 2πħ
+    const auto dp = (2 * M_PI * this->hslash) / (this->n * this->dx);
+    const auto phisq_factor = pow(this->dx, 2) / (2 * M_PI * this->hslash);
+    out_p_vec.resize(this->n);
+    out_phisq_vec.resize(this->n);
+    const auto neg_count = this->n / 2;
     for(long i = 0; i < this->n; i++) {
-        // Same as above
-        p2_est += (cj_psi_vec(i) * p2_psi_vec(i) * this->dx).real();
+        const auto k = i - neg_count;
+        out_p_vec(i) = k * dp;
+        out_phisq_vec(i) = std::norm(this->phi_vec((k + this->n) % this->n)) * phisq_factor;
+    }
+}
+
+double QuantumSimulator::InterpolateCurrent(const double x) {
+    const auto pos = std::clamp((x - this->x_0) / this->dx, 0.0, static_cast<double>(this->n - 1));
+    const auto xi = std::min(static_cast<long>(pos), this->n - 2);
+    if(xi < 0) {
+        return 0;
+    }
+    const auto t = pos - xi;
+    return (1 - t) * this->current_vec(xi) + t * this->current_vec(xi + 1);
+}
+
+void QuantumSimulator::UpdateVariableRecords() {
+    if(this->history_enabled) {
+        this->psi_history.Push(this->cur_ti, this->psi_vec);
+    }
+    this->rec_ti.Push((double)this->cur_ti);
+
+    if(this->cur_ti == 0) {
+        this->psi0_vec = this->psi_vec;
+    }
+    // Note that Eigen's dot product conjugates the first vector (and dx cancels out)
+    const auto autocorr = this->psi0_vec.dot(this->psi_vec) / this->psi0_vec.squaredNorm();
+    this->rec_autocorr_re.Push(autocorr.real());
+    this->rec_autocorr_im.Push(autocorr.imag());
+    this->energy_spectrum.Push(this->cur_ti, autocorr);
+
+    // Approximate integrals as finite sums with dx === our discretized space unit (works fine and it's straightforward to implement)
+
+    // Region bounds are found beforehand (x <= xl is left, x >= xr is right), so that the fused pass below does not branch per point
+    const auto left_end = std::upper_bound(this->x_vec.begin(), this->x_vec.end(), this->left_region_sep) - this->x_vec.begin();
+    const auto right_start = std::max(left_end, std::lower_bound(this->x_vec.begin(), this->x_vec.end(), this->right_region_sep) - this->x_vec.begin());
+
+    // Single pass over |Ψ|² for the norm, region probabilities, <x> and <x²>
+    double psi_norm = 0;
+    double x_sum = 0;
+    double x2_sum = 0;
+    const auto accumulate_region = [&](const long xi_start, const long xi_end) {
+        double region_norm = 0;
+        for(long i = xi_start; i < xi_end; i++) {
+            const auto cur_norm_contrib = this->psisq_vec(i) * this->dx;
+            const auto x = this->x_vec(i);
+            region_norm += cur_norm_contrib;
+            x_sum += x * cur_norm_contrib;
+            x2_sum += x * x * cur_norm_contrib;
+        }
+        psi_norm += region_norm;
+        return region_norm;
+    };
+    auto left_prob = accumulate_region(0, left_end);
+    auto mid_prob = accumulate_region(left_end, right_start);
+    auto right_prob = accumulate_region(right_start, this->n);
+
+    // Single pass over Ψ and its neighbours for the probability current and the finite-difference <p>, <p²> and <H> terms
+    this->current_vec.resize(this->n);
+    const auto deriv_sums = this->kernels.derivative_observables(this->psi_vec.data(), this->cur_v_vec.data(), this->n, this->dx, this->hslash, this->m, this->current_vec.data());
+
+    left_prob /= psi_norm;
+    mid_prob /= psi_norm;
+    right_prob /= psi_norm;
+    this->rec_norm.Push(psi_norm);
+    this->rec_left_prob.Push(left_prob);
+    this->rec_mid_prob.Push(mid_prob);
+    this->rec_right_prob.Push(right_prob);
+
+    // Fluxes are integrated in time with the trapezoidal rule (they start at zero)
+    const auto left_current = this->InterpolateCurrent(this->left_region_sep) / psi_norm;
+    const auto right_current = this->InterpolateCurrent(this->right_region_sep) / psi_norm;
+    const auto has_prev_current = this->rec_left_current.GetCount() > 0;
+    const auto left_flux = has_prev_current ? (this->rec_left_flux.Back() + 0.5 * (this->rec_left_current.Back() + left_current) * this->dt) : 0.0;
+    const auto right_flux = has_prev_current ? (this->rec_right_flux.Back() + 0.5 * (this->rec_right_current.Back() + right_current) * this->dt) : 0.0;
+    this->rec_left_current.Push(left_current);
+    this->rec_right_current.Push(right_current);
+    this->rec_left_flux.Push(left_flux);
+    this->rec_right_flux.Push(right_flux);
+
+    const auto x_est = x_sum / psi_norm;
+    this->rec_x_est.Push(x_est);
+
+    const auto x2_est = x2_sum / psi_norm;
+    this->rec_x2_est.Push(x2_est);
+
+    const auto deltax = sqrt(x2_est - pow(x_est, 2));
+    this->rec_deltax.Push(deltax);
+
+    double p_est;
+    double p2_est;
+    if(this->spectral_momentum) {
+        this->ComputeSpectralMomentumEstimates(p_est, p2_est);
+    }
+    else {
+        p_est = deriv_sums.p / psi_norm;
+        p2_est = deriv_sums.p2 / psi_norm;
     }
-    p2_est /= psi_norm;
-    this->rec_p2_est.push_back(p2_est);
+    this->rec_p_est.Push(p_est);
+    this->rec_p2_est.Push(p2_est);
 
     const auto deltap = sqrt(p2_est - pow(p_est, 2));
-    this->rec_deltap.push_back(deltap);
+    this->rec_deltap.Push(deltap);
 
     const auto deltaprod = deltax * deltap;
-    this->rec_deltaprod.push_back(deltaprod);
+    this->rec_deltaprod.Push(deltaprod);
 
-    double energy_est = 0;
-    for(long i = 0; i < this->n; i++) {
-        const Num hm_psi_vec_i = (1.0 / (2.0 * this->m)) * p2_psi_vec(i) + this->cur_v_vec(i) * this->psi_vec(i);
-        // Same as above
-        energy_est += (cj_psi_vec(i) * hm_psi_vec_i * this->dx).real();
+    const auto energy_est = deriv_sums.energy / psi_norm;
+    this->rec_energy_est.Push(energy_est);
+
+    if(this->exporter != nullptr) {
+        const double row[] = { (double)this->cur_ti, psi_norm, x_est, x2_est, deltax, p_est, p2_est, deltap, deltaprod, energy_est, left_prob, mid_prob, right_prob, left_current, right_current, left_flux, right_flux, autocorr.real(), autocorr.imag() };
+        this->exporter->PushRow(row);
+        if((this->export_snapshot_interval > 0) && ((this->cur_ti % this->export_snapshot_interval) == 0)) {
+            this->exporter->PushSnapshot(this->cur_ti, this->psi_vec);
+        }
     }
-    energy_est /= psi_norm;
-    this->rec_energy_est.push_back(energy_est);
 }
 
 bool QuantumSimulator::ComputeNextIteration() {
+    _TRACE_SCOPE("Iteration");
+
+    // Each phase is timed from the end of the previous one
+    this->last_timings = {};
+    auto phase_start_time = GetCurrentTimeMs();
+    const auto end_phase = [&](double &phase_time, const char *trace_name) {
+        const auto cur_time = GetCurrentTimeMs();
+        phase_time += cur_time - phase_start_time;
+        _TRACE_EVENT(trace_name, phase_start_time, cur_time);
+        phase_start_time = cur_time;
+    };
+
     if(this->cur_ti == 0) {
         this->psi_vec = CVector::Zero(this->n);
         this->CreateXDiscreteVector();
 
-        Num cur_psi0;
-        for(long xi = 0; xi < this->n; xi++) {
-            if(!sim_Psi0_tryGet(this->DiscreteX(xi), cur_psi0)) {
-                this->psi0_src_ok = false;
+        if(this->psi0_table != nullptr) {
+            this->psi0_table->Resample(this->x_vec, this->psi0_table_interp, true, this->psi_vec);
+        }
+        else {
+            this->PrepareCompiledSource(this->psi0_compiled, this->psi0_src, src::GridFunctionKind::Psi0);
+            if(!this->SamplePsi0()) {
                 return false;
             }
-            this->psi_vec(xi) = cur_psi0;
+        }
+        end_phase(this->last_timings.psi0_sampling, "Ψ0 sampling");
+        if(this->v_table == nullptr) {
+            this->PrepareCompiledSource(this->v_compiled, this->v_src, src::GridFunctionKind::V);
         }
 
-        this->psisq_vec = NormSquaredVector(this->psi_vec);
         if(!this->CreateCurrentVDiscreteVector()) {
             return false;
         }
+        end_phase(this->last_timings.v_sampling, "V sampling");
+        NormSquaredVector(this->psi_vec, this->psisq_vec);
         this->UpdateVariableRecords();
+        end_phase(this->last_timings.observables, "Observables");
     }
     else {
-        this->psi_vec = this->CreateEvolutionMatrix() * this->psi_vec;
+        if((this->v_table == nullptr) && (this->v_compiled.src != this->v_src)) {
+            // Resumed from a checkpoint (V samples were restored, but the compiled module is still needed for time-dependent potentials)
+            this->PrepareCompiledSource(this->v_compiled, this->v_src, src::GridFunctionKind::V);
+            end_phase(this->last_timings.v_sampling, "V sampling");
+        }
+        this->PropagatePsi();
+        end_phase(this->last_timings.propagation, "Propagation");
+        const auto point_cost = this->last_timings.propagation / this->n;
+        this->propagation_point_cost = (this->propagation_point_cost > 0) ? (this->propagation_point_cost + PropagationCostSmoothing * (point_cost - this->propagation_point_cost)) : point_cost;
 
-        this->psisq_vec = NormSquaredVector(this->psi_vec);
         if(!this->CreateCurrentVDiscreteVector()) {
             return false;
         }
+        end_phase(this->last_timings.v_sampling, "V sampling");
+        NormSquaredVector(this->psi_vec, this->psisq_vec);
         this->UpdateVariableRecords();
+        end_phase(this->last_timings.observables, "Observables");
     }
 
     this->cur_ti++;
+
+    if((this->auto_checkpoint_interval > 0) && ((this->cur_ti % this->auto_checkpoint_interval) == 0)) {
+        // A failed checkpoint does not stop the simulation
+        std::string checkpoint_error;
+        if(!this->SaveCheckpoint(this->auto_checkpoint_path, checkpoint_error)) {
+            this->auto_checkpoint_error = checkpoint_error;
+        }
+    }
+    return true;
+}
+
+SimulationPlanInput QuantumSimulator::GetPlanInput() {
+    SimulationPlanInput input = {};
+    input.dimensions = this->n;
+    input.record_column_count = RecordColumnCount;
+    // Tabulated potentials are never resampled while the grid stays the same, and sources not prepared yet are assumed to be time-dependent (but compiled)
+    const auto v_prepared = this->v_compiled.src == this->v_src;
+    input.v_time_dependent = (this->v_table == nullptr) && (!v_prepared || this->v_compiled.time_dependent);
+    input.v_compiled = !v_prepared || this->v_compiled.active;
+    input.uses_fft = this->spectral_momentum;
+    input.history_enabled = this->history_enabled;
+    input.history_budget = this->psi_history.GetMemoryBudget();
+    input.measured_propagation_cost = this->propagation_point_cost;
+    return input;
+}
+
+size_t QuantumSimulator::GetRecordMemorySize() {
+    size_t size = 0;
+    for(const auto record: this->GetRecordColumns()) {
+        size += record->GetMemorySize();
+    }
+    return size;
+}
+
+bool QuantumSimulator::StartExport(const std::string &dir, const long snapshot_interval, std::string &out_error) {
+    this->StopExport();
+
+    // Same order as the rows pushed in UpdateVariableRecords
+    const std::vector<std::string> columns(std::begin(RecordColumnNames), std::end(RecordColumnNames));
+    const nlohmann::json header = {
+        { "format_version", ExportFormatVersion },
+        { "settings", this->GenerateSettings() },
+        { "dimensions", this->n },
+        { "record_columns", columns },
+        { "record_chunk_rows", RecordExportChunkRows },
+        { "snapshot_interval", snapshot_interval }
+    };
+
+    auto exporter = std::make_unique<SimulationExporter>();
+    if(!exporter->Start(dir, header, columns.size(), out_error)) {
+        return false;
+    }
+
+    this->exporter = std::move(exporter);
+    this->export_snapshot_interval = snapshot_interval;
+    return true;
+}
+
+void QuantumSimulator::StopExport() {
+    if(this->exporter != nullptr) {
+        this->exporter->Stop();
+        this->exporter = {};
+    }
+}
+
+bool QuantumSimulator::SaveCheckpoint(const std::string &path, std::string &out_error) {
+    if(this->cur_ti == 0) {
+        out_error = "the simulation has not started yet";
+        return false;
+    }
+
+    CheckpointSections sections;
+
+    CheckpointWriter settings_writer;
+    settings_writer.WriteString(this->GenerateSettings().dump());
+    sections[CheckpointSectionTag::Settings] = settings_writer.GetData();
+
+    CheckpointWriter state_writer;
+    state_writer.Write<int64_t>(this->cur_ti);
+    state_writer.Write<int64_t>(this->n);
+    state_writer.Write(this->left_region_sep);
+    state_writer.Write(this->right_region_sep);
+    state_writer.Write(this->v_vec_x_0);
+    state_writer.Write(this->v_vec_dx);
+    state_writer.Write(this->v_vec_t);
+    state_writer.Write(this->cn_r.real());
+    state_writer.Write(this->cn_r.imag());
+    state_writer.Write(this->cn_dt);
+    state_writer.Write<int64_t>(this->cn_factor_rows);
+    // Complex vectors are stored as interleaved real/imaginary parts
+    state_writer.WriteArray(reinterpret_cast<const double*>(this->psi_vec.data()), 2 * this->psi_vec.size());
+    state_writer.WriteArray(this->cur_v_vec.data(), this->cur_v_vec.size());
+    state_writer.WriteArray(reinterpret_cast<const double*>(this->cn_lower.data()), 2 * this->cn_lower.size());
+    state_writer.WriteArray(reinterpret_cast<const double*>(this->cn_diag.data()), 2 * this->cn_diag.size());
+    state_writer.WriteArray(reinterpret_cast<const double*>(this->psi0_vec.data()), 2 * this->psi0_vec.size());
+    sections[CheckpointSectionTag::State] = state_writer.GetData();
+
+    CheckpointWriter records_writer;
+    for(const auto record: this->GetRecordColumns()) {
+        record->Save(records_writer);
+    }
+    sections[CheckpointSectionTag::Records] = records_writer.GetData();
+
+    CheckpointWriter spectrum_writer;
+    this->energy_spectrum.Save(spectrum_writer);
+    sections[CheckpointSectionTag::Spectrum] = spectrum_writer.GetData();
+
+    return WriteCheckpointFile(path, sections, out_error);
+}
+
+bool QuantumSimulator::LoadCheckpoint(const std::string &path, std::string &out_error) {
+    CheckpointSections sections;
+    if(!ReadCheckpointFile(path, sections, out_error)) {
+        return false;
+    }
+    for(const auto tag: { CheckpointSectionTag::Settings, CheckpointSectionTag::State, CheckpointSectionTag::Records }) {
+        if(!sections.count(tag)) {
+            out_error = "checkpoint is missing section " + std::to_string(static_cast<uint32_t>(tag));
+            return false;
+        }
+    }
+
+    this->Reset();
+
+    CheckpointReader settings_reader(sections.at(CheckpointSectionTag::Settings));
+    std::string settings_json;
+    if(!settings_reader.ReadString(settings_json)) {
+        out_error = "invalid checkpoint settings";
+        return false;
+    }
+    try {
+        if(!this->UpdateFromSettings(nlohmann::json::parse(settings_json), out_error)) {
+            return false;
+        }
+    }
+    catch(std::exception &e) {
+        out_error = "invalid checkpoint settings: ";
+        out_error += e.what();
+        return false;
+    }
+
+    CheckpointReader state_reader(sections.at(CheckpointSectionTag::State));
+    int64_t cur_ti;
+    int64_t n;
+    double cn_r_re;
+    double cn_r_im;
+    int64_t cn_factor_rows;
+    std::vector<double> psi_data;
+    std::vector<double> v_data;
+    std::vector<double> cn_lower_data;
+    std::vector<double> cn_diag_data;
+    std::vector<double> psi0_data;
+    state_reader.Read(cur_ti);
+    state_reader.Read(n);
+    state_reader.Read(this->left_region_sep);
+    state_reader.Read(this->right_region_sep);
+    state_reader.Read(this->v_vec_x_0);
+    state_reader.Read(this->v_vec_dx);
+    state_reader.Read(this->v_vec_t);
+    state_reader.Read(cn_r_re);
+    state_reader.Read(cn_r_im);
+    state_reader.Read(this->cn_dt);
+    state_reader.Read(cn_factor_rows);
+    state_reader.ReadArray(psi_data);
+    state_reader.ReadArray(v_data);
+    state_reader.ReadArray(cn_lower_data);
+    state_reader.ReadArray(cn_diag_data);
+    state_reader.ReadArray(psi0_data);
+    const auto size = static_cast<size_t>(std::max<int64_t>(n, 0));
+    if(!state_reader.IsOk() || (cur_ti <= 0) || (n != this->n) || (psi_data.size() != (2 * size)) || (v_data.size() != size) || (cn_lower_data.size() != cn_diag_data.size()) || (!cn_lower_data.empty() && (cn_lower_data.size() != (2 * size))) || (psi0_data.size() != (2 * size))) {
+        this->Reset();
+        out_error = "invalid checkpoint state (dimensions do not match the settings)";
+        return false;
+    }
+
+    this->cur_ti = cur_ti;
+    this->CreateXDiscreteVector();
+    this->psi_vec = Eigen::Map<const CVector>(reinterpret_cast<const Num*>(psi_data.data()), n);
+    this->psi0_vec = Eigen::Map<const CVector>(reinterpret_cast<const Num*>(psi0_data.data()), n);
+    NormSquaredVector(this->psi_vec, this->psisq_vec);
+    this->cur_v_vec = Eigen::Map<const Vector>(v_data.data(), n);
+    this->current_vec.resize(n);
+    this->kernels.derivative_observables(this->psi_vec.data(), this->cur_v_vec.data(), n, this->dx, this->hslash, this->m, this->current_vec.data());
+    this->cn_r = Num(cn_r_re, cn_r_im);
+    if(cn_lower_data.empty()) {
+        this->cn_lower = {};
+        this->cn_diag = {};
+        this->cn_factor_rows = 0;
+    }
+    else {
+        this->cn_lower = Eigen::Map<const CVector>(reinterpret_cast<const Num*>(cn_lower_data.data()), n);
+        this->cn_diag = Eigen::Map<const CVector>(reinterpret_cast<const Num*>(cn_diag_data.data()), n);
+        this->cn_factor_rows = std::clamp<int64_t>(cn_factor_rows, 0, n);
+    }
+
+    CheckpointReader records_reader(sections.at(CheckpointSectionTag::Records));
+    for(const auto record: this->GetRecordColumns()) {
+        if(!record->Load(records_reader)) {
+            this->Reset();
+            out_error = "invalid checkpoint records";
+            return false;
+        }
+    }
+    if(this->rec_ti.GetCount() != static_cast<size_t>(cur_ti)) {
+        this->Reset();
+        out_error = "checkpoint records do not match its iteration";
+        return false;
+    }
+
+    // Optional (the spectrum would just start over otherwise)
+    if(sections.count(CheckpointSectionTag::Spectrum)) {
+        CheckpointReader spectrum_reader(sections.at(CheckpointSectionTag::Spectrum));
+        this->energy_spectrum.Load(spectrum_reader);
+    }
+
     return true;
 }
 
 void QuantumSimulator::Reset() {
+    // Exports cover a single run
+    this->StopExport();
     this->cur_ti = 0;
+    // V samples (and the propagator factorization) are kept, so that they can be partially reused after V edits
     this->x_vec = {};
-    this->cur_v_vec = {};
     this->psi_vec = {};
+    this->psi0_vec = {};
     this->psisq_vec = {};
-    this->rec_ti.clear();
-    this->rec_norm.clear();
-    this->rec_x_est.clear();
-    this->rec_x2_est.clear();
-    this->rec_deltax.clear();
-    this->rec_p_est.clear();
-    this->rec_p2_est.clear();
-    this->rec_deltap.clear();
-    this->rec_deltaprod.clear();
-    this->rec_energy_est.clear();
-    this->rec_left_prob.clear();
-    this->rec_mid_prob.clear();
-    this->rec_right_prob.clear();
+    this->current_vec = {};
+    this->rec_ti.Clear();
+    this->rec_norm.Clear();
+    this->rec_x_est.Clear();
+    this->rec_x2_est.Clear();
+    this->rec_deltax.Clear();
+    this->rec_p_est.Clear();
+    this->rec_p2_est.Clear();
+    this->rec_deltap.Clear();
+    this->rec_deltaprod.Clear();
+    this->rec_energy_est.Clear();
+    this->rec_left_prob.Clear();
+    this->rec_mid_prob.Clear();
+    this->rec_right_prob.Clear();
+    this->rec_left_current.Clear();
+    this->rec_right_current.Clear();
+    this->rec_left_flux.Clear();
+    this->rec_right_flux.Clear();
+    this->rec_autocorr_re.Clear();
+    this->rec_autocorr_im.Clear();
+    this->energy_spectrum.Clear();
+    this->psi_history.Clear();
     this->psi0_src_eval = false;
     this->psi0_src_ok = false;
     this->v_src_eval = false;
@@ -242,11 +732,49 @@ void QuantumSimulator::UpdateAll(const double hslash, const double m, const doub
     strcpy(this->v_src, DefaultVSource);
     this->v_src_eval = false;
     this->v_src_ok = false;
+    this->psi0_table = {};
+    this->psi0_table_interp = InterpolationKind::Linear;
+    this->v_table = {};
+    this->v_table_interp = InterpolationKind::Linear;
+    this->psi0_compiled = {};
+    this->v_compiled = {};
+    this->cur_v_vec = {};
+    this->cn_factor_rows = 0;
+    // Ψ vanishing at the boundaries is the only supported condition for now
+    this->kernels = kernel::SelectPropagationKernels<double>(kernel::Boundary::Dirichlet);
+}
+
+bool QuantumSimulator::LoadPsi0Table(const std::string &path, const InterpolationKind interp, std::string &out_error) {
+    auto table = std::make_shared<SampleTable>();
+    if(!table->Load(path, out_error)) {
+        return false;
+    }
+
+    this->psi0_table = std::move(table);
+    this->psi0_table_interp = interp;
+    return true;
 }
 
-bool QuantumSimulator::UpdateFromSettings(const nlohmann::json &settings) {
+bool QuantumSimulator::LoadVTable(const std::string &path, const InterpolationKind interp, std::string &out_error) {
+    auto table = std::make_shared<SampleTable>();
+    if(!table->Load(path, out_error)) {
+        return false;
+    }
+    if(table->IsComplex()) {
+        out_error = "V table must be real-valued (x, V columns)";
+        return false;
+    }
+
+    this->v_table = std::move(table);
+    this->v_table_interp = interp;
+    this->cur_v_vec = {};
+    return true;
+}
+
+bool QuantumSimulator::UpdateFromSettings(const nlohmann::json &settings, std::string &out_error) {
     #define _GET_ITEM(type, name, def) \
         if(!settings.count(#name)) { \
+            out_error = "Some fields are missing (expected fields: t_0, x_0, x_f, dt, dx, hslash, m, psi0_src, v_src)"; \
             return false; \
         } \
         const auto new_##name = settings.value<type>(#name, def);
@@ -264,6 +792,33 @@ bool QuantumSimulator::UpdateFromSettings(const nlohmann::json &settings) {
     this->UpdateAll(new_hslash, new_m, new_t_0, new_dt, new_x_0, new_x_f, new_dx);
     this->UpdatePsi0Source(new_psi0_src.c_str());
     this->UpdateVSource(new_v_src.c_str());
+
+    // Tables are optional, and referenced by path and content hash instead of being inlined
+
+    #define _GET_TABLE_ITEM(name, load_fn) \
+        if(settings.count(#name) && !settings[#name].is_null()) { \
+            const auto &table_item = settings[#name]; \
+            const auto path = table_item.value<std::string>("path", ""); \
+            const auto hash = table_item.value<std::string>("hash", ""); \
+            InterpolationKind interp = InterpolationKind::Linear; \
+            if(!ParseInterpolationKind(table_item.value<std::string>("interpolation", InterpolationKindNames[0]), interp)) { \
+                out_error = "Invalid " #name " interpolation kind"; \
+                return false; \
+            } \
+            std::string table_error; \
+            if(!this->load_fn(path, interp, table_error)) { \
+                out_error = "Unable to load " #name ": " + table_error; \
+                return false; \
+            } \
+            if(!hash.empty() && (hash != this->name->GetHashString())) { \
+                out_error = "Table '" + path + "' does not match the saved hash (the file has changed since the settings were saved)"; \
+                return false; \
+            } \
+        }
+
+    _GET_TABLE_ITEM(psi0_table, LoadPsi0Table);
+    _GET_TABLE_ITEM(v_table, LoadVTable);
+
     return true;
 }
 
@@ -283,5 +838,17 @@ nlohmann::json QuantumSimulator::GenerateSettings() {
     _SET_ITEM(psi0_src);
     _SET_ITEM(v_src);
 
+    #define _SET_TABLE_ITEM(name) \
+        if(this->name != nullptr) { \
+            settings[#name] = { \
+                { "path", this->name->GetPath() }, \
+                { "hash", this->name->GetHashString() }, \
+                { "interpolation", InterpolationKindNames[static_cast<size_t>(this->name##_interp)] } \
+            }; \
+        }
+
+    _SET_TABLE_ITEM(psi0_table);
+    _SET_TABLE_ITEM(v_table);
+
     return settings;
 }
@@ -0,0 +1,287 @@
+#include "record.hpp"
+#include <algorithm>
+#include <cmath>
+
+RecordColumn::RecordColumn() {
+    size_t block_size = 1;
+    for(auto &level: this->levels) {
+        block_size *= RecordBlockFactor;
+        level.block_size = block_size;
+    }
+    // The recent window never grows past this, thus pushing never reallocates it
+    this->recent.reserve(2 * RecordRecentCount);
+    this->Clear();
+}
+
+void RecordColumn::PushBlock(const size_t level_idx, const double min, const double max, const double sum, const size_t sample_count) {
+    auto &level = this->levels.at(level_idx);
+    if(level.acc_count == 0) {
+        level.acc_min = min;
+        level.acc_max = max;
+        level.acc_sum = sum;
+    }
+    else {
+        level.acc_min = std::min(level.acc_min, min);
+        level.acc_max = std::max(level.acc_max, max);
+        level.acc_sum += sum;
+    }
+    level.acc_count += sample_count;
+
+    if(level.acc_count < level.block_size) {
+        return;
+    }
+
+    if(level.chunks.empty() || (level.chunks.back().count == RecordChunkBlockCount)) {
+        level.chunks.emplace_back();
+        level.chunks.back().count = 0;
+    }
+    auto &chunk = level.chunks.back();
+    chunk.min[chunk.count] = level.acc_min;
+    chunk.max[chunk.count] = level.acc_max;
+    chunk.mean[chunk.count] = level.acc_sum / level.acc_count;
+    chunk.count++;
+    level.block_count++;
+
+    const auto is_last_level = (level_idx + 1) == RecordLevelCount;
+    if(!is_last_level) {
+        if(level.chunks.size() > RecordMaxLevelChunkCount) {
+            // Coarser levels still cover these samples
+            level.chunks.pop_front();
+            level.first_block += RecordChunkBlockCount;
+        }
+        this->PushBlock(level_idx + 1, level.acc_min, level.acc_max, level.acc_sum, level.acc_count);
+    }
+    level.acc_count = 0;
+}
+
+void RecordColumn::Push(const double val) {
+    this->recent.push_back(val);
+    this->count++;
+    if(this->recent.size() >= 2 * RecordRecentCount) {
+        // Slide the window by halves, so that this (linear) erase only happens every RecordRecentCount samples
+        this->recent.erase(this->recent.begin(), this->recent.begin() + RecordRecentCount);
+        this->recent_start += RecordRecentCount;
+    }
+
+    this->PushBlock(0, val, val, val, 1);
+}
+
+void RecordColumn::Clear() {
+    this->recent.clear();
+    this->recent_start = 0;
+    this->count = 0;
+    for(auto &level: this->levels) {
+        level.chunks.clear();
+        level.first_block = 0;
+        level.block_count = 0;
+        level.acc_min = 0;
+        level.acc_max = 0;
+        level.acc_sum = 0;
+        level.acc_count = 0;
+    }
+}
+
+void RecordColumn::Query(const size_t start, const size_t end, const size_t max_blocks, RecordSeries &out_series) const {
+    out_series.idx.clear();
+    out_series.min.clear();
+    out_series.max.clear();
+    out_series.mean.clear();
+    out_series.block_size = 1;
+
+    const auto actual_end = std::min(end, this->count);
+    if((start >= actual_end) || (max_blocks == 0)) {
+        return;
+    }
+    const auto span = actual_end - start;
+
+    if((start >= this->recent_start) && (span <= max_blocks)) {
+        for(size_t i = start; i < actual_end; i++) {
+            const auto val = this->recent.at(i - this->recent_start);
+            out_series.idx.push_back(static_cast<double>(i));
+            out_series.min.push_back(val);
+            out_series.max.push_back(val);
+            out_series.mean.push_back(val);
+        }
+        return;
+    }
+
+    // Finest level with few enough blocks which still covers the start of the range (the coarsest one otherwise)
+    size_t level_idx = 0;
+    for(; level_idx < (RecordLevelCount - 1); level_idx++) {
+        const auto &level = this->levels.at(level_idx);
+        const auto block_count = (span + level.block_size - 1) / level.block_size;
+        if((block_count <= max_blocks) && ((level.first_block * level.block_size) <= start)) {
+            break;
+        }
+    }
+
+    const auto &level = this->levels.at(level_idx);
+    const auto bs = level.block_size;
+    out_series.block_size = bs;
+
+    const auto first_block = std::max(start / bs, level.first_block);
+    const auto last_block = (actual_end - 1) / bs;
+    for(size_t b = first_block; (b <= last_block) && (b < level.block_count); b++) {
+        const auto &chunk = level.chunks.at((b - level.first_block) / RecordChunkBlockCount);
+        const auto chunk_b = (b - level.first_block) % RecordChunkBlockCount;
+        out_series.idx.push_back(b * bs + (bs - 1) / 2.0);
+        out_series.min.push_back(chunk.min[chunk_b]);
+        out_series.max.push_back(chunk.max[chunk_b]);
+        out_series.mean.push_back(chunk.mean[chunk_b]);
+    }
+
+    if(last_block >= level.block_count) {
+        // The incomplete last block is spread over the accumulators of this and every finer level
+        double min = 0;
+        double max = 0;
+        double sum = 0;
+        size_t sample_count = 0;
+        for(size_t i = 0; i <= level_idx; i++) {
+            const auto &acc_level = this->levels.at(i);
+            if(acc_level.acc_count == 0) {
+                continue;
+            }
+            min = (sample_count == 0) ? acc_level.acc_min : std::min(min, acc_level.acc_min);
+            max = (sample_count == 0) ? acc_level.acc_max : std::max(max, acc_level.acc_max);
+            sum += acc_level.acc_sum;
+            sample_count += acc_level.acc_count;
+        }
+        if(sample_count > 0) {
+            out_series.idx.push_back(level.block_count * bs + (sample_count - 1) / 2.0);
+            out_series.min.push_back(min);
+            out_series.max.push_back(max);
+            out_series.mean.push_back(sum / sample_count);
+        }
+    }
+}
+
+void RecordColumn::QueryBuckets(const size_t start, const size_t end, const size_t bucket_count, RecordSeries &out_series) const {
+    // Levels are RecordBlockFactor apart, so query up to that many blocks per bucket
+    RecordSeries blocks;
+    this->Query(start, end, bucket_count * RecordBlockFactor, blocks);
+    if(blocks.GetSize() <= bucket_count) {
+        out_series = std::move(blocks);
+        return;
+    }
+
+    out_series.idx.clear();
+    out_series.min.clear();
+    out_series.max.clear();
+    out_series.mean.clear();
+
+    const auto actual_end = std::min(end, this->count);
+    const auto bucket_width = static_cast<double>(actual_end - start) / bucket_count;
+    out_series.block_size = static_cast<size_t>(std::ceil(bucket_width));
+
+    size_t cur_bucket = bucket_count;
+    size_t cur_block_count = 0;
+    for(size_t i = 0; i < blocks.GetSize(); i++) {
+        const auto bucket = std::min(bucket_count - 1, static_cast<size_t>(std::max(0.0, blocks.idx.at(i) - start) / bucket_width));
+        if(bucket != cur_bucket) {
+            out_series.idx.push_back(blocks.idx.at(i));
+            out_series.min.push_back(blocks.min.at(i));
+            out_series.max.push_back(blocks.max.at(i));
+            out_series.mean.push_back(blocks.mean.at(i));
+            cur_bucket = bucket;
+            cur_block_count = 1;
+        }
+        else {
+            // Blocks are (but maybe the last one) equally sized, so they are equally weighted
+            cur_block_count++;
+            out_series.idx.back() += (blocks.idx.at(i) - out_series.idx.back()) / cur_block_count;
+            out_series.min.back() = std::min(out_series.min.back(), blocks.min.at(i));
+            out_series.max.back() = std::max(out_series.max.back(), blocks.max.at(i));
+            out_series.mean.back() += (blocks.mean.at(i) - out_series.mean.back()) / cur_block_count;
+        }
+    }
+}
+
+size_t RecordColumn::GetMemorySize() const {
+    auto size = this->recent.capacity() * sizeof(double);
+    for(const auto &level: this->levels) {
+        size += level.chunks.size() * sizeof(Chunk);
+    }
+    return size;
+}
+
+void RecordColumn::Save(CheckpointWriter &writer) const {
+    writer.Write<uint64_t>(this->count);
+    writer.Write<uint64_t>(this->recent_start);
+    writer.WriteArray(this->recent.data(), this->recent.size());
+    for(const auto &level: this->levels) {
+        writer.Write<uint64_t>(level.first_block);
+        writer.Write<uint64_t>(level.block_count);
+        writer.Write(level.acc_min);
+        writer.Write(level.acc_max);
+        writer.Write(level.acc_sum);
+        writer.Write<uint64_t>(level.acc_count);
+
+        // Only the blocks still kept, chunks are rebuilt when loading
+        std::vector<double> min;
+        std::vector<double> max;
+        std::vector<double> mean;
+        for(const auto &chunk: level.chunks) {
+            min.insert(min.end(), chunk.min.begin(), chunk.min.begin() + chunk.count);
+            max.insert(max.end(), chunk.max.begin(), chunk.max.begin() + chunk.count);
+            mean.insert(mean.end(), chunk.mean.begin(), chunk.mean.begin() + chunk.count);
+        }
+        writer.WriteArray(min.data(), min.size());
+        writer.WriteArray(max.data(), max.size());
+        writer.WriteArray(mean.data(), mean.size());
+    }
+}
+
+bool RecordColumn::Load(CheckpointReader &reader) {
+    this->Clear();
+
+    uint64_t count;
+    uint64_t recent_start;
+    reader.Read(count);
+    reader.Read(recent_start);
+    reader.ReadArray(this->recent);
+    if(!reader.IsOk() || ((recent_start + this->recent.size()) != count)) {
+        this->Clear();
+        return false;
+    }
+    this->count = count;
+    this->recent_start = recent_start;
+
+    for(auto &level: this->levels) {
+        uint64_t first_block;
+        uint64_t block_count;
+        uint64_t acc_count;
+        std::vector<double> min;
+        std::vector<double> max;
+        std::vector<double> mean;
+        reader.Read(first_block);
+        reader.Read(block_count);
+        reader.Read(level.acc_min);
+        reader.Read(level.acc_max);
+        reader.Read(level.acc_sum);
+        reader.Read(acc_count);
+        reader.ReadArray(min);
+        reader.ReadArray(max);
+        reader.ReadArray(mean);
+        if(!reader.IsOk() || (min.size() != (block_count - first_block)) || (max.size() != min.size()) || (mean.size() != min.size())) {
+            this->Clear();
+            return false;
+        }
+
+        level.first_block = first_block;
+        level.block_count = block_count;
+        level.acc_count = acc_count;
+        for(size_t i = 0; i < min.size(); i++) {
+            if(level.chunks.empty() || (level.chunks.back().count == RecordChunkBlockCount)) {
+                level.chunks.emplace_back();
+                level.chunks.back().count = 0;
+            }
+            auto &chunk = level.chunks.back();
+            chunk.min[chunk.count] = min.at(i);
+            chunk.max[chunk.count] = max.at(i);
+            chunk.mean[chunk.count] = mean.at(i);
+            chunk.count++;
+        }
+    }
+
+    return true;
+}
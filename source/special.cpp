@@ -0,0 +1,227 @@
+#include "special.hpp"
+
+namespace {
+
+    // Recurrence coefficients of the normalized Hermite functions, grown on demand and kept across calls (per thread, since simulations may run concurrently):
+    // h_{k+1} = sqrt(2/(k+1)) * x * h_k - sqrt(k/(k+1)) * h_{k-1}
+
+    thread_local std::vector<double> g_HermiteFunctionCoefficientsA;
+    thread_local std::vector<double> g_HermiteFunctionCoefficientsB;
+
+    void EnsureHermiteFunctionCoefficients(const int n) {
+        for(int k = g_HermiteFunctionCoefficientsA.size(); k < n; k++) {
+            g_HermiteFunctionCoefficientsA.push_back(sqrt(2.0 / (k + 1)));
+            g_HermiteFunctionCoefficientsB.push_back(sqrt((double)k / (k + 1)));
+        }
+    }
+
+    // pi^(-1/4)
+    constexpr double HermiteFunctionBase = 0.7511255444649425;
+
+    // Ai(0) and -Ai'(0)
+    constexpr double AiryC1 = 0.3550280538878172;
+    constexpr double AiryC2 = 0.2588194037928068;
+
+    // Maclaurin series converge everywhere, but cancellation makes them lose precision for big |x|
+    constexpr double AirySeriesMin = -6.0;
+    constexpr double AirySeriesMax = 5.0;
+    constexpr int AiryAsymptoticTerms = 10;
+
+    double AiryAiSeries(const double x) {
+        const auto x3 = x * x * x;
+        double f = 1.0;
+        double g = x;
+        double f_term = 1.0;
+        double g_term = x;
+        for(int k = 1; k < 100; k++) {
+            f_term *= x3 / ((3 * k - 1) * (3 * k));
+            g_term *= x3 / ((3 * k) * (3 * k + 1));
+            f += f_term;
+            g += g_term;
+            if((std::abs(f_term) < 1e-17 * std::abs(f)) && (std::abs(g_term) < 1e-17 * std::abs(g))) {
+                break;
+            }
+        }
+        return AiryC1 * f - AiryC2 * g;
+    }
+
+    double AiryAiAsymptotic(const double x) {
+        // u_k = (6k-5)(6k-3)(6k-1) / ((2k-1) * 216 * k) * u_{k-1}
+        double u[AiryAsymptoticTerms] = { 1.0 };
+        for(int k = 1; k < AiryAsymptoticTerms; k++) {
+            u[k] = u[k - 1] * ((6 * k - 5) * (6 * k - 3) * (6 * k - 1)) / ((2 * k - 1) * 216.0 * k);
+        }
+
+        const auto z = std::abs(x);
+        const auto zeta = (2.0 / 3.0) * z * sqrt(z);
+        if(x > 0) {
+            double sum = 0.0;
+            double zeta_k = 1.0;
+            for(int k = 0; k < AiryAsymptoticTerms; k++) {
+                sum += ((k % 2) ? -1.0 : 1.0) * u[k] / zeta_k;
+                zeta_k *= zeta;
+            }
+            return exp(-zeta) * sum / (2.0 * sqrt(M_PI) * pow(z, 0.25));
+        }
+        else {
+            double sum_even = 0.0;
+            double sum_odd = 0.0;
+            double zeta_k = 1.0;
+            for(int k = 0; k < AiryAsymptoticTerms; k++) {
+                const auto sign = ((k / 2) % 2) ? -1.0 : 1.0;
+                if(k % 2) {
+                    sum_odd += sign * u[k] / zeta_k;
+                }
+                else {
+                    sum_even += sign * u[k] / zeta_k;
+                }
+                zeta_k *= zeta;
+            }
+            const auto phase = zeta + M_PI / 4.0;
+            return (sin(phase) * sum_even - cos(phase) * sum_odd) / (sqrt(M_PI) * pow(z, 0.25));
+        }
+    }
+
+}
+
+namespace special {
+
+    void GaussianPacketGrid(const Vector &x_vec, const double x0, const double k0, const double a, CVector &out_vec) {
+        const auto norm = pow(2.0 / (M_PI * a * a), 0.25);
+        const Eigen::ArrayXd dx_arr = x_vec.array() - x0;
+        const Eigen::ArrayXd amp_arr = norm * (-(dx_arr / a).square()).exp();
+        const Eigen::ArrayXd phase_arr = k0 * dx_arr;
+        out_vec.resize(x_vec.size());
+        out_vec.real() = (amp_arr * phase_arr.cos()).matrix();
+        out_vec.imag() = (amp_arr * phase_arr.sin()).matrix();
+    }
+
+    void DiracDeltaGrid(const Vector &x_vec, const double x0, const double val, const double dx, Vector &out_vec) {
+        out_vec = val * ((x_vec.array() - x0).abs() <= dx).cast<double>().matrix();
+    }
+
+    double HermitePolynomial(const int n, const double x) {
+        // H_{k+1} = 2*x*H_k - 2*k*H_{k-1}
+        double h_km1 = 0.0;
+        double h_k = 1.0;
+        for(int k = 0; k < n; k++) {
+            const auto h_kp1 = 2.0 * x * h_k - 2.0 * k * h_km1;
+            h_km1 = h_k;
+            h_k = h_kp1;
+        }
+        return h_k;
+    }
+
+    void HermitePolynomialGrid(const int n, const Vector &x_vec, Vector &out_vec) {
+        Eigen::ArrayXd h_km1 = Eigen::ArrayXd::Zero(x_vec.size());
+        Eigen::ArrayXd h_k = Eigen::ArrayXd::Ones(x_vec.size());
+        for(int k = 0; k < n; k++) {
+            h_km1 = 2.0 * x_vec.array() * h_k - 2.0 * k * h_km1;
+            h_k.swap(h_km1);
+        }
+        out_vec = h_k.matrix();
+    }
+
+    double HermiteFunction(const int n, const double x) {
+        EnsureHermiteFunctionCoefficients(n);
+
+        double h_km1 = 0.0;
+        double h_k = HermiteFunctionBase * exp(-0.5 * x * x);
+        for(int k = 0; k < n; k++) {
+            const auto h_kp1 = g_HermiteFunctionCoefficientsA[k] * x * h_k - g_HermiteFunctionCoefficientsB[k] * h_km1;
+            h_km1 = h_k;
+            h_k = h_kp1;
+        }
+        return h_k;
+    }
+
+    void HermiteFunctionGrid(const int n, const Vector &x_vec, Vector &out_vec) {
+        EnsureHermiteFunctionCoefficients(n);
+
+        // Run the recurrence over the whole grid at once, one (vectorizable) pass per order
+        Eigen::ArrayXd h_km1 = Eigen::ArrayXd::Zero(x_vec.size());
+        Eigen::ArrayXd h_k = HermiteFunctionBase * (-0.5 * x_vec.array().square()).exp();
+        for(int k = 0; k < n; k++) {
+            h_km1 = g_HermiteFunctionCoefficientsA[k] * x_vec.array() * h_k - g_HermiteFunctionCoefficientsB[k] * h_km1;
+            h_k.swap(h_km1);
+        }
+        out_vec = h_k.matrix();
+    }
+
+    double AiryAi(const double x) {
+        if((x >= AirySeriesMin) && (x <= AirySeriesMax)) {
+            return AiryAiSeries(x);
+        }
+        else {
+            return AiryAiAsymptotic(x);
+        }
+    }
+
+    void AiryAiGrid(const Vector &x_vec, Vector &out_vec) {
+        out_vec.resize(x_vec.size());
+        for(long i = 0; i < x_vec.size(); i++) {
+            out_vec(i) = AiryAi(x_vec(i));
+        }
+    }
+
+    double LaguerrePolynomial(const int n, const double alpha, const double x) {
+        // (k+1) * L_{k+1} = (2k+1+alpha-x) * L_k - (k+alpha) * L_{k-1}
+        double l_km1 = 0.0;
+        double l_k = 1.0;
+        for(int k = 0; k < n; k++) {
+            const auto l_kp1 = ((2 * k + 1 + alpha - x) * l_k - (k + alpha) * l_km1) / (k + 1);
+            l_km1 = l_k;
+            l_k = l_kp1;
+        }
+        return l_k;
+    }
+
+    void LaguerrePolynomialGrid(const int n, const double alpha, const Vector &x_vec, Vector &out_vec) {
+        Eigen::ArrayXd l_km1 = Eigen::ArrayXd::Zero(x_vec.size());
+        Eigen::ArrayXd l_k = Eigen::ArrayXd::Ones(x_vec.size());
+        for(int k = 0; k < n; k++) {
+            l_km1 = ((2 * k + 1 + alpha - x_vec.array()) * l_k - (k + alpha) * l_km1) / (k + 1);
+            l_k.swap(l_km1);
+        }
+        out_vec = l_k.matrix();
+    }
+
+    void SechGrid(const Vector &x_vec, const double x0, const double a, Vector &out_vec) {
+        out_vec = ((x_vec.array() - x0) / a).cosh().inverse().matrix();
+    }
+
+    void SolitonGrid(const Vector &x_vec, const double x0, const double k0, const double a, CVector &out_vec) {
+        const Eigen::ArrayXd dx_arr = x_vec.array() - x0;
+        const Eigen::ArrayXd amp_arr = (dx_arr / a).cosh().inverse() / sqrt(2.0 * a);
+        const Eigen::ArrayXd phase_arr = k0 * dx_arr;
+        out_vec.resize(x_vec.size());
+        out_vec.real() = (amp_arr * phase_arr.cos()).matrix();
+        out_vec.imag() = (amp_arr * phase_arr.sin()).matrix();
+    }
+
+    void SmoothStepGrid(const Vector &x_vec, const double x0, const double w, Vector &out_vec) {
+        out_vec = (0.5 * (1.0 + ((x_vec.array() - x0) / w).tanh())).matrix();
+    }
+
+    void PoschlTellerGrid(const Vector &x_vec, const double v0, const double x0, const double a, Vector &out_vec) {
+        out_vec = (-v0 * ((x_vec.array() - x0) / a).cosh().square().inverse()).matrix();
+    }
+
+    void MorseGrid(const Vector &x_vec, const double d, const double x0, const double a, Vector &out_vec) {
+        out_vec = (d * (1.0 - (-a * (x_vec.array() - x0)).exp()).square()).matrix();
+    }
+
+    void CosineLatticeGrid(const Vector &x_vec, const double v0, const double x0, const double d, Vector &out_vec) {
+        out_vec = (v0 * ((M_PI / d) * (x_vec.array() - x0)).cos().square()).matrix();
+    }
+
+    void KronigPenneyGrid(const Vector &x_vec, const double v0, const double x0, const double d, const double b, Vector &out_vec) {
+        out_vec.resize(x_vec.size());
+        for(long i = 0; i < x_vec.size(); i++) {
+            const auto rel_x = x_vec(i) - x0;
+            const auto period_x = rel_x - d * floor(rel_x / d);
+            out_vec(i) = (period_x < b) ? v0 : 0.0;
+        }
+    }
+
+}
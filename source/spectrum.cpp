@@ -0,0 +1,149 @@
+#include "spectrum.hpp"
+#include "fft.hpp"
+#include <algorithm>
+
+void EnergySpectrum::Clear() {
+    this->samples.clear();
+    this->first_ti = -1;
+    this->stride = 1;
+    this->computed_sample_count = 0;
+    this->energy_vec = {};
+    this->intensity_vec = {};
+    this->peak_energies.clear();
+}
+
+void EnergySpectrum::Push(const long ti, const Num autocorr) {
+    if((this->first_ti < 0) || (ti < this->first_ti)) {
+        this->Clear();
+        this->first_ti = ti;
+    }
+    if(((ti - this->first_ti) % this->stride) != 0) {
+        return;
+    }
+
+    this->samples.push_back(autocorr);
+    if(this->samples.size() >= AutocorrelationMaxSampleCount) {
+        for(size_t i = 0; i < this->samples.size() / 2; i++) {
+            this->samples[i] = this->samples[2 * i];
+        }
+        this->samples.resize(this->samples.size() / 2);
+        this->stride *= 2;
+    }
+}
+
+bool EnergySpectrum::Update(const double hslash, const double dt) {
+    const auto sample_count = this->samples.size();
+    if(sample_count < 2) {
+        return false;
+    }
+    // Recomputed once the samples grow by 1/16 (or after they were decimated), thus the cost stays proportional to the run length
+    const auto min_growth = std::max<size_t>(64, this->computed_sample_count / 16);
+    if((sample_count >= this->computed_sample_count) && ((sample_count - this->computed_sample_count) < min_growth)) {
+        return false;
+    }
+
+    // Zero-padded to (at least) twice the samples, for smoother peaks
+    size_t fft_size = 1;
+    while(fft_size < 2 * sample_count) {
+        fft_size <<= 1;
+    }
+    this->fft_vec.assign(fft_size, 0.0);
+    for(size_t j = 0; j < sample_count; j++) {
+        // Half Hann window (1 at t = 0, vanishing at t = T)
+        const auto w = 0.5 * (1 + std::cos(M_PI * j / sample_count));
+        // Conjugated, so that the forward transform has e^(+iEt/ħ)
+        this->fft_vec[j] = std::conj(w * this->samples[j]);
+    }
+    GetFftPlan(fft_size)->Forward(this->fft_vec.data(), this->fft_vec.data(), this->fft_scratch);
+
+    // S(E_k) = (ts / 2πħ) (2 Re(Σ_j w_j C_j e^(iE_k t_j/ħ)) - C(0)), with E_k = 2πħk / (N ts)
+    const auto ts = this->stride * dt;
+    const auto de = (2 * M_PI * hslash) / (fft_size * ts);
+    const auto factor = ts / (2 * M_PI * hslash);
+    const auto half_size = static_cast<long>(fft_size / 2);
+    this->energy_vec.resize(fft_size);
+    this->intensity_vec.resize(fft_size);
+    for(long i = 0; i < static_cast<long>(fft_size); i++) {
+        const auto k = i - half_size;
+        this->energy_vec(i) = k * de;
+        this->intensity_vec(i) = factor * (2 * this->fft_vec[(k + fft_size) % fft_size].real() - this->samples[0].real());
+    }
+
+    // Highest local maxima (ignoring tiny ones, mostly window ripples)
+    const auto threshold = 0.01 * this->intensity_vec.maxCoeff();
+    std::vector<std::pair<double, double>> peaks;
+    for(long i = 1; i < static_cast<long>(fft_size) - 1; i++) {
+        const auto val = this->intensity_vec(i);
+        if((val > threshold) && (val > this->intensity_vec(i - 1)) && (val >= this->intensity_vec(i + 1))) {
+            peaks.push_back({ val, this->energy_vec(i) });
+        }
+    }
+    std::sort(peaks.begin(), peaks.end(), [](const auto &a, const auto &b) {
+        return a.first > b.first;
+    });
+    peaks.resize(std::min(peaks.size(), SpectrumMaxPeakCount));
+    this->peak_energies.clear();
+    for(const auto &[val, energy]: peaks) {
+        this->peak_energies.push_back(energy);
+    }
+    std::sort(this->peak_energies.begin(), this->peak_energies.end());
+
+    this->computed_sample_count = sample_count;
+    return true;
+}
+
+void EnergySpectrum::QueryBuckets(const double e_min, const double e_max, const size_t bucket_count, RecordSeries &out_series) const {
+    out_series.idx.clear();
+    out_series.min.clear();
+    out_series.max.clear();
+    out_series.mean.clear();
+    out_series.block_size = 1;
+
+    const auto count = this->energy_vec.size();
+    if((count < 2) || (bucket_count == 0)) {
+        return;
+    }
+
+    // Energies are equally spaced, so the visible range is found directly
+    const auto e0 = this->energy_vec(0);
+    const auto de = this->energy_vec(1) - e0;
+    const auto start = static_cast<long>(std::clamp(std::floor((e_min - e0) / de), 0.0, static_cast<double>(count - 1)));
+    const auto end = static_cast<long>(std::clamp(std::ceil((e_max - e0) / de) + 1, static_cast<double>(start + 1), static_cast<double>(count)));
+    const auto block_size = std::max<long>(1, (end - start + bucket_count - 1) / bucket_count);
+    out_series.block_size = block_size;
+
+    for(long i = start; i < end; i += block_size) {
+        const auto block_end = std::min(end, i + block_size);
+        const auto block = this->intensity_vec.segment(i, block_end - i);
+        out_series.idx.push_back(0.5 * (this->energy_vec(i) + this->energy_vec(block_end - 1)));
+        out_series.min.push_back(block.minCoeff());
+        out_series.max.push_back(block.maxCoeff());
+        out_series.mean.push_back(block.mean());
+    }
+}
+
+void EnergySpectrum::Save(CheckpointWriter &writer) const {
+    writer.Write<int64_t>(this->first_ti);
+    writer.Write<int64_t>(this->stride);
+    writer.WriteArray(reinterpret_cast<const double*>(this->samples.data()), 2 * this->samples.size());
+}
+
+bool EnergySpectrum::Load(CheckpointReader &reader) {
+    this->Clear();
+
+    int64_t first_ti;
+    int64_t stride;
+    std::vector<double> sample_data;
+    reader.Read(first_ti);
+    reader.Read(stride);
+    reader.ReadArray(sample_data);
+    if(!reader.IsOk() || (stride <= 0) || ((sample_data.size() % 2) != 0)) {
+        return false;
+    }
+
+    this->first_ti = first_ti;
+    this->stride = stride;
+    const auto sample_ptr = reinterpret_cast<const Num*>(sample_data.data());
+    this->samples.assign(sample_ptr, sample_ptr + sample_data.size() / 2);
+    return true;
+}
@@ -0,0 +1,519 @@
+#include "src_ast.hpp"
+#include <cstring>
+#include <cstdlib>
+
+namespace src {
+
+    namespace {
+
+        enum class TokenKind {
+            Number,
+            Identifier,
+            Punct,
+            End
+        };
+
+        struct Token {
+            TokenKind kind;
+            std::string text;
+            double num;
+            int line;
+        };
+
+        // Only used internally to unwind the recursive descent, Parse() reports it as a regular error
+        struct ParseError {
+            std::string msg;
+        };
+
+        constexpr const char *Puncts[] = {
+            // Longest first, so that they are matched greedily
+            "===", "!==", "**=",
+            "==", "!=", "<=", ">=", "&&", "||", "**", "+=", "-=", "*=", "/=", "++", "--",
+            "+", "-", "*", "/", "%", "<", ">", "!", "=", "(", ")", "{", "}", ",", ";", "?", ":", "."
+        };
+
+        inline bool IsIdentifierStart(const char c) {
+            return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || (c == '_') || (c == '$');
+        }
+
+        inline bool IsIdentifierChar(const char c) {
+            return IsIdentifierStart(c) || ((c >= '0') && (c <= '9'));
+        }
+
+        inline bool IsDigit(const char c) {
+            return (c >= '0') && (c <= '9');
+        }
+
+        std::vector<Token> Tokenize(const char *src) {
+            std::vector<Token> tokens;
+            auto cur = src;
+            int line = 1;
+            while(*cur != '\0') {
+                const auto c = *cur;
+                if(c == '\n') {
+                    line++;
+                    cur++;
+                }
+                else if((c == ' ') || (c == '\t') || (c == '\r')) {
+                    cur++;
+                }
+                else if((c == '/') && (cur[1] == '/')) {
+                    while((*cur != '\0') && (*cur != '\n')) {
+                        cur++;
+                    }
+                }
+                else if((c == '/') && (cur[1] == '*')) {
+                    cur += 2;
+                    while((*cur != '\0') && !((cur[0] == '*') && (cur[1] == '/'))) {
+                        if(*cur == '\n') {
+                            line++;
+                        }
+                        cur++;
+                    }
+                    if(*cur == '\0') {
+                        throw ParseError { "unterminated comment" };
+                    }
+                    cur += 2;
+                }
+                else if(IsDigit(c) || ((c == '.') && IsDigit(cur[1]))) {
+                    char *num_end;
+                    const auto num = strtod(cur, &num_end);
+                    if(IsIdentifierChar(*num_end)) {
+                        throw ParseError { "unsupported numeric literal at line " + std::to_string(line) };
+                    }
+                    tokens.push_back({ TokenKind::Number, std::string(cur, static_cast<const char*>(num_end)), num, line });
+                    cur = num_end;
+                }
+                else if(IsIdentifierStart(c)) {
+                    auto id_end = cur;
+                    while(IsIdentifierChar(*id_end)) {
+                        id_end++;
+                    }
+                    tokens.push_back({ TokenKind::Identifier, std::string(cur, id_end), 0.0, line });
+                    cur = id_end;
+                }
+                else {
+                    bool found = false;
+                    for(const auto punct: Puncts) {
+                        const auto punct_len = strlen(punct);
+                        if(strncmp(cur, punct, punct_len) == 0) {
+                            tokens.push_back({ TokenKind::Punct, punct, 0.0, line });
+                            cur += punct_len;
+                            found = true;
+                            break;
+                        }
+                    }
+                    if(!found) {
+                        throw ParseError { std::string("unsupported character '") + c + "' at line " + std::to_string(line) };
+                    }
+                }
+            }
+            tokens.push_back({ TokenKind::End, "", 0.0, line });
+            return tokens;
+        }
+
+        class Parser {
+            private:
+                std::vector<Token> tokens;
+                size_t pos;
+
+                inline const Token &Peek(const size_t offset = 0) {
+                    return this->tokens.at(std::min(this->pos + offset, this->tokens.size() - 1));
+                }
+
+                inline bool IsPunct(const char *punct, const size_t offset = 0) {
+                    const auto &token = this->Peek(offset);
+                    return (token.kind == TokenKind::Punct) && (token.text == punct);
+                }
+
+                inline bool IsKeyword(const char *keyword, const size_t offset = 0) {
+                    const auto &token = this->Peek(offset);
+                    return (token.kind == TokenKind::Identifier) && (token.text == keyword);
+                }
+
+                inline bool AcceptPunct(const char *punct) {
+                    if(this->IsPunct(punct)) {
+                        this->pos++;
+                        return true;
+                    }
+                    return false;
+                }
+
+                [[noreturn]] void Fail(const std::string &what) {
+                    const auto &token = this->Peek();
+                    throw ParseError { what + " at line " + std::to_string(token.line) + ((token.kind == TokenKind::End) ? " (end of source)" : (" ('" + token.text + "')")) };
+                }
+
+                void ExpectPunct(const char *punct) {
+                    if(!this->AcceptPunct(punct)) {
+                        this->Fail(std::string("expected '") + punct + "'");
+                    }
+                }
+
+                std::string ExpectIdentifier() {
+                    const auto &token = this->Peek();
+                    if(token.kind != TokenKind::Identifier) {
+                        this->Fail("expected identifier");
+                    }
+                    this->pos++;
+                    return token.text;
+                }
+
+                // Statement terminators are optional in JS, accept either a semicolon or an implicit end of statement
+                void EndStatement() {
+                    if(!this->AcceptPunct(";") && !this->IsPunct("}") && (this->Peek().kind != TokenKind::End)) {
+                        if(this->Peek().line == this->tokens.at(this->pos - 1).line) {
+                            this->Fail("expected ';'");
+                        }
+                    }
+                }
+
+                static Operator GetOperator(const ExprKind kind, const std::string &name) {
+                    if(kind == ExprKind::Unary) {
+                        return (name == "-") ? Operator::Negate : ((name == "+") ? Operator::Plus : Operator::Not);
+                    }
+
+                    static const std::pair<const char*, Operator> BinaryOperators[] = {
+                        { "**", Operator::Power },
+                        { "*", Operator::Multiply },
+                        { "/", Operator::Divide },
+                        { "%", Operator::Remainder },
+                        { "+", Operator::Add },
+                        { "-", Operator::Subtract },
+                        { "<", Operator::Less },
+                        { ">", Operator::Greater },
+                        { "<=", Operator::LessEqual },
+                        { ">=", Operator::GreaterEqual },
+                        { "==", Operator::Equal },
+                        { "!=", Operator::NotEqual },
+                        { "&&", Operator::And },
+                        { "||", Operator::Or }
+                    };
+                    for(const auto &[op_name, op]: BinaryOperators) {
+                        if(name == op_name) {
+                            return op;
+                        }
+                    }
+                    return Operator::None;
+                }
+
+                static ExprRef MakeExpr(const ExprKind kind, const std::string &name = "", const double num = 0.0) {
+                    auto expr = std::make_unique<Expr>();
+                    expr->kind = kind;
+                    expr->op = ((kind == ExprKind::Unary) || (kind == ExprKind::Binary) || (kind == ExprKind::Logical)) ? GetOperator(kind, name) : Operator::None;
+                    expr->name = name;
+                    expr->num = num;
+                    return expr;
+                }
+
+                static ExprRef MakeBinary(const ExprKind kind, const std::string &op, ExprRef lhs, ExprRef rhs) {
+                    auto expr = MakeExpr(kind, op);
+                    expr->args.push_back(std::move(lhs));
+                    expr->args.push_back(std::move(rhs));
+                    return expr;
+                }
+
+                ExprRef ParsePrimary() {
+                    const auto &token = this->Peek();
+                    if(token.kind == TokenKind::Number) {
+                        this->pos++;
+                        return MakeExpr(ExprKind::Number, "", token.num);
+                    }
+                    else if(this->AcceptPunct("(")) {
+                        auto expr = this->ParseExpression();
+                        this->ExpectPunct(")");
+                        return expr;
+                    }
+                    else if(token.kind == TokenKind::Identifier) {
+                        if((token.text == "true") || (token.text == "false")) {
+                            // Represented as !0 and !1, which keeps them as booleans
+                            this->pos++;
+                            auto expr = MakeExpr(ExprKind::Unary, "!");
+                            expr->args.push_back(MakeExpr(ExprKind::Number, "", (token.text == "true") ? 0.0 : 1.0));
+                            return expr;
+                        }
+
+                        auto name = this->ExpectIdentifier();
+                        while(this->AcceptPunct(".")) {
+                            name += ".";
+                            name += this->ExpectIdentifier();
+                        }
+
+                        if(this->AcceptPunct("(")) {
+                            auto call = MakeExpr(ExprKind::Call, name);
+                            if(!this->AcceptPunct(")")) {
+                                do {
+                                    call->args.push_back(this->ParseAssignmentLevel());
+                                } while(this->AcceptPunct(","));
+                                this->ExpectPunct(")");
+                            }
+                            return call;
+                        }
+                        else {
+                            return MakeExpr(ExprKind::Identifier, name);
+                        }
+                    }
+                    else {
+                        this->Fail("unsupported expression");
+                    }
+                }
+
+                ExprRef ParseUnary() {
+                    if(this->IsPunct("-") || this->IsPunct("+") || this->IsPunct("!")) {
+                        const auto op = this->Peek().text;
+                        this->pos++;
+                        auto expr = MakeExpr(ExprKind::Unary, op);
+                        expr->args.push_back(this->ParseUnary());
+                        return expr;
+                    }
+                    else if(this->IsPunct("++") || this->IsPunct("--")) {
+                        this->Fail("increment/decrement operators are not supported");
+                    }
+                    return this->ParsePower();
+                }
+
+                ExprRef ParsePower() {
+                    auto base = this->ParsePrimary();
+                    if(this->AcceptPunct("**")) {
+                        // Right-associative
+                        return MakeBinary(ExprKind::Binary, "**", std::move(base), this->ParseUnary());
+                    }
+                    return base;
+                }
+
+                ExprRef ParseMultiplicative() {
+                    auto lhs = this->ParseUnary();
+                    while(this->IsPunct("*") || this->IsPunct("/") || this->IsPunct("%")) {
+                        const auto op = this->Peek().text;
+                        this->pos++;
+                        lhs = MakeBinary(ExprKind::Binary, op, std::move(lhs), this->ParseUnary());
+                    }
+                    return lhs;
+                }
+
+                ExprRef ParseAdditive() {
+                    auto lhs = this->ParseMultiplicative();
+                    while(this->IsPunct("+") || this->IsPunct("-")) {
+                        const auto op = this->Peek().text;
+                        this->pos++;
+                        lhs = MakeBinary(ExprKind::Binary, op, std::move(lhs), this->ParseMultiplicative());
+                    }
+                    return lhs;
+                }
+
+                ExprRef ParseRelational() {
+                    auto lhs = this->ParseAdditive();
+                    while(this->IsPunct("<") || this->IsPunct(">") || this->IsPunct("<=") || this->IsPunct(">=")) {
+                        const auto op = this->Peek().text;
+                        this->pos++;
+                        lhs = MakeBinary(ExprKind::Binary, op, std::move(lhs), this->ParseAdditive());
+                    }
+                    return lhs;
+                }
+
+                ExprRef ParseEquality() {
+                    auto lhs = this->ParseRelational();
+                    while(this->IsPunct("==") || this->IsPunct("!=") || this->IsPunct("===") || this->IsPunct("!==")) {
+                        // Only numbers/booleans are supported, so strict and loose equality are the same thing here
+                        const auto op = (this->Peek().text.front() == '=') ? "==" : "!=";
+                        this->pos++;
+                        lhs = MakeBinary(ExprKind::Binary, op, std::move(lhs), this->ParseRelational());
+                    }
+                    return lhs;
+                }
+
+                ExprRef ParseLogicalAnd() {
+                    auto lhs = this->ParseEquality();
+                    while(this->AcceptPunct("&&")) {
+                        lhs = MakeBinary(ExprKind::Logical, "&&", std::move(lhs), this->ParseEquality());
+                    }
+                    return lhs;
+                }
+
+                ExprRef ParseLogicalOr() {
+                    auto lhs = this->ParseLogicalAnd();
+                    while(this->AcceptPunct("||")) {
+                        lhs = MakeBinary(ExprKind::Logical, "||", std::move(lhs), this->ParseLogicalAnd());
+                    }
+                    return lhs;
+                }
+
+                ExprRef ParseAssignmentLevel() {
+                    auto cond = this->ParseLogicalOr();
+                    if(this->AcceptPunct("?")) {
+                        auto expr = MakeExpr(ExprKind::Conditional);
+                        expr->args.push_back(std::move(cond));
+                        expr->args.push_back(this->ParseAssignmentLevel());
+                        this->ExpectPunct(":");
+                        expr->args.push_back(this->ParseAssignmentLevel());
+                        return expr;
+                    }
+                    return cond;
+                }
+
+                ExprRef ParseExpression() {
+                    auto expr = this->ParseAssignmentLevel();
+                    if(this->IsPunct(",")) {
+                        this->Fail("comma expressions are not supported");
+                    }
+                    return expr;
+                }
+
+                StmtRef ParseStatement() {
+                    auto stmt = std::make_unique<Stmt>();
+                    if(this->AcceptPunct("{")) {
+                        stmt->kind = StmtKind::Block;
+                        while(!this->AcceptPunct("}")) {
+                            if(this->Peek().kind == TokenKind::End) {
+                                this->Fail("expected '}'");
+                            }
+                            stmt->body.push_back(this->ParseStatement());
+                        }
+                    }
+                    else if(this->AcceptPunct(";")) {
+                        stmt->kind = StmtKind::Block;
+                    }
+                    else if(this->IsKeyword("if")) {
+                        this->pos++;
+                        stmt->kind = StmtKind::If;
+                        this->ExpectPunct("(");
+                        stmt->expr = this->ParseExpression();
+                        this->ExpectPunct(")");
+                        stmt->then_stmt = this->ParseStatement();
+                        if(this->IsKeyword("else")) {
+                            this->pos++;
+                            stmt->else_stmt = this->ParseStatement();
+                        }
+                    }
+                    else if(this->IsKeyword("return")) {
+                        this->pos++;
+                        stmt->kind = StmtKind::Return;
+                        if(this->IsPunct(";") || this->IsPunct("}")) {
+                            this->Fail("return values are required");
+                        }
+                        stmt->expr = this->ParseExpression();
+                        this->EndStatement();
+                    }
+                    else if(this->IsKeyword("var") || this->IsKeyword("let") || this->IsKeyword("const")) {
+                        this->pos++;
+                        stmt->kind = StmtKind::Declare;
+                        stmt->name = this->ExpectIdentifier();
+                        if(!this->AcceptPunct("=")) {
+                            this->Fail("declarations must be initialized");
+                        }
+                        stmt->expr = this->ParseExpression();
+                        this->EndStatement();
+                    }
+                    else if((this->Peek().kind == TokenKind::Identifier) && this->IsPunct("=", 1)) {
+                        stmt->kind = StmtKind::Assign;
+                        stmt->name = this->ExpectIdentifier();
+                        this->ExpectPunct("=");
+                        stmt->expr = this->ParseExpression();
+                        this->EndStatement();
+                    }
+                    else {
+                        this->Fail("unsupported statement");
+                    }
+                    return stmt;
+                }
+
+                Function ParseFunction() {
+                    Function fn = {};
+                    fn.name = this->ExpectIdentifier();
+                    this->ExpectPunct("(");
+                    if(!this->AcceptPunct(")")) {
+                        do {
+                            fn.params.push_back(this->ExpectIdentifier());
+                        } while(this->AcceptPunct(","));
+                        this->ExpectPunct(")");
+                    }
+                    if(!this->IsPunct("{")) {
+                        this->Fail("expected function body");
+                    }
+                    fn.body = this->ParseStatement();
+                    return fn;
+                }
+
+            public:
+                Parser(std::vector<Token> tokens) : tokens(std::move(tokens)), pos(0) {}
+
+                void ParseProgram(Program &out_program) {
+                    while(this->Peek().kind != TokenKind::End) {
+                        if(this->AcceptPunct(";")) {
+                            continue;
+                        }
+                        else if(this->IsKeyword("function")) {
+                            this->pos++;
+                            out_program.functions.push_back(this->ParseFunction());
+                        }
+                        else {
+                            if(this->IsKeyword("var") || this->IsKeyword("let") || this->IsKeyword("const")) {
+                                this->pos++;
+                            }
+                            GlobalAssignment global = {};
+                            global.name = this->ExpectIdentifier();
+                            this->ExpectPunct("=");
+                            global.expr = this->ParseExpression();
+                            this->EndStatement();
+                            out_program.globals.push_back(std::move(global));
+                        }
+                    }
+                }
+        };
+
+    }
+
+    const Function *Program::FindFunction(const std::string &name) const {
+        // Like in JS, the last declaration wins
+        for(auto it = this->functions.rbegin(); it != this->functions.rend(); it++) {
+            if(it->name == name) {
+                return &*it;
+            }
+        }
+        return nullptr;
+    }
+
+    bool Parse(const char *src, Program &out_program, std::string &out_error) {
+        out_program = {};
+        try {
+            Parser parser(Tokenize(src));
+            parser.ParseProgram(out_program);
+            return true;
+        }
+        catch(ParseError &e) {
+            out_error = e.msg;
+            return false;
+        }
+    }
+
+    bool References(const Expr &expr, const std::string &name) {
+        if((expr.kind == ExprKind::Identifier) && (expr.name == name)) {
+            return true;
+        }
+        for(const auto &arg: expr.args) {
+            if(References(*arg, name)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool References(const Stmt &stmt, const std::string &name) {
+        if((stmt.expr != nullptr) && References(*stmt.expr, name)) {
+            return true;
+        }
+        if((stmt.then_stmt != nullptr) && References(*stmt.then_stmt, name)) {
+            return true;
+        }
+        if((stmt.else_stmt != nullptr) && References(*stmt.else_stmt, name)) {
+            return true;
+        }
+        for(const auto &sub_stmt: stmt.body) {
+            if(References(*sub_stmt, name)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
@@ -0,0 +1,220 @@
+#include "src_eval.hpp"
+#include "trace.hpp"
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <emscripten/heap.h>
+#endif
+
+// Due to limitations in C++/JS bindings (in the return types), 3 functions are needed:
+// - *_Test to test if the function is properly defined (no exceptions arise and proper return type) for the given position/time
+// - *_Real and *_Imaginary to return a complex result in parts (with V the return value is real and this separation is thankfully not needed)
+
+EM_JS(JsResult, sim_EvaluateSource, (const char *src, const double hslash, const double m, const double x0, const double xf, const double dx, const double t0, const double dt), {
+    try {
+        window.hslash = hslash;
+        window.m = m;
+        window.x0 = x0;
+        window.xf = xf;
+        window.dx = dx;
+        window.t0 = t0;
+        window.dt = dt;
+        window.eval(UTF8ToString(src));
+        return 0;
+    }
+    catch(e) {
+        return 1;
+    }
+});
+
+EM_JS(JsResult, sim_Psi0_Test, (const double x), {
+    try {
+        var psi0_val = psi0(x);
+        math.complex(psi0_val);
+        return 0;
+    }
+    catch {
+        return 1;
+    }
+});
+
+EM_JS(double, sim_Psi0_Real, (const double x), {
+    return math.complex(psi0(x)).re;
+});
+
+EM_JS(double, sim_Psi0_Imaginary, (const double x), {
+    return math.complex(psi0(x)).im;
+});
+
+EM_JS(JsResult, sim_V_Test, (const double x, const double t), {
+    try {
+        var v_val = V(x, t);
+        if(Number.isFinite(v_val)) {
+            return 0;
+        }
+        else {
+            return 2;
+        }
+    }
+    catch {
+        return 1;
+    }
+});
+
+EM_JS(double, sim_V, (const double x, const double t), {
+    return V(x, t);
+});
+
+// Compiled sources (see src_wasm.hpp) are instantiated against the current JS globals, thus this must be done again whenever they might have changed
+
+EM_JS(JsResult, sim_InstallCompiledGridFunction, (const int is_v, const uint8_t *module_ptr, const size_t module_size), {
+    var fn_name = is_v ? "quantize_V_grid" : "quantize_psi0_grid";
+    Module[fn_name] = null;
+    try {
+        var module = new WebAssembly.Module(HEAPU8.slice(module_ptr, module_ptr + module_size));
+        var imports = {};
+        WebAssembly.Module.imports(module).forEach(function(imp) {
+            if(!(imp.module in imports)) {
+                imports[imp.module] = {};
+            }
+
+            var val;
+            if(imp.module == "env") {
+                val = wasmMemory;
+            }
+            else if(imp.module == "Math") {
+                val = Math[imp.name];
+            }
+            else if(imp.module == "math") {
+                val = math[imp.name];
+            }
+            else if(imp.module == "op") {
+                val = { rem: function(a, b) { return a % b; } }[imp.name];
+            }
+            else {
+                // Globals declared with let/const are not window properties, but are still reachable this way
+                val = window.eval(imp.name);
+                if(imp.kind == "global") {
+                    if(typeof val !== "number") {
+                        throw new Error("'" + imp.name + "' is not a number");
+                    }
+                    val = new WebAssembly.Global({ value: "f64", mutable: false }, val);
+                }
+            }
+            imports[imp.module][imp.name] = val;
+        });
+        Module[fn_name] = new WebAssembly.Instance(module, imports).exports.run;
+        return 0;
+    }
+    catch(e) {
+        console.warn("Unable to instantiate compiled " + (is_v ? "V" : "psi0") + " source: " + e);
+        return 1;
+    }
+});
+
+EM_JS(int, sim_Psi0_GridEvaluate, (const double *x_ptr, const long count, double *out_ptr), {
+    try {
+        return Module.quantize_psi0_grid(x_ptr, count, out_ptr);
+    }
+    catch {
+        return -2;
+    }
+});
+
+EM_JS(int, sim_V_GridEvaluate, (const double *x_ptr, const long count, const double t, double *out_ptr), {
+    try {
+        return Module.quantize_V_grid(x_ptr, count, t, out_ptr);
+    }
+    catch {
+        return -2;
+    }
+});
+
+namespace {
+
+    constexpr size_t WasmPageSize = 64 * 1024;
+
+    // Builds with pthreads have a shared memory, which compiled modules must import as such and with the very same maximum size
+    src::WasmMemoryImport GetMemoryImport() {
+        #ifdef __EMSCRIPTEN_PTHREADS__
+        return { true, (uint32_t)(emscripten_get_heap_max() / WasmPageSize) };
+        #else
+        return { false, 0 };
+        #endif
+    }
+
+    // JS bridge calls are traced, except for single samples, which would flood the trace (there might be one per grid point)
+
+    class JsEvaluator : public src::Evaluator {
+        private:
+            std::vector<uint8_t> psi0_module;
+            std::vector<uint8_t> v_module;
+
+            inline std::vector<uint8_t> &GetModule(const src::GridFunctionKind kind) {
+                return (kind == src::GridFunctionKind::V) ? this->v_module : this->psi0_module;
+            }
+
+        public:
+            bool Evaluate(const src::GridFunctionKind kind, const char *src, const src::EvaluationVariables &vars, std::string &out_error) override {
+                _TRACE_SCOPE("JS source evaluation");
+                if(!JS_RC_SUCCEEDED(sim_EvaluateSource(src, vars.hslash, vars.m, vars.x0, vars.xf, vars.dx, vars.t0, vars.dt))) {
+                    out_error = "the source could not be evaluated by the JS engine";
+                    return false;
+                }
+                return true;
+            }
+
+            bool TryGetPsi0(const double x, Num &out_psi0) override {
+                if(JS_RC_SUCCEEDED(sim_Psi0_Test(x))) {
+                    out_psi0 = Num(sim_Psi0_Real(x), sim_Psi0_Imaginary(x));
+                    return true;
+                }
+                else {
+                    return false;
+                }
+            }
+
+            bool TryGetV(const double x, const double t, double &out_v) override {
+                if(JS_RC_SUCCEEDED(sim_V_Test(x, t))) {
+                    out_v = sim_V(x, t);
+                    return true;
+                }
+                else {
+                    return false;
+                }
+            }
+
+            bool CompileGridFunction(const src::Program &program, const src::GridFunctionKind kind, std::string &out_error) override {
+                auto &module = this->GetModule(kind);
+                module.clear();
+                return src::GenerateWasmGridModule(program, kind, GetMemoryImport(), module, out_error);
+            }
+
+            bool InstallGridFunction(const src::GridFunctionKind kind, std::string &out_error) override {
+                _TRACE_SCOPE("JS module instantiation");
+                const auto &module = this->GetModule(kind);
+                if(module.empty() || !JS_RC_SUCCEEDED(sim_InstallCompiledGridFunction(kind == src::GridFunctionKind::V, module.data(), module.size()))) {
+                    out_error = "unable to instantiate the compiled module (check the browser console)";
+                    return false;
+                }
+                return true;
+            }
+
+            long EvaluatePsi0Grid(const double *x_ptr, const long count, Num *out_ptr) override {
+                _TRACE_SCOPE("JS Ψ0 grid evaluation");
+                return sim_Psi0_GridEvaluate(x_ptr, count, reinterpret_cast<double*>(out_ptr));
+            }
+
+            long EvaluateVGrid(const double *x_ptr, const long count, const double t, double *out_ptr) override {
+                _TRACE_SCOPE("JS V grid evaluation");
+                return sim_V_GridEvaluate(x_ptr, count, t, out_ptr);
+            }
+    };
+
+}
+
+namespace src {
+
+    std::unique_ptr<Evaluator> CreatePlatformEvaluator() {
+        return std::make_unique<JsEvaluator>();
+    }
+
+}
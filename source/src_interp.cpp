@@ -0,0 +1,1105 @@
+#include "src_interp.hpp"
+#include "special.hpp"
+#include <cmath>
+
+namespace src {
+
+    namespace {
+
+        // Only used internally to unwind the interpretation, callers report it as a failed evaluation
+        struct EvalError {
+            std::string msg;
+        };
+
+        // Deep enough for any reasonable helper function, while still catching runaway recursion
+        constexpr int MaxCallDepth = 256;
+
+        [[noreturn]] void Fail(const std::string &msg) {
+            throw EvalError { msg };
+        }
+
+        inline Value MakeBool(const bool val) {
+            return { ValueKind::Bool, val ? 1.0 : 0.0 };
+        }
+
+        inline Value MakeReal(const double val) {
+            return { ValueKind::Real, val };
+        }
+
+        inline Value MakeComplex(const Num val) {
+            return { ValueKind::Complex, val };
+        }
+
+        // Value conversions, following JS semantics where they make sense
+
+        double ToReal(const Value &val) {
+            if(val.kind == ValueKind::Complex) {
+                Fail("complex values cannot be used as real numbers (use math.re/math.im/math.abs)");
+            }
+            return val.num.real();
+        }
+
+        bool ToBool(const Value &val) {
+            if(val.kind == ValueKind::Complex) {
+                Fail("complex values cannot be used as conditions");
+            }
+            // Both 0 and NaN are falsy
+            return std::abs(val.num.real()) > 0.0;
+        }
+
+        inline Num ToComplex(const Value &val) {
+            return (val.kind == ValueKind::Complex) ? val.num : Num(ToReal(val), 0.0);
+        }
+
+        enum class NodeKind {
+            Constant,
+            Local,
+            Global,
+            Unary,
+            Binary,
+            Logical,
+            Conditional,
+            Call,
+            Builtin,
+            // Fails once evaluated (with the message as the name), like the lookup would have failed at that point
+            Fail
+        };
+
+        enum class Builtin {
+            Sqrt,
+            Log,
+            Log10,
+            Log2,
+            Log1p,
+            Asin,
+            Acos,
+            Atanh,
+            Acosh,
+            Exp,
+            Sin,
+            Cos,
+            Abs,
+            Floor,
+            Ceil,
+            Trunc,
+            Tan,
+            Atan,
+            Sinh,
+            Cosh,
+            Tanh,
+            Asinh,
+            Cbrt,
+            Expm1,
+            Sign,
+            Round,
+            Min,
+            Max,
+            Atan2,
+            Pow,
+            NthRoot,
+            Factorial,
+            Gamma,
+            Square,
+            Cube,
+            Mod,
+            Complex,
+            Add,
+            Multiply,
+            Subtract,
+            Divide,
+            Re,
+            Im,
+            Conj,
+            UnaryMinus,
+            Gauss,
+            Delta,
+            Hermite,
+            HermiteFunction
+        };
+
+        enum class BuiltinScope {
+            // Both Math.X and math.X
+            Math,
+            // Only math.X
+            MathJs,
+            // Special functions (see js_export.cpp)
+            Global
+        };
+
+        struct BuiltinInfo {
+            const char *name;
+            Builtin builtin;
+            BuiltinScope scope;
+            size_t min_arg_count;
+            size_t max_arg_count;
+        };
+
+        constexpr BuiltinInfo Builtins[] = {
+            { "sqrt", Builtin::Sqrt, BuiltinScope::Math, 1, 1 },
+            { "log", Builtin::Log, BuiltinScope::Math, 1, 1 },
+            { "log10", Builtin::Log10, BuiltinScope::Math, 1, 1 },
+            { "log2", Builtin::Log2, BuiltinScope::Math, 1, 1 },
+            { "log1p", Builtin::Log1p, BuiltinScope::Math, 1, 1 },
+            { "asin", Builtin::Asin, BuiltinScope::Math, 1, 1 },
+            { "acos", Builtin::Acos, BuiltinScope::Math, 1, 1 },
+            { "atanh", Builtin::Atanh, BuiltinScope::Math, 1, 1 },
+            { "acosh", Builtin::Acosh, BuiltinScope::Math, 1, 1 },
+            { "exp", Builtin::Exp, BuiltinScope::Math, 1, 1 },
+            { "sin", Builtin::Sin, BuiltinScope::Math, 1, 1 },
+            { "cos", Builtin::Cos, BuiltinScope::Math, 1, 1 },
+            { "abs", Builtin::Abs, BuiltinScope::Math, 1, 1 },
+            { "floor", Builtin::Floor, BuiltinScope::Math, 1, 1 },
+            { "ceil", Builtin::Ceil, BuiltinScope::Math, 1, 1 },
+            { "trunc", Builtin::Trunc, BuiltinScope::Math, 1, 1 },
+            { "fix", Builtin::Trunc, BuiltinScope::Math, 1, 1 },
+            { "tan", Builtin::Tan, BuiltinScope::Math, 1, 1 },
+            { "atan", Builtin::Atan, BuiltinScope::Math, 1, 1 },
+            { "sinh", Builtin::Sinh, BuiltinScope::Math, 1, 1 },
+            { "cosh", Builtin::Cosh, BuiltinScope::Math, 1, 1 },
+            { "tanh", Builtin::Tanh, BuiltinScope::Math, 1, 1 },
+            { "asinh", Builtin::Asinh, BuiltinScope::Math, 1, 1 },
+            { "cbrt", Builtin::Cbrt, BuiltinScope::Math, 1, 1 },
+            { "expm1", Builtin::Expm1, BuiltinScope::Math, 1, 1 },
+            { "sign", Builtin::Sign, BuiltinScope::Math, 1, 1 },
+            { "round", Builtin::Round, BuiltinScope::Math, 1, 1 },
+            { "min", Builtin::Min, BuiltinScope::Math, 0, SIZE_MAX },
+            { "max", Builtin::Max, BuiltinScope::Math, 0, SIZE_MAX },
+            { "atan2", Builtin::Atan2, BuiltinScope::Math, 2, 2 },
+            { "pow", Builtin::Pow, BuiltinScope::Math, 2, 2 },
+            { "nthRoot", Builtin::NthRoot, BuiltinScope::MathJs, 1, 2 },
+            { "factorial", Builtin::Factorial, BuiltinScope::MathJs, 1, 1 },
+            { "gamma", Builtin::Gamma, BuiltinScope::MathJs, 1, 1 },
+            { "square", Builtin::Square, BuiltinScope::MathJs, 1, 1 },
+            { "cube", Builtin::Cube, BuiltinScope::MathJs, 1, 1 },
+            { "mod", Builtin::Mod, BuiltinScope::MathJs, 2, 2 },
+            { "complex", Builtin::Complex, BuiltinScope::MathJs, 1, 2 },
+            { "add", Builtin::Add, BuiltinScope::MathJs, 2, SIZE_MAX },
+            { "multiply", Builtin::Multiply, BuiltinScope::MathJs, 2, SIZE_MAX },
+            { "subtract", Builtin::Subtract, BuiltinScope::MathJs, 2, 2 },
+            { "divide", Builtin::Divide, BuiltinScope::MathJs, 2, 2 },
+            { "re", Builtin::Re, BuiltinScope::MathJs, 1, 1 },
+            { "im", Builtin::Im, BuiltinScope::MathJs, 1, 1 },
+            { "conj", Builtin::Conj, BuiltinScope::MathJs, 1, 1 },
+            { "unaryMinus", Builtin::UnaryMinus, BuiltinScope::MathJs, 1, 1 },
+            { "gauss", Builtin::Gauss, BuiltinScope::Global, 4, 4 },
+            { "delta", Builtin::Delta, BuiltinScope::Global, 3, 3 },
+            { "hermite", Builtin::Hermite, BuiltinScope::Global, 2, 2 },
+            { "hermite_fn", Builtin::HermiteFunction, BuiltinScope::Global, 2, 2 }
+        };
+
+        // Most arguments taken by a builtin, besides the ones taking any number of them (which are folded as they are evaluated)
+        constexpr size_t MaxBuiltinArgCount = 4;
+
+        // Slot of an assignment to something which is not a local
+        constexpr size_t NoSlot = SIZE_MAX;
+
+        struct Node {
+            NodeKind kind;
+            Operator op;
+            Builtin builtin;
+            bool is_mathjs;
+            Value val;
+            size_t slot;
+            const Value *global;
+            const ResolvedFunction *fn;
+            // Kept for error messages
+            std::string name;
+            // Operands/arguments, or what a local refers to while it is not bound yet
+            std::vector<Node> args;
+        };
+
+        struct ResolvedStmt {
+            StmtKind kind;
+            size_t slot;
+            std::string name;
+            Node expr;
+            std::unique_ptr<ResolvedStmt> then_stmt;
+            std::unique_ptr<ResolvedStmt> else_stmt;
+            std::vector<ResolvedStmt> body;
+        };
+
+    }
+
+    struct ResolvedFunction {
+        const Function *def;
+        std::string name;
+        // Parameters are the first locals, but repeated names share a slot
+        std::vector<size_t> param_slots;
+        size_t local_count;
+        ResolvedStmt body;
+    };
+
+    namespace {
+
+        bool FindConstant(const std::string &name, Value &out_val) {
+            if((name == "math.PI") || (name == "Math.PI") || (name == "math.pi")) {
+                out_val = MakeReal(M_PI);
+            }
+            else if((name == "math.E") || (name == "Math.E") || (name == "math.e")) {
+                out_val = MakeReal(M_E);
+            }
+            else if((name == "math.SQRT2") || (name == "Math.SQRT2")) {
+                out_val = MakeReal(M_SQRT2);
+            }
+            else if((name == "math.LN2") || (name == "Math.LN2")) {
+                out_val = MakeReal(M_LN2);
+            }
+            else if((name == "math.LN10") || (name == "Math.LN10")) {
+                out_val = MakeReal(M_LN10);
+            }
+            else if(name == "math.i") {
+                out_val = MakeComplex(I);
+            }
+            else if(name == "Infinity") {
+                out_val = MakeReal(INFINITY);
+            }
+            else if(name == "NaN") {
+                out_val = MakeReal(NAN);
+            }
+            else {
+                return false;
+            }
+            return true;
+        }
+
+        Node MakeNode(const NodeKind kind, const std::string &name = "") {
+            return { kind, Operator::None, Builtin::Sqrt, false, MakeReal(0.0), NoSlot, nullptr, nullptr, name, {} };
+        }
+
+        // Turns names into slots/pointers/enums, while keeping whatever fails to resolve failing only once (if ever) evaluated
+        class Resolver {
+            private:
+                const GlobalMap &globals;
+                const Program &program;
+                const Program &other_program;
+                const std::vector<std::unique_ptr<ResolvedFunction>> &resolved_fns;
+                // Locals of the function being resolved, which are function-scoped
+                std::map<std::string, size_t> slots;
+
+                const ResolvedFunction *FindFunction(const std::string &name) const {
+                    auto fn_def = this->program.FindFunction(name);
+                    if(fn_def == nullptr) {
+                        fn_def = this->other_program.FindFunction(name);
+                    }
+                    if(fn_def != nullptr) {
+                        for(const auto &fn: this->resolved_fns) {
+                            if(fn->def == fn_def) {
+                                return fn.get();
+                            }
+                        }
+                    }
+                    return nullptr;
+                }
+
+                size_t GetSlot(const std::string &name) {
+                    return this->slots.emplace(name, this->slots.size()).first->second;
+                }
+
+                void CollectDeclarations(const Stmt &stmt) {
+                    if(stmt.kind == StmtKind::Declare) {
+                        this->GetSlot(stmt.name);
+                    }
+                    if(stmt.then_stmt != nullptr) {
+                        this->CollectDeclarations(*stmt.then_stmt);
+                    }
+                    if(stmt.else_stmt != nullptr) {
+                        this->CollectDeclarations(*stmt.else_stmt);
+                    }
+                    for(const auto &sub_stmt: stmt.body) {
+                        this->CollectDeclarations(*sub_stmt);
+                    }
+                }
+
+                // What the name refers to outside of any function
+                Node ResolveOuterName(const std::string &name) const {
+                    Node node = MakeNode(NodeKind::Constant, name);
+                    if(FindConstant(name, node.val)) {
+                        return node;
+                    }
+
+                    const auto it = this->globals.find(name);
+                    if(it != this->globals.end()) {
+                        // Globals are never removed, thus the pointer stays valid (and sees later assignments)
+                        node.kind = NodeKind::Global;
+                        node.global = &it->second;
+                        return node;
+                    }
+                    if(name.find('.') != std::string::npos) {
+                        return MakeNode(NodeKind::Fail, "unsupported member '" + name + "'");
+                    }
+                    if(this->FindFunction(name) != nullptr) {
+                        return MakeNode(NodeKind::Fail, "functions cannot be used as values ('" + name + "')");
+                    }
+                    return MakeNode(NodeKind::Fail, "'" + name + "' is not defined");
+                }
+
+                Node ResolveCall(const Expr &expr) {
+                    const auto &name = expr.name;
+                    auto node = MakeNode(NodeKind::Call, name);
+                    node.fn = this->FindFunction(name);
+                    if(node.fn == nullptr) {
+                        const auto dot_pos = name.find('.');
+                        const auto ns = (dot_pos != std::string::npos) ? name.substr(0, dot_pos) : "";
+                        const auto fn = (dot_pos != std::string::npos) ? name.substr(dot_pos + 1) : name;
+                        const auto is_mathjs = ns == "math";
+
+                        const BuiltinInfo *info = nullptr;
+                        for(const auto &builtin: Builtins) {
+                            const auto in_scope = (builtin.scope == BuiltinScope::Math) ? (is_mathjs || (ns == "Math")) : ((builtin.scope == BuiltinScope::MathJs) ? is_mathjs : ns.empty());
+                            if(in_scope && (fn == builtin.name)) {
+                                info = &builtin;
+                                break;
+                            }
+                        }
+                        if(info == nullptr) {
+                            return MakeNode(NodeKind::Fail, "unsupported function '" + name + "'");
+                        }
+                        if((expr.args.size() < info->min_arg_count) || (expr.args.size() > info->max_arg_count)) {
+                            return MakeNode(NodeKind::Fail, "invalid argument count for '" + name + "'");
+                        }
+
+                        node.kind = NodeKind::Builtin;
+                        node.builtin = info->builtin;
+                        node.is_mathjs = is_mathjs;
+                        if(node.builtin == Builtin::Delta) {
+                            const auto dx_it = this->globals.find("dx");
+                            node.global = (dx_it != this->globals.end()) ? &dx_it->second : nullptr;
+                        }
+                    }
+
+                    for(const auto &arg: expr.args) {
+                        node.args.push_back(this->ResolveExpr(*arg));
+                    }
+                    return node;
+                }
+
+            public:
+                Resolver(const GlobalMap &globals, const Program &program, const Program &other_program, const std::vector<std::unique_ptr<ResolvedFunction>> &resolved_fns) : globals(globals), program(program), other_program(other_program), resolved_fns(resolved_fns) {}
+
+                Node ResolveExpr(const Expr &expr) {
+                    switch(expr.kind) {
+                        case ExprKind::Number: {
+                            auto node = MakeNode(NodeKind::Constant);
+                            node.val = MakeReal(expr.num);
+                            return node;
+                        }
+                        case ExprKind::Identifier: {
+                            const auto it = this->slots.find(expr.name);
+                            if(it == this->slots.end()) {
+                                return this->ResolveOuterName(expr.name);
+                            }
+                            // Locals only exist once declared, and parameters only if an argument was given for them
+                            auto node = MakeNode(NodeKind::Local, expr.name);
+                            node.slot = it->second;
+                            node.args.push_back(this->ResolveOuterName(expr.name));
+                            return node;
+                        }
+                        case ExprKind::Call: {
+                            return this->ResolveCall(expr);
+                        }
+                        default: {
+                            auto node = MakeNode((expr.kind == ExprKind::Unary) ? NodeKind::Unary : ((expr.kind == ExprKind::Binary) ? NodeKind::Binary : ((expr.kind == ExprKind::Logical) ? NodeKind::Logical : NodeKind::Conditional)), expr.name);
+                            node.op = expr.op;
+                            for(const auto &arg: expr.args) {
+                                node.args.push_back(this->ResolveExpr(*arg));
+                            }
+                            return node;
+                        }
+                    }
+                }
+
+                ResolvedStmt ResolveStmt(const Stmt &stmt) {
+                    ResolvedStmt res_stmt = { stmt.kind, NoSlot, stmt.name, MakeNode(NodeKind::Constant), nullptr, nullptr, {} };
+                    if(stmt.expr != nullptr) {
+                        res_stmt.expr = this->ResolveExpr(*stmt.expr);
+                    }
+                    if(stmt.then_stmt != nullptr) {
+                        res_stmt.then_stmt = std::make_unique<ResolvedStmt>(this->ResolveStmt(*stmt.then_stmt));
+                    }
+                    if(stmt.else_stmt != nullptr) {
+                        res_stmt.else_stmt = std::make_unique<ResolvedStmt>(this->ResolveStmt(*stmt.else_stmt));
+                    }
+                    for(const auto &sub_stmt: stmt.body) {
+                        res_stmt.body.push_back(this->ResolveStmt(*sub_stmt));
+                    }
+
+                    const auto it = this->slots.find(stmt.name);
+                    if(((stmt.kind == StmtKind::Declare) || (stmt.kind == StmtKind::Assign)) && (it != this->slots.end())) {
+                        res_stmt.slot = it->second;
+                    }
+                    return res_stmt;
+                }
+
+                void ResolveFunction(ResolvedFunction &fn) {
+                    this->slots.clear();
+                    fn.param_slots.clear();
+                    for(const auto &param: fn.def->params) {
+                        fn.param_slots.push_back(this->GetSlot(param));
+                    }
+                    this->CollectDeclarations(*fn.def->body);
+                    fn.local_count = this->slots.size();
+                    fn.body = this->ResolveStmt(*fn.def->body);
+                    this->slots.clear();
+                }
+        };
+
+        // Real result if it is real (or if the JS builtin was used, which just returns NaN), else the complex one like math.js does
+        template<typename DF, typename RF, typename CF>
+        Value EvalDomainUnary(const Value &arg, const bool is_mathjs, DF in_domain_fn, RF real_fn, CF complex_fn) {
+            if(arg.kind == ValueKind::Complex) {
+                if(!is_mathjs) {
+                    ToReal(arg);
+                }
+                return MakeComplex(complex_fn(arg.num));
+            }
+            const auto val = ToReal(arg);
+            if(is_mathjs && !in_domain_fn(val)) {
+                return MakeComplex(complex_fn(Num(val, 0.0)));
+            }
+            return MakeReal(real_fn(val));
+        }
+
+        class Interpreter {
+            private:
+                // Locals of every function being called, each call using the ones from its frame onwards
+                std::vector<std::optional<Value>> &locals_stack;
+                size_t frame;
+                int call_depth;
+
+                Value EvalUnary(const Node &node) {
+                    const auto val = this->Eval(node.args[0]);
+                    if(node.op == Operator::Negate) {
+                        if(val.kind == ValueKind::Complex) {
+                            return MakeComplex(-val.num);
+                        }
+                        return MakeReal(-ToReal(val));
+                    }
+                    else if(node.op == Operator::Plus) {
+                        return MakeReal(ToReal(val));
+                    }
+                    else {
+                        return MakeBool(!ToBool(val));
+                    }
+                }
+
+                Value EvalBinary(const Node &node) {
+                    const auto lhs = this->Eval(node.args[0]);
+                    const auto rhs = this->Eval(node.args[1]);
+                    if((lhs.kind == ValueKind::Complex) || (rhs.kind == ValueKind::Complex)) {
+                        Fail("operator '" + node.name + "' is not supported on complex values (use math.add/math.multiply...)");
+                    }
+                    const auto a = ToReal(lhs);
+                    const auto b = ToReal(rhs);
+
+                    switch(node.op) {
+                        case Operator::Add: {
+                            return MakeReal(a + b);
+                        }
+                        case Operator::Subtract: {
+                            return MakeReal(a - b);
+                        }
+                        case Operator::Multiply: {
+                            return MakeReal(a * b);
+                        }
+                        case Operator::Divide: {
+                            return MakeReal(a / b);
+                        }
+                        case Operator::Remainder: {
+                            // JS remainder keeps the sign of the dividend
+                            return MakeReal(std::fmod(a, b));
+                        }
+                        case Operator::Power: {
+                            return MakeReal(std::pow(a, b));
+                        }
+                        case Operator::Less: {
+                            return MakeBool(a < b);
+                        }
+                        case Operator::Greater: {
+                            return MakeBool(a > b);
+                        }
+                        case Operator::LessEqual: {
+                            return MakeBool(a <= b);
+                        }
+                        case Operator::GreaterEqual: {
+                            return MakeBool(a >= b);
+                        }
+                        case Operator::Equal: {
+                            return MakeBool(a == b);
+                        }
+                        default: {
+                            return MakeBool(a != b);
+                        }
+                    }
+                }
+
+                // Like in JS, logical operators return one of their operands
+                Value EvalLogical(const Node &node) {
+                    const auto lhs = this->Eval(node.args[0]);
+                    const auto lhs_true = ToBool(lhs);
+                    if(node.op == Operator::And) {
+                        return lhs_true ? this->Eval(node.args[1]) : lhs;
+                    }
+                    else {
+                        return lhs_true ? lhs : this->Eval(node.args[1]);
+                    }
+                }
+
+                Value EvalCall(const Node &node) {
+                    const auto &fn = *node.fn;
+                    const auto fn_frame = this->PushFrame(fn);
+                    for(size_t i = 0; i < node.args.size(); i++) {
+                        // Evaluated in the caller's frame (arguments without parameter are still evaluated, like in JS)
+                        const auto arg = this->Eval(node.args[i]);
+                        this->BindArgument(fn, fn_frame, i, arg);
+                    }
+                    return this->Run(fn, fn_frame);
+                }
+
+                Value EvalBuiltin(const Node &node) {
+                    const auto is_mathjs = node.is_mathjs;
+                    switch(node.builtin) {
+                        case Builtin::Min:
+                        case Builtin::Max: {
+                            const auto is_min = node.builtin == Builtin::Min;
+                            double res = is_min ? INFINITY : -INFINITY;
+                            auto has_nan = false;
+                            for(const auto &arg_node: node.args) {
+                                const auto arg = ToReal(this->Eval(arg_node));
+                                if(std::isnan(arg)) {
+                                    has_nan = true;
+                                }
+                                res = is_min ? std::min(res, arg) : std::max(res, arg);
+                            }
+                            return MakeReal(has_nan ? NAN : res);
+                        }
+                        case Builtin::Add:
+                        case Builtin::Multiply: {
+                            const auto is_multiply = node.builtin == Builtin::Multiply;
+                            auto res = this->Eval(node.args[0]);
+                            for(size_t i = 1; i < node.args.size(); i++) {
+                                const auto arg = this->Eval(node.args[i]);
+                                if((res.kind != ValueKind::Complex) && (arg.kind != ValueKind::Complex)) {
+                                    res = MakeReal(is_multiply ? (ToReal(res) * ToReal(arg)) : (ToReal(res) + ToReal(arg)));
+                                }
+                                else {
+                                    res = MakeComplex(is_multiply ? (ToComplex(res) * ToComplex(arg)) : (ToComplex(res) + ToComplex(arg)));
+                                }
+                            }
+                            return res;
+                        }
+                        default: {
+                            break;
+                        }
+                    }
+
+                    Value args[MaxBuiltinArgCount];
+                    for(size_t i = 0; i < node.args.size(); i++) {
+                        args[i] = this->Eval(node.args[i]);
+                    }
+                    const auto &arg = args[0];
+
+                    switch(node.builtin) {
+                        case Builtin::Sqrt: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double x) { return x >= 0.0; }, [](const double x) { return std::sqrt(x); }, [](const Num z) { return std::sqrt(z); });
+                        }
+                        case Builtin::Log: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double x) { return x >= 0.0; }, [](const double x) { return std::log(x); }, [](const Num z) { return std::log(z); });
+                        }
+                        case Builtin::Log10: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double x) { return x >= 0.0; }, [](const double x) { return std::log10(x); }, [](const Num z) { return std::log10(z); });
+                        }
+                        case Builtin::Log2: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double x) { return x >= 0.0; }, [](const double x) { return std::log2(x); }, [](const Num z) { return std::log(z) / M_LN2; });
+                        }
+                        case Builtin::Log1p: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double x) { return x >= -1.0; }, [](const double x) { return std::log1p(x); }, [](const Num z) { return std::log(1.0 + z); });
+                        }
+                        case Builtin::Asin: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double x) { return std::abs(x) <= 1.0; }, [](const double x) { return std::asin(x); }, [](const Num z) { return std::asin(z); });
+                        }
+                        case Builtin::Acos: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double x) { return std::abs(x) <= 1.0; }, [](const double x) { return std::acos(x); }, [](const Num z) { return std::acos(z); });
+                        }
+                        case Builtin::Atanh: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double x) { return std::abs(x) <= 1.0; }, [](const double x) { return std::atanh(x); }, [](const Num z) { return std::atanh(z); });
+                        }
+                        case Builtin::Acosh: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double x) { return x >= 1.0; }, [](const double x) { return std::acosh(x); }, [](const Num z) { return std::acosh(z); });
+                        }
+                        // Defined everywhere, and for complex arguments in math.js
+                        case Builtin::Exp: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double) { return true; }, [](const double x) { return std::exp(x); }, [](const Num z) { return std::exp(z); });
+                        }
+                        case Builtin::Sin: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double) { return true; }, [](const double x) { return std::sin(x); }, [](const Num z) { return std::sin(z); });
+                        }
+                        case Builtin::Cos: {
+                            return EvalDomainUnary(arg, is_mathjs, [](const double) { return true; }, [](const double x) { return std::cos(x); }, [](const Num z) { return std::cos(z); });
+                        }
+                        case Builtin::Abs: {
+                            return MakeReal((arg.kind == ValueKind::Complex) ? std::abs(arg.num) : std::abs(ToReal(arg)));
+                        }
+                        default: {
+                            break;
+                        }
+                    }
+
+                    if(node.builtin == Builtin::Pow) {
+                        if(is_mathjs) {
+                            const auto is_complex = (args[0].kind == ValueKind::Complex) || (args[1].kind == ValueKind::Complex);
+                            if(is_complex) {
+                                return MakeComplex(std::pow(ToComplex(args[0]), ToComplex(args[1])));
+                            }
+                            // Negative bases with non-integer exponents give complex results
+                            const auto a = ToReal(args[0]);
+                            const auto b = ToReal(args[1]);
+                            if((a < 0.0) && (b != std::trunc(b))) {
+                                return MakeComplex(std::pow(Num(a, 0.0), b));
+                            }
+                        }
+                        return MakeReal(std::pow(ToReal(args[0]), ToReal(args[1])));
+                    }
+
+                    // Complex number support
+                    if(node.builtin == Builtin::Complex) {
+                        if(node.args.size() == 1) {
+                            return MakeComplex(ToComplex(arg));
+                        }
+                        return MakeComplex(Num(ToReal(args[0]), ToReal(args[1])));
+                    }
+                    if((node.builtin == Builtin::Subtract) || (node.builtin == Builtin::Divide)) {
+                        const auto is_subtract = node.builtin == Builtin::Subtract;
+                        if((args[0].kind != ValueKind::Complex) && (args[1].kind != ValueKind::Complex)) {
+                            const auto a = ToReal(args[0]);
+                            const auto b = ToReal(args[1]);
+                            return MakeReal(is_subtract ? (a - b) : (a / b));
+                        }
+                        const auto a = ToComplex(args[0]);
+                        const auto b = ToComplex(args[1]);
+                        return MakeComplex(is_subtract ? (a - b) : (a / b));
+                    }
+                    if((node.builtin == Builtin::Re) || (node.builtin == Builtin::Im) || (node.builtin == Builtin::Conj) || (node.builtin == Builtin::UnaryMinus)) {
+                        const auto val = ToComplex(arg);
+                        if(node.builtin == Builtin::Re) {
+                            return MakeReal(val.real());
+                        }
+                        else if(node.builtin == Builtin::Im) {
+                            return MakeReal(val.imag());
+                        }
+                        else if(node.builtin == Builtin::Conj) {
+                            return MakeComplex(std::conj(val));
+                        }
+                        return MakeComplex(-val);
+                    }
+
+                    // Plain real functions from here on
+                    double x[MaxBuiltinArgCount];
+                    for(size_t i = 0; i < node.args.size(); i++) {
+                        x[i] = ToReal(args[i]);
+                    }
+
+                    switch(node.builtin) {
+                        case Builtin::Floor: {
+                            return MakeReal(std::floor(x[0]));
+                        }
+                        case Builtin::Ceil: {
+                            return MakeReal(std::ceil(x[0]));
+                        }
+                        case Builtin::Trunc: {
+                            return MakeReal(std::trunc(x[0]));
+                        }
+                        case Builtin::Tan: {
+                            return MakeReal(std::tan(x[0]));
+                        }
+                        case Builtin::Atan: {
+                            return MakeReal(std::atan(x[0]));
+                        }
+                        case Builtin::Sinh: {
+                            return MakeReal(std::sinh(x[0]));
+                        }
+                        case Builtin::Cosh: {
+                            return MakeReal(std::cosh(x[0]));
+                        }
+                        case Builtin::Tanh: {
+                            return MakeReal(std::tanh(x[0]));
+                        }
+                        case Builtin::Asinh: {
+                            return MakeReal(std::asinh(x[0]));
+                        }
+                        case Builtin::Cbrt: {
+                            return MakeReal(std::cbrt(x[0]));
+                        }
+                        case Builtin::Expm1: {
+                            return MakeReal(std::expm1(x[0]));
+                        }
+                        case Builtin::Sign: {
+                            return MakeReal((x[0] > 0.0) ? 1.0 : ((x[0] < 0.0) ? -1.0 : x[0]));
+                        }
+                        case Builtin::Round: {
+                            // JS and math.js round halves differently
+                            return MakeReal(is_mathjs ? std::round(x[0]) : std::floor(x[0] + 0.5));
+                        }
+                        case Builtin::Atan2: {
+                            return MakeReal(std::atan2(x[0], x[1]));
+                        }
+                        case Builtin::NthRoot: {
+                            const auto a = x[0];
+                            const auto n = (node.args.size() > 1) ? x[1] : 2.0;
+                            // Only positive integer roots, where negative values are only valid for odd roots
+                            if((n != std::trunc(n)) || (n <= 0.0) || ((a < 0.0) && (std::floor(n * 0.5) * 2.0 == n))) {
+                                Fail("invalid nthRoot arguments");
+                            }
+                            return MakeReal(std::copysign(std::pow(std::abs(a), 1.0 / n), a));
+                        }
+                        case Builtin::Factorial: {
+                            if(x[0] < 0.0) {
+                                Fail("factorial is not defined for negative values");
+                            }
+                            return MakeReal(std::tgamma(x[0] + 1.0));
+                        }
+                        case Builtin::Gamma: {
+                            return MakeReal(std::tgamma(x[0]));
+                        }
+                        case Builtin::Square: {
+                            return MakeReal(x[0] * x[0]);
+                        }
+                        case Builtin::Cube: {
+                            return MakeReal(x[0] * x[0] * x[0]);
+                        }
+                        case Builtin::Mod: {
+                            // Floored modulo
+                            return MakeReal(x[0] - x[1] * std::floor(x[0] / x[1]));
+                        }
+                        case Builtin::Gauss: {
+                            const auto rel_x = x[0] - x[1];
+                            const auto k0 = x[2];
+                            const auto a = x[3];
+                            const auto amp = std::sqrt(std::sqrt(2.0 / (M_PI * a * a))) * std::exp(-(rel_x / a) * (rel_x / a));
+                            return MakeComplex(std::polar(amp, k0 * rel_x));
+                        }
+                        case Builtin::Delta: {
+                            const auto dx = (node.global != nullptr) ? ToReal(*node.global) : 0.0;
+                            return MakeReal((std::abs(x[0] - x[1]) <= dx) ? x[2] : 0.0);
+                        }
+                        case Builtin::Hermite: {
+                            return MakeReal(special::HermitePolynomial(static_cast<int>(x[0]), x[1]));
+                        }
+                        case Builtin::HermiteFunction: {
+                            return MakeReal(special::HermiteFunction(static_cast<int>(x[0]), x[1]));
+                        }
+                        default: {
+                            Fail("unsupported function '" + node.name + "'");
+                        }
+                    }
+                }
+
+                // Returns whether a return statement was reached
+                bool ExecStatement(const ResolvedStmt &stmt, Value &out_ret) {
+                    switch(stmt.kind) {
+                        case StmtKind::Block: {
+                            for(const auto &sub_stmt: stmt.body) {
+                                if(this->ExecStatement(sub_stmt, out_ret)) {
+                                    return true;
+                                }
+                            }
+                            return false;
+                        }
+                        case StmtKind::If: {
+                            if(ToBool(this->Eval(stmt.expr))) {
+                                return this->ExecStatement(*stmt.then_stmt, out_ret);
+                            }
+                            else if(stmt.else_stmt != nullptr) {
+                                return this->ExecStatement(*stmt.else_stmt, out_ret);
+                            }
+                            return false;
+                        }
+                        case StmtKind::Return: {
+                            out_ret = this->Eval(stmt.expr);
+                            return true;
+                        }
+                        case StmtKind::Declare: {
+                            const auto val = this->Eval(stmt.expr);
+                            this->locals_stack[this->frame + stmt.slot] = val;
+                            return false;
+                        }
+                        case StmtKind::Assign: {
+                            if((stmt.slot == NoSlot) || !this->locals_stack[this->frame + stmt.slot].has_value()) {
+                                Fail("only local variables can be assigned ('" + stmt.name + "')");
+                            }
+                            const auto val = this->Eval(stmt.expr);
+                            this->locals_stack[this->frame + stmt.slot] = val;
+                            return false;
+                        }
+                    }
+                    return false;
+                }
+
+            public:
+                Interpreter(std::vector<std::optional<Value>> &locals_stack) : locals_stack(locals_stack), frame(0), call_depth(0) {}
+
+                Value Eval(const Node &node) {
+                    switch(node.kind) {
+                        case NodeKind::Constant: {
+                            return node.val;
+                        }
+                        case NodeKind::Local: {
+                            const auto &local = this->locals_stack[this->frame + node.slot];
+                            if(local.has_value()) {
+                                return *local;
+                            }
+                            return this->Eval(node.args[0]);
+                        }
+                        case NodeKind::Global: {
+                            return *node.global;
+                        }
+                        case NodeKind::Unary: {
+                            return this->EvalUnary(node);
+                        }
+                        case NodeKind::Binary: {
+                            return this->EvalBinary(node);
+                        }
+                        case NodeKind::Logical: {
+                            return this->EvalLogical(node);
+                        }
+                        case NodeKind::Conditional: {
+                            return ToBool(this->Eval(node.args[0])) ? this->Eval(node.args[1]) : this->Eval(node.args[2]);
+                        }
+                        case NodeKind::Call: {
+                            return this->EvalCall(node);
+                        }
+                        case NodeKind::Builtin: {
+                            return this->EvalBuiltin(node);
+                        }
+                        case NodeKind::Fail: {
+                            Fail(node.name);
+                        }
+                    }
+                    Fail("unsupported expression");
+                }
+
+                // Parameters without arguments would be undefined, thus left unbound (any use of them fails)
+                size_t PushFrame(const ResolvedFunction &fn) {
+                    if(this->call_depth >= MaxCallDepth) {
+                        Fail("maximum call depth exceeded");
+                    }
+                    const auto fn_frame = this->locals_stack.size();
+                    this->locals_stack.resize(fn_frame + fn.local_count);
+                    return fn_frame;
+                }
+
+                void BindArgument(const ResolvedFunction &fn, const size_t fn_frame, const size_t idx, const Value &val) {
+                    if(idx < fn.param_slots.size()) {
+                        this->locals_stack[fn_frame + fn.param_slots[idx]] = val;
+                    }
+                }
+
+                Value Run(const ResolvedFunction &fn, const size_t fn_frame) {
+                    const auto prev_frame = this->frame;
+                    this->frame = fn_frame;
+                    this->call_depth++;
+
+                    Value ret = {};
+                    const auto returned = this->ExecStatement(fn.body, ret);
+
+                    this->call_depth--;
+                    this->frame = prev_frame;
+                    this->locals_stack.resize(fn_frame);
+                    if(!returned) {
+                        Fail("function '" + fn.name + "' ended without returning a value");
+                    }
+                    return ret;
+                }
+        };
+
+        bool CheckGridFunction(const Program &program, const GridFunctionKind kind, const Function *&out_fn, std::string &out_error) {
+            const auto fn_name = (kind == GridFunctionKind::Psi0) ? "psi0" : "V";
+            out_fn = program.FindFunction(fn_name);
+            if(out_fn == nullptr) {
+                out_error = std::string("function '") + fn_name + "' is not defined";
+                return false;
+            }
+            if((kind == GridFunctionKind::Psi0) && (out_fn->params.size() > 1)) {
+                out_error = "psi0 must take at most one parameter (x)";
+                return false;
+            }
+            if((kind == GridFunctionKind::V) && (out_fn->params.size() > 2)) {
+                out_error = "V must take at most two parameters (x, t)";
+                return false;
+            }
+            return true;
+        }
+
+    }
+
+    NativeEvaluator::NativeEvaluator() : psi0_fn(nullptr), v_fn(nullptr), resolved_psi0_fn(nullptr), resolved_v_fn(nullptr) {}
+
+    NativeEvaluator::~NativeEvaluator() = default;
+
+    void NativeEvaluator::ResolveFunctions() {
+        this->resolved_fns.clear();
+        for(const auto program: { &this->psi0_program, &this->v_program }) {
+            for(const auto &fn_def: program->functions) {
+                auto fn = std::make_unique<ResolvedFunction>();
+                fn->def = &fn_def;
+                fn->name = fn_def.name;
+                this->resolved_fns.push_back(std::move(fn));
+            }
+        }
+
+        // Every function needs to exist before any call to it is resolved
+        for(size_t i = 0; i < this->resolved_fns.size(); i++) {
+            const auto is_psi0 = i < this->psi0_program.functions.size();
+            Resolver resolver(this->globals, is_psi0 ? this->psi0_program : this->v_program, is_psi0 ? this->v_program : this->psi0_program, this->resolved_fns);
+            resolver.ResolveFunction(*this->resolved_fns.at(i));
+        }
+
+        const auto find_resolved = [&](const Function *fn_def) -> const ResolvedFunction* {
+            for(const auto &fn: this->resolved_fns) {
+                if(fn->def == fn_def) {
+                    return fn.get();
+                }
+            }
+            return nullptr;
+        };
+        this->resolved_psi0_fn = find_resolved(this->psi0_program.FindFunction("psi0"));
+        this->resolved_v_fn = find_resolved(this->v_program.FindFunction("V"));
+    }
+
+    bool NativeEvaluator::Evaluate(const GridFunctionKind kind, const char *src, const EvaluationVariables &vars, std::string &out_error) {
+        auto &program = (kind == GridFunctionKind::Psi0) ? this->psi0_program : this->v_program;
+        auto &other_program = (kind == GridFunctionKind::Psi0) ? this->v_program : this->psi0_program;
+        auto &fn = (kind == GridFunctionKind::Psi0) ? this->psi0_fn : this->v_fn;
+        program = {};
+        fn = nullptr;
+
+        this->globals["hslash"] = MakeReal(vars.hslash);
+        this->globals["m"] = MakeReal(vars.m);
+        this->globals["x0"] = MakeReal(vars.x0);
+        this->globals["xf"] = MakeReal(vars.xf);
+        this->globals["dx"] = MakeReal(vars.dx);
+        this->globals["t0"] = MakeReal(vars.t0);
+        this->globals["dt"] = MakeReal(vars.dt);
+
+        const auto parse_ok = Parse(src, program, out_error);
+        if(!parse_ok) {
+            program = {};
+        }
+        // Also done when failing, since the other source may call the functions that were there before
+        this->ResolveFunctions();
+        if(!parse_ok) {
+            return false;
+        }
+
+        try {
+            // In order, since globals may depend on previous ones
+            for(const auto &global: program.globals) {
+                const auto expr = Resolver(this->globals, program, other_program, this->resolved_fns).ResolveExpr(*global.expr);
+                this->locals_stack.clear();
+                Interpreter interp(this->locals_stack);
+                const auto val = interp.Eval(expr);
+                if(this->globals.insert_or_assign(global.name, val).second) {
+                    // Functions may refer to the new global
+                    this->ResolveFunctions();
+                }
+            }
+        }
+        catch(EvalError &e) {
+            out_error = e.msg;
+            return false;
+        }
+
+        return CheckGridFunction(program, kind, fn, out_error);
+    }
+
+    bool NativeEvaluator::TryGetPsi0(const double x, Num &out_psi0) {
+        if(this->psi0_fn == nullptr) {
+            this->sample_error = "the source has not been evaluated";
+            return false;
+        }
+
+        try {
+            this->locals_stack.clear();
+            Interpreter interp(this->locals_stack);
+            const auto &fn = *this->resolved_psi0_fn;
+            const auto fn_frame = interp.PushFrame(fn);
+            interp.BindArgument(fn, fn_frame, 0, MakeReal(x));
+            const auto ret = interp.Run(fn, fn_frame);
+            if(ret.kind == ValueKind::Bool) {
+                this->sample_error = "boolean return values are not supported";
+                return false;
+            }
+            out_psi0 = ret.num;
+            return true;
+        }
+        catch(EvalError &e) {
+            this->sample_error = e.msg;
+            return false;
+        }
+    }
+
+    bool NativeEvaluator::TryGetV(const double x, const double t, double &out_v) {
+        if(this->v_fn == nullptr) {
+            this->sample_error = "the source has not been evaluated";
+            return false;
+        }
+
+        try {
+            this->locals_stack.clear();
+            Interpreter interp(this->locals_stack);
+            const auto &fn = *this->resolved_v_fn;
+            const auto fn_frame = interp.PushFrame(fn);
+            interp.BindArgument(fn, fn_frame, 0, MakeReal(x));
+            interp.BindArgument(fn, fn_frame, 1, MakeReal(t));
+            const auto ret = interp.Run(fn, fn_frame);
+            if((ret.kind != ValueKind::Real) || !std::isfinite(ret.num.real())) {
+                this->sample_error = "V must return finite real values";
+                return false;
+            }
+            out_v = ret.num.real();
+            return true;
+        }
+        catch(EvalError &e) {
+            this->sample_error = e.msg;
+            return false;
+        }
+    }
+
+    bool NativeEvaluator::CompileGridFunction(const Program &program, const GridFunctionKind kind, std::string &out_error) {
+        const Function *fn;
+        return CheckGridFunction(program, kind, fn, out_error);
+    }
+
+    bool NativeEvaluator::InstallGridFunction(const GridFunctionKind kind, std::string &out_error) {
+        const auto fn = (kind == GridFunctionKind::Psi0) ? this->psi0_fn : this->v_fn;
+        if(fn == nullptr) {
+            out_error = "the source has not been evaluated";
+            return false;
+        }
+        return true;
+    }
+
+    long NativeEvaluator::EvaluatePsi0Grid(const double *x_ptr, const long count, Num *out_ptr) {
+        for(long i = 0; i < count; i++) {
+            if(!this->TryGetPsi0(x_ptr[i], out_ptr[i])) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    long NativeEvaluator::EvaluateVGrid(const double *x_ptr, const long count, const double t, double *out_ptr) {
+        for(long i = 0; i < count; i++) {
+            if(!this->TryGetV(x_ptr[i], t, out_ptr[i])) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    #ifndef __EMSCRIPTEN__
+    std::unique_ptr<Evaluator> CreatePlatformEvaluator() {
+        return std::make_unique<NativeEvaluator>();
+    }
+    #endif
+
+}
@@ -0,0 +1,1373 @@
+#include "src_wasm.hpp"
+#include <cmath>
+#include <cstring>
+#include <map>
+
+namespace src {
+
+    namespace {
+
+        // Only used internally to unwind the code generation, GenerateWasmGridModule() reports it as a regular error
+        struct CompileError {
+            std::string msg;
+        };
+
+        enum class ValueType {
+            Bool,
+            Real,
+            Complex
+        };
+
+        namespace op {
+
+            constexpr uint8_t Block = 0x02;
+            constexpr uint8_t Loop = 0x03;
+            constexpr uint8_t If = 0x04;
+            constexpr uint8_t Else = 0x05;
+            constexpr uint8_t End = 0x0b;
+            constexpr uint8_t Br = 0x0c;
+            constexpr uint8_t BrIf = 0x0d;
+            constexpr uint8_t Return = 0x0f;
+            constexpr uint8_t Call = 0x10;
+            constexpr uint8_t Select = 0x1b;
+            constexpr uint8_t LocalGet = 0x20;
+            constexpr uint8_t LocalSet = 0x21;
+            constexpr uint8_t LocalTee = 0x22;
+            constexpr uint8_t GlobalGet = 0x23;
+            constexpr uint8_t F64Load = 0x2b;
+            constexpr uint8_t F64Store = 0x39;
+            constexpr uint8_t I32Const = 0x41;
+            constexpr uint8_t F64Const = 0x44;
+            constexpr uint8_t I32Eqz = 0x45;
+            constexpr uint8_t I32GeS = 0x4e;
+            constexpr uint8_t F64Eq = 0x61;
+            constexpr uint8_t F64Ne = 0x62;
+            constexpr uint8_t F64Lt = 0x63;
+            constexpr uint8_t F64Gt = 0x64;
+            constexpr uint8_t F64Le = 0x65;
+            constexpr uint8_t F64Ge = 0x66;
+            constexpr uint8_t I32Add = 0x6a;
+            constexpr uint8_t I32And = 0x71;
+            constexpr uint8_t I32Or = 0x72;
+            constexpr uint8_t I32Shl = 0x74;
+            constexpr uint8_t F64Abs = 0x99;
+            constexpr uint8_t F64Neg = 0x9a;
+            constexpr uint8_t F64Ceil = 0x9b;
+            constexpr uint8_t F64Floor = 0x9c;
+            constexpr uint8_t F64Trunc = 0x9d;
+            constexpr uint8_t F64Sqrt = 0x9f;
+            constexpr uint8_t F64Add = 0xa0;
+            constexpr uint8_t F64Sub = 0xa1;
+            constexpr uint8_t F64Mul = 0xa2;
+            constexpr uint8_t F64Div = 0xa3;
+            constexpr uint8_t F64Min = 0xa4;
+            constexpr uint8_t F64Max = 0xa5;
+            constexpr uint8_t F64Copysign = 0xa6;
+            constexpr uint8_t F64ConvertI32U = 0xb8;
+
+        }
+
+        constexpr uint8_t TypeI32 = 0x7f;
+        constexpr uint8_t TypeF64 = 0x7c;
+        constexpr uint8_t TypeFunc = 0x60;
+        constexpr uint8_t BlockVoid = 0x40;
+
+        constexpr uint8_t ImportKindFunction = 0x00;
+        constexpr uint8_t ImportKindMemory = 0x02;
+        constexpr uint8_t ImportKindGlobal = 0x03;
+        constexpr uint8_t ExportKindFunction = 0x00;
+
+        constexpr uint8_t SectionType = 1;
+        constexpr uint8_t SectionImport = 2;
+        constexpr uint8_t SectionFunction = 3;
+        constexpr uint8_t SectionExport = 7;
+        constexpr uint8_t SectionCode = 10;
+
+        void WriteUleb(std::vector<uint8_t> &out, uint64_t val) {
+            do {
+                uint8_t byte = val & 0x7f;
+                val >>= 7;
+                if(val != 0) {
+                    byte |= 0x80;
+                }
+                out.push_back(byte);
+            } while(val != 0);
+        }
+
+        void WriteSleb(std::vector<uint8_t> &out, int64_t val) {
+            while(true) {
+                const uint8_t byte = val & 0x7f;
+                val >>= 7;
+                if(((val == 0) && !(byte & 0x40)) || ((val == -1) && (byte & 0x40))) {
+                    out.push_back(byte);
+                    break;
+                }
+                out.push_back(byte | 0x80);
+            }
+        }
+
+        void WriteName(std::vector<uint8_t> &out, const std::string &name) {
+            WriteUleb(out, name.length());
+            out.insert(out.end(), name.begin(), name.end());
+        }
+
+        void WriteSection(std::vector<uint8_t> &out, const uint8_t id, const std::vector<uint8_t> &contents) {
+            out.push_back(id);
+            WriteUleb(out, contents.size());
+            out.insert(out.end(), contents.begin(), contents.end());
+        }
+
+        struct Local {
+            ValueType type;
+            // Complex values are stored as two locals (real and imaginary parts)
+            uint32_t idx;
+            uint32_t im_idx;
+        };
+
+        struct FunctionImport {
+            std::string module;
+            std::string name;
+            uint32_t arity;
+        };
+
+        class GridCompiler {
+            private:
+                const Program &program;
+                const GridFunctionKind kind;
+                std::vector<uint8_t> code;
+                uint32_t param_count;
+                std::vector<uint8_t> local_types;
+                std::map<std::string, Local> locals;
+                std::vector<FunctionImport> fn_imports;
+                std::map<std::string, uint32_t> fn_import_map;
+                std::vector<std::string> global_imports;
+                std::map<std::string, uint32_t> global_import_map;
+                int depth;
+                int ret_depth;
+                int fail_depth;
+                uint32_t i_local;
+                uint32_t out_ptr_param;
+
+                [[noreturn]] static void Fail(const std::string &msg) {
+                    throw CompileError { msg };
+                }
+
+                inline void Emit(const uint8_t byte) {
+                    this->code.push_back(byte);
+                }
+
+                inline void EmitLocal(const uint8_t opcode, const uint32_t idx) {
+                    this->Emit(opcode);
+                    WriteUleb(this->code, idx);
+                }
+
+                inline void EmitF64(const double val) {
+                    this->Emit(op::F64Const);
+                    uint8_t bytes[sizeof(double)];
+                    memcpy(bytes, &val, sizeof(bytes));
+                    this->code.insert(this->code.end(), bytes, bytes + sizeof(bytes));
+                }
+
+                inline void EmitI32(const int32_t val) {
+                    this->Emit(op::I32Const);
+                    WriteSleb(this->code, val);
+                }
+
+                inline void EmitMemory(const uint8_t opcode, const uint32_t offset) {
+                    this->Emit(opcode);
+                    // 8-byte alignment
+                    WriteUleb(this->code, 3);
+                    WriteUleb(this->code, offset);
+                }
+
+                inline void EmitBeginBlock(const uint8_t opcode, const uint8_t block_type) {
+                    this->Emit(opcode);
+                    this->Emit(block_type);
+                    this->depth++;
+                }
+
+                inline void EmitEndBlock() {
+                    this->Emit(op::End);
+                    this->depth--;
+                }
+
+                inline void EmitBranch(const uint8_t opcode, const int label_depth) {
+                    this->Emit(opcode);
+                    WriteUleb(this->code, this->depth - label_depth);
+                }
+
+                // Branch to the fail label (giving up on the current sample) if the i32 on the stack is true
+                inline void EmitFailIf() {
+                    this->EmitBranch(op::BrIf, this->fail_depth);
+                }
+
+                uint32_t AllocateLocal(const uint8_t type) {
+                    this->local_types.push_back(type);
+                    return this->param_count + this->local_types.size() - 1;
+                }
+
+                uint32_t ImportFunction(const std::string &module, const std::string &name, const uint32_t arity) {
+                    const auto key = module + "." + name;
+                    const auto it = this->fn_import_map.find(key);
+                    if(it != this->fn_import_map.end()) {
+                        return it->second;
+                    }
+
+                    const uint32_t idx = this->fn_imports.size();
+                    this->fn_imports.push_back({ module, name, arity });
+                    this->fn_import_map[key] = idx;
+                    return idx;
+                }
+
+                void EmitImportCall(const std::string &module, const std::string &name, const uint32_t arity) {
+                    this->Emit(op::Call);
+                    WriteUleb(this->code, this->ImportFunction(module, name, arity));
+                }
+
+                uint32_t ImportGlobal(const std::string &name) {
+                    const auto it = this->global_import_map.find(name);
+                    if(it != this->global_import_map.end()) {
+                        return it->second;
+                    }
+
+                    const uint32_t idx = this->global_imports.size();
+                    this->global_imports.push_back(name);
+                    this->global_import_map[name] = idx;
+                    return idx;
+                }
+
+                // Value conversions, following JS semantics where they make sense
+
+                void EmitToReal(const ValueType type) {
+                    if(type == ValueType::Bool) {
+                        this->Emit(op::F64ConvertI32U);
+                    }
+                    else if(type == ValueType::Complex) {
+                        Fail("complex values cannot be used as real numbers (use math.re/math.im/math.abs)");
+                    }
+                }
+
+                void EmitToBool(const ValueType type) {
+                    if(type == ValueType::Real) {
+                        // Both 0 and NaN are falsy
+                        this->Emit(op::F64Abs);
+                        this->EmitF64(0.0);
+                        this->Emit(op::F64Gt);
+                    }
+                    else if(type == ValueType::Complex) {
+                        Fail("complex values cannot be used as conditions");
+                    }
+                }
+
+                void EmitToComplex(const ValueType type) {
+                    if(type != ValueType::Complex) {
+                        this->EmitToReal(type);
+                        this->EmitF64(0.0);
+                    }
+                }
+
+                void EmitConvert(const ValueType from, const ValueType to) {
+                    if(to == ValueType::Complex) {
+                        this->EmitToComplex(from);
+                    }
+                    else if(to == ValueType::Real) {
+                        this->EmitToReal(from);
+                    }
+                    else {
+                        this->EmitToBool(from);
+                    }
+                }
+
+                Local PopComplex() {
+                    Local local = { ValueType::Complex, this->AllocateLocal(TypeF64), this->AllocateLocal(TypeF64) };
+                    this->EmitLocal(op::LocalSet, local.im_idx);
+                    this->EmitLocal(op::LocalSet, local.idx);
+                    return local;
+                }
+
+                uint32_t PopReal() {
+                    const auto idx = this->AllocateLocal(TypeF64);
+                    this->EmitLocal(op::LocalSet, idx);
+                    return idx;
+                }
+
+                void EmitComplexMultiply(const Local &a, const Local &b) {
+                    this->EmitLocal(op::LocalGet, a.idx);
+                    this->EmitLocal(op::LocalGet, b.idx);
+                    this->Emit(op::F64Mul);
+                    this->EmitLocal(op::LocalGet, a.im_idx);
+                    this->EmitLocal(op::LocalGet, b.im_idx);
+                    this->Emit(op::F64Mul);
+                    this->Emit(op::F64Sub);
+                    this->EmitLocal(op::LocalGet, a.idx);
+                    this->EmitLocal(op::LocalGet, b.im_idx);
+                    this->Emit(op::F64Mul);
+                    this->EmitLocal(op::LocalGet, a.im_idx);
+                    this->EmitLocal(op::LocalGet, b.idx);
+                    this->Emit(op::F64Mul);
+                    this->Emit(op::F64Add);
+                }
+
+                void EmitComplexDivide(const Local &a, const Local &b) {
+                    const auto denom = this->AllocateLocal(TypeF64);
+                    this->EmitLocal(op::LocalGet, b.idx);
+                    this->EmitLocal(op::LocalGet, b.idx);
+                    this->Emit(op::F64Mul);
+                    this->EmitLocal(op::LocalGet, b.im_idx);
+                    this->EmitLocal(op::LocalGet, b.im_idx);
+                    this->Emit(op::F64Mul);
+                    this->Emit(op::F64Add);
+                    this->EmitLocal(op::LocalSet, denom);
+
+                    this->EmitLocal(op::LocalGet, a.idx);
+                    this->EmitLocal(op::LocalGet, b.idx);
+                    this->Emit(op::F64Mul);
+                    this->EmitLocal(op::LocalGet, a.im_idx);
+                    this->EmitLocal(op::LocalGet, b.im_idx);
+                    this->Emit(op::F64Mul);
+                    this->Emit(op::F64Add);
+                    this->EmitLocal(op::LocalGet, denom);
+                    this->Emit(op::F64Div);
+
+                    this->EmitLocal(op::LocalGet, a.im_idx);
+                    this->EmitLocal(op::LocalGet, b.idx);
+                    this->Emit(op::F64Mul);
+                    this->EmitLocal(op::LocalGet, a.idx);
+                    this->EmitLocal(op::LocalGet, b.im_idx);
+                    this->Emit(op::F64Mul);
+                    this->Emit(op::F64Sub);
+                    this->EmitLocal(op::LocalGet, denom);
+                    this->Emit(op::F64Div);
+                }
+
+                ValueType EmitIdentifier(const Expr &expr) {
+                    const auto it = this->locals.find(expr.name);
+                    if(it != this->locals.end()) {
+                        this->EmitLocal(op::LocalGet, it->second.idx);
+                        if(it->second.type == ValueType::Complex) {
+                            this->EmitLocal(op::LocalGet, it->second.im_idx);
+                        }
+                        return it->second.type;
+                    }
+
+                    if((expr.name == "math.PI") || (expr.name == "Math.PI") || (expr.name == "math.pi")) {
+                        this->EmitF64(M_PI);
+                        return ValueType::Real;
+                    }
+                    if((expr.name == "math.E") || (expr.name == "Math.E") || (expr.name == "math.e")) {
+                        this->EmitF64(M_E);
+                        return ValueType::Real;
+                    }
+                    if((expr.name == "math.SQRT2") || (expr.name == "Math.SQRT2")) {
+                        this->EmitF64(M_SQRT2);
+                        return ValueType::Real;
+                    }
+                    if((expr.name == "math.LN2") || (expr.name == "Math.LN2")) {
+                        this->EmitF64(M_LN2);
+                        return ValueType::Real;
+                    }
+                    if((expr.name == "math.LN10") || (expr.name == "Math.LN10")) {
+                        this->EmitF64(M_LN10);
+                        return ValueType::Real;
+                    }
+                    if(expr.name == "math.i") {
+                        this->EmitF64(0.0);
+                        this->EmitF64(1.0);
+                        return ValueType::Complex;
+                    }
+                    if(expr.name == "Infinity") {
+                        this->EmitF64(INFINITY);
+                        return ValueType::Real;
+                    }
+                    if(expr.name == "NaN") {
+                        this->EmitF64(NAN);
+                        return ValueType::Real;
+                    }
+
+                    if(expr.name.find('.') != std::string::npos) {
+                        Fail("unsupported member '" + expr.name + "'");
+                    }
+                    if(this->program.FindFunction(expr.name) != nullptr) {
+                        Fail("functions cannot be used as values ('" + expr.name + "')");
+                    }
+
+                    // Any other global is imported at instantiation time (which fails if it is not a number)
+                    this->Emit(op::GlobalGet);
+                    WriteUleb(this->code, this->ImportGlobal(expr.name));
+                    return ValueType::Real;
+                }
+
+                ValueType EmitUnary(const Expr &expr) {
+                    const auto type = this->EmitExpr(*expr.args.at(0));
+                    if(expr.name == "-") {
+                        if(type == ValueType::Complex) {
+                            const auto val = this->PopComplex();
+                            this->EmitLocal(op::LocalGet, val.idx);
+                            this->Emit(op::F64Neg);
+                            this->EmitLocal(op::LocalGet, val.im_idx);
+                            this->Emit(op::F64Neg);
+                            return ValueType::Complex;
+                        }
+                        this->EmitToReal(type);
+                        this->Emit(op::F64Neg);
+                        return ValueType::Real;
+                    }
+                    else if(expr.name == "+") {
+                        this->EmitToReal(type);
+                        return ValueType::Real;
+                    }
+                    else {
+                        this->EmitToBool(type);
+                        this->Emit(op::I32Eqz);
+                        return ValueType::Bool;
+                    }
+                }
+
+                ValueType EmitBinary(const Expr &expr) {
+                    const auto &op_name = expr.name;
+                    const auto lhs_type = this->EmitExpr(*expr.args.at(0));
+                    if((lhs_type == ValueType::Complex)) {
+                        Fail("operator '" + op_name + "' is not supported on complex values (use math.add/math.multiply...)");
+                    }
+                    this->EmitToReal(lhs_type);
+                    const auto rhs_type = this->EmitExpr(*expr.args.at(1));
+                    if((rhs_type == ValueType::Complex)) {
+                        Fail("operator '" + op_name + "' is not supported on complex values (use math.add/math.multiply...)");
+                    }
+                    this->EmitToReal(rhs_type);
+
+                    if(op_name == "+") {
+                        this->Emit(op::F64Add);
+                    }
+                    else if(op_name == "-") {
+                        this->Emit(op::F64Sub);
+                    }
+                    else if(op_name == "*") {
+                        this->Emit(op::F64Mul);
+                    }
+                    else if(op_name == "/") {
+                        this->Emit(op::F64Div);
+                    }
+                    else if(op_name == "%") {
+                        // a - trunc(a/b)*b is not exact (it may even be off by a whole period), thus the JS operator itself is imported
+                        this->EmitImportCall("op", "rem", 2);
+                    }
+                    else if(op_name == "**") {
+                        this->EmitImportCall("Math", "pow", 2);
+                    }
+                    else {
+                        if(op_name == "<") {
+                            this->Emit(op::F64Lt);
+                        }
+                        else if(op_name == ">") {
+                            this->Emit(op::F64Gt);
+                        }
+                        else if(op_name == "<=") {
+                            this->Emit(op::F64Le);
+                        }
+                        else if(op_name == ">=") {
+                            this->Emit(op::F64Ge);
+                        }
+                        else if(op_name == "==") {
+                            this->Emit(op::F64Eq);
+                        }
+                        else {
+                            this->Emit(op::F64Ne);
+                        }
+                        return ValueType::Bool;
+                    }
+                    return ValueType::Real;
+                }
+
+                // In JS, logical operators return one of their operands, so only boolean operands are supported when used as values...
+                ValueType EmitLogical(const Expr &expr) {
+                    const auto lhs_type = this->EmitExpr(*expr.args.at(0));
+                    if(lhs_type != ValueType::Bool) {
+                        Fail("logical operators used as values only support boolean operands");
+                    }
+                    this->EmitBeginBlock(op::If, TypeI32);
+                    if(expr.name == "&&") {
+                        if(this->EmitExpr(*expr.args.at(1)) != ValueType::Bool) {
+                            Fail("logical operators used as values only support boolean operands");
+                        }
+                        this->Emit(op::Else);
+                        this->EmitI32(0);
+                    }
+                    else {
+                        this->EmitI32(1);
+                        this->Emit(op::Else);
+                        if(this->EmitExpr(*expr.args.at(1)) != ValueType::Bool) {
+                            Fail("logical operators used as values only support boolean operands");
+                        }
+                    }
+                    this->EmitEndBlock();
+                    return ValueType::Bool;
+                }
+
+                // ...while as conditions any operands are fine
+                void EmitCondition(const Expr &expr) {
+                    if(expr.kind == ExprKind::Logical) {
+                        this->EmitCondition(*expr.args.at(0));
+                        this->EmitBeginBlock(op::If, TypeI32);
+                        if(expr.name == "&&") {
+                            this->EmitCondition(*expr.args.at(1));
+                            this->Emit(op::Else);
+                            this->EmitI32(0);
+                        }
+                        else {
+                            this->EmitI32(1);
+                            this->Emit(op::Else);
+                            this->EmitCondition(*expr.args.at(1));
+                        }
+                        this->EmitEndBlock();
+                    }
+                    else {
+                        this->EmitToBool(this->EmitExpr(expr));
+                    }
+                }
+
+                ValueType EmitConditional(const Expr &expr) {
+                    this->EmitCondition(*expr.args.at(0));
+
+                    // Generate both branches separately first, since the block type depends on their value types
+                    auto outer_code = std::move(this->code);
+                    this->depth++;
+                    this->code.clear();
+                    const auto then_type = this->EmitExpr(*expr.args.at(1));
+                    auto then_code = std::move(this->code);
+                    this->code.clear();
+                    const auto else_type = this->EmitExpr(*expr.args.at(2));
+                    auto else_code = std::move(this->code);
+                    this->depth--;
+                    this->code = std::move(outer_code);
+
+                    auto result_type = ValueType::Bool;
+                    if((then_type == ValueType::Complex) || (else_type == ValueType::Complex)) {
+                        result_type = ValueType::Complex;
+                    }
+                    else if((then_type == ValueType::Real) || (else_type == ValueType::Real)) {
+                        result_type = ValueType::Real;
+                    }
+
+                    const auto emit_branch = [&](std::vector<uint8_t> &branch_code, const ValueType branch_type) {
+                        this->code.insert(this->code.end(), branch_code.begin(), branch_code.end());
+                        this->EmitConvert(branch_type, result_type);
+                    };
+
+                    if(result_type == ValueType::Complex) {
+                        // Blocks cannot produce two values without the multi-value extension, go through locals instead
+                        const auto re = this->AllocateLocal(TypeF64);
+                        const auto im = this->AllocateLocal(TypeF64);
+                        this->EmitBeginBlock(op::If, BlockVoid);
+                        emit_branch(then_code, then_type);
+                        this->EmitLocal(op::LocalSet, im);
+                        this->EmitLocal(op::LocalSet, re);
+                        this->Emit(op::Else);
+                        emit_branch(else_code, else_type);
+                        this->EmitLocal(op::LocalSet, im);
+                        this->EmitLocal(op::LocalSet, re);
+                        this->EmitEndBlock();
+                        this->EmitLocal(op::LocalGet, re);
+                        this->EmitLocal(op::LocalGet, im);
+                    }
+                    else {
+                        this->EmitBeginBlock(op::If, (result_type == ValueType::Real) ? TypeF64 : TypeI32);
+                        emit_branch(then_code, then_type);
+                        this->Emit(op::Else);
+                        emit_branch(else_code, else_type);
+                        this->EmitEndBlock();
+                    }
+                    return result_type;
+                }
+
+                void EmitRealArgs(const Expr &expr, const size_t min_count, const size_t max_count) {
+                    if((expr.args.size() < min_count) || (expr.args.size() > max_count)) {
+                        Fail("invalid argument count for '" + expr.name + "'");
+                    }
+                    for(const auto &arg: expr.args) {
+                        this->EmitToReal(this->EmitExpr(*arg));
+                    }
+                }
+
+                std::vector<ValueType> EmitArgs(const Expr &expr, const size_t min_count, const size_t max_count) {
+                    if((expr.args.size() < min_count) || (expr.args.size() > max_count)) {
+                        Fail("invalid argument count for '" + expr.name + "'");
+                    }
+                    std::vector<ValueType> types;
+                    for(const auto &arg: expr.args) {
+                        types.push_back(this->EmitExpr(*arg));
+                    }
+                    return types;
+                }
+
+                // math.js returns complex numbers (or throws) outside of the real domain of these functions, leave those samples to JS
+                // Expects the check value in a local, and a condition generator leaving an i32 on the stack
+                template<typename F>
+                void EmitDomainCheck(F emit_fail_condition) {
+                    emit_fail_condition();
+                    this->EmitFailIf();
+                }
+
+                void EmitCheckedUnary(const uint8_t fail_cmp, const double bound, const bool abs_check) {
+                    const auto val = this->PopReal();
+                    this->EmitDomainCheck([&]() {
+                        this->EmitLocal(op::LocalGet, val);
+                        if(abs_check) {
+                            this->Emit(op::F64Abs);
+                        }
+                        this->EmitF64(bound);
+                        this->Emit(fail_cmp);
+                    });
+                    this->EmitLocal(op::LocalGet, val);
+                }
+
+                ValueType EmitVariadicMinMax(const Expr &expr, const uint8_t opcode, const double empty_val) {
+                    if(expr.args.empty()) {
+                        this->EmitF64(empty_val);
+                        return ValueType::Real;
+                    }
+                    this->EmitToReal(this->EmitExpr(*expr.args.at(0)));
+                    for(size_t i = 1; i < expr.args.size(); i++) {
+                        this->EmitToReal(this->EmitExpr(*expr.args.at(i)));
+                        this->Emit(opcode);
+                    }
+                    return ValueType::Real;
+                }
+
+                // math.add/math.multiply accept any number of arguments, fold them pairwise
+                ValueType EmitVariadicComplexFold(const Expr &expr, const bool multiply) {
+                    if(expr.args.size() < 2) {
+                        Fail("invalid argument count for '" + expr.name + "'");
+                    }
+
+                    auto type = this->EmitExpr(*expr.args.at(0));
+                    for(size_t i = 1; i < expr.args.size(); i++) {
+                        // The accumulated value is already on the stack
+                        const auto rhs_type = this->EmitExpr(*expr.args.at(i));
+                        if((type != ValueType::Complex) && (rhs_type != ValueType::Complex)) {
+                            this->EmitToReal(rhs_type);
+                            const auto b = this->PopReal();
+                            this->EmitToReal(type);
+                            this->EmitLocal(op::LocalGet, b);
+                            this->Emit(multiply ? op::F64Mul : op::F64Add);
+                            type = ValueType::Real;
+                        }
+                        else {
+                            this->EmitToComplex(rhs_type);
+                            const auto b = this->PopComplex();
+                            this->EmitToComplex(type);
+                            const auto a = this->PopComplex();
+                            if(multiply) {
+                                this->EmitComplexMultiply(a, b);
+                            }
+                            else {
+                                this->EmitLocal(op::LocalGet, a.idx);
+                                this->EmitLocal(op::LocalGet, b.idx);
+                                this->Emit(op::F64Add);
+                                this->EmitLocal(op::LocalGet, a.im_idx);
+                                this->EmitLocal(op::LocalGet, b.im_idx);
+                                this->Emit(op::F64Add);
+                            }
+                            type = ValueType::Complex;
+                        }
+                    }
+                    return type;
+                }
+
+                ValueType EmitCall(const Expr &expr) {
+                    const auto &name = expr.name;
+                    if(this->program.FindFunction(name) != nullptr) {
+                        Fail("calls to source-defined functions are not supported ('" + name + "')");
+                    }
+
+                    const auto dot_pos = name.find('.');
+                    const auto ns = (dot_pos != std::string::npos) ? name.substr(0, dot_pos) : "";
+                    const auto fn = (dot_pos != std::string::npos) ? name.substr(dot_pos + 1) : name;
+                    const auto is_js_math = ns == "Math";
+                    const auto is_mathjs = ns == "math";
+
+                    if(is_js_math || is_mathjs) {
+                        // Natively supported operations
+                        if((fn == "sqrt") || (fn == "floor") || (fn == "ceil") || (fn == "trunc") || (fn == "fix")) {
+                            this->EmitRealArgs(expr, 1, 1);
+                            if(fn == "sqrt") {
+                                if(is_mathjs) {
+                                    this->EmitCheckedUnary(op::F64Lt, 0.0, false);
+                                }
+                                this->Emit(op::F64Sqrt);
+                            }
+                            else if(fn == "floor") {
+                                this->Emit(op::F64Floor);
+                            }
+                            else if(fn == "ceil") {
+                                this->Emit(op::F64Ceil);
+                            }
+                            else {
+                                this->Emit(op::F64Trunc);
+                            }
+                            return ValueType::Real;
+                        }
+                        if(fn == "abs") {
+                            const auto types = this->EmitArgs(expr, 1, 1);
+                            if(types.at(0) == ValueType::Complex) {
+                                const auto val = this->PopComplex();
+                                this->EmitLocal(op::LocalGet, val.idx);
+                                this->EmitLocal(op::LocalGet, val.idx);
+                                this->Emit(op::F64Mul);
+                                this->EmitLocal(op::LocalGet, val.im_idx);
+                                this->EmitLocal(op::LocalGet, val.im_idx);
+                                this->Emit(op::F64Mul);
+                                this->Emit(op::F64Add);
+                                this->Emit(op::F64Sqrt);
+                            }
+                            else {
+                                this->EmitToReal(types.at(0));
+                                this->Emit(op::F64Abs);
+                            }
+                            return ValueType::Real;
+                        }
+                        if(fn == "min") {
+                            return this->EmitVariadicMinMax(expr, op::F64Min, INFINITY);
+                        }
+                        if(fn == "max") {
+                            return this->EmitVariadicMinMax(expr, op::F64Max, -INFINITY);
+                        }
+
+                        // Plain real functions (no domain restrictions), imported from JS
+                        static const char *unrestricted_fns[] = { "sin", "cos", "tan", "atan", "sinh", "cosh", "tanh", "asinh", "cbrt", "sign", "expm1" };
+                        for(const auto unrestricted_fn: unrestricted_fns) {
+                            if(fn == unrestricted_fn) {
+                                this->EmitRealArgs(expr, 1, 1);
+                                this->EmitImportCall("Math", fn, 1);
+                                return ValueType::Real;
+                            }
+                        }
+
+                        if(fn == "exp") {
+                            const auto types = this->EmitArgs(expr, 1, 1);
+                            if(types.at(0) == ValueType::Complex) {
+                                // e^(a+bi) = e^a * (cos(b) + i*sin(b))
+                                const auto val = this->PopComplex();
+                                const auto mod = this->AllocateLocal(TypeF64);
+                                this->EmitLocal(op::LocalGet, val.idx);
+                                this->EmitImportCall("Math", "exp", 1);
+                                this->EmitLocal(op::LocalSet, mod);
+                                this->EmitLocal(op::LocalGet, mod);
+                                this->EmitLocal(op::LocalGet, val.im_idx);
+                                this->EmitImportCall("Math", "cos", 1);
+                                this->Emit(op::F64Mul);
+                                this->EmitLocal(op::LocalGet, mod);
+                                this->EmitLocal(op::LocalGet, val.im_idx);
+                                this->EmitImportCall("Math", "sin", 1);
+                                this->Emit(op::F64Mul);
+                                return ValueType::Complex;
+                            }
+                            this->EmitToReal(types.at(0));
+                            this->EmitImportCall("Math", "exp", 1);
+                            return ValueType::Real;
+                        }
+
+                        // Real functions with a restricted (real) domain
+                        if((fn == "log") || (fn == "log10") || (fn == "log2") || (fn == "log1p")) {
+                            this->EmitRealArgs(expr, 1, 1);
+                            if(is_mathjs) {
+                                this->EmitCheckedUnary(op::F64Lt, (fn == "log1p") ? -1.0 : 0.0, false);
+                            }
+                            this->EmitImportCall("Math", fn, 1);
+                            return ValueType::Real;
+                        }
+                        if((fn == "asin") || (fn == "acos") || (fn == "atanh")) {
+                            this->EmitRealArgs(expr, 1, 1);
+                            if(is_mathjs) {
+                                this->EmitCheckedUnary(op::F64Gt, 1.0, true);
+                            }
+                            this->EmitImportCall("Math", fn, 1);
+                            return ValueType::Real;
+                        }
+                        if(fn == "acosh") {
+                            this->EmitRealArgs(expr, 1, 1);
+                            if(is_mathjs) {
+                                this->EmitCheckedUnary(op::F64Lt, 1.0, false);
+                            }
+                            this->EmitImportCall("Math", fn, 1);
+                            return ValueType::Real;
+                        }
+                        if(fn == "atan2") {
+                            this->EmitRealArgs(expr, 2, 2);
+                            this->EmitImportCall("Math", fn, 2);
+                            return ValueType::Real;
+                        }
+                        if(fn == "pow") {
+                            this->EmitRealArgs(expr, 2, 2);
+                            if(is_mathjs) {
+                                // Negative bases with non-integer exponents give complex results
+                                const auto b = this->PopReal();
+                                const auto a = this->PopReal();
+                                this->EmitDomainCheck([&]() {
+                                    this->EmitLocal(op::LocalGet, a);
+                                    this->EmitF64(0.0);
+                                    this->Emit(op::F64Lt);
+                                    this->EmitLocal(op::LocalGet, b);
+                                    this->EmitLocal(op::LocalGet, b);
+                                    this->Emit(op::F64Trunc);
+                                    this->Emit(op::F64Ne);
+                                    this->Emit(op::I32And);
+                                });
+                                this->EmitLocal(op::LocalGet, a);
+                                this->EmitLocal(op::LocalGet, b);
+                            }
+                            this->EmitImportCall("Math", fn, 2);
+                            return ValueType::Real;
+                        }
+                        if(fn == "round") {
+                            // JS and math.js round halves differently
+                            this->EmitRealArgs(expr, 1, 1);
+                            this->EmitImportCall(ns, fn, 1);
+                            return ValueType::Real;
+                        }
+                    }
+
+                    if(is_mathjs) {
+                        if(fn == "nthRoot") {
+                            this->EmitRealArgs(expr, 1, 2);
+                            if(expr.args.size() == 1) {
+                                this->EmitF64(2.0);
+                            }
+                            const auto n = this->PopReal();
+                            const auto a = this->PopReal();
+                            // Only positive integer roots, where negative values are only valid for odd roots
+                            this->EmitDomainCheck([&]() {
+                                this->EmitLocal(op::LocalGet, n);
+                                this->EmitLocal(op::LocalGet, n);
+                                this->Emit(op::F64Trunc);
+                                this->Emit(op::F64Ne);
+                                this->EmitLocal(op::LocalGet, n);
+                                this->EmitF64(0.0);
+                                this->Emit(op::F64Le);
+                                this->Emit(op::I32Or);
+                                this->EmitLocal(op::LocalGet, a);
+                                this->EmitF64(0.0);
+                                this->Emit(op::F64Lt);
+                                this->EmitLocal(op::LocalGet, n);
+                                this->EmitLocal(op::LocalGet, n);
+                                this->EmitF64(0.5);
+                                this->Emit(op::F64Mul);
+                                this->Emit(op::F64Floor);
+                                this->EmitF64(2.0);
+                                this->Emit(op::F64Mul);
+                                this->Emit(op::F64Eq);
+                                this->Emit(op::I32And);
+                                this->Emit(op::I32Or);
+                            });
+                            this->EmitLocal(op::LocalGet, a);
+                            this->Emit(op::F64Abs);
+                            this->EmitF64(1.0);
+                            this->EmitLocal(op::LocalGet, n);
+                            this->Emit(op::F64Div);
+                            this->EmitImportCall("Math", "pow", 2);
+                            this->EmitLocal(op::LocalGet, a);
+                            this->Emit(op::F64Copysign);
+                            return ValueType::Real;
+                        }
+                        if((fn == "factorial") || (fn == "gamma")) {
+                            this->EmitRealArgs(expr, 1, 1);
+                            this->EmitImportCall("math", fn, 1);
+                            return ValueType::Real;
+                        }
+                        if((fn == "square") || (fn == "cube")) {
+                            this->EmitRealArgs(expr, 1, 1);
+                            const auto val = this->PopReal();
+                            this->EmitLocal(op::LocalGet, val);
+                            this->EmitLocal(op::LocalGet, val);
+                            this->Emit(op::F64Mul);
+                            if(fn == "cube") {
+                                this->EmitLocal(op::LocalGet, val);
+                                this->Emit(op::F64Mul);
+                            }
+                            return ValueType::Real;
+                        }
+                        if(fn == "mod") {
+                            // Floored modulo: a - b*floor(a/b)
+                            this->EmitRealArgs(expr, 2, 2);
+                            const auto b = this->PopReal();
+                            const auto a = this->PopReal();
+                            this->EmitLocal(op::LocalGet, a);
+                            this->EmitLocal(op::LocalGet, b);
+                            this->EmitLocal(op::LocalGet, a);
+                            this->EmitLocal(op::LocalGet, b);
+                            this->Emit(op::F64Div);
+                            this->Emit(op::F64Floor);
+                            this->Emit(op::F64Mul);
+                            this->Emit(op::F64Sub);
+                            return ValueType::Real;
+                        }
+
+                        // Complex number support
+                        if(fn == "complex") {
+                            const auto types = this->EmitArgs(expr, 1, 2);
+                            if(types.size() == 1) {
+                                this->EmitToComplex(types.at(0));
+                            }
+                            else {
+                                this->EmitToReal(types.at(1));
+                                const auto im = this->PopReal();
+                                this->EmitToReal(types.at(0));
+                                this->EmitLocal(op::LocalGet, im);
+                            }
+                            return ValueType::Complex;
+                        }
+                        if((fn == "add") || (fn == "multiply")) {
+                            return this->EmitVariadicComplexFold(expr, fn == "multiply");
+                        }
+                        if((fn == "subtract") || (fn == "divide")) {
+                            const auto types = this->EmitArgs(expr, 2, 2);
+                            if((types.at(0) != ValueType::Complex) && (types.at(1) != ValueType::Complex)) {
+                                this->EmitToReal(types.at(1));
+                                const auto b = this->PopReal();
+                                this->EmitToReal(types.at(0));
+                                this->EmitLocal(op::LocalGet, b);
+                                this->Emit((fn == "subtract") ? op::F64Sub : op::F64Div);
+                                return ValueType::Real;
+                            }
+                            this->EmitToComplex(types.at(1));
+                            const auto b = this->PopComplex();
+                            this->EmitToComplex(types.at(0));
+                            const auto a = this->PopComplex();
+                            if(fn == "subtract") {
+                                this->EmitLocal(op::LocalGet, a.idx);
+                                this->EmitLocal(op::LocalGet, b.idx);
+                                this->Emit(op::F64Sub);
+                                this->EmitLocal(op::LocalGet, a.im_idx);
+                                this->EmitLocal(op::LocalGet, b.im_idx);
+                                this->Emit(op::F64Sub);
+                            }
+                            else {
+                                this->EmitComplexDivide(a, b);
+                            }
+                            return ValueType::Complex;
+                        }
+                        if((fn == "re") || (fn == "im") || (fn == "conj") || (fn == "unaryMinus")) {
+                            const auto types = this->EmitArgs(expr, 1, 1);
+                            this->EmitToComplex(types.at(0));
+                            const auto val = this->PopComplex();
+                            if(fn == "re") {
+                                this->EmitLocal(op::LocalGet, val.idx);
+                                return ValueType::Real;
+                            }
+                            else if(fn == "im") {
+                                this->EmitLocal(op::LocalGet, val.im_idx);
+                                return ValueType::Real;
+                            }
+                            this->EmitLocal(op::LocalGet, val.idx);
+                            if(fn == "unaryMinus") {
+                                this->Emit(op::F64Neg);
+                            }
+                            this->EmitLocal(op::LocalGet, val.im_idx);
+                            this->Emit(op::F64Neg);
+                            return ValueType::Complex;
+                        }
+                    }
+
+                    // Special functions (see js_export.cpp)
+                    if(name == "gauss") {
+                        this->EmitRealArgs(expr, 4, 4);
+                        const auto a = this->PopReal();
+                        const auto k0 = this->PopReal();
+                        const auto x0 = this->PopReal();
+                        const auto x = this->PopReal();
+                        const auto rel_x = this->AllocateLocal(TypeF64);
+                        const auto amp = this->AllocateLocal(TypeF64);
+                        const auto phase = this->AllocateLocal(TypeF64);
+
+                        this->EmitLocal(op::LocalGet, x);
+                        this->EmitLocal(op::LocalGet, x0);
+                        this->Emit(op::F64Sub);
+                        this->EmitLocal(op::LocalSet, rel_x);
+
+                        // (2 / (pi * a²))^(1/4) * exp(-((x - x0) / a)²)
+                        this->EmitF64(2.0 / M_PI);
+                        this->EmitLocal(op::LocalGet, a);
+                        this->EmitLocal(op::LocalGet, a);
+                        this->Emit(op::F64Mul);
+                        this->Emit(op::F64Div);
+                        this->Emit(op::F64Sqrt);
+                        this->Emit(op::F64Sqrt);
+                        this->EmitLocal(op::LocalGet, rel_x);
+                        this->EmitLocal(op::LocalGet, a);
+                        this->Emit(op::F64Div);
+                        this->EmitLocal(op::LocalTee, amp);
+                        this->EmitLocal(op::LocalGet, amp);
+                        this->Emit(op::F64Mul);
+                        this->Emit(op::F64Neg);
+                        this->EmitImportCall("Math", "exp", 1);
+                        this->Emit(op::F64Mul);
+                        this->EmitLocal(op::LocalSet, amp);
+
+                        this->EmitLocal(op::LocalGet, k0);
+                        this->EmitLocal(op::LocalGet, rel_x);
+                        this->Emit(op::F64Mul);
+                        this->EmitLocal(op::LocalSet, phase);
+
+                        this->EmitLocal(op::LocalGet, amp);
+                        this->EmitLocal(op::LocalGet, phase);
+                        this->EmitImportCall("Math", "cos", 1);
+                        this->Emit(op::F64Mul);
+                        this->EmitLocal(op::LocalGet, amp);
+                        this->EmitLocal(op::LocalGet, phase);
+                        this->EmitImportCall("Math", "sin", 1);
+                        this->Emit(op::F64Mul);
+                        return ValueType::Complex;
+                    }
+                    if(name == "delta") {
+                        this->EmitRealArgs(expr, 3, 3);
+                        const auto val = this->PopReal();
+                        const auto x0 = this->PopReal();
+                        const auto x = this->PopReal();
+                        this->EmitLocal(op::LocalGet, val);
+                        this->EmitF64(0.0);
+                        this->EmitLocal(op::LocalGet, x);
+                        this->EmitLocal(op::LocalGet, x0);
+                        this->Emit(op::F64Sub);
+                        this->Emit(op::F64Abs);
+                        this->Emit(op::GlobalGet);
+                        WriteUleb(this->code, this->ImportGlobal("dx"));
+                        this->Emit(op::F64Le);
+                        this->Emit(op::Select);
+                        return ValueType::Real;
+                    }
+                    if((name == "hermite") || (name == "hermite_fn")) {
+                        this->EmitRealArgs(expr, 2, 2);
+                        this->EmitImportCall("window", name, 2);
+                        return ValueType::Real;
+                    }
+
+                    Fail("unsupported function '" + name + "'");
+                }
+
+                ValueType EmitExpr(const Expr &expr) {
+                    switch(expr.kind) {
+                        case ExprKind::Number: {
+                            this->EmitF64(expr.num);
+                            return ValueType::Real;
+                        }
+                        case ExprKind::Identifier: {
+                            return this->EmitIdentifier(expr);
+                        }
+                        case ExprKind::Unary: {
+                            return this->EmitUnary(expr);
+                        }
+                        case ExprKind::Binary: {
+                            return this->EmitBinary(expr);
+                        }
+                        case ExprKind::Logical: {
+                            return this->EmitLogical(expr);
+                        }
+                        case ExprKind::Conditional: {
+                            return this->EmitConditional(expr);
+                        }
+                        case ExprKind::Call: {
+                            return this->EmitCall(expr);
+                        }
+                    }
+                    Fail("unsupported expression");
+                }
+
+                void EmitStore(const Local &target, const ValueType type) {
+                    this->EmitConvert(type, target.type);
+                    if(target.type == ValueType::Complex) {
+                        this->EmitLocal(op::LocalSet, target.im_idx);
+                    }
+                    this->EmitLocal(op::LocalSet, target.idx);
+                }
+
+                void EmitReturn(const Expr &expr) {
+                    const auto type = this->EmitExpr(expr);
+                    if(type == ValueType::Bool) {
+                        Fail("boolean return values are not supported");
+                    }
+
+                    if(this->kind == GridFunctionKind::Psi0) {
+                        this->EmitToComplex(type);
+                        const auto val = this->PopComplex();
+                        // Complex output values are 16 bytes each
+                        for(int part = 0; part < 2; part++) {
+                            this->EmitLocal(op::LocalGet, this->out_ptr_param);
+                            this->EmitLocal(op::LocalGet, this->i_local);
+                            this->EmitI32(4);
+                            this->Emit(op::I32Shl);
+                            this->Emit(op::I32Add);
+                            this->EmitLocal(op::LocalGet, part ? val.im_idx : val.idx);
+                            this->EmitMemory(op::F64Store, part * sizeof(double));
+                        }
+                    }
+                    else {
+                        if(type == ValueType::Complex) {
+                            Fail("V must be real-valued");
+                        }
+                        const auto val = this->PopReal();
+                        // Non-finite values are left to JS too, which rejects them like any other sample (val - val is only NaN for Inf/NaN values)
+                        this->EmitLocal(op::LocalGet, val);
+                        this->EmitLocal(op::LocalGet, val);
+                        this->Emit(op::F64Sub);
+                        this->EmitF64(0.0);
+                        this->Emit(op::F64Ne);
+                        this->EmitFailIf();
+                        this->EmitLocal(op::LocalGet, this->out_ptr_param);
+                        this->EmitLocal(op::LocalGet, this->i_local);
+                        this->EmitI32(3);
+                        this->Emit(op::I32Shl);
+                        this->Emit(op::I32Add);
+                        this->EmitLocal(op::LocalGet, val);
+                        this->EmitMemory(op::F64Store, 0);
+                    }
+                    this->EmitBranch(op::Br, this->ret_depth);
+                }
+
+                void EmitStatement(const Stmt &stmt) {
+                    switch(stmt.kind) {
+                        case StmtKind::Block: {
+                            for(const auto &sub_stmt: stmt.body) {
+                                this->EmitStatement(*sub_stmt);
+                            }
+                            break;
+                        }
+                        case StmtKind::If: {
+                            this->EmitCondition(*stmt.expr);
+                            this->EmitBeginBlock(op::If, BlockVoid);
+                            this->EmitStatement(*stmt.then_stmt);
+                            if(stmt.else_stmt != nullptr) {
+                                this->Emit(op::Else);
+                                this->EmitStatement(*stmt.else_stmt);
+                            }
+                            this->EmitEndBlock();
+                            break;
+                        }
+                        case StmtKind::Return: {
+                            this->EmitReturn(*stmt.expr);
+                            break;
+                        }
+                        case StmtKind::Declare: {
+                            const auto type = this->EmitExpr(*stmt.expr);
+                            auto it = this->locals.find(stmt.name);
+                            if(it == this->locals.end()) {
+                                Local local = {};
+                                local.type = type;
+                                local.idx = this->AllocateLocal((type == ValueType::Bool) ? TypeI32 : TypeF64);
+                                if(type == ValueType::Complex) {
+                                    local.im_idx = this->AllocateLocal(TypeF64);
+                                }
+                                it = this->locals.emplace(stmt.name, local).first;
+                            }
+                            else if((it->second.type != type) && !((it->second.type == ValueType::Real) && (type == ValueType::Bool))) {
+                                Fail("variable '" + stmt.name + "' is redeclared with a different type");
+                            }
+                            this->EmitStore(it->second, type);
+                            break;
+                        }
+                        case StmtKind::Assign: {
+                            const auto it = this->locals.find(stmt.name);
+                            if(it == this->locals.end()) {
+                                Fail("only local variables can be assigned ('" + stmt.name + "')");
+                            }
+                            const auto type = this->EmitExpr(*stmt.expr);
+                            if((it->second.type == ValueType::Bool) && (type != ValueType::Bool)) {
+                                Fail("variable '" + stmt.name + "' is assigned with a different type");
+                            }
+                            this->EmitStore(it->second, type);
+                            break;
+                        }
+                    }
+                }
+
+            public:
+                GridCompiler(const Program &program, const GridFunctionKind kind) : program(program), kind(kind), param_count(0), depth(0), ret_depth(0), fail_depth(0), i_local(0), out_ptr_param(0) {}
+
+                std::vector<uint8_t> Compile(const WasmMemoryImport &mem_import) {
+                    const auto fn_name = (this->kind == GridFunctionKind::Psi0) ? "psi0" : "V";
+                    const auto fn = this->program.FindFunction(fn_name);
+                    if(fn == nullptr) {
+                        Fail(std::string("function '") + fn_name + "' is not defined");
+                    }
+
+                    // Parameters of the generated function
+                    std::vector<uint8_t> param_types;
+                    constexpr uint32_t x_ptr_param = 0;
+                    constexpr uint32_t count_param = 1;
+                    uint32_t t_param = 0;
+                    if(this->kind == GridFunctionKind::Psi0) {
+                        if(fn->params.size() > 1) {
+                            Fail("psi0 must take at most one parameter (x)");
+                        }
+                        param_types = { TypeI32, TypeI32, TypeI32 };
+                        this->out_ptr_param = 2;
+                    }
+                    else {
+                        if(fn->params.size() > 2) {
+                            Fail("V must take at most two parameters (x, t)");
+                        }
+                        param_types = { TypeI32, TypeI32, TypeF64, TypeI32 };
+                        t_param = 2;
+                        this->out_ptr_param = 3;
+                    }
+                    this->param_count = param_types.size();
+
+                    this->i_local = this->AllocateLocal(TypeI32);
+                    const auto x_local = this->AllocateLocal(TypeF64);
+                    if(fn->params.size() > 0) {
+                        this->locals[fn->params.at(0)] = { ValueType::Real, x_local, 0 };
+                    }
+                    if(fn->params.size() > 1) {
+                        // Copy t into a local, so that it can be reassigned like any other JS parameter
+                        const auto t_local = this->AllocateLocal(TypeF64);
+                        this->locals[fn->params.at(1)] = { ValueType::Real, t_local, 0 };
+                        this->EmitLocal(op::LocalGet, t_param);
+                        this->EmitLocal(op::LocalSet, t_local);
+                    }
+
+                    this->EmitBeginBlock(op::Block, BlockVoid);
+                    const auto exit_depth = this->depth;
+                    this->EmitBeginBlock(op::Block, BlockVoid);
+                    this->fail_depth = this->depth;
+                    this->EmitBeginBlock(op::Loop, BlockVoid);
+                    const auto loop_depth = this->depth;
+
+                    this->EmitLocal(op::LocalGet, this->i_local);
+                    this->EmitLocal(op::LocalGet, count_param);
+                    this->Emit(op::I32GeS);
+                    this->EmitBranch(op::BrIf, exit_depth);
+
+                    this->EmitLocal(op::LocalGet, x_ptr_param);
+                    this->EmitLocal(op::LocalGet, this->i_local);
+                    this->EmitI32(3);
+                    this->Emit(op::I32Shl);
+                    this->Emit(op::I32Add);
+                    this->EmitMemory(op::F64Load, 0);
+                    this->EmitLocal(op::LocalSet, x_local);
+
+                    this->EmitBeginBlock(op::Block, BlockVoid);
+                    this->ret_depth = this->depth;
+                    this->EmitStatement(*fn->body);
+                    // Reaching the end of the function means no value was returned
+                    this->EmitBranch(op::Br, this->fail_depth);
+                    this->EmitEndBlock();
+
+                    this->EmitLocal(op::LocalGet, this->i_local);
+                    this->EmitI32(1);
+                    this->Emit(op::I32Add);
+                    this->EmitLocal(op::LocalSet, this->i_local);
+                    this->EmitBranch(op::Br, loop_depth);
+                    this->EmitEndBlock();
+                    this->EmitEndBlock();
+
+                    // Failure: report the sample index
+                    this->EmitLocal(op::LocalGet, this->i_local);
+                    this->Emit(op::Return);
+                    this->EmitEndBlock();
+
+                    this->EmitI32(-1);
+                    this->Emit(op::End);
+
+                    return this->AssembleModule(mem_import, param_types);
+                }
+
+                std::vector<uint8_t> AssembleModule(const WasmMemoryImport &mem_import, const std::vector<uint8_t> &param_types) {
+                    std::vector<uint8_t> module = { 0x00, 'a', 's', 'm', 0x01, 0x00, 0x00, 0x00 };
+
+                    // Types: the exported function first, then one (f64^n) -> f64 type per import arity
+                    std::map<uint32_t, uint32_t> arity_types;
+                    for(const auto &fn_import: this->fn_imports) {
+                        arity_types.emplace(fn_import.arity, 0);
+                    }
+                    std::vector<uint8_t> type_section;
+                    WriteUleb(type_section, 1 + arity_types.size());
+                    type_section.push_back(TypeFunc);
+                    WriteUleb(type_section, param_types.size());
+                    type_section.insert(type_section.end(), param_types.begin(), param_types.end());
+                    WriteUleb(type_section, 1);
+                    type_section.push_back(TypeI32);
+                    uint32_t type_idx = 1;
+                    for(auto &[arity, arity_type_idx]: arity_types) {
+                        arity_type_idx = type_idx++;
+                        type_section.push_back(TypeFunc);
+                        WriteUleb(type_section, arity);
+                        for(uint32_t i = 0; i < arity; i++) {
+                            type_section.push_back(TypeF64);
+                        }
+                        WriteUleb(type_section, 1);
+                        type_section.push_back(TypeF64);
+                    }
+                    WriteSection(module, SectionType, type_section);
+
+                    std::vector<uint8_t> import_section;
+                    WriteUleb(import_section, 1 + this->fn_imports.size() + this->global_imports.size());
+                    WriteName(import_section, "env");
+                    WriteName(import_section, "memory");
+                    import_section.push_back(ImportKindMemory);
+                    if(mem_import.shared) {
+                        import_section.push_back(0x03);
+                        WriteUleb(import_section, 1);
+                        WriteUleb(import_section, mem_import.max_pages);
+                    }
+                    else {
+                        import_section.push_back(0x00);
+                        WriteUleb(import_section, 1);
+                    }
+                    for(const auto &fn_import: this->fn_imports) {
+                        WriteName(import_section, fn_import.module);
+                        WriteName(import_section, fn_import.name);
+                        import_section.push_back(ImportKindFunction);
+                        WriteUleb(import_section, arity_types.at(fn_import.arity));
+                    }
+                    for(const auto &global_import: this->global_imports) {
+                        WriteName(import_section, "window");
+                        WriteName(import_section, global_import);
+                        import_section.push_back(ImportKindGlobal);
+                        import_section.push_back(TypeF64);
+                        import_section.push_back(0x00);
+                    }
+                    WriteSection(module, SectionImport, import_section);
+
+                    std::vector<uint8_t> function_section;
+                    WriteUleb(function_section, 1);
+                    WriteUleb(function_section, 0);
+                    WriteSection(module, SectionFunction, function_section);
+
+                    std::vector<uint8_t> export_section;
+                    WriteUleb(export_section, 1);
+                    WriteName(export_section, "run");
+                    export_section.push_back(ExportKindFunction);
+                    WriteUleb(export_section, this->fn_imports.size());
+                    WriteSection(module, SectionExport, export_section);
+
+                    std::vector<uint8_t> body;
+                    WriteUleb(body, this->local_types.size());
+                    for(const auto local_type: this->local_types) {
+                        WriteUleb(body, 1);
+                        body.push_back(local_type);
+                    }
+                    body.insert(body.end(), this->code.begin(), this->code.end());
+                    std::vector<uint8_t> code_section;
+                    WriteUleb(code_section, 1);
+                    WriteUleb(code_section, body.size());
+                    code_section.insert(code_section.end(), body.begin(), body.end());
+                    WriteSection(module, SectionCode, code_section);
+
+                    return module;
+                }
+        };
+
+    }
+
+    bool GenerateWasmGridModule(const Program &program, const GridFunctionKind kind, const WasmMemoryImport &mem_import, std::vector<uint8_t> &out_module, std::string &out_error) {
+        try {
+            GridCompiler compiler(program, kind);
+            out_module = compiler.Compile(mem_import);
+            return true;
+        }
+        catch(CompileError &e) {
+            out_error = e.msg;
+            return false;
+        }
+    }
+
+}
@@ -0,0 +1,315 @@
+#include "table.hpp"
+#include <fstream>
+
+#ifndef __EMSCRIPTEN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    inline bool IsCsvSeparator(const char c) {
+        return (c == ',') || (c == ';') || (c == ' ') || (c == '\t') || (c == '\r');
+    }
+
+    // Parses up to 3 numbers from a CSV line, returns how many were found (or -1 if the line has non-numeric content)
+    int ParseCsvLine(const char *line, const char *line_end, double (&out_vals)[3]) {
+        std::string line_str(line, line_end);
+        const char *cur = line_str.c_str();
+        int val_count = 0;
+        while(*cur != '\0') {
+            if(IsCsvSeparator(*cur)) {
+                cur++;
+                continue;
+            }
+            if(val_count == 3) {
+                return -1;
+            }
+
+            char *num_end;
+            const auto val = strtod(cur, &num_end);
+            if(num_end == cur) {
+                return -1;
+            }
+            out_vals[val_count] = val;
+            val_count++;
+            cur = num_end;
+        }
+        return val_count;
+    }
+
+}
+
+bool ParseInterpolationKind(const std::string &name, InterpolationKind &out_kind) {
+    for(size_t i = 0; i < std::size(InterpolationKindNames); i++) {
+        if(name == InterpolationKindNames[i]) {
+            out_kind = static_cast<InterpolationKind>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SampleTable::LoadBinary(const uint8_t *data, const size_t data_size, const bool can_reference, std::string &out_error) {
+    if(data_size < sizeof(SampleTableHeader)) {
+        out_error = "binary table is too small";
+        return false;
+    }
+
+    SampleTableHeader header;
+    memcpy(&header, data, sizeof(header));
+    if(header.version != SampleTableVersion) {
+        out_error = "unsupported binary table version " + std::to_string(header.version);
+        return false;
+    }
+    if((header.column_count != 2) && (header.column_count != 3)) {
+        out_error = "binary table must have 2 (x, re) or 3 (x, re, im) columns";
+        return false;
+    }
+    if((data_size - sizeof(header)) / sizeof(double) / header.column_count < header.sample_count) {
+        out_error = "binary table is truncated";
+        return false;
+    }
+
+    this->count = header.sample_count;
+    this->is_complex = header.column_count == 3;
+
+    const double *columns;
+    if(can_reference) {
+        // Reference the mapped file directly, no copies involved
+        columns = reinterpret_cast<const double*>(data + sizeof(header));
+    }
+    else {
+        this->owned_data.resize(header.column_count * this->count);
+        memcpy(this->owned_data.data(), data + sizeof(header), this->owned_data.size() * sizeof(double));
+        columns = this->owned_data.data();
+    }
+
+    this->x_data = columns;
+    this->re_data = columns + this->count;
+    this->im_data = this->is_complex ? (columns + 2 * this->count) : nullptr;
+    return true;
+}
+
+bool SampleTable::LoadCsv(const char *data, const size_t data_size, std::string &out_error) {
+    std::vector<double> x_col;
+    std::vector<double> re_col;
+    std::vector<double> im_col;
+    int column_count = 0;
+
+    const auto data_end = data + data_size;
+    auto line = data;
+    size_t line_no = 0;
+    while(line < data_end) {
+        auto line_end = static_cast<const char*>(memchr(line, '\n', data_end - line));
+        if(line_end == nullptr) {
+            line_end = data_end;
+        }
+        line_no++;
+
+        if((line_end > line) && (*line != '#')) {
+            double vals[3];
+            const auto val_count = ParseCsvLine(line, line_end, vals);
+            if(val_count < 0) {
+                // Allow column name headers before any data
+                if(!x_col.empty()) {
+                    out_error = "invalid CSV table line " + std::to_string(line_no);
+                    return false;
+                }
+            }
+            else if(val_count > 0) {
+                if(column_count == 0) {
+                    column_count = val_count;
+                    if(column_count < 2) {
+                        out_error = "CSV table must have 2 (x, re) or 3 (x, re, im) columns";
+                        return false;
+                    }
+                }
+                else if(val_count != column_count) {
+                    out_error = "inconsistent column count in CSV table line " + std::to_string(line_no);
+                    return false;
+                }
+
+                x_col.push_back(vals[0]);
+                re_col.push_back(vals[1]);
+                if(column_count == 3) {
+                    im_col.push_back(vals[2]);
+                }
+            }
+        }
+
+        line = line_end + 1;
+    }
+
+    this->count = x_col.size();
+    this->is_complex = column_count == 3;
+    this->owned_data = std::move(x_col);
+    this->owned_data.insert(this->owned_data.end(), re_col.begin(), re_col.end());
+    this->owned_data.insert(this->owned_data.end(), im_col.begin(), im_col.end());
+    this->x_data = this->owned_data.data();
+    this->re_data = this->owned_data.data() + this->count;
+    this->im_data = this->is_complex ? (this->owned_data.data() + 2 * this->count) : nullptr;
+    return true;
+}
+
+void SampleTable::Unmap() {
+    #ifndef __EMSCRIPTEN__
+    if(this->map_addr != nullptr) {
+        munmap(this->map_addr, this->map_size);
+    }
+    #endif
+    this->map_addr = nullptr;
+    this->map_size = 0;
+}
+
+bool SampleTable::Load(const std::string &path, std::string &out_error) {
+    this->Unmap();
+    this->owned_data.clear();
+    this->path = path;
+    this->count = 0;
+
+    const uint8_t *data;
+    size_t data_size;
+
+    #ifdef __EMSCRIPTEN__
+    // No mmap support in the browser (files are already in memory anyway)
+    std::ifstream file(path, std::ios::binary);
+    if(!file) {
+        out_error = "unable to open table file '" + path + "'";
+        return false;
+    }
+    const std::vector<uint8_t> file_data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    data = file_data.data();
+    data_size = file_data.size();
+    constexpr bool can_reference = false;
+    #else
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        out_error = "unable to open table file '" + path + "'";
+        return false;
+    }
+    struct stat st;
+    if((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+        close(fd);
+        out_error = "unable to read table file '" + path + "'";
+        return false;
+    }
+    this->map_size = st.st_size;
+    this->map_addr = mmap(nullptr, this->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(this->map_addr == MAP_FAILED) {
+        this->map_addr = nullptr;
+        out_error = "unable to map table file '" + path + "'";
+        return false;
+    }
+    data = static_cast<const uint8_t*>(this->map_addr);
+    data_size = this->map_size;
+    constexpr bool can_reference = true;
+    #endif
+
+    this->hash = HashFnv1a(data, data_size);
+
+    bool load_ok;
+    if((data_size >= sizeof(SampleTableMagic)) && (memcmp(data, SampleTableMagic, sizeof(SampleTableMagic)) == 0)) {
+        load_ok = this->LoadBinary(data, data_size, can_reference, out_error);
+        if(!can_reference) {
+            this->Unmap();
+        }
+    }
+    else {
+        // CSV samples are always parsed into owned memory, so the mapping is no longer needed
+        load_ok = this->LoadCsv(reinterpret_cast<const char*>(data), data_size, out_error);
+        this->Unmap();
+    }
+    if(!load_ok) {
+        this->Unmap();
+        this->count = 0;
+        return false;
+    }
+
+    if(this->count < 2) {
+        out_error = "table must have at least 2 samples";
+        this->Unmap();
+        this->count = 0;
+        return false;
+    }
+    for(size_t i = 1; i < this->count; i++) {
+        if(!(this->x_data[i] > this->x_data[i - 1])) {
+            out_error = "table x values must be strictly ascending (sample " + std::to_string(i) + ")";
+            this->Unmap();
+            this->count = 0;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SampleTable::ResampleColumn(const double *y_data, const Vector &x_vec, const InterpolationKind interp, const bool zero_outside, Vector &out_vec) const {
+    out_vec.resize(x_vec.size());
+
+    // Both the table and the simulation grid are sorted, so a single merge-like sweep finds every interval
+    const auto last = this->count - 1;
+    size_t j = 0;
+    for(long i = 0; i < x_vec.size(); i++) {
+        const auto x = x_vec(i);
+        if(x <= this->x_data[0]) {
+            out_vec(i) = ((x < this->x_data[0]) && zero_outside) ? 0.0 : y_data[0];
+            continue;
+        }
+        if(x >= this->x_data[last]) {
+            out_vec(i) = ((x > this->x_data[last]) && zero_outside) ? 0.0 : y_data[last];
+            continue;
+        }
+
+        while(this->x_data[j + 1] < x) {
+            j++;
+        }
+
+        const auto x_a = this->x_data[j];
+        const auto x_b = this->x_data[j + 1];
+        const auto h = x_b - x_a;
+        const auto s = (x - x_a) / h;
+        const auto y_a = y_data[j];
+        const auto y_b = y_data[j + 1];
+
+        if(interp == InterpolationKind::Linear) {
+            out_vec(i) = y_a + s * (y_b - y_a);
+        }
+        else {
+            // Cubic Hermite spline with finite difference slopes (one-sided at the table ends)
+            const auto m_a = (j > 0) ? ((y_b - y_data[j - 1]) / (x_b - this->x_data[j - 1])) : ((y_b - y_a) / h);
+            const auto m_b = (j + 1 < last) ? ((y_data[j + 2] - y_a) / (this->x_data[j + 2] - x_a)) : ((y_b - y_a) / h);
+            const auto s2 = s * s;
+            const auto s3 = s2 * s;
+            out_vec(i) = (2 * s3 - 3 * s2 + 1) * y_a + (s3 - 2 * s2 + s) * h * m_a + (-2 * s3 + 3 * s2) * y_b + (s3 - s2) * h * m_b;
+        }
+    }
+}
+
+void SampleTable::Resample(const Vector &x_vec, const InterpolationKind interp, const bool zero_outside, Vector &out_vec) const {
+    this->ResampleColumn(this->re_data, x_vec, interp, zero_outside, out_vec);
+}
+
+void SampleTable::Resample(const Vector &x_vec, const InterpolationKind interp, const bool zero_outside, CVector &out_vec) const {
+    Vector re_vec;
+    this->ResampleColumn(this->re_data, x_vec, interp, zero_outside, re_vec);
+    out_vec.resize(x_vec.size());
+    out_vec.real() = re_vec;
+    if(this->is_complex) {
+        Vector im_vec;
+        this->ResampleColumn(this->im_data, x_vec, interp, zero_outside, im_vec);
+        out_vec.imag() = im_vec;
+    }
+    else {
+        out_vec.imag().setZero();
+    }
+}
+
+std::string SampleTable::GetHashString() const {
+    char hash_str[17] = {};
+    snprintf(hash_str, sizeof(hash_str), "%016llx", static_cast<unsigned long long>(this->hash));
+    return hash_str;
+}
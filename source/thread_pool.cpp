@@ -0,0 +1,87 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(const size_t worker_count) : cur_fn(nullptr), cur_count(0), next_idx(0), generation(0), busy_worker_count(0), stopping(false) {
+    #if _THREAD_POOL_THREADED
+    for(size_t i = 0; i < worker_count; i++) {
+        this->workers.emplace_back(&ThreadPool::WorkerMain, this, i + 1);
+    }
+    #endif
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::scoped_lock lk(this->lock);
+        this->stopping = true;
+    }
+    this->start_cv.notify_all();
+    for(auto &worker: this->workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::RunLoop(const size_t thread_idx) {
+    while(true) {
+        const auto idx = this->next_idx.fetch_add(1);
+        if(idx >= this->cur_count) {
+            break;
+        }
+        (*this->cur_fn)(idx, thread_idx);
+    }
+}
+
+void ThreadPool::WorkerMain(const size_t thread_idx) {
+    size_t last_generation = 0;
+    while(true) {
+        {
+            std::unique_lock lk(this->lock);
+            this->start_cv.wait(lk, [&]() {
+                return this->stopping || (this->generation != last_generation);
+            });
+            if(this->stopping) {
+                return;
+            }
+            last_generation = this->generation;
+        }
+
+        this->RunLoop(thread_idx);
+
+        {
+            std::scoped_lock lk(this->lock);
+            this->busy_worker_count--;
+        }
+        this->done_cv.notify_one();
+    }
+}
+
+void ThreadPool::ParallelFor(const size_t count, const LoopFunction &fn) {
+    if(this->workers.empty() || (count <= 1)) {
+        for(size_t i = 0; i < count; i++) {
+            fn(i, 0);
+        }
+        return;
+    }
+
+    {
+        std::scoped_lock lk(this->lock);
+        this->cur_fn = &fn;
+        this->cur_count = count;
+        this->next_idx = 0;
+        this->busy_worker_count = this->workers.size();
+        this->generation++;
+    }
+    this->start_cv.notify_all();
+
+    this->RunLoop(0);
+
+    std::unique_lock lk(this->lock);
+    this->done_cv.wait(lk, [&]() {
+        return this->busy_worker_count == 0;
+    });
+    this->cur_fn = nullptr;
+}
+
+ThreadPool &GetThreadPool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
@@ -0,0 +1,103 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+    std::atomic_bool g_Enabled = false;
+
+}
+
+namespace {
+
+    struct TraceEvent {
+        const char *name;
+        double start_time;
+        double duration;
+        uint32_t thread_id;
+    };
+
+    std::vector<TraceEvent> g_TraceEvents;
+    // Total events recorded since the last clear (the ring slot being this modulo the capacity)
+    std::atomic_size_t g_TraceEventCount = 0;
+    // Slots are written under it, so that saving copies whole events even while the simulation keeps recording (a few events per iteration, thus uncontended)
+    std::mutex g_TraceEventsLock;
+    std::atomic_uint32_t g_NextTraceThreadId = 1;
+
+    inline uint32_t GetTraceThreadId() {
+        thread_local const auto thread_id = g_NextTraceThreadId.fetch_add(1);
+        return thread_id;
+    }
+
+}
+
+namespace trace {
+
+    void SetEnabled(const bool enabled) {
+        if(enabled && g_TraceEvents.empty()) {
+            g_TraceEvents.resize(EventCapacity);
+        }
+        g_Enabled.store(enabled, std::memory_order_release);
+    }
+
+    void Clear() {
+        std::scoped_lock lk(g_TraceEventsLock);
+        g_TraceEventCount = 0;
+    }
+
+    size_t GetEventCount() {
+        return std::min(g_TraceEventCount.load(), EventCapacity);
+    }
+
+    void RecordEvent(const char *name, const double start_time_ms, const double end_time_ms) {
+        const TraceEvent event = { name, start_time_ms, end_time_ms - start_time_ms, GetTraceThreadId() };
+        std::scoped_lock lk(g_TraceEventsLock);
+        const auto idx = g_TraceEventCount.fetch_add(1, std::memory_order_relaxed) % EventCapacity;
+        g_TraceEvents[idx] = event;
+    }
+
+    bool SaveJson(const std::string &path, std::string &out_error) {
+        std::vector<TraceEvent> events;
+        events.reserve(EventCapacity);
+        {
+            // Snapshot of the ring, everything else is done without holding the lock
+            std::scoped_lock lk(g_TraceEventsLock);
+            const auto total_count = g_TraceEventCount.load();
+            const auto count = std::min(total_count, EventCapacity);
+            const auto first_idx = total_count - count;
+            for(size_t i = 0; i < count; i++) {
+                events.push_back(g_TraceEvents[(first_idx + i) % EventCapacity]);
+            }
+        }
+        // Events are recorded as they end, thus nested ones come before their parents
+        std::stable_sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) {
+            return a.start_time < b.start_time;
+        });
+
+        std::ofstream file(path);
+        if(!file) {
+            out_error = "unable to open '" + path + "'";
+            return false;
+        }
+
+        // Complete ("X") events, with timestamps in microseconds
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        char event_str[256];
+        for(size_t i = 0; i < events.size(); i++) {
+            const auto &event = events[i];
+            snprintf(event_str, sizeof(event_str), "%s\n{\"name\":\"%s\",\"cat\":\"quantize\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", (i > 0) ? "," : "", event.name, event.thread_id, event.start_time * 1000.0, event.duration * 1000.0);
+            file << event_str;
+        }
+        file << "\n]}\n";
+
+        if(!file) {
+            out_error = "unable to write '" + path + "'";
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,60 @@
+#include "wigner.hpp"
+#include "fft.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+
+void WignerDistribution::Compute(const CVector &psi_vec, const double x_0, const double dx, const double hslash, const size_t row_count, const size_t momentum_count) {
+    const auto n = static_cast<size_t>(psi_vec.size());
+    this->row_count = std::min(row_count, n);
+    this->momentum_count = momentum_count;
+    this->values.resize(this->row_count * momentum_count);
+    if(this->row_count == 0) {
+        this->max_abs_value = 0;
+        return;
+    }
+
+    // The lag is 2y, thus the p range is half the usual Nyquist one: p_k = πħk / (M dx)
+    const auto dp = (M_PI * hslash) / (momentum_count * dx);
+    this->x_0 = x_0;
+    this->x_f = x_0 + (n - 1) * dx;
+    this->p_max = (momentum_count / 2) * dp;
+
+    // Every thread uses its own buffers with the same plan
+    const auto plan = GetFftPlan(momentum_count);
+    auto &pool = GetThreadPool();
+    this->thread_buffers.resize(pool.GetThreadCount());
+    this->thread_scratches.resize(pool.GetThreadCount());
+
+    const auto half_m = static_cast<long>(momentum_count / 2);
+    const auto factor = dx / (M_PI * hslash);
+    pool.ParallelFor(this->row_count, [&](const size_t row, const size_t thread_idx) {
+        const auto xi = static_cast<long>((this->row_count > 1) ? (row * (n - 1)) / (this->row_count - 1) : 0);
+        auto &buf = this->thread_buffers[thread_idx];
+        buf.resize(momentum_count);
+
+        // Lags in FFT order (l >= 0 first, then the negative ones)
+        for(size_t i = 0; i < momentum_count; i++) {
+            const auto l = (static_cast<long>(i) < half_m) ? static_cast<long>(i) : (static_cast<long>(i) - static_cast<long>(momentum_count));
+            const auto xi_minus = xi - l;
+            const auto xi_plus = xi + l;
+            if((xi_minus < 0) || (xi_plus < 0) || (xi_minus >= static_cast<long>(n)) || (xi_plus >= static_cast<long>(n))) {
+                buf[i] = 0.0;
+            }
+            else {
+                buf[i] = std::conj(psi_vec(xi_minus)) * psi_vec(xi_plus);
+            }
+        }
+        plan->Forward(buf.data(), buf.data(), this->thread_scratches[thread_idx]);
+
+        for(size_t col = 0; col < momentum_count; col++) {
+            const auto k = static_cast<long>(col) - half_m;
+            const auto val = buf[(k + momentum_count) % momentum_count].real() * factor;
+            this->values[(momentum_count - 1 - col) * this->row_count + row] = val;
+        }
+    });
+
+    this->max_abs_value = 0;
+    for(const auto val: this->values) {
+        this->max_abs_value = std::max(this->max_abs_value, std::abs(val));
+    }
+}